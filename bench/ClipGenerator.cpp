@@ -0,0 +1,244 @@
+#include <filesystem>
+#include <iostream>
+#include "ClipGenerator.h"
+
+extern "C" {
+#include <libavfilter/buffersink.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+std::string ClipSpec::getFilename() const {
+    std::string filename = codec + "_" + std::to_string(width) + "x" + std::to_string(height) + "_" + std::to_string(fps) + "fps_gop"
+        + std::to_string(gopSize) + "_" + std::to_string(static_cast<int>(seconds)) + "s";
+    if (isVariableFrameRate) filename += "_vfr";
+    return filename + ".mkv";
+}
+
+ClipGenerator::ClipGenerator(const ClipSpec& spec) : m_spec(spec) { }
+
+ClipGenerator::~ClipGenerator() {
+    close();
+}
+
+bool ClipGenerator::generate(const std::string& path) {
+    close();
+    std::string temporaryPath = path + ".tmp";
+    if (avformat_alloc_output_context2(&m_formatContext, nullptr, "matroska", temporaryPath.c_str()) < 0 || !m_formatContext) {
+        std::cerr << "Could not create an output container for: " << path << std::endl;
+        return false;
+    }
+    if (!openVideo() || !openAudio()) return false;
+
+    if (avio_open(&m_formatContext->pb, temporaryPath.c_str(), AVIO_FLAG_WRITE) < 0) {
+        std::cerr << "Could not open output file: " << temporaryPath << std::endl;
+        return false;
+    }
+    if (avformat_write_header(m_formatContext, nullptr) < 0) {
+        std::cerr << "Could not write the header of: " << temporaryPath << std::endl;
+        return false;
+    }
+
+    // Encode whichever stream is behind, so the file is interleaved like a real recording
+    m_packet = av_packet_alloc();
+    while (!m_video.isFinished || !m_audio.isFinished) {
+        bool isVideoNext = m_audio.isFinished || (!m_video.isFinished && av_compare_ts(m_video.lastPts, m_video.codecContext->time_base,
+            m_audio.lastPts, m_audio.codecContext->time_base) <= 0);
+        if (!encodeNext(isVideoNext ? m_video : m_audio)) return false;
+    }
+
+    if (av_write_trailer(m_formatContext) < 0) {
+        std::cerr << "Could not finish writing: " << temporaryPath << std::endl;
+        return false;
+    }
+    close();
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::cerr << "Could not move the generated clip to: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ClipGenerator::openVideo() {
+    const AVCodec* codec = avcodec_find_encoder_by_name(m_spec.codec.c_str());
+    if (!codec) {
+        std::cerr << "Video encoder " << m_spec.codec << " is not available." << std::endl;
+        return false;
+    }
+
+    // The encoder's preferred format, e.g. full range YUV for MJPEG. The filter graph converts the test picture to it.
+    AVPixelFormat pixelFormat = codec->pix_fmts ? codec->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+    std::string description = "testsrc=size=" + std::to_string(m_spec.width) + "x" + std::to_string(m_spec.height)
+        + ":rate=" + std::to_string(m_spec.fps) + ":duration=" + std::to_string(m_spec.seconds);
+    if (m_spec.isVariableFrameRate) {
+        // Drops 2 of every 7 frames plus every 13th, which leaves gaps of one to four frame periods
+        description += ",select='not(between(mod(n,7),1,2)+eq(mod(n,13),6))'";
+    }
+    description += std::string(",format=") + av_get_pix_fmt_name(pixelFormat);
+    if (!openSource(m_video, description, false)) return false;
+
+    m_video.stream = avformat_new_stream(m_formatContext, nullptr);
+    m_video.codecContext = avcodec_alloc_context3(codec);
+    if (!m_video.stream || !m_video.codecContext) {
+        std::cerr << "Could not allocate the video encoder." << std::endl;
+        return false;
+    }
+
+    AVCodecContext* codecContext = m_video.codecContext;
+    codecContext->width = m_spec.width;
+    codecContext->height = m_spec.height;
+    codecContext->pix_fmt = pixelFormat;
+    codecContext->time_base = av_buffersink_get_time_base(m_video.sink);
+    codecContext->framerate = { m_spec.fps, 1 };
+    codecContext->gop_size = m_spec.gopSize;
+    codecContext->thread_count = 0; // One per core
+
+    // Options only some encoders know are ignored by the others. Scene cut detection would add keyframes to the GOP.
+    av_opt_set(codecContext->priv_data, "preset", "veryfast", 0);
+    av_opt_set_int(codecContext->priv_data, "sc_threshold", 0, 0);
+
+    if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+        std::cerr << "Could not open video encoder: " << codec->name << std::endl;
+        return false;
+    }
+    if (avcodec_parameters_from_context(m_video.stream->codecpar, codecContext) < 0) {
+        std::cerr << "Could not copy the video encoder parameters to the stream." << std::endl;
+        return false;
+    }
+    m_video.stream->time_base = codecContext->time_base;
+    return true;
+}
+
+bool ClipGenerator::openAudio() {
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    if (!codec) {
+        std::cerr << "No AAC encoder available." << std::endl;
+        return false;
+    }
+
+    AVSampleFormat sampleFormat = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    std::string description = "sine=frequency=440:sample_rate=" + std::to_string(m_sampleRate) + ":duration=" + std::to_string(m_spec.seconds)
+        + ",aformat=sample_fmts=" + av_get_sample_fmt_name(sampleFormat) + ":channel_layouts=stereo";
+    if (!openSource(m_audio, description, true)) return false;
+
+    m_audio.stream = avformat_new_stream(m_formatContext, nullptr);
+    m_audio.codecContext = avcodec_alloc_context3(codec);
+    if (!m_audio.stream || !m_audio.codecContext) {
+        std::cerr << "Could not allocate the audio encoder." << std::endl;
+        return false;
+    }
+
+    AVCodecContext* codecContext = m_audio.codecContext;
+    codecContext->sample_fmt = sampleFormat;
+    codecContext->sample_rate = m_sampleRate;
+    av_channel_layout_default(&codecContext->ch_layout, 2);
+    codecContext->bit_rate = 128000;
+    codecContext->time_base = { 1, m_sampleRate };
+
+    if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+        std::cerr << "Could not open audio encoder: " << codec->name << std::endl;
+        return false;
+    }
+    if (avcodec_parameters_from_context(m_audio.stream->codecpar, codecContext) < 0) {
+        std::cerr << "Could not copy the audio encoder parameters to the stream." << std::endl;
+        return false;
+    }
+    m_audio.stream->time_base = codecContext->time_base;
+
+    // The encoder takes blocks of a fixed size, the sink cuts the tone into them
+    if (codecContext->frame_size > 0 && !(codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        av_buffersink_set_frame_size(m_audio.sink, codecContext->frame_size);
+    }
+    return true;
+}
+
+bool ClipGenerator::openSource(Track& track, const std::string& description, bool isAudio) {
+    track.graph = avfilter_graph_alloc();
+    track.frame = av_frame_alloc();
+    if (!track.graph || !track.frame) {
+        std::cerr << "Could not allocate the filter graph." << std::endl;
+        return false;
+    }
+    if (avfilter_graph_create_filter(&track.sink, avfilter_get_by_name(isAudio ? "abuffersink" : "buffersink"), "out", nullptr, nullptr, track.graph) < 0) {
+        std::cerr << "Could not create the filter graph output." << std::endl;
+        return false;
+    }
+
+    // The description's unconnected output is linked to the sink
+    AVFilterInOut* inputs = avfilter_inout_alloc();
+    AVFilterInOut* outputs = nullptr;
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = track.sink;
+    inputs->pad_idx = 0;
+    inputs->next = nullptr;
+    int result = avfilter_graph_parse_ptr(track.graph, description.c_str(), &inputs, &outputs, nullptr);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (result < 0 || avfilter_graph_config(track.graph, nullptr) < 0) {
+        std::cerr << "Could not create the filter graph: " << description << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ClipGenerator::encodeNext(Track& track) {
+    int result = av_buffersink_get_frame(track.sink, track.frame);
+    if (result == AVERROR_EOF) {
+        // Flush the frames the encoder still holds
+        avcodec_send_frame(track.codecContext, nullptr);
+        track.isFinished = true;
+        return writePackets(track);
+    }
+    if (result < 0) {
+        std::cerr << "Could not generate a frame." << std::endl;
+        return false;
+    }
+
+    // The sink's time base is the encoder's, so the timestamps carry over (including the gaps of variable frame rates)
+    track.frame->pict_type = AV_PICTURE_TYPE_NONE;
+    track.lastPts = track.frame->pts;
+    result = avcodec_send_frame(track.codecContext, track.frame);
+    av_frame_unref(track.frame);
+    if (result < 0) {
+        std::cerr << "Could not encode a frame." << std::endl;
+        return false;
+    }
+    return writePackets(track);
+}
+
+bool ClipGenerator::writePackets(Track& track) {
+    while (avcodec_receive_packet(track.codecContext, m_packet) == 0) {
+        av_packet_rescale_ts(m_packet, track.codecContext->time_base, track.stream->time_base);
+        m_packet->stream_index = track.stream->index;
+        if (av_interleaved_write_frame(m_formatContext, m_packet) < 0) {
+            std::cerr << "Could not write a packet." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void ClipGenerator::close() {
+    for (Track* track : { &m_video, &m_audio }) {
+        if (track->graph) avfilter_graph_free(&track->graph);
+        if (track->codecContext) avcodec_free_context(&track->codecContext);
+        if (track->frame) av_frame_free(&track->frame);
+        *track = Track();
+    }
+    if (m_formatContext && m_formatContext->pb) avio_closep(&m_formatContext->pb);
+    if (m_formatContext) {
+        avformat_free_context(m_formatContext);
+        m_formatContext = nullptr;
+    }
+    if (m_packet) av_packet_free(&m_packet);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <SDL.h>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavformat/avformat.h>
+}
+
+// Description of a synthetic test clip: a testsrc picture with a sine tone, encoded at the given settings
+struct ClipSpec {
+    std::string codec;                // Name of the video encoder, e.g. "libx264"
+    int width = 1280;
+    int height = 720;
+    int fps = 30;                     // Frame rate, the nominal one for variable frame rate clips
+    int gopSize = 30;                 // Frames between keyframes
+    double seconds = 10.0;
+    bool isVariableFrameRate = false; // Drop frames in an irregular pattern, so frame durations vary
+
+    // Get a file name that identifies every setting, so a generated clip can be reused
+    std::string getFilename() const;
+};
+
+/**
+ * @class ClipGenerator
+ * @brief Generates a test clip with libavfilter's testsrc and sine sources, so benchmarks run on the same media on every
+ *        machine without shipping any. The clip is written to a Matroska file, which holds every codec and variable frame rates.
+ */
+class ClipGenerator {
+public:
+    ClipGenerator(const ClipSpec& spec);
+    ~ClipGenerator();
+
+    /**
+     * @brief Encode the clip to a file. Writes to a temporary file first, so an interrupted run never leaves a partial clip behind.
+     * @param path The path of the clip.
+     * @return True if successful, otherwise false.
+     */
+    bool generate(const std::string& path);
+
+private:
+    // Filter graph producing one stream, and the encoder it feeds
+    struct Track {
+        AVFilterGraph* graph = nullptr;
+        AVFilterContext* sink = nullptr;
+        AVCodecContext* codecContext = nullptr;
+        AVStream* stream = nullptr;
+        AVFrame* frame = nullptr;
+        int64_t lastPts = 0;      // Timestamp of the last frame sent to the encoder, in the encoder's time base
+        bool isFinished = false;  // The source ended and the encoder is flushed
+    };
+
+    bool openVideo();
+    bool openAudio();
+
+    // Create a filter graph from a description that ends in an unconnected output, which gets connected to a sink
+    bool openSource(Track& track, const std::string& description, bool isAudio);
+
+    // Pull the next frame of a track from its filter graph and encode it, or flush the encoder at the end of the source
+    bool encodeNext(Track& track);
+
+    // Write every packet the encoder of a track has ready
+    bool writePackets(Track& track);
+
+    void close();
+
+private:
+    ClipSpec m_spec;
+    AVFormatContext* m_formatContext = nullptr;
+    AVPacket* m_packet = nullptr;
+    Track m_video;
+    Track m_audio;
+    int m_sampleRate = 48000;
+};
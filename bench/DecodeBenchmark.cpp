@@ -0,0 +1,321 @@
+#define SDL_MAIN_HANDLED  // This prevents SDL from overriding the main function
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "AudioDecoder.h"
+#include "ClipGenerator.h"
+#include "DecoderPool.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+// Decode and seek benchmark on generated clips. Measures the paths the editor uses: VideoDecoder::getVideoFrame through a
+// DecoderPool lease like the video player, the YUV to RGB conversion of VideoDecoder, and AudioDecoder's decoding and
+// resampling to the playback format. Results are written as JSON, to compare versions and machines.
+//
+// DecodeBenchmark [--output <file>] [--clips <directory>] [--seeks <count>] [--quick]
+// Generated clips are kept in the clip directory and reused by the next run.
+
+// Distribution of durations in milliseconds
+struct Summary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+struct ClipResult {
+    ClipSpec spec;
+    Uint32 frameCount = 0;
+    double sequentialFps = 0.0;  // Frames decoded and converted per second while playing forward
+    Summary sequentialFrame;     // Time per frame while playing forward
+    int seekCount = 0;
+    Summary seek;                // Time to show a random frame while paused, like scrubbing
+    std::string pixelFormat;     // Decoded format, converted to RGB24
+    double conversionFps = 0.0;
+    double conversionMegapixels = 0.0; // Megapixels converted per second
+    double audioSeconds = 0.0;   // Seconds of audio decoded
+    double audioRealtime = 0.0;  // Seconds of audio decoded and resampled per second
+    double audioMegabytes = 0.0; // Output megabytes per second
+    bool hasSucceeded = false;
+};
+
+static double getMilliseconds(Uint64 start) {
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+static Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+
+    // Nearest rank, so a percentile is always one of the measured durations
+    auto percentile = [&samples](double fraction) {
+        size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+    double sum = 0.0;
+    for (double sample : samples) sum += sample;
+    summary.mean = sum / samples.size();
+    summary.p50 = percentile(0.5);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+// Play the clip forward from the first frame, like the player does during playback
+static bool measureSequential(const std::string& path, ClipResult& result) {
+    DecoderLease lease = DecoderPool::shared().acquire(path, 1, 0);
+    if (!lease) return false;
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(result.frameCount);
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (Uint32 frame = 0; frame < result.frameCount; frame++) {
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        if (!lease->getVideoFrame(frame, result.spec.fps, true)) {
+            std::cerr << "Could not decode frame " << frame << " of: " << path << std::endl;
+            return false;
+        }
+        frameTimes.push_back(getMilliseconds(frameStart));
+    }
+    result.sequentialFps = result.frameCount / (getMilliseconds(start) / 1000.0);
+    result.sequentialFrame = summarize(frameTimes);
+    return true;
+}
+
+// Show random frames while paused, like scrubbing. The order is the same on every run.
+static bool measureSeeks(const std::string& path, int seekCount, ClipResult& result) {
+    DecoderLease lease = DecoderPool::shared().acquire(path, 1, 0);
+    if (!lease) return false;
+
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<Uint32> frames(0, result.frameCount - 1);
+    std::vector<double> seekTimes;
+    seekTimes.reserve(seekCount);
+    for (int i = 0; i < seekCount; i++) {
+        Uint32 frame = frames(random);
+        Uint64 seekStart = SDL_GetPerformanceCounter();
+        if (!lease->getVideoFrame(frame, result.spec.fps, false)) {
+            std::cerr << "Could not seek to frame " << frame << " of: " << path << std::endl;
+            return false;
+        }
+        seekTimes.push_back(getMilliseconds(seekStart));
+    }
+    result.seekCount = seekCount;
+    result.seek = summarize(seekTimes);
+    return true;
+}
+
+// Convert frames of the clip's decoded format to RGB24, with the same scaler settings as VideoDecoder
+static bool measureConversion(const std::string& path, ClipResult& result) {
+    AVFormatContext* formatContext = nullptr;
+    if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) < 0) return false;
+    int streamIndex = -1;
+    if (avformat_find_stream_info(formatContext, nullptr) >= 0) {
+        streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    }
+    if (streamIndex < 0) {
+        avformat_close_input(&formatContext);
+        return false;
+    }
+    AVCodecParameters* codecParams = formatContext->streams[streamIndex]->codecpar;
+    int width = codecParams->width;
+    int height = codecParams->height;
+    AVPixelFormat pixelFormat = static_cast<AVPixelFormat>(codecParams->format);
+    avformat_close_input(&formatContext);
+
+    AVFrame* frame = av_frame_alloc();
+    AVFrame* rgbFrame = av_frame_alloc();
+    frame->format = pixelFormat;
+    frame->width = width;
+    frame->height = height;
+    rgbFrame->format = AV_PIX_FMT_RGB24;
+    rgbFrame->width = width;
+    rgbFrame->height = height;
+    SwsContext* swsContext = sws_getContext(width, height, pixelFormat, width, height, AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    bool isReady = swsContext && av_frame_get_buffer(frame, 0) >= 0 && av_frame_get_buffer(rgbFrame, 0) >= 0;
+
+    if (isReady) {
+        // Mid grey, the scaler's speed does not depend on the picture
+        for (int plane = 0; plane < AV_NUM_DATA_POINTERS && frame->buf[plane]; plane++) {
+            std::fill(frame->buf[plane]->data, frame->buf[plane]->data + frame->buf[plane]->size, uint8_t(128));
+        }
+
+        int conversionCount = std::max(30, static_cast<int>(result.frameCount));
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < conversionCount; i++) {
+            sws_scale(swsContext, frame->data, frame->linesize, 0, height, rgbFrame->data, rgbFrame->linesize);
+        }
+        double seconds = getMilliseconds(start) / 1000.0;
+        result.pixelFormat = av_get_pix_fmt_name(pixelFormat) ? av_get_pix_fmt_name(pixelFormat) : "unknown";
+        result.conversionFps = conversionCount / seconds;
+        result.conversionMegapixels = result.conversionFps * width * height / 1000000.0;
+    }
+
+    sws_freeContext(swsContext);
+    av_frame_free(&frame);
+    av_frame_free(&rgbFrame);
+    return isReady;
+}
+
+// Decode all audio and resample it to the playback format, in blocks like the player queues them
+static bool measureAudio(const std::string& path, ClipResult& result) {
+    AudioDecoder decoder;
+    if (!decoder.open(path.c_str())) return false;
+
+    std::vector<uint8_t> output;
+    size_t totalBytes = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    while (true) {
+        output.clear();
+        int bytes = decoder.decode(result.spec.seconds + 1.0, 64 * 1024, output);
+        if (bytes < 0) return false;
+        if (bytes == 0) break;
+        totalBytes += bytes;
+    }
+    double seconds = getMilliseconds(start) / 1000.0;
+    result.audioSeconds = static_cast<double>(totalBytes) / decoder.getBytesPerFrame() / decoder.getSampleRate();
+    result.audioRealtime = result.audioSeconds / seconds;
+    result.audioMegabytes = totalBytes / seconds / (1024.0 * 1024.0);
+    return true;
+}
+
+static void writeSummary(std::ostringstream& json, const char* name, const Summary& summary) {
+    json << "\"" << name << "\": { \"meanMs\": " << summary.mean << ", \"p50Ms\": " << summary.p50 << ", \"p95Ms\": " << summary.p95
+        << ", \"p99Ms\": " << summary.p99 << ", \"maxMs\": " << summary.max << " }";
+}
+
+static bool writeResults(const std::filesystem::path& path, const std::vector<ClipResult>& results) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n  \"machine\": { \"platform\": \"" << SDL_GetPlatform() << "\", \"cpuCount\": " << SDL_GetCPUCount()
+        << ", \"systemRamMB\": " << SDL_GetSystemRAM() << " },\n";
+#ifdef NDEBUG
+    json << "  \"build\": { \"date\": \"" << __DATE__ << " " << __TIME__ << "\", \"type\": \"release\", \"ffmpeg\": \"" << av_version_info() << "\" },\n";
+#else
+    json << "  \"build\": { \"date\": \"" << __DATE__ << " " << __TIME__ << "\", \"type\": \"debug\", \"ffmpeg\": \"" << av_version_info() << "\" },\n";
+#endif
+    json << "  \"clips\": [";
+    const char* separator = "\n";
+    for (const ClipResult& result : results) {
+        const ClipSpec& spec = result.spec;
+        json << separator << "    {\n      \"name\": \"" << spec.getFilename() << "\", \"codec\": \"" << spec.codec << "\", \"width\": " << spec.width
+            << ", \"height\": " << spec.height << ", \"fps\": " << spec.fps << ", \"gopSize\": " << spec.gopSize
+            << ", \"variableFrameRate\": " << (spec.isVariableFrameRate ? "true" : "false") << ", \"seconds\": " << spec.seconds
+            << ", \"succeeded\": " << (result.hasSucceeded ? "true" : "false") << ",\n";
+        json << "      \"sequential\": { \"frames\": " << result.frameCount << ", \"fps\": " << result.sequentialFps << ", ";
+        writeSummary(json, "frame", result.sequentialFrame);
+        json << " },\n      \"seek\": { \"count\": " << result.seekCount << ", ";
+        writeSummary(json, "latency", result.seek);
+        json << " },\n      \"conversion\": { \"pixelFormat\": \"" << result.pixelFormat << "\", \"fps\": " << result.conversionFps
+            << ", \"megapixelsPerSecond\": " << result.conversionMegapixels << " },\n";
+        json << "      \"audio\": { \"seconds\": " << result.audioSeconds << ", \"realtimeFactor\": " << result.audioRealtime
+            << ", \"megabytesPerSecond\": " << result.audioMegabytes << " }\n    }";
+        separator = ",\n";
+    }
+    json << "\n  ]\n}\n";
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Unable to write benchmark results to " << path.string() << std::endl;
+        return false;
+    }
+    file << json.str();
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    SDL_SetMainReady();
+
+    std::filesystem::path outputPath = "decode_benchmark.json";
+    std::filesystem::path clipDirectory = std::filesystem::temp_directory_path() / "RythmGameVideoEditorBenchmark";
+    int seekCount = 100;
+    bool isQuick = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--output" && hasValue) outputPath = argv[++i];
+        else if (argument == "--clips" && hasValue) clipDirectory = argv[++i];
+        else if (argument == "--seeks" && hasValue) seekCount = std::max(1, std::atoi(argv[++i]));
+        else if (argument == "--quick") isQuick = true;
+        else {
+            std::cerr << "Unknown argument: " << argument << std::endl;
+            std::cerr << "Usage: DecodeBenchmark [--output <file>] [--clips <directory>] [--seeks <count>] [--quick]" << std::endl;
+            return 2;
+        }
+    }
+
+    // FFmpeg builds without GPL parts have no libx264, Windows has the Media Foundation encoder instead
+    std::string h264Encoder = "mpeg4";
+    for (const char* name : { "libx264", "h264_mf" }) {
+        if (avcodec_find_encoder_by_name(name)) {
+            h264Encoder = name;
+            break;
+        }
+    }
+
+    // Long and short GOPs, intra-only, a range of resolutions and frame rates, and a variable frame rate
+    std::vector<ClipSpec> specs = {
+        { h264Encoder, 1920, 1080, 60,  60, 10.0, false },
+        { h264Encoder, 1920, 1080, 60, 250, 10.0, false },
+        { h264Encoder, 1280,  720, 30,  30, 10.0, false },
+        { h264Encoder, 3840, 2160, 30,  30,  4.0, false },
+        { h264Encoder, 1280,  720, 60, 120, 10.0, true },
+        { "mpeg4",   1280,  720, 30,  12, 10.0, false },
+        { "mjpeg",   1280,  720, 30,   1, 10.0, false },
+    };
+    if (isQuick) {
+        for (ClipSpec& spec : specs) spec.seconds = std::min(spec.seconds, 2.0);
+        seekCount = std::min(seekCount, 20);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(clipDirectory, error);
+
+    std::vector<ClipResult> results;
+    for (const ClipSpec& spec : specs) {
+        std::string path = (clipDirectory / spec.getFilename()).string();
+        if (!std::filesystem::exists(path)) {
+            std::cout << "Generating " << path << std::endl;
+            ClipGenerator generator(spec);
+            if (!generator.generate(path)) {
+                std::cerr << "Skipping " << spec.getFilename() << ", it could not be generated" << std::endl;
+                continue;
+            }
+        }
+
+        ClipResult result;
+        result.spec = spec;
+        result.frameCount = static_cast<Uint32>(spec.seconds * spec.fps);
+        std::cout << "Measuring " << spec.getFilename() << std::endl;
+        result.hasSucceeded = measureSequential(path, result) && measureSeeks(path, seekCount, result) && measureConversion(path, result);
+
+        // Close the video decoders, so the audio has the file's reader to itself
+        DecoderPool::shared().clear();
+        result.hasSucceeded = measureAudio(path, result) && result.hasSucceeded;
+
+        std::cout << std::fixed << std::setprecision(2) << "  sequential " << result.sequentialFps << " fps, seek p50 " << result.seek.p50
+            << " ms p95 " << result.seek.p95 << " ms, conversion " << result.conversionFps << " fps, audio " << result.audioRealtime
+            << "x realtime" << std::defaultfloat << std::endl;
+        results.push_back(result);
+    }
+
+    if (!writeResults(outputPath, results)) return 1;
+    std::cout << "Wrote " << outputPath.string() << std::endl;
+    for (const ClipResult& result : results) {
+        if (!result.hasSucceeded) return 1;
+    }
+    return results.size() == specs.size() ? 0 : 1;
+}
@@ -1,8 +1,13 @@
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include "Application.h"
+#include "AllocationTracker.h"
 #include "util.h"
 #include "WindowIncludes.h"
 #include "ContextMenu.h"
+#include "GlyphAtlas.h"
+#include "Tracer.h"
 
 Application::Application(int width, int height) : m_screenWidth(width), m_screenHeight(height) {
     if (init()) {
@@ -39,6 +44,7 @@ bool Application::init() {
         std::cerr << "Failed to create renderer: " << SDL_GetError() << std::endl;
         return false;
     }
+    m_framePacer.init(m_window, m_renderer);
 
     TTF_Init();
 
@@ -61,6 +67,8 @@ bool Application::init() {
 
 Application::~Application() {
     if (m_rootWindow) delete m_rootWindow;
+    if (m_frameTexture) SDL_DestroyTexture(m_frameTexture);
+    GlyphAtlas::releaseAll(); // Its textures belong to the renderer
     if (m_renderer) SDL_DestroyRenderer(m_renderer);
     if (m_window) SDL_DestroyWindow(m_window);
     if (m_font) TTF_CloseFont(m_font);
@@ -68,10 +76,16 @@ Application::~Application() {
     SDL_Quit();
 }
 
-void Application::handleEvents() {
+bool Application::handleEvents() {
+    TRACE_ZONE("Application::handleEvents");
+    ALLOCATION_TAG("UI");
     SDL_Event event;
+    bool hasEvents = false;
 
     while (SDL_PollEvent(&event)) {
+        hasEvents = true;
+        m_framePacer.handleEvent(event);
+
         // Pass event to the context menu
         if (!ContextMenu::handleEvent(event)) {
 			// Only pass event to windows if the context menu did not handle it
@@ -97,7 +111,36 @@ void Application::handleEvents() {
 
                 // Handle the window resize
                 m_rootWindow->update(0, 0, newWidth, newHeight);
+
+                // The kept frame has the old size
+                if (m_frameTexture) SDL_DestroyTexture(m_frameTexture);
+                m_frameTexture = nullptr;
+            }
+            break;
+        }
+        case SDL_KEYDOWN: {
+            if (event.key.keysym.sym == SDLK_F9) {
+                // Dump the last seconds of every thread, to open in Perfetto or chrome://tracing
+                Tracer::writeChromeTrace("trace.json", m_traceDumpSeconds);
+            }
+            else if (event.key.keysym.sym == SDLK_F10) {
+                m_isTraceOverlayVisible = !m_isTraceOverlayVisible;
             }
+            else if (event.key.keysym.sym == SDLK_F7) {
+                AllocationTracker::printReport();
+            }
+            break;
+        }
+        case SDL_RENDER_TARGETS_RESET: {
+            // The contents of the kept frame are lost
+            m_rootWindow->invalidate();
+            break;
+        }
+        case SDL_RENDER_DEVICE_RESET: {
+            // The kept frame itself is lost
+            if (m_frameTexture) SDL_DestroyTexture(m_frameTexture);
+            m_frameTexture = nullptr;
+            m_rootWindow->invalidate();
             break;
         }
         case SDL_MOUSEBUTTONDOWN: {
@@ -139,43 +182,111 @@ void Application::handleEvents() {
         }
         }
     }
+    return hasEvents;
 }
 
-void Application::render() {
+bool Application::createFrameTexture() {
+    int width = 0, height = 0;
+    if (SDL_GetRendererOutputSize(m_renderer, &width, &height) != 0 || width <= 0 || height <= 0) return false;
+
+    m_frameTexture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (!m_frameTexture) {
+        std::cerr << "Unable to create the frame texture, every window is drawn every frame! SDL Error: " << SDL_GetError() << std::endl;
+        m_isFrameTextureSupported = false;
+        return false;
+    }
+    SDL_SetTextureBlendMode(m_frameTexture, SDL_BLENDMODE_NONE);
+
+    // A new texture holds nothing yet
+    SDL_SetRenderTarget(m_renderer, m_frameTexture);
     SDL_SetRenderDrawColor(m_renderer, 255, 0, 0, 255); // red (easy to find problems)
     SDL_RenderClear(m_renderer);
+    SDL_SetRenderTarget(m_renderer, nullptr);
+    if (m_rootWindow) m_rootWindow->invalidate();
+    return true;
+}
+
+bool Application::render(bool isPresentNeeded) {
+    TRACE_ZONE("Application::render");
+    ALLOCATION_TAG("Render");
+    if (!m_rootWindow) return false;
+    isPresentNeeded = isPresentNeeded || m_isTraceOverlayVisible; // Its numbers change all the time
+    if (!m_frameTexture && m_isFrameTextureSupported && SDL_RenderTargetSupported(m_renderer)) createFrameTexture();
 
-    // Render windows
-    if (m_rootWindow) {
-        m_rootWindow->render();
+    bool isDrawn = false;
+    if (m_frameTexture) {
+        // Only the windows that changed, the rest of the kept frame stays as it is
+        if (m_rootWindow->isDirty()) {
+            SDL_SetRenderTarget(m_renderer, m_frameTexture);
+            isDrawn = m_rootWindow->renderIfDirty();
+            SDL_SetRenderTarget(m_renderer, nullptr);
+        }
+        if (!isDrawn && !isPresentNeeded) return false;
+        SDL_RenderCopy(m_renderer, m_frameTexture, nullptr, nullptr);
+    }
+    else {
+        // Without render targets there is nothing to keep, draw everything
+        if (!m_rootWindow->isDirty() && !isPresentNeeded) return false;
+        SDL_SetRenderDrawColor(m_renderer, 255, 0, 0, 255); // red (easy to find problems)
+        SDL_RenderClear(m_renderer);
+        m_rootWindow->invalidate();
+        m_rootWindow->renderIfDirty();
     }
 
+    // Overlays change every frame (the playhead) or come and go (the context menu), they are drawn over the kept frame
+    m_rootWindow->renderOverlay();
     ContextMenu::render(m_renderer);
+    if (m_isTraceOverlayVisible) renderTraceOverlay();
 
-    SDL_RenderPresent(m_renderer);
+    m_framePacer.present();
+    return true;
 }
 
-void Application::run() {
-    const int targetFrameTime = 1000 / 60;  // 16.67 ms per frame for 60 FPS
-    Uint32 frameStart, frameEnd, frameDuration;
-
-    while (m_running) {
-        // Record the time at the start of the frame
-        frameStart = SDL_GetTicks();
+void Application::renderTraceOverlay() {
+    std::vector<Tracer::ZoneStats> zones = Tracer::getZoneStats(1.0);
+    const FramePacer::LatencyStats& latency = m_framePacer.getInputLatency();
+    TTF_Font* font = getFontSmall();
+    int lineHeight = TTF_FontLineSkip(font);
+    size_t lineCount = std::min<size_t>(zones.size(), 16);
 
-        handleEvents(); // Process input events
-        render();       // Render everything
+    SDL_Rect background = { 8, 8, 420, lineHeight * static_cast<int>(lineCount + 3) + 8 };
+    SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 200);
+    SDL_RenderFillRect(m_renderer, &background);
+    SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_NONE);
 
-        // Record the time at the end of the frame
-        frameEnd = SDL_GetTicks();
+    char line[160];
+    int yPos = background.y + 4;
+    snprintf(line, sizeof(line), "%.0f Hz   input latency: last %.1f ms, avg %.1f ms, max %.1f ms",
+        m_framePacer.getRefreshRate(), latency.last, latency.average, latency.max);
+    renderText(m_renderer, background.x + 6, yPos, font, line);
+    yPos += lineHeight * 2;
+    renderText(m_renderer, background.x + 6, yPos - lineHeight, font, "Zone (last second)", { 160, 160, 160, 255 });
+    renderText(m_renderer, background.x + 236, yPos - lineHeight, font, "calls     ms/s     max ms", { 160, 160, 160, 255 });
 
-        // Calculate how long the frame took
-        frameDuration = frameEnd - frameStart;
+    for (size_t i = 0; i < lineCount; i++) {
+        const Tracer::ZoneStats& zone = zones[i];
+        renderText(m_renderer, background.x + 6, yPos, font, zone.name);
+        snprintf(line, sizeof(line), "%5u  %7.2f  %7.2f", zone.count, zone.totalMs, zone.maxMs);
+        renderText(m_renderer, background.x + 236, yPos, font, line);
+        yPos += lineHeight;
+    }
+}
 
-        // If the frame took less time than the target frame duration, delay the difference
-        if (frameDuration < targetFrameTime) {
-            SDL_Delay(targetFrameTime - frameDuration);
+void Application::run() {
+    TRACE_THREAD_NAME("Main");
+    while (m_running) {
+        // When nothing changes by itself, sleep until there is input. Wake up now and then for changes made in the background.
+        bool isAnimating = m_rootWindow && m_rootWindow->isAnimating();
+        if (!isAnimating && !(m_rootWindow && m_rootWindow->isDirty())) {
+            SDL_WaitEventTimeout(nullptr, m_idleWakeInterval);
         }
-        // If the frame took longer, we don't delay and the game continues running
+
+        // Start the frame as late as the next refresh allows, so it picks up the newest input and playhead time
+        m_framePacer.waitForFrame();
+        m_framePacer.beginFrame();
+
+        bool hasEvents = handleEvents(); // Process input events
+        render(hasEvents || isAnimating); // Render what changed
     }
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include "Window.h"
+#include "FramePacer.h"
 #include "AssetsList.h"
 #include "Timeline.h"
 
@@ -12,19 +13,38 @@ public:
 
     // Main Application loop
     void run();
+
+    // Frame timing and the measured latency from input to the screen
+    const FramePacer& getFramePacer() const { return m_framePacer; }
 private:
     // Initialize SDL and create window/renderer
     bool init();
 
-    // Handle user interaction events
-    void handleEvents();
+    // Handle user interaction events, returns whether there were any
+    bool handleEvents();
+
+    /**
+     * @brief Draw the windows that changed into the kept frame, and show it with the overlays on top.
+     * @param isPresentNeeded Show the frame even when no window changed, e.g. because input may have changed an overlay.
+     * @returns Whether a frame was presented.
+     */
+    bool render(bool isPresentNeeded);
+
+    // (Re)create the texture that keeps the frame between frames, at the renderer's output size
+    bool createFrameTexture();
 
-    // Render the screen and all active windows
-    void render();
+    // Draw the time spent per trace zone over the last second, and the input latency, in the top-left corner
+    void renderTraceOverlay();
 private:
     SDL_Window* m_window = nullptr;
     SDL_Renderer* m_renderer = nullptr;
+    SDL_Texture* m_frameTexture = nullptr; // Last drawn output of every window, only dirty windows are drawn into it again
+    bool m_isFrameTextureSupported = true;
+    Uint32 m_idleWakeInterval = 250; // Milliseconds to wait for input when idle, before checking for changes made in the background
+    bool m_isTraceOverlayVisible = false; // Toggled with F10
+    double m_traceDumpSeconds = 10.0;     // How far back F9 writes the trace
     EventManager m_eventManager;
+    FramePacer m_framePacer;
 
     Window* m_rootWindow; // Root of the window segment hierarchy
     AssetsList* m_assetsList;
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include "FramePacer.h"
+#include "Tracer.h"
+
+void FramePacer::init(SDL_Window* window, SDL_Renderer* renderer) {
+    m_window = window;
+    m_renderer = renderer;
+    m_frequency = std::max<Uint64>(SDL_GetPerformanceFrequency(), 1);
+    m_presentMargin = static_cast<Uint64>(m_presentMarginMs * m_frequency / 1000.0);
+    m_sleepSlack = static_cast<Uint64>(m_sleepSlackMs * m_frequency / 1000.0);
+    updateRefreshRate();
+    m_workEstimate = m_framePeriod / 2; // Until the first frames are measured
+}
+
+void FramePacer::handleEvent(const SDL_Event& event) {
+    if (isInputEvent(event.type)) {
+        // The oldest input decides the latency, later input in the same frame waited less
+        if (m_pendingInputAt == 0) {
+            // SDL stamps events in milliseconds when they are queued, take off how long this one has been waiting
+            Uint64 now = SDL_GetPerformanceCounter();
+            Uint64 queuedFor = static_cast<Uint64>(static_cast<Uint32>(SDL_GetTicks() - event.common.timestamp)) * m_frequency / 1000;
+            m_pendingInputAt = std::max<Uint64>(now - std::min(now, queuedFor), 1);
+        }
+    }
+    else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+        updateRefreshRate();
+    }
+    else if (event.type == SDL_DISPLAYEVENT) {
+        updateRefreshRate();
+    }
+}
+
+void FramePacer::waitForFrame() {
+    TRACE_ZONE("FramePacer::waitForFrame");
+    Uint64 startAt = 0;
+    if (m_isPresented) {
+        // Start so the frame is ready right before the next refresh
+        Uint64 lead = m_workEstimate + m_presentMargin;
+        if (lead >= m_framePeriod) return; // Frames take longer than a refresh, start right away
+        startAt = m_presentedAt + m_framePeriod - lead;
+    }
+    else if (m_frameStartedAt != 0) {
+        // Nothing was presented to wait on, still don't loop faster than the display
+        startAt = m_frameStartedAt + m_framePeriod;
+    }
+    sleepUntil(startAt);
+}
+
+void FramePacer::beginFrame() {
+    m_frameStartedAt = SDL_GetPerformanceCounter();
+    m_isPresented = false;
+}
+
+void FramePacer::present() {
+    // Only the work counts, not how long the present waits for the display
+    Uint64 renderedAt = SDL_GetPerformanceCounter();
+    if (m_frameStartedAt != 0 && renderedAt > m_frameStartedAt) {
+        Uint64 work = renderedAt - m_frameStartedAt;
+        if (work > m_workEstimate) m_workEstimate = work;
+        else m_workEstimate -= (m_workEstimate - work) / 16;
+    }
+
+    {
+        TRACE_ZONE("SDL_RenderPresent");
+        SDL_RenderPresent(m_renderer);
+    }
+    m_presentedAt = SDL_GetPerformanceCounter();
+    m_isPresented = true;
+
+    if (m_pendingInputAt != 0) {
+        double latency = toMilliseconds(m_presentedAt > m_pendingInputAt ? m_presentedAt - m_pendingInputAt : 0);
+        m_inputLatency.last = latency;
+        m_inputLatency.max = std::max(m_inputLatency.max, latency);
+        m_inputLatency.count++;
+        m_inputLatency.average += (latency - m_inputLatency.average) / static_cast<double>(m_inputLatency.count);
+        m_pendingInputAt = 0;
+    }
+}
+
+void FramePacer::updateRefreshRate() {
+    SDL_DisplayMode mode;
+    int displayIndex = m_window ? SDL_GetWindowDisplayIndex(m_window) : -1;
+    if (displayIndex >= 0 && SDL_GetCurrentDisplayMode(displayIndex, &mode) == 0 && mode.refresh_rate > 0) {
+        m_refreshRate = mode.refresh_rate;
+    }
+    else {
+        m_refreshRate = m_defaultRefreshRate;
+    }
+    m_framePeriod = static_cast<Uint64>(m_frequency / m_refreshRate);
+}
+
+void FramePacer::sleepUntil(Uint64 counter) const {
+    while (true) {
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now >= counter) return;
+        Uint64 remaining = counter - now;
+        if (remaining > m_sleepSlack) {
+            SDL_Delay(static_cast<Uint32>((remaining - m_sleepSlack) * 1000 / m_frequency));
+        }
+        else {
+            SDL_Delay(0); // Yield to other threads (the decoders) while waiting out the last bit
+        }
+    }
+}
+
+bool FramePacer::isInputEvent(Uint32 type) {
+    switch (type) {
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+    case SDL_TEXTINPUT:
+    case SDL_MOUSEMOTION:
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    case SDL_MOUSEWHEEL:
+        return true;
+    default:
+        return false;
+    }
+}
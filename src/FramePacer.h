@@ -0,0 +1,79 @@
+#pragma once
+#include <SDL.h>
+
+/**
+ * @class FramePacer
+ * @brief Decides when the main loop starts a frame, with the high resolution performance counter instead of SDL_GetTicks().
+ *        A frame is started as late as possible while still being presented one display refresh after the previous one:
+ *        the refresh period minus the (estimated) time it takes to handle the events and render. Input and the playhead time
+ *        are then read just before the frame is presented, instead of waiting a whole refresh in the swap chain.
+ *        With vsync, the present itself waits for the display and the pacer only moves the start of the frame. Without it,
+ *        the pacer is what keeps the loop at the refresh rate. Either way there is one throttle, not two.
+ *
+ *        It also measures the time from an input event to the present that shows its result.
+ */
+class FramePacer {
+public:
+    // Time from input events to the present showing them, in milliseconds
+    struct LatencyStats {
+        double last = 0.0;    // Of the last present that followed input
+        double average = 0.0; // Since the stats were reset
+        double max = 0.0;
+        Uint64 count = 0;     // Presents that followed input
+    };
+
+    FramePacer() = default;
+
+    // Start pacing a window's renderer, and read the refresh rate of the display it is on
+    void init(SDL_Window* window, SDL_Renderer* renderer);
+
+    // Pass every event: input events are timed for the latency, display changes update the refresh rate
+    void handleEvent(const SDL_Event& event);
+
+    // Sleep until the latest moment the next frame can start and still be presented one refresh after the last
+    void waitForFrame();
+
+    // Call right after waitForFrame(), before handling events
+    void beginFrame();
+
+    // Present the renderer, and time it. Use this instead of SDL_RenderPresent().
+    void present();
+
+    double getRefreshRate() const { return m_refreshRate; }
+    double getFramePeriod() const { return toMilliseconds(m_framePeriod); }   // Milliseconds
+    double getWorkEstimate() const { return toMilliseconds(m_workEstimate); } // Milliseconds the loop expects a frame to take
+    const LatencyStats& getInputLatency() const { return m_inputLatency; }
+    void resetInputLatency() { m_inputLatency = LatencyStats(); }
+
+private:
+    // Read the refresh rate of the display the window is on
+    void updateRefreshRate();
+
+    // Sleep until a performance counter value: SDL_Delay() for most of it, then yield for the last bit, which SDL_Delay() may overshoot
+    void sleepUntil(Uint64 counter) const;
+
+    double toMilliseconds(Uint64 counter) const { return counter * 1000.0 / m_frequency; }
+
+    static bool isInputEvent(Uint32 type);
+
+private:
+    SDL_Window* m_window = nullptr;
+    SDL_Renderer* m_renderer = nullptr;
+
+    Uint64 m_frequency = 1;           // Performance counter ticks per second
+    double m_refreshRate = 60.0;      // Hz of the display the window is on
+    double m_defaultRefreshRate = 60.0; // When the display does not report it
+    Uint64 m_framePeriod = 0;         // Performance counter ticks per refresh
+    Uint64 m_workEstimate = 0;        // Ticks from the start of a frame until it is presented, follows increases at once and decreases slowly
+    Uint64 m_presentMargin = 0;       // Ticks the frame is started earlier than the estimate asks, for a little variation
+    double m_presentMarginMs = 1.5;
+    Uint64 m_sleepSlack = 0;          // The last ticks before a wake up are yielded instead of slept, SDL_Delay() is not that precise
+    double m_sleepSlackMs = 2.0;
+
+    Uint64 m_frameStartedAt = 0;      // Performance counter at beginFrame()
+    Uint64 m_presentedAt = 0;         // Performance counter after the last present returned
+    bool m_isPresented = false;       // Whether the current (or, before beginFrame(), the last) frame was presented
+
+    Uint64 m_pendingInputAt = 0;      // Performance counter of the oldest input event not presented yet, 0 = none
+    LatencyStats m_inputLatency;
+};
@@ -0,0 +1,230 @@
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include "AllocationTracker.h"
+
+// Fixed tables, so counting an allocation never allocates itself. Everything here is constant-initialised, so it
+// already works for allocations made before main() and during static initialisation of other files.
+static constexpr int s_maxTagCount = 32;
+static constexpr int s_maxRegionCount = 32;
+
+struct TagCounters {
+    std::atomic<const char*> name = nullptr;
+    std::atomic<Uint64> allocations = 0;
+    std::atomic<Uint64> frees = 0;
+    std::atomic<Uint64> allocatedBytes = 0;
+    std::atomic<Uint64> freedBytes = 0;
+};
+
+static TagCounters s_tags[s_maxTagCount]; // Tag 0 is everything outside of a tag scope
+static std::atomic<int> s_tagCount = 1;
+static AllocationTracker::RegionStats s_regions[s_maxRegionCount];
+static int s_regionCount = 0;
+static std::mutex s_mutex; // Guards adding tags and the region table
+static std::atomic<bool> s_isAsserting = false;
+
+static thread_local int t_currentTag = 0;
+static thread_local int t_regionDepth = 0;        // Nested NO_ALLOCATIONS regions of this thread
+static thread_local Uint64 t_allocationCount = 0; // Every allocation of this thread, regions compare it before and after
+static thread_local Uint64 t_allocationBytes = 0;
+
+AllocationTracker::TagScope::TagScope(const char* name) : m_previousTag(t_currentTag) {
+    t_currentTag = findTag(name);
+}
+
+AllocationTracker::TagScope::~TagScope() {
+    t_currentTag = m_previousTag;
+}
+
+AllocationTracker::NoAllocationScope::NoAllocationScope(const char* region, bool isActive) : m_region(region), m_isActive(isActive) {
+    if (!m_isActive) return;
+    t_regionDepth++;
+    m_allocationsBefore = t_allocationCount;
+    m_bytesBefore = t_allocationBytes;
+}
+
+AllocationTracker::NoAllocationScope::~NoAllocationScope() {
+    if (!m_isActive) return;
+    t_regionDepth--;
+    Uint64 allocations = t_allocationCount - m_allocationsBefore;
+    Uint64 bytes = t_allocationBytes - m_bytesBefore;
+
+    // Only the outermost region reports, reporting allocates and that would count in the regions around it
+    if (allocations > 0 && t_regionDepth == 0) reportViolation(m_region, allocations, bytes);
+}
+
+int AllocationTracker::onAllocate(size_t size) {
+    int tag = t_currentTag;
+    TagCounters& counters = s_tags[tag];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    t_allocationCount++;
+    t_allocationBytes += size;
+    return tag;
+}
+
+void AllocationTracker::onFree(size_t size, int tag) {
+    TagCounters& counters = s_tags[tag];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.freedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+bool AllocationTracker::isEnabled() {
+#ifdef TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationTracker::setAssertOnViolation(bool isAsserting) {
+    s_isAsserting = isAsserting;
+}
+
+std::vector<AllocationTracker::TagStats> AllocationTracker::getTagStats() {
+    std::vector<TagStats> stats;
+    int tagCount = s_tagCount.load();
+    for (int i = 0; i < tagCount; i++) {
+        const TagCounters& counters = s_tags[i];
+        TagStats tag;
+        tag.name = i == 0 ? "Other" : counters.name.load();
+        tag.allocations = counters.allocations.load(std::memory_order_relaxed);
+        tag.frees = counters.frees.load(std::memory_order_relaxed);
+        tag.allocatedBytes = counters.allocatedBytes.load(std::memory_order_relaxed);
+        tag.liveBytes = static_cast<Sint64>(tag.allocatedBytes - counters.freedBytes.load(std::memory_order_relaxed));
+        if (tag.name) stats.push_back(tag);
+    }
+    return stats;
+}
+
+std::vector<AllocationTracker::RegionStats> AllocationTracker::getRegionStats() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return std::vector<RegionStats>(s_regions, s_regions + s_regionCount);
+}
+
+void AllocationTracker::printReport() {
+    if (!isEnabled()) {
+        std::cout << "Allocations are not counted, build with TRACK_ALLOCATIONS to count them" << std::endl;
+        return;
+    }
+
+    std::vector<TagStats> tags = getTagStats();
+    std::vector<RegionStats> regions = getRegionStats();
+    std::cout << std::left << std::setw(20) << "Allocations by tag" << std::right << std::setw(14) << "allocations" << std::setw(14) << "frees"
+        << std::setw(16) << "allocated MB" << std::setw(12) << "live MB" << '\n' << std::fixed << std::setprecision(2);
+    for (const TagStats& tag : tags) {
+        std::cout << std::left << std::setw(20) << tag.name << std::right << std::setw(14) << tag.allocations << std::setw(14) << tag.frees
+            << std::setw(16) << tag.allocatedBytes / (1024.0 * 1024.0) << std::setw(12) << tag.liveBytes / (1024.0 * 1024.0) << '\n';
+    }
+    for (const RegionStats& region : regions) {
+        std::cout << "Region '" << region.name << "' allocated in " << region.violations << " run(s): "
+            << region.allocations << " allocations, " << region.bytes << " bytes" << '\n';
+    }
+    std::cout << std::defaultfloat << std::flush;
+}
+
+int AllocationTracker::findTag(const char* name) {
+    // Tags are few and looked up when a scope starts, not per allocation
+    int tagCount = s_tagCount.load();
+    for (int i = 1; i < tagCount; i++) {
+        const char* tagName = s_tags[i].name.load();
+        if (tagName == name || std::strcmp(tagName, name) == 0) return i;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    tagCount = s_tagCount.load();
+    for (int i = 1; i < tagCount; i++) {
+        if (std::strcmp(s_tags[i].name.load(), name) == 0) return i;
+    }
+    if (tagCount == s_maxTagCount) return 0; // Out of tags, count it as untagged
+    s_tags[tagCount].name = name;
+    s_tagCount = tagCount + 1;
+    return tagCount;
+}
+
+void AllocationTracker::reportViolation(const char* region, Uint64 allocations, Uint64 bytes) {
+    bool isFirst = false;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        RegionStats* stats = nullptr;
+        for (int i = 0; i < s_regionCount; i++) {
+            if (std::strcmp(s_regions[i].name, region) == 0) stats = &s_regions[i];
+        }
+        if (!stats && s_regionCount < s_maxRegionCount) {
+            stats = &s_regions[s_regionCount++];
+            stats->name = region;
+        }
+        if (stats) {
+            isFirst = stats->violations == 0;
+            stats->violations++;
+            stats->allocations += allocations;
+            stats->bytes += bytes;
+        }
+    }
+
+    // Once per region, it usually happens every frame. printReport() has the totals.
+    if (isFirst) {
+        std::cerr << "Allocation in no-allocation region '" << region << "': " << allocations << " allocations, " << bytes << " bytes" << std::endl;
+    }
+    assert(!s_isAsserting && "Allocation in a NO_ALLOCATIONS region, set a breakpoint in operator new to find it");
+}
+
+#ifdef TRACK_ALLOCATIONS
+// Every allocation gets a header with its size and tag, so freeing it is counted against the tag that allocated it.
+// 16 bytes keeps the alignment malloc gives. Over-aligned allocations use the other operator new overloads and are not counted.
+static constexpr size_t s_headerSize = 16;
+
+struct AllocationHeader {
+    size_t size;
+    int tag;
+};
+static_assert(sizeof(AllocationHeader) <= s_headerSize, "The allocation header has to fit before the allocation");
+
+static void* trackedAllocate(std::size_t size) {
+    void* block = std::malloc(size + s_headerSize);
+    if (!block) return nullptr;
+    AllocationHeader* header = static_cast<AllocationHeader*>(block);
+    header->size = size;
+    header->tag = AllocationTracker::onAllocate(size);
+    return static_cast<char*>(block) + s_headerSize;
+}
+
+static void trackedFree(void* pointer) {
+    if (!pointer) return;
+    AllocationHeader* header = reinterpret_cast<AllocationHeader*>(static_cast<char*>(pointer) - s_headerSize);
+    AllocationTracker::onFree(header->size, header->tag);
+    std::free(header);
+}
+
+void* operator new(std::size_t size) {
+    void* pointer = trackedAllocate(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size) {
+    void* pointer = trackedAllocate(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return trackedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { trackedFree(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { trackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { trackedFree(pointer); }
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+
+// Count the allocations of the rest of the enclosing scope under a subsystem tag, and check that a region allocates nothing.
+// Names have to be string literals. Building without TRACK_ALLOCATIONS removes both, and does not replace operator new.
+#ifdef TRACK_ALLOCATIONS
+#define ALLOCATION_CONCAT_INNER(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_INNER(a, b)
+#define ALLOCATION_TAG(name) AllocationTracker::TagScope ALLOCATION_CONCAT(allocationTag, __LINE__)(name)
+#define NO_ALLOCATIONS(region) AllocationTracker::NoAllocationScope ALLOCATION_CONCAT(noAllocations, __LINE__)(region)
+#define NO_ALLOCATIONS_IF(region, isActive) AllocationTracker::NoAllocationScope ALLOCATION_CONCAT(noAllocations, __LINE__)(region, isActive)
+#else
+#define ALLOCATION_TAG(name) ((void)0)
+#define NO_ALLOCATIONS(region) ((void)0)
+#define NO_ALLOCATIONS_IF(region, isActive) ((void)(isActive))
+#endif
+
+/**
+ * @class AllocationTracker
+ * @brief Counts the allocations made with operator new, per subsystem. A thread's allocations are counted under the tag
+ *        of its innermost ALLOCATION_TAG scope ("Other" outside of any), and their memory is returned to that tag when
+ *        freed. NO_ALLOCATIONS marks a steady-state region that should not allocate at all: allocations in it are
+ *        reported when the region ends, and can be made to fail an assert, to stop right where they happen in a debugger.
+ *        Only operator new is seen: SDL, SDL_ttf and FFmpeg allocate with malloc and FFmpeg has no allocator hook
+ *        (av_max_alloc() only limits the size of a single allocation).
+ */
+class AllocationTracker {
+public:
+    // Allocations counted under one tag
+    struct TagStats {
+        const char* name = nullptr;
+        Uint64 allocations = 0;
+        Uint64 frees = 0;
+        Uint64 allocatedBytes = 0; // Everything allocated, also what was freed since
+        Sint64 liveBytes = 0;      // Allocated and not freed yet
+    };
+
+    // Allocations made inside one NO_ALLOCATIONS region
+    struct RegionStats {
+        const char* name = nullptr;
+        Uint64 violations = 0;     // Times the region ended with allocations in it
+        Uint64 allocations = 0;
+        Uint64 bytes = 0;
+    };
+
+    // Counts the allocations of the calling thread under a tag while it lives, use ALLOCATION_TAG() instead of creating one directly
+    class TagScope {
+    public:
+        explicit TagScope(const char* name);
+        ~TagScope();
+        TagScope(const TagScope&) = delete;
+        TagScope& operator=(const TagScope&) = delete;
+    private:
+        int m_previousTag;
+    };
+
+    // Checks that the calling thread allocates nothing while it lives, use NO_ALLOCATIONS() instead of creating one directly
+    class NoAllocationScope {
+    public:
+        explicit NoAllocationScope(const char* region, bool isActive = true);
+        ~NoAllocationScope();
+        NoAllocationScope(const NoAllocationScope&) = delete;
+        NoAllocationScope& operator=(const NoAllocationScope&) = delete;
+    private:
+        const char* m_region;
+        bool m_isActive;
+        Uint64 m_allocationsBefore = 0;
+        Uint64 m_bytesBefore = 0;
+    };
+
+    // Called by the replaced operator new / delete, returns the tag the allocation is counted under
+    static int onAllocate(size_t size);
+    static void onFree(size_t size, int tag);
+
+    // Whether the build counts allocations (TRACK_ALLOCATIONS)
+    static bool isEnabled();
+
+    // Fail an assert (in builds with asserts) when a NO_ALLOCATIONS region allocated, instead of only reporting it
+    static void setAssertOnViolation(bool isAsserting);
+
+    // Get the counts of every tag and of every region that allocated
+    static std::vector<TagStats> getTagStats();
+    static std::vector<RegionStats> getRegionStats();
+
+    // Print the counts of every tag and region to std::cout
+    static void printReport();
+
+private:
+    // Get the index of a tag, added the first time
+    static int findTag(const char* name);
+
+    // Count what a region allocated, and report it the first time
+    static void reportViolation(const char* region, Uint64 allocations, Uint64 bytes);
+};
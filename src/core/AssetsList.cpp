@@ -3,7 +3,10 @@
 #include <vector>
 #include <filesystem>
 #include "AssetsList.h"
+#include "AllocationTracker.h"
 #include "VideoData.h"
+#include "DecoderPool.h"
+#include "Tracer.h"
 #include "util.h"
 
 AssetsList::AssetsList(SDL_Renderer* renderer) { 
@@ -21,33 +24,21 @@ const std::vector<Asset>* AssetsList::getAllAssets() {
 }
 
 bool AssetsList::loadFile(const char* filepath) {
+    TRACE_ZONE("AssetsList::loadFile");
+    ALLOCATION_TAG("Assets");
     Asset newAsset;
 
-    // Open the file and reads its header, populating formatContext.
-    newAsset.videoData->formatContext = avformat_alloc_context();
-    if (avformat_open_input(&newAsset.videoData->formatContext, filepath, nullptr, nullptr) != 0) {
-        std::cerr << "Could not open input file: " << filepath << std::endl;
+    // Open and probe the file once, the video and audio data share the same reader
+    std::shared_ptr<Demuxer> demuxer = Demuxer::open(filepath, Demuxer::s_playbackOwner);
+    if (!demuxer) {
         delete newAsset.videoData;
-        return false;
-    }
-    newAsset.audioData->formatContext = avformat_alloc_context();
-    if (avformat_open_input(&newAsset.audioData->formatContext, filepath, nullptr, nullptr) != 0) {
-        std::cerr << "Could not open input file: " << filepath << std::endl;
-        delete newAsset.audioData;
-        return false;
-    }
-
-    // Find information about streams (audio, video) within the file.
-    if (avformat_find_stream_info(newAsset.videoData->formatContext, NULL) < 0) {
-        std::cerr << "Could not find stream information." << std::endl;
-        delete newAsset.videoData;
-        return false;
-    }
-    if (avformat_find_stream_info(newAsset.audioData->formatContext, NULL) < 0) {
-        std::cerr << "Could not find stream information." << std::endl;
         delete newAsset.audioData;
         return false;
     }
+    newAsset.videoData->demuxer = demuxer;
+    newAsset.videoData->formatContext = demuxer->getFormatContext();
+    newAsset.audioData->demuxer = demuxer;
+    newAsset.audioData->formatContext = demuxer->getFormatContext();
 
     // Initialize stream indices as invalid
     newAsset.videoData->streamIndex = -1;
@@ -209,6 +200,9 @@ bool AssetsList::loadFile(const char* filepath) {
 
         // Allocate memory for audio frames
         newAsset.audioData->frame = av_frame_alloc();
+
+        // Audio playback reads its packets through the shared reader
+        newAsset.audioData->demuxer->claimStream(newAsset.audioData->streamIndex);
     }
     else {
         delete newAsset.audioData;
@@ -232,6 +226,8 @@ bool AssetsList::loadFile(const char* filepath) {
 }
 
 SDL_Texture* AssetsList::getThumbnail(VideoData* videoData) {
+    if (!videoData || !m_renderer) return nullptr; // Audio only, or loaded without a window (batch rendering)
+
 #ifdef _WIN32
     // If on a windows machine and m_useWindowsThumbnail is true, get the same thumbnail as windows shows
     if (m_useWindowsThumbnail) {
@@ -239,8 +235,10 @@ SDL_Texture* AssetsList::getThumbnail(VideoData* videoData) {
         return getWindowsThumbnail(wideFilePath.c_str());
     }
 #endif // _WIN32
-    // Otherwise, get the first video frame as the thumbnail
-    return videoData->getFrameTexture(m_renderer, 0);
+    // Otherwise, get the first video frame as the thumbnail. The decoder stays open in the pool for segments of this asset.
+    DecoderLease lease = DecoderPool::shared().acquire(videoData->formatContext->url, 0, 0, Demuxer::s_playbackOwner);
+    if (!lease || !lease->getVideoFrame(0, 1, false)) return nullptr;
+    return lease->createFrameTexture(m_renderer);
 }
 
 #ifdef _WIN32
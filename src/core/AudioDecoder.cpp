@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <iostream>
+#include "AudioDecoder.h"
+
+AudioDecoder::AudioDecoder() { }
+
+AudioDecoder::~AudioDecoder() { }
+
+bool AudioDecoder::open(const char* filepath, int sampleRate, int channels) {
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+
+    // Read through a reader of our own, the decoder runs in jobs next to playback and must not move the reader playback uses
+    m_demuxer = Demuxer::openForStream(filepath, AVMEDIA_TYPE_AUDIO, &m_audioData.streamIndex);
+    if (!m_demuxer) {
+        std::cerr << "Could not open audio stream of: " << filepath << std::endl;
+        return false;
+    }
+    m_audioData.demuxer = m_demuxer;
+    m_audioData.formatContext = m_demuxer->getFormatContext();
+    m_serial = m_demuxer->getSerial(m_audioData.streamIndex);
+
+    // Get the codec parameters for audio
+    AVCodecParameters* codecParams = m_audioData.formatContext->streams[m_audioData.streamIndex]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(codecParams->codec_id);
+    if (!codec) {
+        std::cerr << "Unsupported audio codec!" << std::endl;
+        return false;
+    }
+
+    // Allocate audio codec context and copy the codec parameters to it
+    m_audioData.codecContext = avcodec_alloc_context3(codec);
+    if (!m_audioData.codecContext) {
+        std::cerr << "Could not allocate audio codec context." << std::endl;
+        return false;
+    }
+    if (avcodec_parameters_to_context(m_audioData.codecContext, codecParams) < 0) {
+        std::cerr << "Could not copy audio codec parameters to context." << std::endl;
+        return false;
+    }
+    m_audioData.codecContext->pkt_timebase = m_audioData.formatContext->streams[m_audioData.streamIndex]->time_base;
+
+    // Open the audio codec
+    if (avcodec_open2(m_audioData.codecContext, codec, nullptr) < 0) {
+        std::cerr << "Could not open audio codec." << std::endl;
+        return false;
+    }
+
+    // Set up the SwrContext for converting to the output format
+    AVChannelLayout outChannelLayout;
+    av_channel_layout_default(&outChannelLayout, channels);
+    if (swr_alloc_set_opts2(&m_audioData.swrContext,
+        &outChannelLayout, AV_SAMPLE_FMT_S16, sampleRate,
+        &m_audioData.codecContext->ch_layout, m_audioData.codecContext->sample_fmt, m_audioData.codecContext->sample_rate,
+        0, nullptr) < 0 || swr_init(m_audioData.swrContext) < 0) {
+        std::cerr << "Failed to initialize the SwrContext." << std::endl;
+        return false;
+    }
+
+    m_audioData.frame = av_frame_alloc();
+    return true;
+}
+
+bool AudioDecoder::seek(double time) {
+    if (!m_audioData.frame) return false;
+
+    AVRational timeBase = m_audioData.formatContext->streams[m_audioData.streamIndex]->time_base;
+    int64_t timestamp = static_cast<int64_t>(time / av_q2d(timeBase));
+    if (!m_demuxer->seek(m_audioData.streamIndex, timestamp)) {
+        std::cerr << "Error seeking audio to timestamp: " << timestamp << std::endl;
+        return false;
+    }
+    m_serial = m_demuxer->getSerial(m_audioData.streamIndex);
+
+    // Forget everything decoded before the seek
+    avcodec_flush_buffers(m_audioData.codecContext);
+    swr_init(m_audioData.swrContext);
+    m_position = time;
+    return true;
+}
+
+int AudioDecoder::decode(double endTime, size_t maxBytes, std::vector<uint8_t>& output) {
+    if (!m_audioData.frame) return -1;
+
+    AVRational timeBase = m_audioData.formatContext->streams[m_audioData.streamIndex]->time_base;
+    AVCodecContext* codecContext = m_audioData.codecContext;
+    AVFrame* frame = m_audioData.frame;
+    size_t startSize = output.size();
+
+    AVPacket packet;
+    Uint32 serial = m_serial;
+    bool hasSeeked = false;
+    while (output.size() - startSize < maxBytes && m_position < endTime) {
+        int ret = m_demuxer->readPacket(m_audioData.streamIndex, &packet, &serial);
+        if (ret == AVERROR_EOF) break;
+        if (ret < 0) return -1;
+
+        // Something else moved the reader, its packets don't follow the ones the codec has. Continue from our position once.
+        if (serial != m_serial) {
+            av_packet_unref(&packet);
+            if (hasSeeked || !seek(m_position)) return -1;
+            hasSeeked = true;
+            continue;
+        }
+
+        ret = avcodec_send_packet(codecContext, &packet);
+        av_packet_unref(&packet);
+        if (ret < 0) continue;
+
+        while (avcodec_receive_frame(codecContext, frame) == 0) {
+            double frameTime = frame->best_effort_timestamp * av_q2d(timeBase);
+            int sampleRate = frame->sample_rate;
+            if (frameTime >= endTime) {
+                m_position = endTime;
+                break;
+            }
+
+            // Only keep the samples in [m_position, endTime), decoding starts at the packet before a seek target
+            int firstSample = std::max(0, static_cast<int>((m_position - frameTime) * sampleRate));
+            int endSample = std::min(frame->nb_samples, static_cast<int>((endTime - frameTime) * sampleRate));
+            if (endSample <= firstSample) continue;
+
+            // Point the input at the first kept sample
+            int bytesPerSample = av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format));
+            bool isPlanar = av_sample_fmt_is_planar(static_cast<AVSampleFormat>(frame->format));
+            int planeCount = isPlanar ? frame->ch_layout.nb_channels : 1;
+            int sampleStride = isPlanar ? bytesPerSample : bytesPerSample * frame->ch_layout.nb_channels;
+            std::vector<const uint8_t*> input(planeCount);
+            for (int plane = 0; plane < planeCount; plane++) {
+                input[plane] = frame->extended_data[plane] + static_cast<size_t>(firstSample) * sampleStride;
+            }
+
+            int inputCount = endSample - firstSample;
+            int outputCount = swr_get_out_samples(m_audioData.swrContext, inputCount);
+            m_convertBuffer.resize(static_cast<size_t>(std::max(outputCount, 0)) * getBytesPerFrame());
+            uint8_t* outputData = m_convertBuffer.data();
+            int convertedCount = swr_convert(m_audioData.swrContext, &outputData, outputCount, input.data(), inputCount);
+            if (convertedCount < 0) {
+                std::cerr << "Error in resampling audio" << std::endl;
+                return -1;
+            }
+
+            output.insert(output.end(), m_convertBuffer.begin(), m_convertBuffer.begin() + static_cast<size_t>(convertedCount) * getBytesPerFrame());
+            m_position = frameTime + static_cast<double>(endSample) / sampleRate;
+        }
+    }
+    return static_cast<int>(output.size() - startSize);
+}
+
+double AudioDecoder::getPosition() const {
+    return m_position;
+}
+
+int AudioDecoder::getSampleRate() const {
+    return m_sampleRate;
+}
+
+int AudioDecoder::getChannels() const {
+    return m_channels;
+}
+
+int AudioDecoder::getBytesPerFrame() const {
+    return m_channels * av_get_bytes_per_sample(AV_SAMPLE_FMT_S16);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <SDL.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "VideoData.h"
+#include "Demuxer.h"
+
+/**
+ * @class AudioDecoder
+ * @brief Independent decoder for the audio stream of one file, converting to interleaved signed 16-bit samples.
+ *        Like VideoDecoder it never shares codec state, and it reads through a reader of its own, so it can decode on any thread
+ *        next to the playback audio.
+ */
+class AudioDecoder {
+public:
+    AudioDecoder();
+    ~AudioDecoder();
+
+    /**
+     * @brief Open the file and set up the codec and resampler for its best audio stream.
+     * @param filepath The path to the media file.
+     * @param sampleRate The output sample rate.
+     * @param channels The output channel count (1 or 2).
+     * @return True if successful, otherwise false.
+     */
+    bool open(const char* filepath, int sampleRate = 44100, int channels = 2);
+
+    // Seek to a time in seconds, the next decode starts there. Returns true if successful.
+    bool seek(double time);
+
+    /**
+     * @brief Decode from the current position and append the converted samples to output.
+     * @param endTime Stop at this time in seconds (source time).
+     * @param maxBytes Stop once at least this many bytes were appended.
+     * @param output Receives the interleaved samples.
+     * @return The amount of bytes appended, 0 at the end (of the file or endTime), or -1 on an error.
+     */
+    int decode(double endTime, size_t maxBytes, std::vector<uint8_t>& output);
+
+    // Get the source time in seconds up to which audio was output
+    double getPosition() const;
+
+    int getSampleRate() const;
+    int getChannels() const;
+
+    // Get the size of one output sample frame (all channels) in bytes
+    int getBytesPerFrame() const;
+
+private:
+    AudioData m_audioData; // ffmpeg state of this decoder, the formatContext belongs to m_demuxer
+    std::shared_ptr<Demuxer> m_demuxer;
+    Uint32 m_serial = 0; // Serial of the audio stream in m_demuxer when this decoder was last positioned
+    int m_sampleRate = 44100;
+    int m_channels = 2;
+    double m_position = 0.0;
+    std::vector<uint8_t> m_convertBuffer;
+};
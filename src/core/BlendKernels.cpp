@@ -0,0 +1,136 @@
+#include <SDL.h>
+#include <algorithm>
+#include <cstring>
+#include "BlendKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BLEND_KERNELS_X86
+#include <immintrin.h>
+// MSVC allows AVX2 intrinsics in any function, GCC and Clang need them enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define BLEND_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BLEND_TARGET_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define BLEND_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// Rounded division by 255 of a value in [0, 255 * 255], the same formula is used by every kernel
+static inline uint8_t div255(unsigned int value) {
+    value += 128;
+    return static_cast<uint8_t>((value + (value >> 8)) >> 8);
+}
+
+static void blendRowScalar(uint8_t* dst, const uint8_t* src, int byteCount, uint8_t alpha) {
+    unsigned int inverseAlpha = 255 - alpha;
+    for (int i = 0; i < byteCount; i++) {
+        dst[i] = div255(src[i] * alpha + dst[i] * inverseAlpha);
+    }
+}
+
+#ifdef BLEND_KERNELS_X86
+BLEND_TARGET_AVX2
+static void blendRowAVX2(uint8_t* dst, const uint8_t* src, int byteCount, uint8_t alpha) {
+    const __m256i alphaVec   = _mm256_set1_epi16(alpha);
+    const __m256i inverseVec = _mm256_set1_epi16(255 - alpha);
+    const __m256i roundVec   = _mm256_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 32 <= byteCount; i += 32) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+
+        // Widen to 16 bits, 16 bytes at a time
+        __m256i sLow  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(s));
+        __m256i sHigh = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(s, 1));
+        __m256i dLow  = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(d));
+        __m256i dHigh = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(d, 1));
+
+        __m256i low  = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sLow,  alphaVec), _mm256_mullo_epi16(dLow,  inverseVec)), roundVec);
+        __m256i high = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sHigh, alphaVec), _mm256_mullo_epi16(dHigh, inverseVec)), roundVec);
+        low  = _mm256_srli_epi16(_mm256_add_epi16(low,  _mm256_srli_epi16(low,  8)), 8);
+        high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+        // Pack back to 8 bits, packus works per 128-bit lane so restore the order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    blendRowScalar(dst + i, src + i, byteCount - i, alpha);
+}
+#endif // BLEND_KERNELS_X86
+
+#ifdef BLEND_KERNELS_NEON
+static void blendRowNEON(uint8_t* dst, const uint8_t* src, int byteCount, uint8_t alpha) {
+    const uint8x8_t alphaVec   = vdup_n_u8(alpha);
+    const uint8x8_t inverseVec = vdup_n_u8(255 - alpha);
+    const uint16x8_t roundVec  = vdupq_n_u16(128);
+
+    int i = 0;
+    for (; i + 16 <= byteCount; i += 16) {
+        uint8x16_t s = vld1q_u8(src + i);
+        uint8x16_t d = vld1q_u8(dst + i);
+
+        uint16x8_t low  = vmlal_u8(vmull_u8(vget_low_u8(s),  alphaVec), vget_low_u8(d),  inverseVec);
+        uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(s), alphaVec), vget_high_u8(d), inverseVec);
+        low  = vaddq_u16(low,  roundVec);
+        high = vaddq_u16(high, roundVec);
+        low  = vshrq_n_u16(vaddq_u16(low,  vshrq_n_u16(low,  8)), 8);
+        high = vshrq_n_u16(vaddq_u16(high, vshrq_n_u16(high, 8)), 8);
+
+        vst1q_u8(dst + i, vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+    }
+    blendRowScalar(dst + i, src + i, byteCount - i, alpha);
+}
+#endif // BLEND_KERNELS_NEON
+
+using BlendRowFunction = void (*)(uint8_t*, const uint8_t*, int, uint8_t);
+
+// Pick the best kernel for this CPU once
+static BlendRowFunction selectBlendRow() {
+#ifdef BLEND_KERNELS_X86
+    if (SDL_HasAVX2()) return blendRowAVX2;
+#endif
+#ifdef BLEND_KERNELS_NEON
+    return blendRowNEON;
+#endif
+    return blendRowScalar;
+}
+
+static const BlendRowFunction s_blendRow = selectBlendRow();
+
+void blendRow(uint8_t* dst, const uint8_t* src, int byteCount, uint8_t alpha) {
+    if (alpha == 255) {
+        memcpy(dst, src, byteCount);
+        return;
+    }
+    if (alpha == 0) return;
+    s_blendRow(dst, src, byteCount, alpha);
+}
+
+void fillRowRGB(uint8_t* dst, int pixelCount, uint8_t r, uint8_t g, uint8_t b) {
+    if (pixelCount <= 0) return;
+    dst[0] = r;
+    dst[1] = g;
+    dst[2] = b;
+
+    // Double the filled part every step, memcpy is vectorised already
+    int filled = 3;
+    int byteCount = pixelCount * 3;
+    while (filled < byteCount) {
+        int chunk = std::min(filled, byteCount - filled);
+        memcpy(dst + filled, dst, chunk);
+        filled += chunk;
+    }
+}
+
+const char* getBlendKernelName() {
+#ifdef BLEND_KERNELS_X86
+    if (s_blendRow == blendRowAVX2) return "AVX2";
+#endif
+#ifdef BLEND_KERNELS_NEON
+    return "NEON";
+#endif
+    return "Scalar";
+}
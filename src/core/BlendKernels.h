@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+// Per-row pixel kernels used for compositing. All kernels work on raw bytes, so they apply to any interleaved 8-bit pixel format.
+// Every instruction set produces bit-identical results, so preview and export always match.
+
+/**
+ * @brief Blend a row of source pixels over a row of destination pixels with a constant opacity.
+ *        dst = (src * alpha + dst * (255 - alpha)) / 255, rounded.
+ * @param dst The destination row, also the background.
+ * @param src The source row to blend over dst.
+ * @param byteCount The amount of bytes in both rows.
+ * @param alpha The opacity of src, 0 (invisible) to 255 (opaque).
+ */
+void blendRow(uint8_t* dst, const uint8_t* src, int byteCount, uint8_t alpha);
+
+/**
+ * @brief Fill a row of RGB24 pixels with a single color.
+ * @param dst The destination row.
+ * @param pixelCount The amount of pixels to fill.
+ */
+void fillRowRGB(uint8_t* dst, int pixelCount, uint8_t r, uint8_t g, uint8_t b);
+
+// Get the name of the instruction set the kernels use on this machine ("AVX2", "NEON" or "Scalar")
+const char* getBlendKernelName();
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Compositor.h"
+#include "AllocationTracker.h"
+#include "BlendKernels.h"
+#include "Tracer.h"
+
+Compositor::Compositor(ThreadPool* threadPool) : m_threadPool(threadPool) { }
+
+bool Compositor::composite(const TimelineSnapshot& snapshot, Uint32 frame, FrameProvider& provider, CompositeFrame& output) {
+    return composite(snapshot, frame, snapshot.getVideoLayers(frame), provider, output);
+}
+
+bool Compositor::composite(const TimelineSnapshot& snapshot, Uint32 frame, const std::vector<VideoLayerRef>& trackLayers, FrameProvider& provider, CompositeFrame& output, bool* isExact) {
+    TRACE_ZONE("Compositor::composite");
+    ALLOCATION_TAG("Compositor");
+    output.resize(snapshot.outputWidth, snapshot.outputHeight);
+
+    // Collect layers from the top track down, and stop at the first layer that hides everything below it.
+    // Hidden segments are never decoded. m_layers[0] ends up as the topmost layer.
+    int layerCount = 0;
+    bool allExact = true;
+    for (auto it = trackLayers.rbegin(); it != trackLayers.rend(); ++it) {
+        if (layerCount == static_cast<int>(m_layers.size())) m_layers.emplace_back();
+        Layer& layer = m_layers[layerCount];
+
+        bool isVisible = buildLayer(layer, *it, frame, provider, output.width, output.height);
+        allExact = allExact && layer.isExact;
+        if (!isVisible) continue;
+
+        layerCount++;
+        if (layer.coversOutput) break;
+    }
+
+    // Without an opaque full-size layer at the bottom, start from black
+    bool clearFirst = layerCount == 0 || !m_layers[layerCount - 1].coversOutput;
+
+    // Split the output in horizontal tiles and draw them in parallel, every tile blends all layers bottom to top
+    int tileCount = (output.height + m_tileHeight - 1) / m_tileHeight;
+    m_threadPool->parallelFor(tileCount, [&](int tile) {
+        int rowStart = tile * m_tileHeight;
+        compositeRows(output, layerCount, clearFirst, rowStart, std::min(rowStart + m_tileHeight, output.height));
+        });
+
+    if (isExact) *isExact = allExact;
+    return layerCount > 0;
+}
+
+bool Compositor::buildLayer(Layer& layer, const VideoLayerRef& ref, Uint32 frame, FrameProvider& provider, int outputWidth, int outputHeight) {
+    layer.transition = ref.incoming ? ref.incoming->transitionIn : SegmentTransition();
+    if (!ref.incoming) layer.transition.type = TRANSITION_NONE;
+    layer.progress = ref.progress;
+
+    // A dip to color only shows one side at a time
+    bool needOutgoing = true;
+    bool needIncoming = ref.incoming != nullptr;
+    if (layer.transition.type == TRANSITION_DIP_TO_COLOR) {
+        needOutgoing = ref.progress < 0.5f;
+        needIncoming = !needOutgoing;
+    }
+
+    const VideoSegment* sides[2] = { needOutgoing ? ref.segment : nullptr, needIncoming ? ref.incoming : nullptr };
+    PlacedImage* placed[2] = { &layer.outgoing, &layer.incoming };
+    bool visible[2] = { false, false };
+    bool exact[2] = { true, true }; // One flag per side, the sides may be fetched in parallel
+
+    auto fetchSide = [&](int i) {
+        const VideoSegment* segment = sides[i];
+        if (!segment || segment->transform.opacity <= 0.0f) return;
+
+        // A side that should show but has no image is as inexact as a stale one
+        LayerFrame& image = placed[i]->image;
+        image.isExact = true;
+        exact[i] = false;
+        if (!provider.getSegmentFrame(*segment, segment->getSourceFrame(frame), image)) return;
+        if (!image.data || image.width <= 0 || image.height <= 0) return;
+        exact[i] = image.isExact;
+
+        placeImage(*placed[i], segment->transform, outputWidth, outputHeight);
+        visible[i] = placed[i]->destRect.w > 0 && placed[i]->destRect.h > 0;
+    };
+
+    if (sides[0] && sides[1]) {
+        // Both sides of a transition have their own decoder, so decode them at the same time
+        m_threadPool->parallelFor(2, fetchSide);
+    }
+    else {
+        fetchSide(0);
+        fetchSide(1);
+    }
+
+    layer.hasOutgoing = visible[0];
+    layer.hasIncoming = visible[1];
+    layer.isExact = exact[0] && exact[1];
+
+    // A dip still draws its color when the side itself is not visible
+    if (!layer.hasOutgoing && !layer.hasIncoming && layer.transition.type != TRANSITION_DIP_TO_COLOR) return false;
+
+    layer.coversOutput = (!needOutgoing || (layer.hasOutgoing && layer.outgoing.coversOutput))
+        && (!needIncoming || (layer.hasIncoming && layer.incoming.coversOutput));
+    return true;
+}
+
+void Compositor::placeImage(PlacedImage& placed, const SegmentTransform& transform, int outputWidth, int outputHeight) {
+    const LayerFrame& image = placed.image;
+    placed.alpha = static_cast<Uint8>(std::lround(std::clamp(transform.opacity, 0.0f, 1.0f) * 255.0f));
+    placed.destRect = { 0, 0, 0, 0 };
+    placed.isDirectCopy = false;
+    placed.coversOutput = false;
+    // Area of the source frame that is left after cropping
+    int cropX0 = std::clamp(static_cast<int>(std::lround(transform.cropLeft * image.width)), 0, image.width);
+    int cropX1 = std::clamp(static_cast<int>(std::lround((1.0f - transform.cropRight) * image.width)), cropX0, image.width);
+    int cropY0 = std::clamp(static_cast<int>(std::lround(transform.cropTop * image.height)), 0, image.height);
+    int cropY1 = std::clamp(static_cast<int>(std::lround((1.0f - transform.cropBottom) * image.height)), cropY0, image.height);
+
+    // Fit the full source frame into the output, then apply the segment's own scale
+    double scale = std::min(static_cast<double>(outputWidth) / image.width, static_cast<double>(outputHeight) / image.height) * transform.scale;
+    if (scale <= 0.0 || cropX1 <= cropX0 || cropY1 <= cropY0) return;
+
+    // Top-left corner of the full (uncropped) source frame on the output
+    double frameX = (outputWidth  - image.width  * scale) / 2.0 + transform.positionX * outputWidth;
+    double frameY = (outputHeight - image.height * scale) / 2.0 + transform.positionY * outputHeight;
+
+    // Output pixels whose centers fall inside the cropped area, clipped to the output
+    int x0 = std::clamp(static_cast<int>(std::ceil(frameX + cropX0 * scale - 0.5)), 0, outputWidth);
+    int x1 = std::clamp(static_cast<int>(std::ceil(frameX + cropX1 * scale - 0.5)), x0, outputWidth);
+    int y0 = std::clamp(static_cast<int>(std::ceil(frameY + cropY0 * scale - 0.5)), 0, outputHeight);
+    int y1 = std::clamp(static_cast<int>(std::ceil(frameY + cropY1 * scale - 0.5)), y0, outputHeight);
+    placed.destRect = { x0, y0, x1 - x0, y1 - y0 };
+    if (placed.destRect.w <= 0 || placed.destRect.h <= 0) return;
+
+    // Nearest source pixel for every output column and row
+    placed.sourceColumnOffsets.resize(placed.destRect.w);
+    for (int x = x0; x < x1; x++) {
+        int sourceX = std::clamp(static_cast<int>(std::floor((x + 0.5 - frameX) / scale)), cropX0, cropX1 - 1);
+        placed.sourceColumnOffsets[x - x0] = sourceX * 3;
+    }
+    placed.sourceRows.resize(placed.destRect.h);
+    for (int y = y0; y < y1; y++) {
+        placed.sourceRows[y - y0] = std::clamp(static_cast<int>(std::floor((y + 0.5 - frameY) / scale)), cropY0, cropY1 - 1);
+    }
+
+    placed.isDirectCopy = true;
+    for (int i = 1; i < placed.destRect.w; i++) {
+        if (placed.sourceColumnOffsets[i] != placed.sourceColumnOffsets[0] + i * 3) {
+            placed.isDirectCopy = false;
+            break;
+        }
+    }
+    placed.coversOutput = placed.alpha == 255 && x0 == 0 && y0 == 0 && x1 == outputWidth && y1 == outputHeight;
+}
+
+void Compositor::drawImageRows(const PlacedImage& placed, uint8_t* target, int linesize, int targetFirstRow, int rowStart, int rowEnd) {
+    thread_local std::vector<uint8_t> s_rowBuffer; // Resampled source row, one per worker thread
+
+    int y0 = std::max(rowStart, placed.destRect.y);
+    int y1 = std::min(rowEnd, placed.destRect.y + placed.destRect.h);
+    int rowBytes = placed.destRect.w * 3;
+    if (!placed.isDirectCopy && static_cast<int>(s_rowBuffer.size()) < rowBytes) s_rowBuffer.resize(rowBytes);
+
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* sourceRow = placed.image.data + static_cast<size_t>(placed.sourceRows[y - placed.destRect.y]) * placed.image.linesize;
+        uint8_t* destRow = target + static_cast<size_t>(y - targetFirstRow) * linesize + placed.destRect.x * 3;
+
+        const uint8_t* blendSource = sourceRow + placed.sourceColumnOffsets[0];
+        if (!placed.isDirectCopy) {
+            // Gather the scaled row first, so the blend kernel always works on contiguous pixels
+            uint8_t* buffer = s_rowBuffer.data();
+            for (int x = 0; x < placed.destRect.w; x++) {
+                const uint8_t* pixel = sourceRow + placed.sourceColumnOffsets[x];
+                buffer[x * 3]     = pixel[0];
+                buffer[x * 3 + 1] = pixel[1];
+                buffer[x * 3 + 2] = pixel[2];
+            }
+            blendSource = buffer;
+        }
+        blendRow(destRow, blendSource, rowBytes, placed.alpha);
+    }
+}
+
+void Compositor::compositeRows(CompositeFrame& output, int layerCount, bool clearFirst, int rowStart, int rowEnd) {
+    if (clearFirst) {
+        memset(output.pixels.data() + static_cast<size_t>(rowStart) * output.linesize, 0, static_cast<size_t>(rowEnd - rowStart) * output.linesize);
+    }
+
+    // Blend from the bottom layer up
+    for (int i = layerCount - 1; i >= 0; i--) {
+        const Layer& layer = m_layers[i];
+        if (layer.transition.type == TRANSITION_NONE) {
+            drawImageRows(layer.outgoing, output.pixels.data(), output.linesize, 0, rowStart, rowEnd);
+        }
+        else {
+            compositeTransitionRows(output, layer, rowStart, rowEnd);
+        }
+    }
+}
+
+void Compositor::compositeTransitionRows(CompositeFrame& output, const Layer& layer, int rowStart, int rowEnd) {
+    thread_local std::vector<uint8_t> s_incomingRows; // The tile with the incoming side drawn over the background
+    thread_local std::vector<uint8_t> s_colorRow;     // One output row filled with the dip color
+
+    uint8_t* outputRows = output.pixels.data() + static_cast<size_t>(rowStart) * output.linesize;
+    int rowCount = rowEnd - rowStart;
+    int rowBytes = output.width * 3;
+
+    if (layer.transition.type == TRANSITION_DIP_TO_COLOR) {
+        if (static_cast<int>(s_colorRow.size()) < rowBytes) s_colorRow.resize(rowBytes);
+        const SDL_Color& color = layer.transition.color;
+        fillRowRGB(s_colorRow.data(), output.width, color.r, color.g, color.b);
+
+        // First half fades the outgoing side to the color, the second half fades from the color to the incoming side
+        bool firstHalf = layer.progress < 0.5f;
+        if (firstHalf && layer.hasOutgoing) drawImageRows(layer.outgoing, output.pixels.data(), output.linesize, 0, rowStart, rowEnd);
+        if (!firstHalf && layer.hasIncoming) drawImageRows(layer.incoming, output.pixels.data(), output.linesize, 0, rowStart, rowEnd);
+
+        float colorAmount = firstHalf ? layer.progress * 2.0f : (1.0f - layer.progress) * 2.0f;
+        Uint8 alpha = static_cast<Uint8>(std::lround(std::clamp(colorAmount, 0.0f, 1.0f) * 255.0f));
+        for (int y = 0; y < rowCount; y++) {
+            blendRow(outputRows + static_cast<size_t>(y) * output.linesize, s_colorRow.data(), rowBytes, alpha);
+        }
+        return;
+    }
+
+    // Draw the incoming side over a copy of the background, and the outgoing side over the background itself
+    size_t tileBytes = static_cast<size_t>(rowCount) * output.linesize;
+    if (s_incomingRows.size() < tileBytes) s_incomingRows.resize(tileBytes);
+    memcpy(s_incomingRows.data(), outputRows, tileBytes);
+    if (layer.hasIncoming) drawImageRows(layer.incoming, s_incomingRows.data(), output.linesize, rowStart, rowStart, rowEnd);
+    if (layer.hasOutgoing) drawImageRows(layer.outgoing, output.pixels.data(), output.linesize, 0, rowStart, rowEnd);
+
+    if (layer.transition.type == TRANSITION_CROSSFADE) {
+        Uint8 alpha = static_cast<Uint8>(std::lround(std::clamp(layer.progress, 0.0f, 1.0f) * 255.0f));
+        for (int y = 0; y < rowCount; y++) {
+            size_t offset = static_cast<size_t>(y) * output.linesize;
+            blendRow(outputRows + offset, s_incomingRows.data() + offset, rowBytes, alpha);
+        }
+    }
+    else if (layer.transition.type == TRANSITION_WIPE) {
+        // The incoming side covers everything left of the wipe edge
+        int splitX = std::clamp(static_cast<int>(std::lround(layer.progress * output.width)), 0, output.width);
+        for (int y = 0; y < rowCount; y++) {
+            size_t offset = static_cast<size_t>(y) * output.linesize;
+            memcpy(outputRows + offset, s_incomingRows.data() + offset, static_cast<size_t>(splitX) * 3);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+#include "Timeline.h"
+#include "ThreadPool.h"
+
+// Decoded RGB24 image of one segment. The pixel data is owned by the FrameProvider that produced it.
+struct LayerFrame {
+    const uint8_t* data = nullptr;
+    int linesize = 0; // Bytes per row
+    int width = 0;
+    int height = 0;
+    bool isExact = true; // False if the provider fell back to another frame, e.g. the last one it decoded
+};
+
+// Composited RGB24 output frame
+struct CompositeFrame {
+    int width = 0;
+    int height = 0;
+    int linesize = 0; // Bytes per row
+    std::vector<uint8_t> pixels;
+
+    // Resize the frame, keeps the allocation if the size did not change
+    void resize(int newWidth, int newHeight) {
+        width = newWidth;
+        height = newHeight;
+        linesize = newWidth * 3;
+        pixels.resize(static_cast<size_t>(linesize) * newHeight);
+    }
+};
+
+/**
+ * @class FrameProvider
+ * @brief Source of decoded segment frames for the Compositor. Implemented by everything that renders the timeline (preview, export).
+ */
+class FrameProvider {
+public:
+    virtual ~FrameProvider() {}
+
+    /**
+     * @brief Get the decoded frame of a video segment.
+     * @param segment The segment to get the frame of.
+     * @param frameInSegment The frame in the segment's source, in the timeline's fps.
+     * @param frame Receives the decoded image. Must stay valid until the Compositor call that asked for it returns.
+     *              Clear frame.isExact when the image is not the requested frame.
+     * @return True if successful, otherwise false.
+     * @note Called concurrently for the two segments of a transition, so different segments must be decodable at the same time.
+     */
+    virtual bool getSegmentFrame(const VideoSegment& segment, Uint32 frameInSegment, LayerFrame& frame) = 0;
+};
+
+/**
+ * @class Compositor
+ * @brief Blends every active video segment of a timeline snapshot into one output frame, using each segment's transform and opacity.
+ *        Transitions between segments are mixed here as well, both sides are decoded in parallel.
+ *        Preview and export both render through this class, so they produce the same output.
+ */
+class Compositor {
+public:
+    Compositor(ThreadPool* threadPool = &ThreadPool::shared());
+
+    /**
+     * @brief Composite all video segments active at frame into output.
+     * @param snapshot The timeline state to render.
+     * @param frame The timeline frame to render.
+     * @param provider Decodes the segment frames. Only called for segments that are visible.
+     * @param output Receives the composited frame, resized to the snapshot's output size.
+     * @return True if at least one segment was drawn, otherwise false (output is black).
+     */
+    bool composite(const TimelineSnapshot& snapshot, Uint32 frame, FrameProvider& provider, CompositeFrame& output);
+
+    // Same as above, with the frame's layers from TimelineSnapshot::getVideoLayers(), for callers that already have them.
+    // isExact receives whether every needed segment frame was provided exactly, only then is the output worth keeping.
+    bool composite(const TimelineSnapshot& snapshot, Uint32 frame, const std::vector<VideoLayerRef>& trackLayers, FrameProvider& provider, CompositeFrame& output, bool* isExact = nullptr);
+
+private:
+    // A segment frame placed on the output
+    struct PlacedImage {
+        LayerFrame image;
+        Uint8 alpha = 255;
+        SDL_Rect destRect = { 0, 0, 0, 0 }; // Visible area on the output
+        std::vector<int> sourceColumnOffsets;  // Byte offset in a source row for every output column of destRect
+        std::vector<int> sourceRows;           // Source row for every output row of destRect
+        bool isDirectCopy = false;             // Source columns map 1:1 onto output columns, so rows need no resampling
+        bool coversOutput = false;             // Opaque and covering the whole output, everything below is hidden
+    };
+
+    // What one track draws: a single segment, or the two sides of a transition
+    struct Layer {
+        PlacedImage outgoing; // The segment, or the outgoing side of a transition
+        PlacedImage incoming; // The incoming side of a transition
+        bool hasOutgoing = false;
+        bool hasIncoming = false;
+        SegmentTransition transition; // Type is TRANSITION_NONE for a single segment
+        float progress = 0.0f;
+        bool coversOutput = false; // Everything below this layer is hidden
+        bool isExact = true; // Every needed side was provided at exactly its frame
+    };
+
+    // Decode and place everything a track shows at frame, returns false if nothing of it is visible.
+    // Sets layer.isExact, also when returning false.
+    bool buildLayer(Layer& layer, const VideoLayerRef& ref, Uint32 frame, FrameProvider& provider, int outputWidth, int outputHeight);
+
+    // Compute where an image lands on the output and which source pixels it samples
+    void placeImage(PlacedImage& placed, const SegmentTransform& transform, int outputWidth, int outputHeight);
+
+    // Draw the rows [rowStart, rowEnd) of an image into target, whose first row is output row targetFirstRow
+    void drawImageRows(const PlacedImage& placed, uint8_t* target, int linesize, int targetFirstRow, int rowStart, int rowEnd);
+
+    // Draw all layers into the output rows [rowStart, rowEnd)
+    void compositeRows(CompositeFrame& output, int layerCount, bool clearFirst, int rowStart, int rowEnd);
+
+    // Draw a transition layer into the output rows [rowStart, rowEnd)
+    void compositeTransitionRows(CompositeFrame& output, const Layer& layer, int rowStart, int rowEnd);
+
+private:
+    ThreadPool* m_threadPool;
+    std::vector<Layer> m_layers; // Reused between frames to avoid reallocating the sample maps
+    int m_tileHeight = 64; // Rows per unit of work spread over the thread pool
+};
@@ -0,0 +1,160 @@
+#include <iostream>
+#include "DecoderPool.h"
+#include "Metrics.h"
+
+DecoderLease::DecoderLease(DecoderPool* pool, std::unique_ptr<VideoDecoder> decoder, Uint32 affinity)
+    : m_pool(pool), m_decoder(std::move(decoder)), m_affinity(affinity) { }
+
+DecoderLease::DecoderLease(DecoderLease&& other) noexcept
+    : m_pool(other.m_pool), m_decoder(std::move(other.m_decoder)), m_affinity(other.m_affinity) { }
+
+DecoderLease& DecoderLease::operator=(DecoderLease&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_pool = other.m_pool;
+        m_decoder = std::move(other.m_decoder);
+        m_affinity = other.m_affinity;
+    }
+    return *this;
+}
+
+DecoderLease::~DecoderLease() {
+    release();
+}
+
+void DecoderLease::release() {
+    if (m_pool && m_decoder) {
+        m_pool->release(std::move(m_decoder), m_affinity);
+    }
+    m_decoder = nullptr;
+}
+
+DecoderPool::DecoderPool(size_t memoryBudget) : m_memoryBudget(memoryBudget) { }
+
+DecoderPool::~DecoderPool() { }
+
+DecoderLease DecoderPool::acquire(const std::string& filepath, Uint32 affinity, Uint32 frameIndex, Uint32 owner) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_idleDecoders.find(filepath);
+        if (it != m_idleDecoders.end() && !it->second.empty()) {
+            std::vector<IdleDecoder>& idle = it->second;
+
+            // Pick the best idle decoder: same user first, then one that needs no seek (closest first), then the least recently returned
+            int best = -1;
+            int bestRank = 0;
+            for (int i = 0; i < static_cast<int>(idle.size()); i++) {
+                const VideoDecoder* decoder = idle[i].decoder.get();
+                if (decoder->getOwner() != owner) continue;
+
+                int rank;
+                if (affinity != 0 && idle[i].affinity == affinity) rank = 3;
+                else if (decoder->canDecodeWithoutSeek(frameIndex)) rank = 2;
+                else rank = 1;
+
+                bool isBetter = best == -1 || rank > bestRank;
+                if (!isBetter && rank == bestRank) {
+                    if (rank == 2) isBetter = decoder->getPosition() > idle[best].decoder->getPosition();
+                    else isBetter = idle[i].returnedAt < idle[best].returnedAt;
+                }
+                if (isBetter) {
+                    best = i;
+                    bestRank = rank;
+                }
+            }
+
+            if (best != -1) {
+                std::unique_ptr<VideoDecoder> decoder = std::move(idle[best].decoder);
+                idle.erase(idle.begin() + best);
+
+                size_t memory = decoder->getMemoryEstimate();
+                m_idleMemory -= memory;
+                m_leasedMemory += memory;
+                m_idleCount--;
+                m_leasedCount++;
+                return DecoderLease(this, std::move(decoder), affinity);
+            }
+        }
+    }
+
+    // Nothing idle for this owner, open a new decoder (without holding the lock, opening a file is slow)
+    auto decoder = std::make_unique<VideoDecoder>();
+    if (!decoder->open(filepath.c_str(), owner)) {
+        std::cerr << "Failed to open a decoder for: " << filepath << std::endl;
+        return DecoderLease();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_leasedMemory += decoder->getMemoryEstimate();
+    m_leasedCount++;
+    evictIdleDecoders();
+
+    // Closing idle decoders was not enough, the leases alone are over the budget
+    if (m_leasedMemory > m_memoryBudget) {
+        static Metrics::Counter& leasesOverBudget = Metrics::shared().counter("decoderPool.leasesOverBudget");
+        leasesOverBudget.add();
+    }
+    return DecoderLease(this, std::move(decoder), affinity);
+}
+
+void DecoderPool::release(std::unique_ptr<VideoDecoder> decoder, Uint32 affinity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t memory = decoder->getMemoryEstimate();
+    m_leasedMemory -= memory;
+    m_idleMemory += memory;
+    m_leasedCount--;
+    m_idleCount++;
+
+    std::string filepath = decoder->getFilepath();
+    m_idleDecoders[filepath].push_back({ std::move(decoder), affinity, ++m_returnCount });
+    evictIdleDecoders();
+}
+
+void DecoderPool::evictIdleDecoders() {
+    while (m_leasedMemory + m_idleMemory > m_memoryBudget && m_idleCount > 0) {
+        // Find the least recently returned idle decoder over all files
+        std::vector<IdleDecoder>* oldestList = nullptr;
+        int oldest = -1;
+        for (auto& [filepath, idle] : m_idleDecoders) {
+            for (int i = 0; i < static_cast<int>(idle.size()); i++) {
+                if (!oldestList || idle[i].returnedAt < (*oldestList)[oldest].returnedAt) {
+                    oldestList = &idle;
+                    oldest = i;
+                }
+            }
+        }
+        if (!oldestList) return;
+
+        m_idleMemory -= (*oldestList)[oldest].decoder->getMemoryEstimate();
+        m_idleCount--;
+        oldestList->erase(oldestList->begin() + oldest);
+    }
+}
+
+void DecoderPool::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memoryBudget = bytes;
+    evictIdleDecoders();
+}
+
+size_t DecoderPool::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_leasedMemory + m_idleMemory;
+}
+
+int DecoderPool::getOpenCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_leasedCount + m_idleCount;
+}
+
+void DecoderPool::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idleDecoders.clear();
+    m_idleMemory = 0;
+    m_idleCount = 0;
+}
+
+DecoderPool& DecoderPool::shared() {
+    static DecoderPool instance;
+    return instance;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <SDL.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "VideoDecoder.h"
+
+class DecoderPool;
+
+/**
+ * @class DecoderLease
+ * @brief A VideoDecoder borrowed from a DecoderPool. The decoder goes back to the pool when the lease is released or destroyed.
+ */
+class DecoderLease {
+public:
+    DecoderLease() {}
+    DecoderLease(DecoderPool* pool, std::unique_ptr<VideoDecoder> decoder, Uint32 affinity);
+    DecoderLease(DecoderLease&& other) noexcept;
+    DecoderLease& operator=(DecoderLease&& other) noexcept;
+    DecoderLease(const DecoderLease&) = delete;
+    DecoderLease& operator=(const DecoderLease&) = delete;
+    ~DecoderLease();
+
+    // Return the decoder to the pool now
+    void release();
+
+    VideoDecoder* get() const { return m_decoder.get(); }
+    VideoDecoder* operator->() const { return m_decoder.get(); }
+    explicit operator bool() const { return m_decoder != nullptr; }
+
+private:
+    DecoderPool* m_pool = nullptr;
+    std::unique_ptr<VideoDecoder> m_decoder;
+    Uint32 m_affinity = 0; // Who leased the decoder, the pool hands it back to them first
+};
+
+/**
+ * @class DecoderPool
+ * @brief Keeps open VideoDecoders per file, so segments, thumbnails and exports lease a decoder instead of sharing one.
+ *        Returned decoders stay open and positioned, and go preferably to whoever can continue decoding without a seek.
+ *        A decoder only goes back to the owner it was opened for, decoders of the player share their reader with the playback audio.
+ *        The memory budget counts leased and idle decoders. When the pool is over it, idle decoders are closed (least recently
+ *        returned first). A lease is never refused, so leased decoders alone can take the pool over its budget until they are returned.
+ */
+class DecoderPool {
+public:
+    DecoderPool(size_t memoryBudget = 1024ull * 1024 * 1024);
+    ~DecoderPool();
+
+    /**
+     * @brief Lease a decoder for a file. Prefers the idle decoder last used with the same affinity, then an idle decoder
+     *        that reaches frameIndex without seeking, then the least recently returned idle decoder. Opens a new decoder if none is idle,
+     *        even when the leased decoders already use the whole budget (counted in the metric decoderPool.leasesOverBudget).
+     * @param filepath The path to the video file.
+     * @param affinity Identifies the user of the decoder (e.g. a segmentID), 0 for none.
+     * @param frameIndex The first frame the user will decode, in the timeline's fps.
+     * @param owner Who decodes, see Demuxer. Jobs on other threads (prefetch, export) keep the default, a reader of their own.
+     * @return The lease, empty if no decoder could be opened for the file.
+     */
+    DecoderLease acquire(const std::string& filepath, Uint32 affinity, Uint32 frameIndex, Uint32 owner = Demuxer::s_privateOwner);
+
+    // Set the memory budget in bytes, closes idle decoders if the pool is over it
+    void setMemoryBudget(size_t bytes);
+
+    // Get the estimated memory of all open decoders (leased and idle) in bytes
+    size_t getMemoryUsage() const;
+
+    // Get the amount of open decoders (leased and idle)
+    int getOpenCount() const;
+
+    // Close all idle decoders
+    void clear();
+
+    // Get the pool shared by the whole application
+    static DecoderPool& shared();
+
+private:
+    friend class DecoderLease;
+
+    // Return a leased decoder to the idle decoders of its file
+    void release(std::unique_ptr<VideoDecoder> decoder, Uint32 affinity);
+
+    // Close idle decoders, least recently returned first, until the pool is within its memory budget. Expects m_mutex to be locked.
+    void evictIdleDecoders();
+
+private:
+    struct IdleDecoder {
+        std::unique_ptr<VideoDecoder> decoder;
+        Uint32 affinity = 0;
+        Uint64 returnedAt = 0; // Value of m_returnCount when it was returned
+    };
+
+    std::unordered_map<std::string, std::vector<IdleDecoder>> m_idleDecoders; // Keyed by filepath
+    mutable std::mutex m_mutex;
+    size_t m_memoryBudget;
+    size_t m_leasedMemory = 0;
+    size_t m_idleMemory = 0;
+    int m_leasedCount = 0;
+    int m_idleCount = 0;
+    Uint64 m_returnCount = 0;
+};
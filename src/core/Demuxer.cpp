@@ -0,0 +1,194 @@
+#include <iostream>
+#include <unordered_map>
+#include "Demuxer.h"
+
+// Every open shared reader per filepath, so decoders of the same file and owner find each other's reader
+static std::mutex s_registryMutex;
+static std::unordered_map<std::string, std::vector<std::weak_ptr<Demuxer>>> s_registry;
+
+Demuxer::~Demuxer() {
+    for (StreamQueue& queue : m_streams) {
+        clearQueue(queue);
+    }
+    if (m_formatContext) {
+        avformat_close_input(&m_formatContext);
+    }
+}
+
+std::shared_ptr<Demuxer> Demuxer::open(const std::string& filepath, Uint32 owner) {
+    if (owner != s_privateOwner) {
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        for (const std::weak_ptr<Demuxer>& entry : s_registry[filepath]) {
+            std::shared_ptr<Demuxer> demuxer = entry.lock();
+            if (demuxer && demuxer->m_owner == owner) return demuxer;
+        }
+    }
+
+    // Open outside the lock, probing a file is slow
+    std::shared_ptr<Demuxer> demuxer(new Demuxer(owner));
+    if (!demuxer->openFile(filepath)) return nullptr;
+    registerShared(demuxer);
+    return demuxer;
+}
+
+std::shared_ptr<Demuxer> Demuxer::openForStream(const std::string& filepath, AVMediaType type, int* streamIndex, Uint32 owner) {
+    if (owner != s_privateOwner) {
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        for (const std::weak_ptr<Demuxer>& entry : s_registry[filepath]) {
+            std::shared_ptr<Demuxer> demuxer = entry.lock();
+            if (!demuxer || demuxer->m_owner != owner) continue;
+
+            int index = av_find_best_stream(demuxer->m_formatContext, type, -1, -1, nullptr, 0);
+            if (index >= 0 && demuxer->claimStream(index)) {
+                *streamIndex = index;
+                return demuxer;
+            }
+        }
+    }
+
+    // Every open reader of the owner already feeds a decoder of this type, open another one
+    std::shared_ptr<Demuxer> demuxer(new Demuxer(owner));
+    if (!demuxer->openFile(filepath)) return nullptr;
+
+    int index = av_find_best_stream(demuxer->m_formatContext, type, -1, -1, nullptr, 0);
+    if (index < 0) {
+        std::cerr << "Could not find a stream of type " << av_get_media_type_string(type) << " in: " << filepath << std::endl;
+        return nullptr;
+    }
+    demuxer->claimStream(index);
+    *streamIndex = index;
+    registerShared(demuxer);
+    return demuxer;
+}
+
+void Demuxer::registerShared(const std::shared_ptr<Demuxer>& demuxer) {
+    if (demuxer->m_owner == s_privateOwner) return;
+
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    std::vector<std::weak_ptr<Demuxer>>& demuxers = s_registry[demuxer->m_filepath];
+    std::erase_if(demuxers, [](const std::weak_ptr<Demuxer>& entry) { return entry.expired(); });
+    demuxers.push_back(demuxer);
+}
+
+bool Demuxer::openFile(const std::string& filepath) {
+    m_filepath = filepath;
+
+    // Open the file and reads its header, populating formatContext.
+    m_formatContext = avformat_alloc_context();
+    if (avformat_open_input(&m_formatContext, filepath.c_str(), nullptr, nullptr) != 0) {
+        std::cerr << "Could not open input file: " << filepath << std::endl;
+        return false;
+    }
+
+    // Find information about streams (audio, video) within the file.
+    if (avformat_find_stream_info(m_formatContext, nullptr) < 0) {
+        std::cerr << "Could not find stream information." << std::endl;
+        return false;
+    }
+
+    m_streams.resize(m_formatContext->nb_streams);
+    return true;
+}
+
+bool Demuxer::claimStream(int streamIndex) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (streamIndex < 0 || streamIndex >= static_cast<int>(m_streams.size())) return false;
+    if (m_streams[streamIndex].isClaimed) return false;
+    m_streams[streamIndex].isClaimed = true;
+    return true;
+}
+
+void Demuxer::releaseStream(int streamIndex) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (streamIndex < 0 || streamIndex >= static_cast<int>(m_streams.size())) return;
+    m_streams[streamIndex].isClaimed = false;
+    clearQueue(m_streams[streamIndex]);
+}
+
+int Demuxer::readPacket(int streamIndex, AVPacket* packet, Uint32* serial) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (streamIndex < 0 || streamIndex >= static_cast<int>(m_streams.size())) return AVERROR(EINVAL);
+
+    // Packets read earlier for this stream come first
+    StreamQueue& queue = m_streams[streamIndex];
+    if (serial) *serial = queue.serial;
+    if (!queue.packets.empty()) {
+        AVPacket* queued = queue.packets.front();
+        queue.packets.pop_front();
+        queue.byteCount -= queued->size;
+        av_packet_move_ref(packet, queued);
+        av_packet_free(&queued);
+        return 0;
+    }
+
+    while (true) {
+        int ret = av_read_frame(m_formatContext, packet);
+        if (ret < 0) return ret;
+        if (packet->stream_index == streamIndex) return 0;
+
+        // A packet of another stream, keep it for that stream's decoder if there is one
+        if (packet->stream_index < 0 || packet->stream_index >= static_cast<int>(m_streams.size()) || !m_streams[packet->stream_index].isClaimed) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        StreamQueue& other = m_streams[packet->stream_index];
+        AVPacket* queued = av_packet_alloc();
+        av_packet_move_ref(queued, packet);
+        other.packets.push_back(queued);
+        other.byteCount += queued->size;
+
+        // The other decoder is not reading, drop its oldest packets. It has to seek once it reads again.
+        while (other.byteCount > m_maxQueueBytes && !other.packets.empty()) {
+            AVPacket* dropped = other.packets.front();
+            other.packets.pop_front();
+            other.byteCount -= dropped->size;
+            av_packet_free(&dropped);
+            other.serial++;
+            other.seekTime = -1.0;
+        }
+    }
+}
+
+bool Demuxer::seek(int streamIndex, int64_t timestamp) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (av_seek_frame(m_formatContext, streamIndex, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        std::cerr << "Error seeking to timestamp: " << timestamp << std::endl;
+        return false;
+    }
+
+    // Every stream continues from the new position
+    double seekTime = timestamp * av_q2d(m_formatContext->streams[streamIndex]->time_base);
+    for (StreamQueue& queue : m_streams) {
+        clearQueue(queue);
+        queue.serial++;
+        queue.seekTime = seekTime;
+    }
+    return true;
+}
+
+Uint32 Demuxer::getSerial(int streamIndex) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_streams[streamIndex].serial;
+}
+
+double Demuxer::getSeekTime(int streamIndex) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_streams[streamIndex].seekTime;
+}
+
+AVFormatContext* Demuxer::getFormatContext() const {
+    return m_formatContext;
+}
+
+const std::string& Demuxer::getFilepath() const {
+    return m_filepath;
+}
+
+void Demuxer::clearQueue(StreamQueue& queue) {
+    for (AVPacket* packet : queue.packets) {
+        av_packet_free(&packet);
+    }
+    queue.packets.clear();
+    queue.byteCount = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <SDL.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/**
+ * @class Demuxer
+ * @brief One reader of a media file, shared by the video and audio decoders of that file.
+ *        Packets are routed into a bounded queue per stream, so the file is read (and probed) once while every decoder only sees its own stream.
+ *        A seek moves the reader for all streams. Decoders notice it through their stream's serial, and continue from the new position
+ *        instead of seeking again when it is just before the point they need. This keeps video and audio reads in lockstep.
+ *        Readers are only shared between decoders of the same owner, so a job on another thread never seeks the reader playback reads from.
+ */
+class Demuxer {
+public:
+    static constexpr Uint32 s_privateOwner = 0;  // Never shared, every decoder of this owner gets a reader of its own
+    static constexpr Uint32 s_playbackOwner = 1; // The video player and the assets' playback audio
+
+    ~Demuxer();
+
+    // Get an open reader of a file for an owner, or open one. Returns nullptr if the file can't be opened.
+    static std::shared_ptr<Demuxer> open(const std::string& filepath, Uint32 owner);
+
+    /**
+     * @brief Get a reader of a file whose best stream of a type is not read by another decoder yet, and claim that stream.
+     *        Reuses an open reader of the file and the same owner when possible, otherwise opens a new one.
+     * @param filepath The path to the media file.
+     * @param type The type of stream to decode.
+     * @param streamIndex Receives the index of the claimed stream.
+     * @param owner Who decodes the stream, s_privateOwner for a reader that is not shared.
+     * @return The reader, nullptr if the file can't be opened or has no stream of that type.
+     */
+    static std::shared_ptr<Demuxer> openForStream(const std::string& filepath, AVMediaType type, int* streamIndex, Uint32 owner = s_privateOwner);
+
+    // Claim a stream for a decoder, only packets of claimed streams are queued. Returns false if the stream is already claimed.
+    bool claimStream(int streamIndex);
+
+    // Give up the claim on a stream and drop its queued packets
+    void releaseStream(int streamIndex);
+
+    /**
+     * @brief Read the next packet of a claimed stream. Packets of other claimed streams read on the way are queued for their decoders.
+     * @param streamIndex The stream to read.
+     * @param packet Receives the packet, unref it when done.
+     * @param serial Receives the serial of the stream the packet belongs to (optional). A packet read after a seek by another decoder
+     *        has a different serial than the one the caller positioned at.
+     * @return 0 if successful, AVERROR_EOF at the end of the file, or another negative ffmpeg error.
+     */
+    int readPacket(int streamIndex, AVPacket* packet, Uint32* serial = nullptr);
+
+    /**
+     * @brief Seek the reader to the last keyframe at or before timestamp, for all streams, and clear all queues.
+     * @param streamIndex The stream that timestamp is in the time base of.
+     * @param timestamp The time to seek to.
+     * @return True if successful, otherwise false.
+     */
+    bool seek(int streamIndex, int64_t timestamp);
+
+    // Get the serial of a stream. It changes whenever the stream's next packet does not follow the last one read (a seek or dropped packets).
+    Uint32 getSerial(int streamIndex) const;
+
+    // Get the time in seconds the reader was last seeked to, or -1 if packets of the stream were dropped since then
+    double getSeekTime(int streamIndex) const;
+
+    AVFormatContext* getFormatContext() const;
+    const std::string& getFilepath() const;
+
+private:
+    Demuxer(Uint32 owner) : m_owner(owner) {}
+
+    // Add a reader to the readers of its file that decoders of its owner may share
+    static void registerShared(const std::shared_ptr<Demuxer>& demuxer);
+
+    // Open and probe the file, returns true if successful
+    bool openFile(const std::string& filepath);
+
+    struct StreamQueue {
+        bool isClaimed = false;
+        std::deque<AVPacket*> packets;
+        size_t byteCount = 0;
+        Uint32 serial = 0;
+        double seekTime = -1.0;
+    };
+
+    // Free all packets of a queue
+    void clearQueue(StreamQueue& queue);
+
+private:
+    AVFormatContext* m_formatContext = nullptr;
+    std::string m_filepath;
+    Uint32 m_owner;
+    std::vector<StreamQueue> m_streams;
+    mutable std::mutex m_mutex;
+    size_t m_maxQueueBytes = 8 * 1024 * 1024; // Per stream, older packets are dropped when a decoder stops reading its stream
+};
@@ -0,0 +1,329 @@
+#include <cstring>
+#include <iostream>
+#include "FrameCache.h"
+#include "AllocationTracker.h"
+#include "QoiCodec.h"
+
+template <typename Data>
+void FrameCache::Tier<Data>::insert(const FrameKey& key, Data data, Uint64 size) {
+    erase(key);
+    order.push_back(key);
+    entries[key] = { std::move(data), size, std::prev(order.end()) };
+    stats.frameCount++;
+    stats.bytes += size;
+}
+
+template <typename Data>
+void FrameCache::Tier<Data>::touch(Entry& entry) {
+    order.splice(order.end(), order, entry.order);
+}
+
+template <typename Data>
+void FrameCache::Tier<Data>::erase(const FrameKey& key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) return;
+    order.erase(it->second.order);
+    stats.frameCount--;
+    stats.bytes -= it->second.size;
+    entries.erase(it);
+}
+
+FrameCache::FrameCache(Uint64 hotBudget, Uint64 compressedBudget, Uint64 diskBudget, const std::filesystem::path& spillPath)
+    : m_spillPath(spillPath), m_worker(1) {
+    m_hot.stats.budget = hotBudget;
+    m_compressed.stats.budget = compressedBudget;
+    m_disk.stats.budget = diskBudget;
+
+    if (diskBudget > 0) {
+        std::error_code error;
+        std::filesystem::create_directories(m_spillPath.parent_path(), error);
+        m_spillFile.open(m_spillPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!m_spillFile) {
+            std::cerr << "Could not create the frame cache spill file: " << m_spillPath.string() << std::endl;
+            m_disk.stats.budget = 0;
+        }
+    }
+}
+
+FrameCache::~FrameCache() {
+    // Let the demotion job finish before closing the spill file
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hot.stats.budget = UINT64_MAX;
+        m_compressed.stats.budget = UINT64_MAX;
+    }
+    m_worker.submit([]() {}).wait();
+
+    if (m_spillFile.is_open()) {
+        m_spillFile.close();
+        std::error_code error;
+        std::filesystem::remove(m_spillPath, error);
+    }
+}
+
+std::shared_ptr<const CachedFrame> FrameCache::get(std::string_view filepath, Uint32 frameIndex, int fps) {
+    FrameKeyView key = { filepath, frameIndex, fps };
+    std::shared_ptr<const std::vector<uint8_t>> compressed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto hotIt = m_hot.entries.find(key);
+        if (hotIt != m_hot.entries.end()) {
+            m_hot.touch(hotIt->second);
+            m_hot.stats.hits++;
+            return hotIt->second.data;
+        }
+
+        auto compressedIt = m_compressed.entries.find(key);
+        if (compressedIt != m_compressed.entries.end()) {
+            m_compressed.stats.hits++;
+            compressed = compressedIt->second.data;
+        }
+        else if (!m_disk.entries.count(key)) {
+            m_misses++;
+            return nullptr;
+        }
+    }
+
+    // Decompress outside the lock, other threads keep using the cache in the meantime
+    FrameKey ownedKey = { std::string(filepath), frameIndex, fps };
+    if (compressed) return promote(ownedKey, *compressed);
+
+    std::vector<uint8_t> spilled;
+    if (!readSpilledFrame(ownedKey, spilled)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_misses++;
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_disk.stats.hits++;
+    }
+    return promote(ownedKey, spilled);
+}
+
+void FrameCache::put(std::string_view filepath, Uint32 frameIndex, int fps, const uint8_t* pixels, int width, int height, int linesize) {
+    ALLOCATION_TAG("FrameCache");
+    if (!pixels || width <= 0 || height <= 0) return;
+
+    // Copy without the row padding of the source
+    auto frame = std::make_shared<CachedFrame>();
+    frame->width = width;
+    frame->height = height;
+    frame->linesize = width * 3;
+    frame->pixels.resize(static_cast<size_t>(frame->linesize) * height);
+    for (int y = 0; y < height; y++) {
+        memcpy(frame->pixels.data() + static_cast<size_t>(y) * frame->linesize, pixels + static_cast<size_t>(y) * linesize, frame->linesize);
+    }
+
+    FrameKey key = { std::string(filepath), frameIndex, fps };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_compressed.erase(key);
+    m_disk.erase(key);
+    m_hot.insert(key, frame, frame->pixels.size());
+    dropOverHardLimit();
+    scheduleDemotion();
+}
+
+std::shared_ptr<const CachedFrame> FrameCache::promote(const FrameKey& key, const std::vector<uint8_t>& compressed) {
+    auto frame = std::make_shared<CachedFrame>();
+    if (!decodeQOI(compressed.data(), compressed.size(), frame->width, frame->height, frame->pixels)) {
+        std::cerr << "Could not decompress a cached frame" << std::endl;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_compressed.erase(key);
+        m_disk.erase(key);
+        return nullptr;
+    }
+    frame->linesize = frame->width * 3;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_compressed.erase(key);
+    m_disk.erase(key);
+    m_hot.insert(key, frame, frame->pixels.size());
+    dropOverHardLimit();
+    scheduleDemotion();
+    return frame;
+}
+
+FrameCache::TierStats FrameCache::getHotStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hot.stats;
+}
+
+FrameCache::TierStats FrameCache::getCompressedStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_compressed.stats;
+}
+
+FrameCache::TierStats FrameCache::getDiskStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_disk.stats;
+}
+
+Uint64 FrameCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+void FrameCache::setBudgets(Uint64 hotBudget, Uint64 compressedBudget, Uint64 diskBudget) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hot.stats.budget = hotBudget;
+    m_compressed.stats.budget = compressedBudget;
+
+    // The spill file can't shrink in place, start over at the front
+    if (!m_spillFile.is_open()) diskBudget = 0;
+    if (diskBudget < m_disk.stats.budget) {
+        while (!m_disk.order.empty()) m_disk.erase(m_disk.order.front());
+        m_spillWritePosition = 0;
+    }
+    m_disk.stats.budget = diskBudget;
+    scheduleDemotion();
+}
+
+void FrameCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_hot.order.empty()) m_hot.erase(m_hot.order.front());
+    while (!m_compressed.order.empty()) m_compressed.erase(m_compressed.order.front());
+    while (!m_disk.order.empty()) m_disk.erase(m_disk.order.front());
+    m_spillWritePosition = 0;
+}
+
+FrameCache& FrameCache::shared() {
+    static FrameCache instance;
+    return instance;
+}
+
+std::filesystem::path FrameCache::getDefaultSpillPath() {
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+    return directory / "RythmGameVideoEditor" / "FrameCache.spill";
+}
+
+void FrameCache::scheduleDemotion() {
+    bool isOverBudget = m_hot.stats.bytes > m_hot.stats.budget || m_compressed.stats.bytes > m_compressed.stats.budget;
+    if (!isOverBudget || m_isDemoting) return;
+
+    m_isDemoting = true;
+    m_worker.submit([this]() { demoteFrames(); });
+}
+
+void FrameCache::dropOverHardLimit() {
+    // Divided instead of multiplied, the budget is UINT64_MAX while the cache is destroyed
+    while (m_hot.stats.bytes / m_hotHardLimitFactor > m_hot.stats.budget && m_hot.order.size() > 1) {
+        m_hot.erase(m_hot.order.front());
+        m_hot.stats.evictions++;
+    }
+}
+
+void FrameCache::demoteFrames() {
+    while (true) {
+        FrameKey key;
+        std::shared_ptr<const CachedFrame> frame;
+        std::shared_ptr<const std::vector<uint8_t>> compressed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_hot.stats.bytes > m_hot.stats.budget && !m_hot.order.empty()) {
+                // Leave the frame findable in the hot tier while it is compressed
+                key = m_hot.order.front();
+                frame = m_hot.entries[key].data;
+            }
+            else if (m_compressed.stats.bytes > m_compressed.stats.budget && !m_compressed.order.empty()) {
+                key = m_compressed.order.front();
+                compressed = m_compressed.entries[key].data;
+                m_compressed.erase(key);
+                m_compressed.stats.evictions++;
+            }
+            else {
+                m_isDemoting = false;
+                return;
+            }
+        }
+
+        if (frame) {
+            auto data = std::make_shared<std::vector<uint8_t>>();
+            bool isEncoded = encodeQOI(frame->pixels.data(), frame->width, frame->height, frame->linesize, *data);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_hot.entries.find(key);
+            if (it == m_hot.entries.end() || it->second.data != frame) continue; // Replaced or dropped while compressing
+            m_hot.erase(key);
+            m_hot.stats.evictions++;
+            if (isEncoded && m_compressed.stats.budget > 0) {
+                data->shrink_to_fit();
+                m_compressed.insert(key, data, data->size());
+            }
+        }
+        else {
+            spillFrame(key, compressed);
+        }
+    }
+}
+
+void FrameCache::spillFrame(const FrameKey& key, const std::shared_ptr<const std::vector<uint8_t>>& compressed) {
+    Uint64 size = compressed->size();
+    SpillLocation location;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (size > m_disk.stats.budget) return;
+
+        // Reserve the next part of the ring, the frames stored there are overwritten
+        if (m_spillWritePosition + size > m_disk.stats.budget) m_spillWritePosition = 0;
+        location.offset = m_spillWritePosition;
+        location.id = ++m_spillWriteCount;
+        m_spillWritePosition += size;
+
+        std::vector<FrameKey> overwritten;
+        for (const auto& [diskKey, entry] : m_disk.entries) {
+            if (entry.data.offset < location.offset + size && location.offset < entry.data.offset + entry.size) {
+                overwritten.push_back(diskKey);
+            }
+        }
+        for (const FrameKey& diskKey : overwritten) {
+            m_disk.erase(diskKey);
+            m_disk.stats.evictions++;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_spillFileMutex);
+        m_spillFile.seekp(location.offset);
+        m_spillFile.write(reinterpret_cast<const char*>(compressed->data()), size);
+        if (!m_spillFile) {
+            std::cerr << "Could not write to the frame cache spill file" << std::endl;
+            m_spillFile.clear();
+            return;
+        }
+    }
+
+    // Only findable once written
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_hot.entries.count(key) || m_compressed.entries.count(key)) return; // Added again while spilling
+    m_disk.insert(key, location, size);
+}
+
+bool FrameCache::readSpilledFrame(const FrameKey& key, std::vector<uint8_t>& compressed) {
+    SpillLocation location;
+    Uint64 size = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_disk.entries.find(key);
+        if (it == m_disk.entries.end()) return false;
+        location = it->second.data;
+        size = it->second.size;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_spillFileMutex);
+        compressed.resize(size);
+        m_spillFile.seekg(location.offset);
+        m_spillFile.read(reinterpret_cast<char*>(compressed.data()), size);
+        if (!m_spillFile) {
+            m_spillFile.clear();
+            return false;
+        }
+    }
+
+    // Frames are dropped from the index before their part of the file is overwritten, so the read is valid if it is still there
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_disk.entries.find(key);
+    return it != m_disk.entries.end() && it->second.data.id == location.id;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <SDL.h>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+
+// Decoded RGB24 video frame held by the FrameCache
+struct CachedFrame {
+    int width = 0;
+    int height = 0;
+    int linesize = 0; // Bytes per row
+    std::vector<uint8_t> pixels;
+};
+
+/**
+ * @class FrameCache
+ * @brief Decoded video frames of source files, kept so revisiting a section doesn't decode it from the source again.
+ *        Frames live in three tiers, each with its own budget:
+ *        - hot: uncompressed frames in RAM, ready to composite.
+ *        - compressed: frames pushed out of the hot tier, QOI compressed in RAM.
+ *        - disk: frames pushed out of the compressed tier, in one spill file on local disk that is used as a ring.
+ *        A frame found in a lower tier is decompressed and moved back to the hot tier. Compressing and spilling happen
+ *        on a background thread, so adding a frame only costs a copy.
+ */
+class FrameCache {
+public:
+    // Statistics of one tier
+    struct TierStats {
+        int frameCount = 0;
+        Uint64 bytes = 0;
+        Uint64 budget = 0;
+        Uint64 hits = 0;      // Frames found in this tier
+        Uint64 evictions = 0; // Frames pushed out of this tier because it was full
+    };
+
+    /**
+     * @param hotBudget Bytes of uncompressed frames to keep.
+     * @param compressedBudget Bytes of compressed frames to keep in RAM.
+     * @param diskBudget Size of the spill file in bytes (0 = no disk tier).
+     * @param spillPath The spill file, created or truncated on construction and deleted on destruction.
+     */
+    FrameCache(Uint64 hotBudget = 512ull * 1024 * 1024, Uint64 compressedBudget = 1024ull * 1024 * 1024,
+        Uint64 diskBudget = 8ull * 1024 * 1024 * 1024, const std::filesystem::path& spillPath = getDefaultSpillPath());
+    ~FrameCache();
+
+    /**
+     * @brief Get a cached frame.
+     * @param filepath The source file.
+     * @param frameIndex The frame in the source, in the timeline's fps.
+     * @param fps The timeline's fps.
+     * @return The frame, nullptr if it is not cached. The frame stays valid while the pointer is held.
+     *         Finding a frame in the hot tier, or not at all, allocates nothing.
+     */
+    std::shared_ptr<const CachedFrame> get(std::string_view filepath, Uint32 frameIndex, int fps);
+
+    // Add a decoded frame to the hot tier, the pixels are copied
+    void put(std::string_view filepath, Uint32 frameIndex, int fps, const uint8_t* pixels, int width, int height, int linesize);
+
+    // Get the statistics of the hot / compressed / disk tier
+    TierStats getHotStats() const; TierStats getCompressedStats() const; TierStats getDiskStats() const;
+
+    // Get the amount of frames that were asked for but not cached
+    Uint64 getMisses() const;
+
+    // Set the budget of each tier in bytes, frames over a budget move down a tier
+    void setBudgets(Uint64 hotBudget, Uint64 compressedBudget, Uint64 diskBudget);
+
+    // Drop every cached frame
+    void clear();
+
+    // Get the cache shared by the whole application
+    static FrameCache& shared();
+
+    // Get the spill file used by default, in the system's temporary directory
+    static std::filesystem::path getDefaultSpillPath();
+
+private:
+    // Key of a lookup, refers to the filepath instead of copying it
+    struct FrameKeyView {
+        std::string_view filepath;
+        Uint32 frameIndex = 0;
+        int fps = 0;
+    };
+
+    struct FrameKey {
+        std::string filepath;
+        Uint32 frameIndex = 0;
+        int fps = 0;
+
+        operator FrameKeyView() const { return { filepath, frameIndex, fps }; }
+    };
+
+    // Hash and compare keys and views alike, so the tiers are searched with a FrameKeyView
+    struct FrameKeyHash {
+        using is_transparent = void;
+        size_t operator()(const FrameKeyView& key) const {
+            return std::hash<std::string_view>()(key.filepath) ^ (static_cast<size_t>(key.frameIndex) * 2654435761u) ^ (static_cast<size_t>(key.fps) << 48);
+        }
+    };
+
+    struct FrameKeyEqual {
+        using is_transparent = void;
+        bool operator()(const FrameKeyView& a, const FrameKeyView& b) const {
+            return a.frameIndex == b.frameIndex && a.fps == b.fps && a.filepath == b.filepath;
+        }
+    };
+
+    // A tier's frames in least recently used order, each data type holds what the tier stores of a frame
+    template <typename Data>
+    struct Tier {
+        struct Entry {
+            Data data;
+            Uint64 size = 0;
+            typename std::list<FrameKey>::iterator order;
+        };
+        std::unordered_map<FrameKey, Entry, FrameKeyHash, FrameKeyEqual> entries;
+        std::list<FrameKey> order; // Least recently used first
+        TierStats stats;
+
+        void insert(const FrameKey& key, Data data, Uint64 size);
+        void touch(Entry& entry);
+        void erase(const FrameKey& key);
+    };
+
+    // Where a spilled frame is in the spill file
+    struct SpillLocation {
+        Uint64 offset = 0;
+        Uint64 id = 0; // Unique per write, a reader checks it is unchanged after reading
+    };
+
+    // Move a frame found in a lower tier to the hot tier
+    std::shared_ptr<const CachedFrame> promote(const FrameKey& key, const std::vector<uint8_t>& compressed);
+
+    // Start the background job that moves frames down while a tier is over its budget. Expects m_mutex to be locked.
+    void scheduleDemotion();
+
+    // Drop the least recently used hot frames without compressing them while the hot tier is over its hard limit,
+    // when frames are added faster than the background job compresses them. Expects m_mutex to be locked.
+    void dropOverHardLimit();
+
+    // Compress frames out of the hot tier and spill frames out of the compressed tier until both are within budget
+    void demoteFrames();
+
+    // Write a compressed frame to the spill file, dropping the frames it overwrites
+    void spillFrame(const FrameKey& key, const std::shared_ptr<const std::vector<uint8_t>>& compressed);
+
+    // Read a spilled frame, returns false if it was overwritten in the meantime
+    bool readSpilledFrame(const FrameKey& key, std::vector<uint8_t>& compressed);
+
+private:
+    Tier<std::shared_ptr<const CachedFrame>> m_hot;
+    Tier<std::shared_ptr<const std::vector<uint8_t>>> m_compressed;
+    Tier<SpillLocation> m_disk;
+    Uint64 m_misses = 0;
+    Uint64 m_spillWritePosition = 0; // Where the next spilled frame is written, wraps to 0 at the disk budget
+    Uint64 m_spillWriteCount = 0;
+    bool m_isDemoting = false;
+    Uint64 m_hotHardLimitFactor = 2; // The hot tier may grow to this many times its budget while frames wait to be compressed
+    mutable std::mutex m_mutex; // Guards everything above
+
+    std::filesystem::path m_spillPath;
+    std::fstream m_spillFile;
+    std::mutex m_spillFileMutex; // Guards m_spillFile
+
+    ThreadPool m_worker; // Declared last, so the demotion job finishes before the tiers are destroyed
+};
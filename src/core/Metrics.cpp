@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "Metrics.h"
+
+void Metrics::Gauge::set(Sint64 value) {
+    m_value.store(value, std::memory_order_relaxed);
+    Sint64 max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+void Metrics::Histogram::record(double milliseconds) {
+    Uint64 microseconds = static_cast<Uint64>(std::max(0.0, milliseconds * 1000.0));
+
+    // Bucket 0 holds less than a microsecond, bucket i from 2^(i-1) up to 2^i microseconds
+    int bucket = 0;
+    for (Uint64 value = microseconds; value > 0 && bucket < s_bucketCount - 1; value >>= 1) bucket++;
+
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+    Uint64 max = m_maxMicroseconds.load(std::memory_order_relaxed);
+    while (microseconds > max && !m_maxMicroseconds.compare_exchange_weak(max, microseconds, std::memory_order_relaxed)) {}
+}
+
+double Metrics::Histogram::getMean() const {
+    Uint64 count = getCount();
+    return count == 0 ? 0.0 : m_sumMicroseconds.load(std::memory_order_relaxed) / 1000.0 / count;
+}
+
+double Metrics::Histogram::getPercentile(double fraction) const {
+    Uint64 count = getCount();
+    if (count == 0) return 0.0;
+
+    Uint64 wanted = static_cast<Uint64>(std::ceil(std::clamp(fraction, 0.0, 1.0) * count));
+    Uint64 seen = 0;
+    for (int i = 0; i < s_bucketCount; i++) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= wanted) return std::min(static_cast<double>(1ull << i) / 1000.0, getMax());
+    }
+    return getMax();
+}
+
+Metrics::~Metrics() {
+    stopSnapshots();
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<Counter>& metric = m_counters[name];
+    if (!metric) metric = std::make_unique<Counter>();
+    return *metric;
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<Gauge>& metric = m_gauges[name];
+    if (!metric) metric = std::make_unique<Gauge>();
+    return *metric;
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_ptr<Histogram>& metric = m_histograms[name];
+    if (!metric) metric = std::make_unique<Histogram>();
+    return *metric;
+}
+
+bool Metrics::startSnapshots(const std::filesystem::path& directory, double intervalSeconds) {
+    stopSnapshots();
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Named after the start time, so runs on different machines and builds can be kept side by side
+    std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    std::filesystem::path csvPath = directory / (std::string("metrics_") + stamp + ".csv");
+
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    m_csvFile.open(csvPath, std::ios::trunc);
+    if (!m_csvFile) {
+        std::cerr << "Unable to write metrics to " << csvPath.string() << std::endl;
+        return false;
+    }
+    m_csvFile << "seconds,metric,type,count,value,mean_ms,p50_ms,p95_ms,p99_ms,max\n";
+    m_jsonPath = directory / (std::string("metrics_") + stamp + ".json");
+    m_snapshotInterval = std::max(0.1, intervalSeconds);
+    m_snapshotStart = SDL_GetPerformanceCounter();
+    m_isStopping = false;
+    m_snapshotThread = std::thread(&Metrics::snapshotLoop, this);
+    std::cout << "Writing metrics to " << csvPath.string() << " every " << m_snapshotInterval << " s" << std::endl;
+    return true;
+}
+
+void Metrics::stopSnapshots() {
+    {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        m_isStopping = true;
+    }
+    m_snapshotWake.notify_all();
+    if (m_snapshotThread.joinable()) {
+        m_snapshotThread.join();
+        writeSnapshot(); // The end of the run, with everything since the last interval
+    }
+
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    if (m_csvFile.is_open()) m_csvFile.close();
+}
+
+void Metrics::writeSnapshot() {
+    std::lock_guard<std::mutex> lock(m_snapshotMutex);
+    if (!m_csvFile.is_open()) return;
+    double seconds = (SDL_GetPerformanceCounter() - m_snapshotStart) / static_cast<double>(SDL_GetPerformanceFrequency());
+    writeCsvRows(seconds);
+    writeJson(seconds);
+}
+
+Metrics& Metrics::shared() {
+    static Metrics instance;
+    return instance;
+}
+
+void Metrics::snapshotLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_snapshotMutex);
+            auto interval = std::chrono::duration<double>(m_snapshotInterval);
+            if (m_snapshotWake.wait_for(lock, interval, [this]() { return m_isStopping; })) return;
+        }
+        writeSnapshot();
+    }
+}
+
+void Metrics::writeCsvRows(double seconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_csvFile << std::fixed << std::setprecision(3);
+    for (const auto& [name, counter] : m_counters) {
+        m_csvFile << seconds << ',' << name << ",counter," << counter->get() << ',' << counter->get() << ",,,,,\n";
+    }
+    for (const auto& [name, gauge] : m_gauges) {
+        m_csvFile << seconds << ',' << name << ",gauge,," << gauge->get() << ",,,,," << gauge->getMax() << '\n';
+    }
+    for (const auto& [name, histogram] : m_histograms) {
+        m_csvFile << seconds << ',' << name << ",histogram," << histogram->getCount() << ",," << histogram->getMean() << ','
+            << histogram->getPercentile(0.5) << ',' << histogram->getPercentile(0.95) << ',' << histogram->getPercentile(0.99) << ','
+            << histogram->getMax() << '\n';
+    }
+    m_csvFile.flush(); // Readable while the editor runs, and complete if it crashes
+}
+
+void Metrics::writeJson(double seconds) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n  \"seconds\": " << seconds << ",\n";
+    json << "  \"machine\": { \"platform\": \"" << SDL_GetPlatform() << "\", \"cpuCount\": " << SDL_GetCPUCount()
+        << ", \"systemRamMB\": " << SDL_GetSystemRAM() << " },\n";
+#ifdef NDEBUG
+    json << "  \"build\": { \"date\": \"" << __DATE__ << " " << __TIME__ << "\", \"type\": \"release\" },\n";
+#else
+    json << "  \"build\": { \"date\": \"" << __DATE__ << " " << __TIME__ << "\", \"type\": \"debug\" },\n";
+#endif
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        json << "  \"counters\": {";
+        const char* separator = "\n";
+        for (const auto& [name, counter] : m_counters) {
+            json << separator << "    \"" << name << "\": " << counter->get();
+            separator = ",\n";
+        }
+        json << "\n  },\n  \"gauges\": {";
+        separator = "\n";
+        for (const auto& [name, gauge] : m_gauges) {
+            json << separator << "    \"" << name << "\": { \"value\": " << gauge->get() << ", \"max\": " << gauge->getMax() << " }";
+            separator = ",\n";
+        }
+        json << "\n  },\n  \"histograms\": {";
+        separator = "\n";
+        for (const auto& [name, histogram] : m_histograms) {
+            json << separator << "    \"" << name << "\": { \"count\": " << histogram->getCount() << ", \"meanMs\": " << histogram->getMean()
+                << ", \"p50Ms\": " << histogram->getPercentile(0.5) << ", \"p95Ms\": " << histogram->getPercentile(0.95)
+                << ", \"p99Ms\": " << histogram->getPercentile(0.99) << ", \"maxMs\": " << histogram->getMax() << " }";
+            separator = ",\n";
+        }
+        json << "\n  }\n}\n";
+    }
+
+    // Replaced as a whole, so a reader never sees half a file
+    std::filesystem::path temporaryPath = m_jsonPath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        if (!file) return;
+        file << json.str();
+    }
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, m_jsonPath, error);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @class Metrics
+ * @brief Registry of named counters, gauges and histograms about playback health: how many frames were shown, skipped or
+ *        dropped, how often decoders seek, how long decoding takes, how full the queues are. Updating a metric is a few
+ *        atomic operations, so it can be done from any thread. Look a metric up once and keep the reference, e.g. in a
+ *        function-local static: the registry never removes them.
+ *        It can write snapshots of every metric to disk at an interval, to compare machines and builds.
+ */
+class Metrics {
+public:
+    // A count that only goes up
+    class Counter {
+    public:
+        void add(Uint64 amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+        Uint64 get() const { return m_value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<Uint64> m_value = 0;
+    };
+
+    // A current level, e.g. the depth of a queue, and the highest it has been
+    class Gauge {
+    public:
+        void set(Sint64 value);
+        Sint64 get() const { return m_value.load(std::memory_order_relaxed); }
+        Sint64 getMax() const { return m_max.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<Sint64> m_value = 0;
+        std::atomic<Sint64> m_max = 0;
+    };
+
+    // A distribution of durations in milliseconds, in buckets that double in size from 1 microsecond
+    class Histogram {
+    public:
+        void record(double milliseconds);
+        Uint64 getCount() const { return m_count.load(std::memory_order_relaxed); }
+        double getMean() const;
+        double getMax() const { return m_maxMicroseconds.load(std::memory_order_relaxed) / 1000.0; }
+
+        // Get the value below which a fraction (0 to 1) of the durations are, as the upper bound of its bucket
+        double getPercentile(double fraction) const;
+    private:
+        static constexpr int s_bucketCount = 40; // The last bucket holds everything longer
+        std::atomic<Uint64> m_buckets[s_bucketCount] = {};
+        std::atomic<Uint64> m_count = 0;
+        std::atomic<Uint64> m_sumMicroseconds = 0;
+        std::atomic<Uint64> m_maxMicroseconds = 0;
+    };
+
+    // Records the time from its construction to its destruction into a histogram
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram) : m_histogram(histogram), m_start(SDL_GetPerformanceCounter()) {}
+        ~ScopedTimer() { m_histogram.record((SDL_GetPerformanceCounter() - m_start) * 1000.0 / SDL_GetPerformanceFrequency()); }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    private:
+        Histogram& m_histogram;
+        Uint64 m_start;
+    };
+
+    Metrics() = default;
+    ~Metrics();
+
+    // Get a metric by name, created the first time. The reference stays valid for the lifetime of the registry.
+    Counter& counter(const std::string& name);
+    Gauge& gauge(const std::string& name);
+    Histogram& histogram(const std::string& name);
+
+    /**
+     * @brief Start writing snapshots on a background thread: a row per metric is added to metrics_<start time>.csv
+     *        every interval, and metrics_<start time>.json is replaced with the latest values and a description of the machine.
+     * @param directory The directory to write to, created if needed.
+     * @param intervalSeconds Seconds between snapshots.
+     * @returns False if the files could not be created.
+     */
+    bool startSnapshots(const std::filesystem::path& directory, double intervalSeconds);
+
+    // Write a last snapshot and stop the background thread
+    void stopSnapshots();
+
+    // Write the current value of every metric now
+    void writeSnapshot();
+
+    // Get the registry shared by the whole application
+    static Metrics& shared();
+
+private:
+    void snapshotLoop();
+
+    // Add a row per metric to the CSV file, seconds is the time since the snapshots started
+    void writeCsvRows(double seconds);
+    void writeJson(double seconds);
+
+    std::map<std::string, std::unique_ptr<Counter>> m_counters; // Sorted, so the snapshots list them in a stable order
+    std::map<std::string, std::unique_ptr<Gauge>> m_gauges;
+    std::map<std::string, std::unique_ptr<Histogram>> m_histograms;
+    std::mutex m_mutex; // Guards the maps, not the metrics themselves
+
+    std::thread m_snapshotThread;
+    std::mutex m_snapshotMutex; // Guards the files and the stop flag
+    std::condition_variable m_snapshotWake;
+    bool m_isStopping = false;
+    double m_snapshotInterval = 5.0;
+    std::ofstream m_csvFile;
+    std::filesystem::path m_jsonPath;
+    Uint64 m_snapshotStart = 0; // SDL_GetPerformanceCounter() when the snapshots started
+};
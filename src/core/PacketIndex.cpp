@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include "PacketIndex.h"
+
+PacketIndex::~PacketIndex() {
+    if (m_codecParameters) avcodec_parameters_free(&m_codecParameters);
+}
+
+std::shared_ptr<const PacketIndex> PacketIndex::get(const std::string& filepath) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const PacketIndex>> indices; // Keyed by filepath
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = indices.find(filepath);
+    if (it != indices.end()) return it->second;
+
+    std::shared_ptr<PacketIndex> index(new PacketIndex());
+    if (!index->build(filepath)) index = nullptr;
+    indices[filepath] = index; // Files that can't be read are not read again either
+    return index;
+}
+
+bool PacketIndex::build(const std::string& filepath) {
+    AVFormatContext* formatContext = nullptr;
+    if (avformat_open_input(&formatContext, filepath.c_str(), nullptr, nullptr) < 0) {
+        std::cerr << "Could not open: " << filepath << std::endl;
+        return false;
+    }
+    int streamIndex = -1;
+    if (avformat_find_stream_info(formatContext, nullptr) >= 0) {
+        streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    }
+    if (streamIndex < 0) {
+        std::cerr << "Could not find a video stream in: " << filepath << std::endl;
+        avformat_close_input(&formatContext);
+        return false;
+    }
+
+    AVStream* stream = formatContext->streams[streamIndex];
+    m_timeBase = stream->time_base;
+    m_frameRate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+    m_codecParameters = avcodec_parameters_alloc();
+    avcodec_parameters_copy(m_codecParameters, stream->codecpar);
+
+    // Collect the frame of every packet in decode order, and where the keyframes are in it
+    std::vector<int64_t> frames;
+    std::vector<int64_t> timestamps;
+    std::vector<size_t> keyframePackets;
+    bool hasTimestamps = m_frameRate.num > 0;
+    AVPacket* packet = av_packet_alloc();
+    while (av_read_frame(formatContext, packet) >= 0) {
+        if (packet->stream_index == streamIndex) {
+            if (packet->pts == AV_NOPTS_VALUE) hasTimestamps = false;
+            else {
+                frames.push_back(av_rescale_q_rnd(packet->pts, m_timeBase, av_inv_q(m_frameRate), AV_ROUND_NEAR_INF));
+                timestamps.push_back(packet->pts);
+            }
+            if (packet->flags & AV_PKT_FLAG_KEY) keyframePackets.push_back(frames.size() - 1);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&formatContext);
+    if (!hasTimestamps || frames.empty()) return false;
+
+    // A keyframe is clean if no packet up to the next keyframe is shown before it. Keyframes are in presentation order in decode order.
+    for (size_t i = 0; i < keyframePackets.size(); i++) {
+        size_t first = keyframePackets[i];
+        size_t end = i + 1 < keyframePackets.size() ? keyframePackets[i + 1] : frames.size();
+        bool isClean = frames[first] >= 0;
+        for (size_t p = first + 1; p < end && isClean; p++) {
+            if (frames[p] < frames[first]) isClean = false;
+        }
+        if (isClean && (m_keyframes.empty() || frames[first] > m_keyframes.back())) {
+            m_keyframes.push_back(static_cast<Uint32>(frames[first]));
+            m_keyframeTimestamps.push_back(timestamps[first]);
+        }
+    }
+
+    // Constant frame rate: in presentation order, every frame is exactly one after the one before it
+    std::sort(frames.begin(), frames.end());
+    m_isConstantFrameRate = true;
+    for (size_t i = 1; i < frames.size(); i++) {
+        if (frames[i] != frames[i - 1] + 1) {
+            m_isConstantFrameRate = false;
+            break;
+        }
+    }
+    m_frameCount = static_cast<Uint32>(std::max<int64_t>(0, frames.back() + 1));
+    return true;
+}
+
+Uint32 PacketIndex::getKeyframeAtOrAfter(Uint32 frame) const {
+    auto it = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), frame);
+    return it != m_keyframes.end() ? *it : UINT32_MAX;
+}
+
+Uint32 PacketIndex::getKeyframeAtOrBefore(Uint32 frame) const {
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frame);
+    return it != m_keyframes.begin() ? *(it - 1) : UINT32_MAX;
+}
+
+int64_t PacketIndex::getTimestamp(Uint32 frame) const {
+    auto it = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), frame);
+    if (it != m_keyframes.end() && *it == frame) return m_keyframeTimestamps[it - m_keyframes.begin()];
+    return av_rescale_q(frame, av_inv_q(m_frameRate), m_timeBase);
+}
+
+bool PacketIndex::isConstantFrameRate() const { return m_isConstantFrameRate; }
+
+Uint32 PacketIndex::getFrameCount() const { return m_frameCount; }
+
+AVRational PacketIndex::getFrameRate() const { return m_frameRate; }
+
+AVRational PacketIndex::getTimeBase() const { return m_timeBase; }
+
+const AVCodecParameters* PacketIndex::getCodecParameters() const { return m_codecParameters; }
@@ -0,0 +1,56 @@
+#pragma once
+#include <SDL.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+/**
+ * @class PacketIndex
+ * @brief Where the keyframes of a video file are, found by reading its packets without decoding them.
+ *        Frames are counted at the stream's own frame rate, frame n is the frame at n / frameRate seconds (like VideoDecoder).
+ *        Only keyframes that start a closed GOP are listed: no frame decoded after the keyframe is shown before it,
+ *        so the file can be cut there and the packets on either side stream copied on their own.
+ */
+class PacketIndex {
+public:
+    ~PacketIndex();
+
+    // Get the index of a file's first video stream, built the first time it is asked for. Returns nullptr if the file can't be read.
+    static std::shared_ptr<const PacketIndex> get(const std::string& filepath);
+
+    // Get the first clean keyframe at or after frame, UINT32_MAX if there is none
+    Uint32 getKeyframeAtOrAfter(Uint32 frame) const;
+
+    // Get the last clean keyframe at or before frame, UINT32_MAX if there is none
+    Uint32 getKeyframeAtOrBefore(Uint32 frame) const;
+
+    // Get the timestamp (in the stream's time base) of a frame, exactly as stored in the file for keyframes
+    int64_t getTimestamp(Uint32 frame) const;
+
+    // Whether every frame is 1 / frameRate after the one before it, frames can only be matched to the timeline's frames if so
+    bool isConstantFrameRate() const;
+
+    Uint32 getFrameCount() const;
+    AVRational getFrameRate() const;
+    AVRational getTimeBase() const;
+    const AVCodecParameters* getCodecParameters() const;
+
+private:
+    PacketIndex() {}
+
+    // Read all packets of the file, returns true if successful
+    bool build(const std::string& filepath);
+
+private:
+    std::vector<Uint32> m_keyframes; // Clean keyframes, ascending
+    std::vector<int64_t> m_keyframeTimestamps; // Timestamp of every keyframe in m_keyframes
+    Uint32 m_frameCount = 0;
+    bool m_isConstantFrameRate = false;
+    AVRational m_frameRate = { 0, 1 };
+    AVRational m_timeBase = { 0, 1 };
+    AVCodecParameters* m_codecParameters = nullptr;
+};
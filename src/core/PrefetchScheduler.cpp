@@ -0,0 +1,113 @@
+#include <iostream>
+#include "PrefetchScheduler.h"
+#include "AudioDecoder.h"
+
+PrefetchScheduler::PrefetchScheduler(unsigned int threadCount) : m_threadPool(threadCount) { }
+
+PrefetchScheduler::~PrefetchScheduler() { }
+
+void PrefetchScheduler::update(const TimelineSnapshot& snapshot, Uint32 currentTime, bool isPlaying) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!isPlaying) {
+        // Nothing is upcoming while paused, let the leased decoders go back to the pool
+        std::erase_if(m_videoJobs, [](const auto& entry) { return entry.second->done.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        std::erase_if(m_audioJobs, [](const auto& entry) { return entry.second->done.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        return;
+    }
+
+    int fps = snapshot.fps;
+    Uint32 lookAheadEnd = currentTime + static_cast<Uint32>(m_lookAheadSeconds * fps);
+    auto isUpcoming = [currentTime, lookAheadEnd](Uint32 startFrame) { return startFrame > currentTime && startFrame <= lookAheadEnd; };
+
+    // Prepared segments are kept a little after they start, the playhead can move more than one frame per render
+    Uint32 keepAfterStart = static_cast<Uint32>(m_keepAfterStartSeconds * fps);
+    auto isKept = [currentTime, lookAheadEnd, keepAfterStart](Uint32 startFrame) { return startFrame + keepAfterStart >= currentTime && startFrame <= lookAheadEnd; };
+
+    // Drop preparations of segments that moved, were deleted, or that the playhead jumped past
+    std::erase_if(m_videoJobs, [&](const auto& entry) {
+        const VideoSegment* segment = snapshot.findVideoSegment(entry.first);
+        return !segment || snapshot.getVideoSegmentStart(*segment) != entry.second->startFrame || !isKept(entry.second->startFrame);
+        });
+    std::erase_if(m_audioJobs, [&](const auto& entry) {
+        const AudioSegment* segment = snapshot.findAudioSegment(entry.first);
+        return !segment || segment->timelinePosition != entry.second->startFrame || !isKept(entry.second->startFrame);
+        });
+
+    // Video: lease a decoder, position it and decode the first frame
+    for (const VideoSegment& segment : snapshot.videoSegments) {
+        if (static_cast<int>(m_videoJobs.size() + m_audioJobs.size()) >= m_maxJobs) break;
+        Uint32 startFrame = snapshot.getVideoSegmentStart(segment);
+        if (!isUpcoming(startFrame) || m_videoJobs.count(segment.segmentID)) continue;
+        if (!segment.videoData || !segment.videoData->formatContext) continue;
+
+        auto job = std::make_shared<VideoJob>();
+        job->startFrame = startFrame;
+        std::string filepath = segment.videoData->formatContext->url;
+        Uint32 segmentID = segment.segmentID;
+        Uint32 sourceFrame = segment.getSourceFrame(startFrame);
+
+        // The decoder reads through a reader of its own, positioning it must not move the reader the playing audio uses
+        job->done = m_threadPool.submit([job, filepath, segmentID, sourceFrame, fps]() {
+            job->lease = DecoderPool::shared().acquire(filepath, segmentID, sourceFrame);
+            if (job->lease && !job->lease->getVideoFrame(sourceFrame, fps, true)) {
+                std::cerr << "Failed to prefetch the first frame of video segment " << segmentID << std::endl;
+            }
+            }).share();
+        m_videoJobs[segment.segmentID] = job;
+    }
+
+    // Audio: decode the start of the segment with a decoder of its own, playback keeps using the asset's
+    for (const AudioSegment& segment : snapshot.audioSegments) {
+        if (static_cast<int>(m_videoJobs.size() + m_audioJobs.size()) >= m_maxJobs) break;
+        if (!isUpcoming(segment.timelinePosition) || m_audioJobs.count(segment.segmentID)) continue;
+        if (!segment.audioData || !segment.audioData->formatContext) continue;
+
+        auto job = std::make_shared<AudioJob>();
+        job->startFrame = segment.timelinePosition;
+        std::string filepath = segment.audioData->formatContext->url;
+        double startTime = static_cast<double>(segment.sourceStartTime) / fps;
+        double endTime = std::min(startTime + m_audioPrerollSeconds, static_cast<double>(segment.sourceStartTime + segment.timelineDuration) / fps);
+
+        job->done = m_threadPool.submit([job, filepath, startTime, endTime]() {
+            AudioDecoder decoder;
+            if (!decoder.open(filepath.c_str()) || !decoder.seek(startTime)) return;
+            if (decoder.decode(endTime, SIZE_MAX, job->preroll.samples) < 0) return;
+            job->preroll.startTime = startTime;
+            job->preroll.endTime = decoder.getPosition();
+            job->isReady = true;
+            }).share();
+        m_audioJobs[segment.segmentID] = job;
+    }
+}
+
+DecoderLease PrefetchScheduler::takeVideoDecoder(Uint32 segmentID) {
+    std::shared_ptr<VideoJob> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_videoJobs.find(segmentID);
+        if (it == m_videoJobs.end()) return DecoderLease();
+        job = it->second;
+        m_videoJobs.erase(it);
+    }
+    job->done.wait();
+    return std::move(job->lease);
+}
+
+bool PrefetchScheduler::takeAudioPreroll(Uint32 segmentID, AudioPreroll& preroll) {
+    std::shared_ptr<AudioJob> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_audioJobs.find(segmentID);
+        if (it == m_audioJobs.end()) return false;
+        job = it->second;
+        m_audioJobs.erase(it);
+    }
+    job->done.wait();
+    if (!job->isReady) return false;
+    preroll = std::move(job->preroll);
+    return true;
+}
+
+void PrefetchScheduler::setLookAhead(double seconds) {
+    m_lookAheadSeconds = seconds;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <SDL.h>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Timeline.h"
+#include "ThreadPool.h"
+#include "DecoderPool.h"
+
+// Start of an audio segment, decoded ahead of time
+struct AudioPreroll {
+    std::vector<uint8_t> samples; // Interleaved signed 16-bit samples
+    double startTime = 0.0; // Source time in seconds of the first sample
+    double endTime = 0.0;   // Source time in seconds after the last sample
+};
+
+/**
+ * @class PrefetchScheduler
+ * @brief Watches the timeline ahead of the playhead and prepares segments before they start, so cuts play without a stall.
+ *        Video segments get a decoder leased and positioned on their first frame, with that frame already decoded.
+ *        Audio segments get their first part decoded. Preparation runs on threads of its own, so whoever waits for it
+ *        (possibly a thread of the shared pool) never waits for work queued behind itself.
+ */
+class PrefetchScheduler {
+public:
+    PrefetchScheduler(unsigned int threadCount = 2);
+    ~PrefetchScheduler();
+
+    /**
+     * @brief Start preparing the segments that start within the look-ahead, and drop preparations that are no longer upcoming.
+     *        Call once per rendered frame.
+     * @param snapshot The timeline state being played.
+     * @param currentTime The playhead position.
+     * @param isPlaying Nothing is prepared while paused.
+     */
+    void update(const TimelineSnapshot& snapshot, Uint32 currentTime, bool isPlaying);
+
+    /**
+     * @brief Take the prepared decoder of a video segment. Waits for the preparation if it is still running. Safe to call from any thread.
+     * @return The decoder, positioned at the segment's first frame. Empty if the segment was not prepared.
+     */
+    DecoderLease takeVideoDecoder(Uint32 segmentID);
+
+    /**
+     * @brief Take the prepared start of an audio segment. Waits for the preparation if it is still running. Safe to call from any thread.
+     * @return True if the segment was prepared, otherwise false.
+     */
+    bool takeAudioPreroll(Uint32 segmentID, AudioPreroll& preroll);
+
+    // Set how far ahead of the playhead segments are prepared, in seconds
+    void setLookAhead(double seconds);
+
+private:
+    struct VideoJob {
+        Uint32 startFrame = 0; // Timeline frame the segment starts at, a moved segment is prepared again
+        DecoderLease lease;
+        std::shared_future<void> done;
+    };
+    struct AudioJob {
+        Uint32 startFrame = 0;
+        AudioPreroll preroll;
+        bool isReady = false;
+        std::shared_future<void> done;
+    };
+
+private:
+    std::unordered_map<Uint32, std::shared_ptr<VideoJob>> m_videoJobs; // Keyed by segmentID
+    std::unordered_map<Uint32, std::shared_ptr<AudioJob>> m_audioJobs; // Keyed by segmentID
+    std::mutex m_mutex; // Guards the job maps
+    double m_lookAheadSeconds = 1.0;
+    double m_audioPrerollSeconds = 0.5; // How much of an audio segment's start to decode
+    double m_keepAfterStartSeconds = 0.5; // How long a prepared segment waits to be taken after it started
+    int m_maxJobs = 4; // Segments prepared at the same time
+    ThreadPool m_threadPool; // Declared last, so running jobs finish before the job maps are destroyed
+};
@@ -0,0 +1,182 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "ProjectFile.h"
+
+static const char* projectHeader = "RythmGameVideoEditorProject";
+static const int projectVersion = 1;
+
+// Get the index of a file in the list of assets, adds it if it is not in the list yet
+static int getAssetIndex(std::vector<std::string>& assetPaths, const char* url) {
+    for (size_t i = 0; i < assetPaths.size(); i++) {
+        if (assetPaths[i] == url) return static_cast<int>(i);
+    }
+    assetPaths.push_back(url);
+    return static_cast<int>(assetPaths.size() - 1);
+}
+
+bool ProjectFile::save(Timeline& timeline, const std::filesystem::path& filepath) {
+    const std::vector<VideoSegment>* videoSegments = timeline.getAllVideoSegments();
+    const std::vector<AudioSegment>* audioSegments = timeline.getAllAudioSegments();
+
+    // Segments refer to their file by index, so every file is listed once
+    std::vector<std::string> assetPaths;
+    std::ostringstream segmentLines;
+    for (const VideoSegment& segment : *videoSegments) {
+        if (!segment.videoData || !segment.videoData->formatContext) continue;
+        const SegmentTransform& transform = segment.transform;
+        const SegmentTransition& transition = segment.transitionIn;
+        segmentLines << "video " << getAssetIndex(assetPaths, segment.videoData->formatContext->url) << " "
+            << timeline.getVideoTrackPos(segment.trackID) << " "
+            << segment.timelinePosition << " " << segment.timelineDuration << " "
+            << segment.sourceStartTime << " " << segment.sourceDuration << " "
+            << transform.positionX << " " << transform.positionY << " " << transform.scale << " "
+            << transform.cropLeft << " " << transform.cropTop << " " << transform.cropRight << " " << transform.cropBottom << " "
+            << transform.opacity << " "
+            << static_cast<int>(transition.type) << " " << transition.duration << " "
+            << static_cast<int>(transition.color.r) << " " << static_cast<int>(transition.color.g) << " " << static_cast<int>(transition.color.b) << "\n";
+    }
+    for (const AudioSegment& segment : *audioSegments) {
+        if (!segment.audioData || !segment.audioData->formatContext) continue;
+        segmentLines << "audio " << getAssetIndex(assetPaths, segment.audioData->formatContext->url) << " "
+            << timeline.getAudioTrackPos(segment.trackID) << " "
+            << segment.timelinePosition << " " << segment.timelineDuration << " "
+            << segment.sourceStartTime << " " << segment.sourceDuration << "\n";
+    }
+
+    std::ofstream file(filepath);
+    if (!file) {
+        std::cerr << "Could not open " << filepath.string() << " for writing" << std::endl;
+        return false;
+    }
+    file << projectHeader << " " << projectVersion << "\n";
+    file << "fps " << timeline.getFPS() << "\n";
+    file << "output " << timeline.getOutputWidth() << " " << timeline.getOutputHeight() << "\n";
+    file << "tracks " << timeline.getVideoTrackCount() << " " << timeline.getAudioTrackCount() << "\n";
+    for (const std::string& path : assetPaths) {
+        file << "asset " << std::quoted(path) << "\n";
+    }
+    file << segmentLines.str();
+
+    if (!file) {
+        std::cerr << "Could not write " << filepath.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ProjectFile::load(const std::filesystem::path& filepath, Timeline& timeline, AssetsList& assets) {
+    std::ifstream file(filepath);
+    if (!file) {
+        std::cerr << "Could not open project " << filepath.string() << std::endl;
+        return false;
+    }
+
+    std::string header;
+    int version = 0;
+    if (!(file >> header >> version) || header != projectHeader || version > projectVersion) {
+        std::cerr << filepath.string() << " is not a supported project file" << std::endl;
+        return false;
+    }
+
+    // Media of the files by index in the project file, both nullptr if the file could not be loaded
+    struct LoadedAsset {
+        VideoData* videoData = nullptr;
+        AudioData* audioData = nullptr;
+    };
+    std::vector<LoadedAsset> loadedAssets;
+    std::string line;
+    int lineNumber = 1;
+    std::getline(file, line); // Rest of the header line
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword)) continue; // Empty line
+
+        bool isValid = true;
+        if (keyword == "fps") {
+            int fps = 0;
+            isValid = static_cast<bool>(fields >> fps) && fps > 0;
+            if (isValid) timeline.setFPS(fps);
+        }
+        else if (keyword == "output") {
+            int width = 0, height = 0;
+            isValid = static_cast<bool>(fields >> width >> height) && width > 0 && height > 0;
+            if (isValid) timeline.setOutputSize(width, height);
+        }
+        else if (keyword == "tracks") {
+            int videoTrackCount = 0, audioTrackCount = 0;
+            isValid = static_cast<bool>(fields >> videoTrackCount >> audioTrackCount);
+            if (isValid) timeline.ensureTrackCount(videoTrackCount, audioTrackCount);
+        }
+        else if (keyword == "asset") {
+            std::string path;
+            isValid = static_cast<bool>(fields >> std::quoted(path));
+            if (isValid) {
+                // Segments of a file that can't be loaded are skipped, the rest of the project still loads
+                if (assets.loadFile(path.c_str())) {
+                    const Asset& asset = assets.getAllAssets()->back();
+                    loadedAssets.push_back({ asset.videoData, asset.audioData });
+                }
+                else {
+                    std::cerr << "Could not load " << path << ", its segments are left out" << std::endl;
+                    loadedAssets.push_back({ nullptr, nullptr });
+                }
+            }
+        }
+        else if (keyword == "video") {
+            int assetIndex = 0, trackPos = 0;
+            VideoSegment segment = {};
+            SegmentTransform& transform = segment.transform;
+            int transitionType = 0, r = 0, g = 0, b = 0;
+            isValid = static_cast<bool>(fields >> assetIndex >> trackPos
+                >> segment.timelinePosition >> segment.timelineDuration >> segment.sourceStartTime >> segment.sourceDuration
+                >> transform.positionX >> transform.positionY >> transform.scale
+                >> transform.cropLeft >> transform.cropTop >> transform.cropRight >> transform.cropBottom >> transform.opacity
+                >> transitionType >> segment.transitionIn.duration >> r >> g >> b)
+                && assetIndex >= 0 && assetIndex < static_cast<int>(loadedAssets.size());
+            if (isValid && loadedAssets[assetIndex].videoData) {
+                VideoData* videoData = loadedAssets[assetIndex].videoData;
+                segment.videoData = videoData;
+                segment.duration = videoData->getVideoDurationInFrames();
+                segment.fps = videoData->getFPS();
+                segment.transitionIn.type = static_cast<TransitionType>(transitionType);
+                segment.transitionIn.color = { static_cast<Uint8>(r), static_cast<Uint8>(g), static_cast<Uint8>(b), 255 };
+                if (!timeline.addVideoSegment(segment, trackPos)) {
+                    std::cerr << filepath.string() << ":" << lineNumber << ": video segment overlaps another segment or has no track" << std::endl;
+                }
+            }
+        }
+        else if (keyword == "audio") {
+            int assetIndex = 0, trackPos = 0;
+            AudioSegment segment = {};
+            isValid = static_cast<bool>(fields >> assetIndex >> trackPos
+                >> segment.timelinePosition >> segment.timelineDuration >> segment.sourceStartTime >> segment.sourceDuration)
+                && assetIndex >= 0 && assetIndex < static_cast<int>(loadedAssets.size());
+            if (isValid && loadedAssets[assetIndex].audioData) {
+                AudioData* audioData = loadedAssets[assetIndex].audioData;
+                segment.audioData = audioData;
+                segment.duration = audioData->getAudioDurationInFrames();
+                if (!timeline.addAudioSegment(segment, trackPos)) {
+                    std::cerr << filepath.string() << ":" << lineNumber << ": audio segment overlaps another segment or has no track" << std::endl;
+                }
+            }
+        }
+        else {
+            std::cerr << filepath.string() << ":" << lineNumber << ": unknown entry '" << keyword << "'" << std::endl;
+        }
+
+        if (!isValid) {
+            std::cerr << filepath.string() << ":" << lineNumber << ": invalid " << keyword << " entry" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::filesystem::path ProjectFile::getDefaultPath() {
+    return std::filesystem::current_path() / "project.rgvproject";
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <SDL.h>
+#include <filesystem>
+#include <string>
+#include "Timeline.h"
+#include "AssetsList.h"
+
+/**
+ * @class ProjectFile
+ * @brief Reads and writes a timeline as a small text file: the fps, output size, track counts, the media files used and every segment.
+ *        Media files are referenced by path, so a project file can be rendered on another machine as long as the paths exist there.
+ *
+ *        RythmGameVideoEditorProject 1
+ *        fps 60
+ *        output 1920 1080
+ *        tracks 2 2
+ *        asset "C:/videos/play.mp4"
+ *        video <asset> <trackPos> <timelinePosition> <timelineDuration> <sourceStartTime> <sourceDuration> <transform (8 values)> <transition type duration r g b>
+ *        audio <asset> <trackPos> <timelinePosition> <timelineDuration> <sourceStartTime> <sourceDuration>
+ */
+class ProjectFile {
+public:
+    /**
+     * @brief Write the timeline to a project file.
+     * @param timeline The timeline to save.
+     * @param filepath Where to write the project, overwritten if it exists.
+     * @return True if successful, otherwise false.
+     */
+    static bool save(Timeline& timeline, const std::filesystem::path& filepath);
+
+    /**
+     * @brief Read a project file into an empty timeline. The media files are loaded into assets.
+     * @param filepath The project to read.
+     * @param timeline The timeline to add the tracks and segments to.
+     * @param assets The list to load the media files of the project into.
+     * @return True if successful, otherwise false.
+     */
+    static bool load(const std::filesystem::path& filepath, Timeline& timeline, AssetsList& assets);
+
+    // Get the path the editor saves its project to
+    static std::filesystem::path getDefaultPath();
+};
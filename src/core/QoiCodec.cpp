@@ -0,0 +1,197 @@
+#include <iostream>
+#include "QoiCodec.h"
+
+// Chunk tags, see the QOI specification
+static const uint8_t QOI_OP_INDEX = 0x00;
+static const uint8_t QOI_OP_DIFF = 0x40;
+static const uint8_t QOI_OP_LUMA = 0x80;
+static const uint8_t QOI_OP_RUN = 0xc0;
+static const uint8_t QOI_OP_RGB = 0xfe;
+static const uint8_t QOI_OP_RGBA = 0xff;
+static const uint8_t QOI_MASK = 0xc0;
+
+static const int QOI_HEADER_SIZE = 14;
+static const uint8_t QOI_END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+static const int QOI_MAX_SIZE = 32768; // Refuse images larger than this in either direction
+
+struct QoiPixel {
+    uint8_t r = 0, g = 0, b = 0, a = 0;
+
+    bool operator==(const QoiPixel& other) const {
+        return r == other.r && g == other.g && b == other.b && a == other.a;
+    }
+
+    int hash() const {
+        return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+    }
+};
+
+static void writeUint32(std::vector<uint8_t>& output, uint32_t value) {
+    output.push_back(static_cast<uint8_t>(value >> 24));
+    output.push_back(static_cast<uint8_t>(value >> 16));
+    output.push_back(static_cast<uint8_t>(value >> 8));
+    output.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t readUint32(const uint8_t* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+bool encodeQOI(const uint8_t* pixels, int width, int height, int linesize, std::vector<uint8_t>& output) {
+    if (!pixels || width <= 0 || height <= 0 || width > QOI_MAX_SIZE || height > QOI_MAX_SIZE) {
+        std::cerr << "Invalid image for QOI encoding" << std::endl;
+        return false;
+    }
+
+    // Worst case every pixel is a QOI_OP_RGB chunk, reserve that so the loop never reallocates
+    output.clear();
+    output.reserve(QOI_HEADER_SIZE + static_cast<size_t>(width) * height * 4 + sizeof(QOI_END_MARKER));
+
+    output.insert(output.end(), { 'q', 'o', 'i', 'f' });
+    writeUint32(output, width);
+    writeUint32(output, height);
+    output.push_back(3); // Channels: RGB
+    output.push_back(0); // Colorspace: sRGB with linear alpha
+
+    QoiPixel index[64] = {};
+    QoiPixel previous;
+    previous.a = 255;
+    QoiPixel pixel = previous;
+    int run = 0;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pixels + static_cast<size_t>(y) * linesize;
+        bool isLastRow = y == height - 1;
+        for (int x = 0; x < width; x++) {
+            pixel.r = row[x * 3];
+            pixel.g = row[x * 3 + 1];
+            pixel.b = row[x * 3 + 2];
+
+            if (pixel == previous) {
+                run++;
+                if (run == 62 || (isLastRow && x == width - 1)) {
+                    output.push_back(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                output.push_back(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            int hash = pixel.hash();
+            if (index[hash] == pixel) {
+                output.push_back(QOI_OP_INDEX | hash);
+            }
+            else {
+                index[hash] = pixel;
+
+                int8_t diffR = static_cast<int8_t>(pixel.r - previous.r);
+                int8_t diffG = static_cast<int8_t>(pixel.g - previous.g);
+                int8_t diffB = static_cast<int8_t>(pixel.b - previous.b);
+                int8_t diffRG = static_cast<int8_t>(diffR - diffG);
+                int8_t diffBG = static_cast<int8_t>(diffB - diffG);
+
+                if (diffR > -3 && diffR < 2 && diffG > -3 && diffG < 2 && diffB > -3 && diffB < 2) {
+                    output.push_back(QOI_OP_DIFF | ((diffR + 2) << 4) | ((diffG + 2) << 2) | (diffB + 2));
+                }
+                else if (diffRG > -9 && diffRG < 8 && diffG > -33 && diffG < 32 && diffBG > -9 && diffBG < 8) {
+                    output.push_back(QOI_OP_LUMA | (diffG + 32));
+                    output.push_back(((diffRG + 8) << 4) | (diffBG + 8));
+                }
+                else {
+                    output.push_back(QOI_OP_RGB);
+                    output.push_back(pixel.r);
+                    output.push_back(pixel.g);
+                    output.push_back(pixel.b);
+                }
+            }
+            previous = pixel;
+        }
+    }
+
+    output.insert(output.end(), std::begin(QOI_END_MARKER), std::end(QOI_END_MARKER));
+    return true;
+}
+
+bool decodeQOI(const uint8_t* data, size_t size, int& width, int& height, std::vector<uint8_t>& pixels) {
+    if (!data || size < QOI_HEADER_SIZE + sizeof(QOI_END_MARKER) || data[0] != 'q' || data[1] != 'o' || data[2] != 'i' || data[3] != 'f') {
+        std::cerr << "Not a QOI file" << std::endl;
+        return false;
+    }
+
+    uint32_t headerWidth = readUint32(data + 4);
+    uint32_t headerHeight = readUint32(data + 8);
+    int channels = data[12];
+    if (headerWidth == 0 || headerHeight == 0 || headerWidth > QOI_MAX_SIZE || headerHeight > QOI_MAX_SIZE || (channels != 3 && channels != 4)) {
+        std::cerr << "Invalid QOI header" << std::endl;
+        return false;
+    }
+    width = static_cast<int>(headerWidth);
+    height = static_cast<int>(headerHeight);
+    pixels.resize(static_cast<size_t>(width) * height * 3);
+
+    QoiPixel index[64] = {};
+    QoiPixel pixel;
+    pixel.a = 255;
+    int run = 0;
+
+    size_t position = QOI_HEADER_SIZE;
+    size_t chunksEnd = size - sizeof(QOI_END_MARKER);
+    size_t pixelCount = static_cast<size_t>(width) * height;
+
+    for (size_t i = 0; i < pixelCount; i++) {
+        if (run > 0) {
+            run--;
+        }
+        else if (position < chunksEnd) {
+            uint8_t tag = data[position++];
+            if (tag == QOI_OP_RGB) {
+                if (position + 3 > chunksEnd) return false;
+                pixel.r = data[position];
+                pixel.g = data[position + 1];
+                pixel.b = data[position + 2];
+                position += 3;
+            }
+            else if (tag == QOI_OP_RGBA) {
+                if (position + 4 > chunksEnd) return false;
+                pixel.r = data[position];
+                pixel.g = data[position + 1];
+                pixel.b = data[position + 2];
+                pixel.a = data[position + 3];
+                position += 4;
+            }
+            else if ((tag & QOI_MASK) == QOI_OP_INDEX) {
+                pixel = index[tag];
+            }
+            else if ((tag & QOI_MASK) == QOI_OP_DIFF) {
+                pixel.r += ((tag >> 4) & 0x03) - 2;
+                pixel.g += ((tag >> 2) & 0x03) - 2;
+                pixel.b += (tag & 0x03) - 2;
+            }
+            else if ((tag & QOI_MASK) == QOI_OP_LUMA) {
+                if (position + 1 > chunksEnd) return false;
+                uint8_t next = data[position++];
+                int diffG = (tag & 0x3f) - 32;
+                pixel.r += diffG - 8 + ((next >> 4) & 0x0f);
+                pixel.g += diffG;
+                pixel.b += diffG - 8 + (next & 0x0f);
+            }
+            else {
+                run = tag & 0x3f; // QOI_OP_RUN, this pixel plus run more
+            }
+            index[pixel.hash()] = pixel;
+        }
+        else {
+            std::cerr << "QOI file ends early" << std::endl;
+            return false;
+        }
+
+        pixels[i * 3] = pixel.r;
+        pixels[i * 3 + 1] = pixel.g;
+        pixels[i * 3 + 2] = pixel.b;
+    }
+    return true;
+}
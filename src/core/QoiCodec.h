@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Encode an RGB24 image in the QOI format (https://qoiformat.org). Lossless and a lot faster than PNG,
+ *        which makes it suitable for caching rendered frames on disk.
+ * @param pixels The first row of the image.
+ * @param width The image width in pixels.
+ * @param height The image height in pixels.
+ * @param linesize Bytes per row of pixels.
+ * @param output Receives the encoded file, replacing its contents.
+ * @return True if successful, otherwise false.
+ */
+bool encodeQOI(const uint8_t* pixels, int width, int height, int linesize, std::vector<uint8_t>& output);
+
+/**
+ * @brief Decode a QOI file into a tightly packed RGB24 image (the alpha channel of RGBA files is dropped).
+ * @param data The encoded file.
+ * @param size The size of the encoded file in bytes.
+ * @param width Receives the image width in pixels.
+ * @param height Receives the image height in pixels.
+ * @param pixels Receives the image, width * 3 bytes per row.
+ * @return True if successful, otherwise false.
+ */
+bool decodeQOI(const uint8_t* data, size_t size, int& width, int& height, std::vector<uint8_t>& pixels);
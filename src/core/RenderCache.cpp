@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "RenderCache.h"
+#include "QoiCodec.h"
+
+// Bump when the compositor's output changes, so frames stored by older versions are never used
+static const Uint32 RENDER_CACHE_FORMAT_VERSION = 1;
+
+static const Uint64 FNV_OFFSET_BASIS = 14695981039346656037ull;
+static const Uint64 FNV_PRIME = 1099511628211ull;
+
+// FNV-1a over raw bytes
+static void hashBytes(Uint64& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+}
+
+template <typename T>
+static void hashValue(Uint64& hash, const T& value) {
+    hashBytes(hash, &value, sizeof(T));
+}
+
+RenderCache::RenderCache(const std::filesystem::path& directory, Uint64 diskBudget)
+    : m_directory(directory), m_diskBudget(diskBudget), m_writer(1) {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+        std::cerr << "Could not create the render cache directory: " << m_directory.string() << std::endl;
+        return;
+    }
+
+    // Pick up the frames of earlier sessions, the oldest written counts as the least recently used
+    std::vector<std::pair<std::filesystem::file_time_type, std::pair<Uint64, Uint64>>> found;
+    for (const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(m_directory, error)) {
+        if (file.path().extension() != ".qoi") continue;
+        Uint64 hash = std::strtoull(file.path().stem().string().c_str(), nullptr, 16);
+        if (hash == 0) continue;
+        found.push_back({ file.last_write_time(error), { hash, file.file_size(error) } });
+    }
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [writeTime, frame] : found) {
+        m_entries[frame.first] = { frame.second, ++m_useCount };
+        m_diskUsage += frame.second;
+    }
+    evictFrames();
+}
+
+RenderCache::~RenderCache() { }
+
+Uint64 RenderCache::computeFrameHash(const TimelineSnapshot& snapshot, Uint32 frame) {
+    return computeFrameHash(snapshot, frame, snapshot.getVideoLayers(frame));
+}
+
+Uint64 RenderCache::computeFrameHash(const TimelineSnapshot& snapshot, Uint32 frame, const std::vector<VideoLayerRef>& layers) {
+    if (layers.empty()) return 0;
+
+    Uint64 hash = FNV_OFFSET_BASIS;
+    hashValue(hash, RENDER_CACHE_FORMAT_VERSION);
+    hashValue(hash, snapshot.outputWidth);
+    hashValue(hash, snapshot.outputHeight);
+    hashValue(hash, snapshot.fps);
+
+    auto hashSegment = [this, &hash, frame](const VideoSegment& segment) {
+        Uint64 fileHash = segment.videoData && segment.videoData->formatContext ? getFileHash(segment.videoData->formatContext->url) : 0;
+        hashValue(hash, fileHash);
+        hashValue(hash, segment.getSourceFrame(frame));
+        hashValue(hash, segment.transform);
+    };
+
+    // Layers are ordered from the lowest track up, which is also the drawing order
+    for (const VideoLayerRef& layer : layers) {
+        hashSegment(*layer.segment);
+        if (layer.incoming) {
+            hashSegment(*layer.incoming);
+            hashValue(hash, layer.incoming->transitionIn.type);
+            hashValue(hash, layer.incoming->transitionIn.color);
+            hashValue(hash, layer.progress);
+        }
+        hashValue(hash, static_cast<Uint8>(layer.incoming != nullptr)); // Separates the layers
+    }
+    return hash != 0 ? hash : 1;
+}
+
+bool RenderCache::isWorthCaching(const TimelineSnapshot& snapshot, Uint32 frame) {
+    return isWorthCaching(snapshot.getVideoLayers(frame));
+}
+
+bool RenderCache::isWorthCaching(const std::vector<VideoLayerRef>& layers) {
+    return layers.size() > 1 || (layers.size() == 1 && layers[0].incoming);
+}
+
+bool RenderCache::contains(Uint64 hash) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.count(hash) > 0;
+}
+
+bool RenderCache::load(Uint64 hash, CompositeFrame& output) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(hash);
+        if (it == m_entries.end()) return false;
+        it->second.lastUsed = ++m_useCount;
+    }
+
+    // Read and decode outside the lock, so writes of other frames continue
+    std::ifstream file(getFramePath(hash), std::ios::binary | std::ios::ate);
+    std::vector<uint8_t> data;
+    if (file) {
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+    }
+
+    int width = 0;
+    int height = 0;
+    if (!file || !decodeQOI(data.data(), data.size(), width, height, output.pixels)) {
+        std::cerr << "Could not read cached frame: " << getFramePath(hash).string() << std::endl;
+
+        // Forget the frame, it is rendered and stored again
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(hash);
+        if (it != m_entries.end()) {
+            m_diskUsage -= it->second.size;
+            m_entries.erase(it);
+            m_generation++;
+        }
+        return false;
+    }
+
+    output.width = width;
+    output.height = height;
+    output.linesize = width * 3;
+    return true;
+}
+
+void RenderCache::store(Uint64 hash, const CompositeFrame& frame) {
+    if (hash == 0 || frame.pixels.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.count(hash) || m_pendingStores.count(hash)) return;
+        if (static_cast<int>(m_pendingStores.size()) >= m_maxPendingStores) return;
+        m_pendingStores.insert(hash);
+    }
+
+    auto copy = std::make_shared<CompositeFrame>(frame);
+    m_writer.submit([this, hash, copy]() {
+        std::vector<uint8_t> data;
+        bool isWritten = encodeQOI(copy->pixels.data(), copy->width, copy->height, copy->linesize, data);
+
+        // Write next to the final file and rename, so a reader never sees a partly written frame
+        std::filesystem::path path = getFramePath(hash);
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+        if (isWritten) {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            isWritten = static_cast<bool>(file);
+        }
+        if (isWritten) {
+            std::error_code error;
+            std::filesystem::rename(tempPath, path, error);
+            isWritten = !error;
+        }
+        if (!isWritten) {
+            std::cerr << "Could not write cached frame: " << path.string() << std::endl;
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingStores.erase(hash);
+        if (!isWritten) return;
+        m_entries[hash] = { data.size(), ++m_useCount };
+        m_diskUsage += data.size();
+        evictFrames();
+        m_generation++;
+        });
+}
+
+void RenderCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [hash, entry] : m_entries) {
+        std::error_code error;
+        std::filesystem::remove(getFramePath(hash), error);
+    }
+    m_entries.clear();
+    m_diskUsage = 0;
+    m_generation++;
+}
+
+Uint64 RenderCache::getGeneration() const {
+    return m_generation;
+}
+
+Uint64 RenderCache::getDiskUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_diskUsage;
+}
+
+void RenderCache::setDiskBudget(Uint64 bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_diskBudget = bytes;
+    evictFrames();
+}
+
+RenderCache& RenderCache::shared() {
+    static RenderCache instance;
+    return instance;
+}
+
+std::filesystem::path RenderCache::getDefaultDirectory() {
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+    return directory / "RythmGameVideoEditor" / "RenderCache";
+}
+
+std::filesystem::path RenderCache::getFramePath(Uint64 hash) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.qoi", static_cast<unsigned long long>(hash));
+    return m_directory / name;
+}
+
+Uint64 RenderCache::getFileHash(std::string_view filepath) {
+    Uint64 now = SDL_GetTicks64();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_fileStamps.find(filepath);
+        if (it != m_fileStamps.end() && now - it->second.checkedAt < m_fileCheckInterval) return it->second.hash;
+    }
+
+    // A replaced or re-encoded file changes size or modification time
+    std::error_code error;
+    Uint64 hash = FNV_OFFSET_BASIS;
+    hashBytes(hash, filepath.data(), filepath.size());
+    Uint64 size = std::filesystem::file_size(filepath, error);
+    hashValue(hash, error ? 0 : size);
+    auto writeTime = std::filesystem::last_write_time(filepath, error).time_since_epoch().count();
+    hashValue(hash, error ? 0 : writeTime);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fileStamps[std::string(filepath)] = { hash, now };
+    return hash;
+}
+
+void RenderCache::evictFrames() {
+    if (m_diskUsage <= m_diskBudget) return;
+
+    std::vector<std::pair<Uint64, Uint64>> byAge; // lastUsed, hash
+    byAge.reserve(m_entries.size());
+    for (const auto& [hash, entry] : m_entries) {
+        byAge.push_back({ entry.lastUsed, hash });
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    for (const auto& [lastUsed, hash] : byAge) {
+        if (m_diskUsage <= m_diskBudget) break;
+        std::error_code error;
+        std::filesystem::remove(getFramePath(hash), error);
+        m_diskUsage -= m_entries[hash].size;
+        m_entries.erase(hash);
+    }
+    m_generation++;
+}
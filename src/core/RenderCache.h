@@ -0,0 +1,118 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Timeline.h"
+#include "Compositor.h"
+#include "ThreadPool.h"
+
+/**
+ * @class RenderCache
+ * @brief Composited frames of the timeline stored on local disk as QOI images, so sections with several layers or
+ *        transitions play back (and export) without compositing them again.
+ *        Frames are stored under a hash of everything that contributes to them: the segments, their source frames and
+ *        files, transforms and transitions. Editing anything gives the affected frames a new hash, so exactly those
+ *        frames stop hitting the cache and no explicit invalidation is needed.
+ */
+class RenderCache {
+public:
+    /**
+     * @param directory Where the frames are stored, created if it doesn't exist. Frames stored by earlier sessions are reused.
+     * @param diskBudget The maximum size of all stored frames in bytes, the least recently used frames are deleted beyond it.
+     */
+    RenderCache(const std::filesystem::path& directory = getDefaultDirectory(), Uint64 diskBudget = 8ull * 1024 * 1024 * 1024);
+    ~RenderCache();
+
+    /**
+     * @brief Compute the hash of everything that contributes to a frame of the timeline.
+     * @param snapshot The timeline state to render.
+     * @param frame The timeline frame.
+     * @return The hash, 0 if no segment is visible at frame.
+     */
+    Uint64 computeFrameHash(const TimelineSnapshot& snapshot, Uint32 frame);
+
+    // Same as above, with the frame's layers from TimelineSnapshot::getVideoLayers(), for callers that already have them
+    Uint64 computeFrameHash(const TimelineSnapshot& snapshot, Uint32 frame, const std::vector<VideoLayerRef>& layers);
+
+    // Whether a frame is worth storing: it shows more than one segment or a transition. A single segment decodes as fast as it reads from disk.
+    static bool isWorthCaching(const TimelineSnapshot& snapshot, Uint32 frame);
+    static bool isWorthCaching(const std::vector<VideoLayerRef>& layers);
+
+    // Whether a frame with this hash is stored
+    bool contains(Uint64 hash) const;
+
+    /**
+     * @brief Read a stored frame.
+     * @param hash The frame's hash from computeFrameHash().
+     * @param output Receives the frame.
+     * @return True if the frame was stored and could be read, otherwise false.
+     */
+    bool load(Uint64 hash, CompositeFrame& output);
+
+    // Store a frame under its hash. The frame is copied, encoding and writing happen on a background thread.
+    void store(Uint64 hash, const CompositeFrame& frame);
+
+    // Delete every stored frame
+    void clear();
+
+    // Get a counter that changes whenever frames are stored or deleted, to know when the render bar has to be updated
+    Uint64 getGeneration() const;
+
+    // Get the total size of the stored frames in bytes
+    Uint64 getDiskUsage() const;
+
+    // Set the maximum size of the stored frames in bytes, deletes the least recently used frames if over it
+    void setDiskBudget(Uint64 bytes);
+
+    // Get the cache shared by the whole application (preview and export)
+    static RenderCache& shared();
+
+    // Get the directory frames are stored in by default, in the system's temporary directory
+    static std::filesystem::path getDefaultDirectory();
+
+private:
+    struct Entry {
+        Uint64 size = 0;
+        Uint64 lastUsed = 0; // Value of m_useCount when the frame was last stored or loaded
+    };
+
+    // Identity of a source file, changes when the file is replaced or edited
+    struct FileStamp {
+        Uint64 hash = 0;
+        Uint64 checkedAt = 0; // SDL_GetTicks64() when the file was last checked
+    };
+
+    // Lets m_fileStamps be searched with a std::string_view, without copying the filepath
+    struct FilepathHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view filepath) const { return std::hash<std::string_view>()(filepath); }
+    };
+
+    std::filesystem::path getFramePath(Uint64 hash) const;
+
+    // Get the hash of a source file's path, size and modification time. Files are checked again every m_fileCheckInterval ms.
+    Uint64 getFileHash(std::string_view filepath);
+
+    // Delete the least recently used frames until the cache is within its disk budget. Expects m_mutex to be locked.
+    void evictFrames();
+
+private:
+    std::filesystem::path m_directory;
+    std::unordered_map<Uint64, Entry> m_entries; // Keyed by frame hash
+    std::unordered_map<std::string, FileStamp, FilepathHash, std::equal_to<>> m_fileStamps; // Keyed by filepath
+    std::unordered_set<Uint64> m_pendingStores; // Frames being written, keyed by frame hash
+    mutable std::mutex m_mutex; // Guards everything above
+    Uint64 m_diskBudget;
+    Uint64 m_diskUsage = 0;
+    Uint64 m_useCount = 0;
+    std::atomic<Uint64> m_generation = 0;
+    int m_maxPendingStores = 8; // Frames waiting to be written, later frames are skipped so the copies don't pile up
+    Uint64 m_fileCheckInterval = 2000; // Milliseconds
+    ThreadPool m_writer; // Declared last, so pending writes finish before the maps are destroyed
+};
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include "ThreadPool.h"
+#include "Metrics.h"
+#include "Tracer.h"
+
+// Jobs waiting for a worker, of whichever pool queued or took one last
+static Metrics::Gauge& getQueuedJobsGauge() {
+    static Metrics::Gauge& gauge = Metrics::shared().gauge("threadPool.queuedJobs");
+    return gauge;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < threadCount; i++) {
+        m_workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job) {
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> future = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push(std::move(task));
+        getQueuedJobsGauge().set(static_cast<Sint64>(m_jobs.size()));
+    }
+    m_condition.notify_one();
+    return future;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& job) {
+    if (count <= 0) return;
+    if (count == 1) {
+        job(0);
+        return;
+    }
+
+    // Shared between the caller and the helpers, helpers that start after everything is claimed simply do nothing
+    struct State {
+        std::atomic<int> nextIndex = 0;
+        std::atomic<int> doneCount = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+
+    auto runIndices = [state, count, &job]() {
+        int i;
+        while ((i = state->nextIndex.fetch_add(1)) < count) {
+            job(i);
+            if (state->doneCount.fetch_add(1) + 1 == count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    // The calling thread works as well, so only ask for count - 1 helpers
+    int helperCount = std::min(count - 1, static_cast<int>(m_workers.size()));
+    for (int i = 0; i < helperCount; i++) {
+        submit(runIndices);
+    }
+    runIndices();
+
+    // Wait for indices that are still being processed by helpers
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->doneCount.load() >= count; });
+}
+
+unsigned int ThreadPool::getThreadCount() const {
+    return static_cast<unsigned int>(m_workers.size());
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool instance;
+    return instance;
+}
+
+void ThreadPool::workerLoop() {
+    TRACE_THREAD_NAME("ThreadPool worker");
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping && m_jobs.empty()) return;
+            task = std::move(m_jobs.front());
+            m_jobs.pop();
+            getQueuedJobsGauge().set(static_cast<Sint64>(m_jobs.size()));
+        }
+        task();
+    }
+}
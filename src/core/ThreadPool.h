@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads that run queued jobs. Used to spread per-frame work (compositing tiles, decoding) over all cores.
+ */
+class ThreadPool {
+public:
+    // Create a pool with threadCount workers (0 = one per hardware thread)
+    ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    // Queue a job, the returned future becomes ready once the job has run
+    std::future<void> submit(std::function<void()> job);
+
+    /**
+     * @brief Run job(i) for every i in [0, count), spread over the workers and the calling thread.
+     *        Returns once every index has been processed. Safe to call from inside a job.
+     */
+    void parallelFor(int count, const std::function<void(int)>& job);
+
+    // Get the amount of worker threads
+    unsigned int getThreadCount() const;
+
+    // Get the pool shared by the whole application
+    static ThreadPool& shared();
+
+private:
+    void workerLoop();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::queue<std::packaged_task<void()>> m_jobs; // Jobs waiting for a free worker
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping = false;
+};
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include "Timeline.h"
+#include "DecoderPool.h"
 
 Timeline::Timeline() {
     m_videoTrackIDtoPosMap[0] = 0;
@@ -15,6 +17,8 @@ Timeline::Timeline() {
 
     m_nextVideoTrackID = 2;
     m_nextAudioTrackID = 2;
+
+    commit();
 }
 
 Timeline::~Timeline() { }
@@ -40,6 +44,16 @@ int Timeline::getFPS() {
 
 void Timeline::setFPS(int fps) {
     m_fps = fps;
+    commit();
+}
+
+int Timeline::getOutputWidth() { return m_outputWidth; }
+int Timeline::getOutputHeight() { return m_outputHeight; }
+
+void Timeline::setOutputSize(int width, int height) {
+    m_outputWidth = width;
+    m_outputHeight = height;
+    commit();
 }
 
 Uint32 Timeline::getCurrentTime() {
@@ -68,38 +82,6 @@ int Timeline::getAudioTrackPos(int trackID) { return m_audioTrackIDtoPosMap[trac
 const std::vector<VideoSegment>* Timeline::getAllVideoSegments() { return &m_videoSegments; }
 const std::vector<AudioSegment>* Timeline::getAllAudioSegments() { return &m_audioSegments; }
 
-// TODO: return only the video segment with the highest trackID at this time
-VideoSegment* Timeline::getCurrentVideoSegment() {
-    Uint32 currentTime = getCurrentTime();
-    VideoSegment* currentVideoSegment = nullptr;
-
-    // Iterate over video segments
-    for (VideoSegment& segment : m_videoSegments) {
-        // Check if active at the current time
-        if (currentTime >= segment.timelinePosition &&
-            currentTime < segment.timelinePosition + segment.timelineDuration) {
-            // Check if the found segment is higher on the track ordering
-            if (!currentVideoSegment || (m_videoTrackPosToIDMap[segment.trackID] > m_videoTrackPosToIDMap[currentVideoSegment->trackID])) {
-                currentVideoSegment = &segment; // Set this segment to be returned
-            }
-        }
-    }
-    return currentVideoSegment;
-}
-
-// TODO: merge audio if multiple tracks have a audioSegment to play at this time
-AudioSegment* Timeline::getCurrentAudioSegment() {
-    Uint32 currentTime = getCurrentTime();
-
-    for (AudioSegment& segment : m_audioSegments) {
-        if (currentTime >= segment.timelinePosition &&
-            currentTime < segment.timelinePosition + segment.timelineDuration) {
-            return &segment;  // Return the active audio segment
-        }
-    }
-    return nullptr;  // No segment found at the current time
-}
-
 VideoSegment* Timeline::getVideoSegment(int trackPos, Uint32 frame) {
     if (trackPos >= getVideoTrackCount()) return nullptr;
     int trackID = m_videoTrackPosToIDMap[trackPos];
@@ -167,10 +149,19 @@ SegmentPointer Timeline::addAssetSegments(SDL_Renderer* renderer, AssetData* dat
             .timelinePosition = frame,
             .timelineDuration = videoDurationInTimelineFrames,
             .fps = data->videoData->getFPS(),
-            .trackID = videoTrackID
+            .trackID = videoTrackID,
+            .firstFrame = nullptr,
+            .lastFrame = nullptr,
+            .segmentID = m_nextSegmentID++,
+            .transform = {},
+            .transitionIn = {}
         };
-        videoSegment.firstFrame = videoSegment.videoData->getFrameTexture(renderer, 0);
-        videoSegment.lastFrame = videoSegment.videoData->getFrameTexture(renderer, videoSegment.duration - 1);
+        // Thumbnails of the first and last frame, decoded with a pooled decoder
+        DecoderLease lease = DecoderPool::shared().acquire(data->videoData->formatContext->url, 0, 0, Demuxer::s_playbackOwner);
+        if (lease) {
+            if (lease->getVideoFrame(0, m_fps, false)) videoSegment.firstFrame = lease->createFrameTexture(renderer);
+            if (lease->getVideoFrame(videoSegment.sourceDuration - 1, m_fps, false)) videoSegment.lastFrame = lease->createFrameTexture(renderer);
+        }
 
         // Cannot drop here, because it would overlap with another segment
         if (isCollidingWithOtherSegments(&videoSegment)) return segmentPointer;
@@ -186,7 +177,8 @@ SegmentPointer Timeline::addAssetSegments(SDL_Renderer* renderer, AssetData* dat
             .duration = data->audioData->getAudioDurationInFrames(),
             .timelinePosition = frame,
             .timelineDuration = audioDurationInTimelineFrames,
-            .trackID = audioTrackID
+            .trackID = audioTrackID,
+            .segmentID = m_nextSegmentID++
         };
 
         // Cannot drop here, because it would overlap with another segment
@@ -204,6 +196,7 @@ SegmentPointer Timeline::addAssetSegments(SDL_Renderer* renderer, AssetData* dat
         segmentPointer.audioSegment = &m_audioSegments.back();
     }
 
+    commit();
     return segmentPointer;
 }
 
@@ -246,6 +239,7 @@ bool Timeline::segmentsChangeTrack(std::vector<VideoSegment*>* videoSegments, st
         }
         return false;
     }
+    commit();
     return true;
 }
 
@@ -288,6 +282,7 @@ bool Timeline::segmentsMoveFrames(std::vector<VideoSegment*>* videoSegments, std
         }
         return false;
     }
+    commit();
     return true;
 }
 
@@ -316,6 +311,68 @@ void Timeline::deleteSegments(std::vector<VideoSegment*>* videoSegments, std::ve
             m_audioSegments.end()
         );
     }
+    commit();
+}
+
+void Timeline::setSegmentsPlacement(std::vector<VideoSegment*>* videoSegments, const SegmentTransform& placement) {
+    for (VideoSegment* segment : *videoSegments) {
+        float opacity = segment->transform.opacity;
+        segment->transform = placement;
+        segment->transform.opacity = opacity;
+    }
+    commit();
+}
+
+void Timeline::setSegmentsOpacity(std::vector<VideoSegment*>* videoSegments, float opacity) {
+    for (VideoSegment* segment : *videoSegments) {
+        segment->transform.opacity = std::clamp(opacity, 0.0f, 1.0f);
+    }
+    commit();
+}
+
+void Timeline::setSegmentsTransition(std::vector<VideoSegment*>* videoSegments, const SegmentTransition& transition) {
+    for (VideoSegment* segment : *videoSegments) {
+        segment->transitionIn = transition;
+    }
+    commit();
+}
+
+void Timeline::ensureTrackCount(int videoTrackCount, int audioTrackCount) {
+    while (getVideoTrackCount() < videoTrackCount) {
+        int trackID = m_nextVideoTrackID++;
+        int trackPos = getVideoTrackCount();
+        m_videoTrackIDtoPosMap[trackID] = trackPos;
+        m_videoTrackPosToIDMap[trackPos] = trackID;
+    }
+    while (getAudioTrackCount() < audioTrackCount) {
+        int trackID = m_nextAudioTrackID++;
+        int trackPos = getAudioTrackCount();
+        m_audioTrackIDtoPosMap[trackID] = trackPos;
+        m_audioTrackPosToIDMap[trackPos] = trackID;
+    }
+    commit();
+}
+
+VideoSegment* Timeline::addVideoSegment(VideoSegment segment, int trackPos) {
+    if (trackPos < 0 || trackPos >= getVideoTrackCount()) return nullptr;
+    segment.trackID = m_videoTrackPosToIDMap[trackPos];
+    if (isCollidingWithOtherSegments(&segment)) return nullptr;
+
+    segment.segmentID = m_nextSegmentID++;
+    m_videoSegments.push_back(segment);
+    commit();
+    return &m_videoSegments.back();
+}
+
+AudioSegment* Timeline::addAudioSegment(AudioSegment segment, int trackPos) {
+    if (trackPos < 0 || trackPos >= getAudioTrackCount()) return nullptr;
+    segment.trackID = m_audioTrackPosToIDMap[trackPos];
+    if (isCollidingWithOtherSegments(&segment)) return nullptr;
+
+    segment.segmentID = m_nextSegmentID++;
+    m_audioSegments.push_back(segment);
+    commit();
+    return &m_audioSegments.back();
 }
 
 void Timeline::addTrack(Track track, int videoOrAudio, bool above) {
@@ -371,6 +428,7 @@ void Timeline::addTrack(Track track, int videoOrAudio, bool above) {
             m_audioTrackPosToIDMap[static_cast<int>(m_audioTrackIDtoPosMap.size())] = newAudioTrackID;
         }
     }
+    commit();
 }
 
 void Timeline::deleteTrack(Track track) {
@@ -442,6 +500,7 @@ void Timeline::deleteTrack(Track track) {
         }
         m_audioTrackPosToIDMap = std::move(updatedTrackPosToIDmap);
     }
+    commit();
 }
 
 bool Timeline::isCollidingWithOtherSegments(VideoSegment* videoSegment) {
@@ -461,3 +520,185 @@ bool Timeline::isCollidingWithOtherSegments(AudioSegment* audioSegment) {
     }
     return false;
 }
+
+
+void Timeline::commit() {
+    auto snapshot = std::make_shared<TimelineSnapshot>();
+    snapshot->version = m_version.load(std::memory_order_relaxed) + 1;
+    snapshot->fps = m_fps;
+    snapshot->outputWidth = m_outputWidth;
+    snapshot->outputHeight = m_outputHeight;
+    snapshot->videoSegments = m_videoSegments;
+    snapshot->audioSegments = m_audioSegments;
+    snapshot->videoTrackIDtoPosMap = m_videoTrackIDtoPosMap;
+    snapshot->audioTrackIDtoPosMap = m_audioTrackIDtoPosMap;
+
+    // Publish: readers that already hold the previous snapshot keep it alive until they release it
+    m_snapshot.store(std::move(snapshot), std::memory_order_release);
+    m_version.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<const TimelineSnapshot> Timeline::acquireSnapshot() const {
+    return m_snapshot.load(std::memory_order_acquire);
+}
+
+Uint64 Timeline::getVersion() const {
+    return m_version.load(std::memory_order_acquire);
+}
+
+int TimelineSnapshot::getVideoTrackPos(int trackID) const {
+    auto it = videoTrackIDtoPosMap.find(trackID);
+    return it != videoTrackIDtoPosMap.end() ? it->second : -1;
+}
+
+int TimelineSnapshot::getAudioTrackPos(int trackID) const {
+    auto it = audioTrackIDtoPosMap.find(trackID);
+    return it != audioTrackIDtoPosMap.end() ? it->second : -1;
+}
+
+const VideoSegment* TimelineSnapshot::getCurrentVideoSegment(Uint32 frame) const {
+    const VideoSegment* currentVideoSegment = nullptr;
+
+    // Iterate over video segments
+    for (const VideoSegment& segment : videoSegments) {
+        // Check if active at the given frame
+        if (frame >= segment.timelinePosition &&
+            frame < segment.timelinePosition + segment.timelineDuration) {
+            // Check if the found segment is higher on the track ordering
+            if (!currentVideoSegment || getVideoTrackPos(segment.trackID) > getVideoTrackPos(currentVideoSegment->trackID)) {
+                currentVideoSegment = &segment; // Set this segment to be returned
+            }
+        }
+    }
+    return currentVideoSegment;
+}
+
+std::vector<const VideoSegment*> TimelineSnapshot::getActiveVideoSegments(Uint32 frame) const {
+    std::vector<const VideoSegment*> activeSegments;
+    for (const VideoSegment& segment : videoSegments) {
+        if (frame >= segment.timelinePosition &&
+            frame < segment.timelinePosition + segment.timelineDuration) {
+            activeSegments.push_back(&segment);
+        }
+    }
+
+    // Order from the lowest to the highest track
+    std::sort(activeSegments.begin(), activeSegments.end(), [this](const VideoSegment* a, const VideoSegment* b) {
+        return getVideoTrackPos(a->trackID) < getVideoTrackPos(b->trackID);
+        });
+    return activeSegments;
+}
+
+const VideoSegment* TimelineSnapshot::getPreviousVideoSegment(const VideoSegment& segment) const {
+    // Segments on a track cannot touch (overlap checks are inclusive), so allow a single frame between them
+    const Uint32 maxGap = 1;
+
+    for (const VideoSegment& other : videoSegments) {
+        if (other.trackID != segment.trackID || &other == &segment) continue;
+        Uint32 otherEnd = other.timelinePosition + other.timelineDuration;
+        if (otherEnd <= segment.timelinePosition && segment.timelinePosition - otherEnd <= maxGap) {
+            return &other;
+        }
+    }
+    return nullptr;
+}
+
+bool TimelineSnapshot::getTransitionWindow(const VideoSegment& segment, Uint32& windowStart, Uint32& duration) const {
+    if (segment.transitionIn.type == TRANSITION_NONE) return false;
+    const VideoSegment* previous = getPreviousVideoSegment(segment);
+    if (!previous) return false;
+
+    // The window is centered on the cut and can't be longer than either segment
+    duration = std::min({ segment.transitionIn.duration, segment.timelineDuration, previous->timelineDuration });
+    if (duration == 0) return false;
+    windowStart = segment.timelinePosition - std::min(duration / 2, segment.timelinePosition);
+    return true;
+}
+
+Uint32 TimelineSnapshot::getVideoSegmentStart(const VideoSegment& segment) const {
+    Uint32 windowStart, duration;
+    if (getTransitionWindow(segment, windowStart, duration)) return windowStart;
+    return segment.timelinePosition;
+}
+
+std::vector<VideoLayerRef> TimelineSnapshot::getVideoLayers(Uint32 frame) const {
+    std::vector<VideoLayerRef> layers;
+    getVideoLayers(frame, layers);
+    return layers;
+}
+
+void TimelineSnapshot::getVideoLayers(Uint32 frame, std::vector<VideoLayerRef>& layers) const {
+    layers.clear();
+
+    // One layer per track, there are only a few so they are searched instead of keyed
+    auto findTrackLayer = [&layers](int trackID) -> VideoLayerRef* {
+        for (VideoLayerRef& layer : layers) {
+            if ((layer.incoming ? layer.incoming : layer.segment)->trackID == trackID) return &layer;
+        }
+        return nullptr;
+    };
+
+    // Transitions first, they take over their track for the whole transition window
+    for (const VideoSegment& segment : videoSegments) {
+        Uint32 windowStart, duration;
+        if (!getTransitionWindow(segment, windowStart, duration)) continue;
+        if (frame < windowStart || frame >= windowStart + duration) continue;
+
+        VideoLayerRef layer;
+        layer.segment = getPreviousVideoSegment(segment);
+        layer.incoming = &segment;
+        layer.progress = (frame - windowStart + 0.5f) / duration;
+        VideoLayerRef* trackLayer = findTrackLayer(segment.trackID);
+        if (trackLayer) *trackLayer = layer;
+        else layers.push_back(layer);
+    }
+
+    // Then every other active segment
+    for (const VideoSegment& segment : videoSegments) {
+        if (frame < segment.timelinePosition || frame >= segment.timelinePosition + segment.timelineDuration) continue;
+        VideoLayerRef* trackLayer = findTrackLayer(segment.trackID);
+        if (!trackLayer) layers.push_back({ &segment });
+        else if (!trackLayer->incoming) trackLayer->segment = &segment;
+    }
+
+    // Order from the lowest to the highest track
+    std::sort(layers.begin(), layers.end(), [this](const VideoLayerRef& a, const VideoLayerRef& b) {
+        return getVideoTrackPos(a.segment->trackID) < getVideoTrackPos(b.segment->trackID);
+        });
+}
+
+// TODO: merge audio if multiple tracks have a audioSegment to play at this time
+const AudioSegment* TimelineSnapshot::getCurrentAudioSegment(Uint32 frame) const {
+    for (const AudioSegment& segment : audioSegments) {
+        if (frame >= segment.timelinePosition &&
+            frame < segment.timelinePosition + segment.timelineDuration) {
+            return &segment;  // Return the active audio segment
+        }
+    }
+    return nullptr;  // No segment found at the given frame
+}
+
+const VideoSegment* TimelineSnapshot::findVideoSegment(Uint32 segmentID) const {
+    for (const VideoSegment& segment : videoSegments) {
+        if (segment.segmentID == segmentID) return &segment;
+    }
+    return nullptr;
+}
+
+const AudioSegment* TimelineSnapshot::findAudioSegment(Uint32 segmentID) const {
+    for (const AudioSegment& segment : audioSegments) {
+        if (segment.segmentID == segmentID) return &segment;
+    }
+    return nullptr;
+}
+
+Uint32 TimelineSnapshot::getEndFrame() const {
+    Uint32 endFrame = 0;
+    for (const VideoSegment& segment : videoSegments) {
+        endFrame = std::max(endFrame, segment.timelinePosition + segment.timelineDuration);
+    }
+    for (const AudioSegment& segment : audioSegments) {
+        endFrame = std::max(endFrame, segment.timelinePosition + segment.timelineDuration);
+    }
+    return endFrame;
+}
\ No newline at end of file
@@ -1,10 +1,38 @@
 #pragma once
 #include <SDL.h>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include "VideoData.h"
 
+// Placement of a video segment in the output frame. The default shows the full source frame fitted into the output.
+struct SegmentTransform {
+    float positionX = 0.0f;  // Horizontal offset of the segment from the output's center, as a fraction of the output width
+    float positionY = 0.0f;  // Vertical offset of the segment from the output's center, as a fraction of the output height
+    float scale = 1.0f;      // Scale relative to the full source frame fitted into the output
+    float cropLeft = 0.0f;   // Fraction of the source frame's width cut away on the left
+    float cropTop = 0.0f;    // Fraction of the source frame's height cut away at the top
+    float cropRight = 0.0f;  // Fraction of the source frame's width cut away on the right
+    float cropBottom = 0.0f; // Fraction of the source frame's height cut away at the bottom
+    float opacity = 1.0f;    // Opacity of the segment, 0 (invisible) to 1 (opaque)
+};
+
+enum TransitionType {
+    TRANSITION_NONE = 0,
+    TRANSITION_CROSSFADE = 1,    // Blend from the outgoing into the incoming segment
+    TRANSITION_DIP_TO_COLOR = 2, // Fade the outgoing segment to a color, then fade the color into the incoming segment
+    TRANSITION_WIPE = 3,         // The incoming segment slides in from the left over the outgoing segment
+};
+
+// Transition into a video segment from the segment right before it on the same track
+struct SegmentTransition {
+    TransitionType type = TRANSITION_NONE;
+    Uint32 duration = 30;              // Length in the timeline's fps, centered on the cut
+    SDL_Color color = { 0, 0, 0, 255 }; // Color used by TRANSITION_DIP_TO_COLOR
+};
+
 // Segment in the timeline with a pointer to the corresponding video data and data on what of that video is to be played.
 struct VideoSegment {
     VideoData* videoData;    // Reference to the video data
@@ -17,6 +45,17 @@ struct VideoSegment {
     int trackID;             // The video track this segment is on
     SDL_Texture* firstFrame; // First video frame
     SDL_Texture* lastFrame;  // First video frame
+    Uint32 segmentID = 0;    // Unique id of this segment, stable across edits and snapshots
+    SegmentTransform transform; // Position, scale, crop and opacity of this segment in the output frame
+    SegmentTransition transitionIn; // Transition from the previous segment on this track into this one
+
+    // Get the frame in the source that plays at timelineFrame, clamped to the source (transitions show frames outside the segment)
+    Uint32 getSourceFrame(Uint32 timelineFrame) const {
+        int64_t sourceFrame = static_cast<int64_t>(timelineFrame) - timelinePosition + sourceStartTime;
+        if (sourceFrame < 0) return 0;
+        if (sourceDuration > 0 && sourceFrame >= sourceDuration) return sourceDuration - 1;
+        return static_cast<Uint32>(sourceFrame);
+    }
 
     // Checks if two VideoSegments on the same track overlap
     bool overlapsWith(VideoSegment* other) {
@@ -36,6 +75,7 @@ struct AudioSegment {
     Uint32 timelinePosition; // Position in the overall timeline
     Uint32 timelineDuration; // Duration of this segment in the timeline's fps
     int trackID;             // The audio track this segment is on
+    Uint32 segmentID = 0;    // Unique id of this segment, stable across edits and snapshots
 
     // Checks if two VideoSegments on the same track overlap
     bool overlapsWith(AudioSegment* other) {
@@ -61,6 +101,62 @@ struct Track {
     TrackType trackType;
 };
 
+// What one video track shows at a frame: a single segment, or two segments during a transition
+struct VideoLayerRef {
+    const VideoSegment* segment = nullptr;  // The active segment, or the outgoing segment during a transition
+    const VideoSegment* incoming = nullptr; // The incoming segment during a transition, otherwise nullptr
+    float progress = 0.0f;                  // Transition progress from 0 (only outgoing) to 1 (only incoming)
+};
+
+/**
+ * @struct TimelineSnapshot
+ * @brief Immutable copy of the timeline's edit state at one version. Published by Timeline::commit() and shared with
+ *        reader threads (playback, export, analysis) through Timeline::acquireSnapshot(). Never modified after publishing.
+ */
+struct TimelineSnapshot {
+    Uint64 version = 0;       // Version of the timeline this snapshot was taken from
+    int fps = 60;             // Target frames per second of the timeline
+    int outputWidth = 1920;   // Width of the rendered output frame
+    int outputHeight = 1080;  // Height of the rendered output frame
+    std::vector<VideoSegment> videoSegments;
+    std::vector<AudioSegment> audioSegments;
+    std::unordered_map<int, int> videoTrackIDtoPosMap;
+    std::unordered_map<int, int> audioTrackIDtoPosMap;
+
+    // Get the video / audio trackPos of a given trackID (-1 if the track does not exist)
+    int getVideoTrackPos(int trackID) const;
+    int getAudioTrackPos(int trackID) const;
+
+    // Get the video / audio segment that should be playing at frame (nullptr if none)
+    const VideoSegment* getCurrentVideoSegment(Uint32 frame) const;
+    const AudioSegment* getCurrentAudioSegment(Uint32 frame) const;
+
+    // Get all video segments active at frame, ordered from the lowest to the highest track
+    std::vector<const VideoSegment*> getActiveVideoSegments(Uint32 frame) const;
+
+    // Get what every video track shows at frame (including transitions), ordered from the lowest to the highest track
+    std::vector<VideoLayerRef> getVideoLayers(Uint32 frame) const;
+
+    // Same as above, into layers. Reuses the vector's memory, so callers that keep it allocate nothing once it is large enough.
+    void getVideoLayers(Uint32 frame, std::vector<VideoLayerRef>& layers) const;
+
+    // Get the segment on the same track that ends right before segment starts (nullptr if none)
+    const VideoSegment* getPreviousVideoSegment(const VideoSegment& segment) const;
+
+    // Get the window of the transition into segment, returns false if it has no (valid) transition
+    bool getTransitionWindow(const VideoSegment& segment, Uint32& windowStart, Uint32& duration) const;
+
+    // Get the first timeline frame a video segment is drawn at, before its position if it has a transition in
+    Uint32 getVideoSegmentStart(const VideoSegment& segment) const;
+
+    // Find a video / audio segment by its segmentID (nullptr if none)
+    const VideoSegment* findVideoSegment(Uint32 segmentID) const;
+    const AudioSegment* findAudioSegment(Uint32 segmentID) const;
+
+    // Get the first frame after the last segment in the timeline
+    Uint32 getEndFrame() const;
+};
+
 /**
  * @class Timeline
  * @brief The editors timeline. Contains everything that will be played at what time, in what order and for how long.
@@ -76,6 +172,9 @@ public:
     // Get / Set the timeline's target frames per second
     int getFPS(); void setFPS(int fps);
 
+    // Get / Set the size of the rendered output frame
+    int getOutputWidth(); int getOutputHeight(); void setOutputSize(int width, int height);
+
     // Get / Set the current time in the timeline (as a frameIndex)
     Uint32 getCurrentTime(); void setCurrentTime(Uint32 time);
 
@@ -91,9 +190,6 @@ public:
     // Get all video / audio segments
     const std::vector<VideoSegment>* getAllVideoSegments(); const std::vector<AudioSegment>* getAllAudioSegments();
 
-    // Get the video / audio segment that should currently be playing
-    VideoSegment* getCurrentVideoSegment(); AudioSegment* getCurrentAudioSegment();
-
     // Get the video / audio segment from a track at a given position (nullptr if none)
     VideoSegment* getVideoSegment(int trackPos, Uint32 frame); AudioSegment* getAudioSegment(int trackPos, Uint32 frame);
 
@@ -109,6 +205,15 @@ public:
     // Delete the given video and audio segments from the timeline
     void deleteSegments(std::vector<VideoSegment*>* videoSegments, std::vector<AudioSegment*>* audioSegments);
 
+    // Set the position, scale and crop of all given video segments (keeps their opacity)
+    void setSegmentsPlacement(std::vector<VideoSegment*>* videoSegments, const SegmentTransform& placement);
+
+    // Set the opacity (0 to 1) of all given video segments
+    void setSegmentsOpacity(std::vector<VideoSegment*>* videoSegments, float opacity);
+
+    // Set the transition into all given video segments from the segment before them
+    void setSegmentsTransition(std::vector<VideoSegment*>* videoSegments, const SegmentTransition& transition);
+
     /**
      * @brief Add a new track to the timeline.
      * @param trackID The track from which we relatively add a new track.
@@ -121,10 +226,35 @@ public:
     // Delete a track from the timeline
     void deleteTrack(Track track);
 
+    // Add video / audio tracks at the top / bottom until the timeline has at least the given amount
+    void ensureTrackCount(int videoTrackCount, int audioTrackCount);
+
+    /**
+     * @brief Add a fully described segment (e.g. read from a project file) to the track at trackPos. The segment gets a new segmentID.
+     * @return A pointer to the added segment, nullptr if the track does not exist or the segment overlaps another one.
+     */
+    VideoSegment* addVideoSegment(VideoSegment segment, int trackPos);
+    AudioSegment* addAudioSegment(AudioSegment segment, int trackPos);
+
     // Expose collision checks publicly for editor operations (resizing)
     bool isCollidingWithOtherSegments(VideoSegment* videoSegment);
     bool isCollidingWithOtherSegments(AudioSegment* audioSegment);
 
+    /**
+     * @brief Publish the current edit state as a new immutable snapshot. Must be called from the editing (UI) thread after every edit.
+     *        Edits made through Timeline's own methods commit automatically; callers that modify segments directly must commit themselves.
+     */
+    void commit();
+
+    /**
+     * @brief Atomically acquire the most recently committed snapshot. Safe to call from any thread.
+     *        Readers never block the editor or each other, and keep their snapshot alive for as long as they hold the pointer.
+     */
+    std::shared_ptr<const TimelineSnapshot> acquireSnapshot() const;
+
+    // Get the version of the most recently committed snapshot
+    Uint64 getVersion() const;
+
 private:
     bool m_playing = false;
     std::vector<VideoSegment> m_videoSegments; // List of all VideoSegments in the timeline.
@@ -139,4 +269,9 @@ private:
     Uint32 m_startPlayTime = 0; // The time in the timeline where playing starts from (in frames)
     Uint32 m_startTime = 0; // Absolute start time of playback (in milliseconds)
     int m_fps = 60; // Target frames per second to render in.
+    int m_outputWidth = 1920;  // Width of the rendered output frame
+    int m_outputHeight = 1080; // Height of the rendered output frame
+    Uint32 m_nextSegmentID = 1; // Keeps track of the next available segmentID
+    std::atomic<Uint64> m_version = 0; // Version of the last committed snapshot
+    std::atomic<std::shared_ptr<const TimelineSnapshot>> m_snapshot; // Last committed snapshot, read by other threads
 };
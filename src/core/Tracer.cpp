@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include "Tracer.h"
+
+std::vector<std::shared_ptr<Tracer::ThreadBuffer>> Tracer::s_buffers;
+std::mutex Tracer::s_buffersMutex;
+Uint32 Tracer::s_nextThreadId = 1;
+
+// Names are string literals written by us, but a quote or backslash would still break the file
+static void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text ? text : ""; *c; c++) {
+        if (*c == '"' || *c == '\\') out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+Uint64 Tracer::now() {
+    return static_cast<Uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Tracer::record(const char* name, Uint64 start, Uint64 end) {
+    ThreadBuffer& buffer = getThreadBuffer();
+
+    // Only this thread writes, readers check writeCount afterwards to leave out what was overwritten while they read
+    Uint64 index = buffer.writeCount.load(std::memory_order_relaxed);
+    Event& event = buffer.events[index % s_bufferCapacity];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer.writeCount.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name) {
+    getThreadBuffer().threadName.store(name, std::memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer& Tracer::getThreadBuffer() {
+    thread_local ThreadBufferOwner owner;
+    if (!owner.buffer) {
+        owner.buffer = std::make_shared<ThreadBuffer>();
+        owner.buffer->events = std::make_unique<Event[]>(s_bufferCapacity);
+
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        owner.buffer->threadId = s_nextThreadId++;
+        s_buffers.push_back(owner.buffer);
+    }
+    return *owner.buffer;
+}
+
+Tracer::ThreadBufferOwner::~ThreadBufferOwner() {
+    if (!buffer) return;
+    std::lock_guard<std::mutex> lock(s_buffersMutex);
+    buffer->exitTime = now();
+
+    // Only the threads that ended last keep their buffer, a trace being written still holds the ones dropped here
+    auto isEnded = [](const std::shared_ptr<ThreadBuffer>& entry) { return entry->exitTime != 0; };
+    while (static_cast<size_t>(std::count_if(s_buffers.begin(), s_buffers.end(), isEnded)) > s_maxEndedBuffers) {
+        auto oldest = s_buffers.end();
+        for (auto it = s_buffers.begin(); it != s_buffers.end(); ++it) {
+            if (isEnded(*it) && (oldest == s_buffers.end() || (*it)->exitTime < (*oldest)->exitTime)) oldest = it;
+        }
+        s_buffers.erase(oldest);
+    }
+}
+
+void Tracer::copyEvents(const ThreadBuffer& buffer, Uint64 since, std::vector<EventCopy>& events) {
+    Uint64 writeCount = buffer.writeCount.load(std::memory_order_acquire);
+    Uint64 first = writeCount > s_bufferCapacity ? writeCount - s_bufferCapacity : 0;
+    size_t copyStart = events.size();
+
+    // Newest first, zones end in about the order they are written so the rest is older
+    Uint64 index = writeCount;
+    while (index > first) {
+        index--;
+        const Event& event = buffer.events[index % s_bufferCapacity];
+        Uint64 end = event.end.load(std::memory_order_relaxed);
+        if (end < since) break;
+        events.push_back({ event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed), end, buffer.threadId });
+    }
+
+    // The thread kept writing meanwhile. Slots it wrote to again (and the one it may be writing now) hold newer events.
+    Uint64 newWriteCount = buffer.writeCount.load(std::memory_order_acquire);
+    if (newWriteCount + 1 > s_bufferCapacity) {
+        Uint64 firstValid = newWriteCount + 1 - s_bufferCapacity;
+        if (index < firstValid) {
+            // The copy is newest first, so the overwritten ones are at its end
+            size_t validCount = static_cast<size_t>(writeCount > firstValid ? writeCount - firstValid : 0);
+            events.resize(copyStart + std::min(events.size() - copyStart, validCount));
+        }
+    }
+}
+
+bool Tracer::writeChromeTrace(const std::string& path, double seconds) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        buffers = s_buffers;
+    }
+
+    Uint64 until = now();
+    Uint64 window = static_cast<Uint64>(seconds * 1e9);
+    Uint64 since = until > window ? until - window : 0;
+    std::vector<EventCopy> events;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : buffers) {
+        copyEvents(*buffer, since, events);
+    }
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Unable to write trace file: " << path << std::endl;
+        return false;
+    }
+
+    // Chrome trace timestamps are in microseconds, relative to the oldest zone to keep the numbers short
+    Uint64 base = until;
+    for (const EventCopy& event : events) base = std::min(base, event.start);
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool isFirst = true;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : buffers) {
+        const char* threadName = buffer->threadName.load(std::memory_order_relaxed);
+        if (!threadName) continue;
+        file << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+        writeJsonString(file, threadName);
+        file << "}}";
+        isFirst = false;
+    }
+    file << std::fixed << std::setprecision(3);
+    for (const EventCopy& event : events) {
+        file << (isFirst ? "" : ",\n") << "{\"name\":";
+        writeJsonString(file, event.name);
+        file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId
+            << ",\"ts\":" << (event.start - base) / 1000.0
+            << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+        isFirst = false;
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        std::cerr << "Unable to write trace file: " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << events.size() << " trace zones of the last " << seconds << " seconds to " << path << std::endl;
+    return true;
+}
+
+std::vector<Tracer::ZoneStats> Tracer::getZoneStats(double seconds) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        buffers = s_buffers;
+    }
+
+    Uint64 until = now();
+    Uint64 window = static_cast<Uint64>(seconds * 1e9);
+    std::vector<EventCopy> events;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : buffers) {
+        copyEvents(*buffer, until > window ? until - window : 0, events);
+    }
+
+    // Names are literals, the same name in two files may be two pointers but is still one stage
+    std::unordered_map<std::string, ZoneStats> statsByName;
+    for (const EventCopy& event : events) {
+        if (!event.name) continue;
+        ZoneStats& stats = statsByName[event.name];
+        double ms = (event.end - event.start) / 1e6;
+        stats.name = event.name;
+        stats.count++;
+        stats.totalMs += ms;
+        stats.maxMs = std::max(stats.maxMs, ms);
+    }
+
+    std::vector<ZoneStats> result;
+    result.reserve(statsByName.size());
+    for (const auto& entry : statsByName) result.push_back(entry.second);
+    std::sort(result.begin(), result.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.totalMs > b.totalMs; });
+    return result;
+}
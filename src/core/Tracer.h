@@ -0,0 +1,113 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Time the rest of the enclosing scope as a zone. The name has to be a string literal, only its pointer is kept.
+// Building without TRACING_ENABLED removes the zones completely.
+#ifdef TRACING_ENABLED
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) Tracer::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Tracer::setThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+/**
+ * @class Tracer
+ * @brief Records how long zones of code take, to find out where a stutter comes from. Every thread writes its zones into
+ *        its own ring buffer without locking, so the newest zones of every thread are always available. They can be
+ *        written to a Chrome trace (JSON, opens in Perfetto or chrome://tracing) or summarised per zone name.
+ *        Times are in nanoseconds of a steady clock.
+ */
+class Tracer {
+public:
+    // Times the scope it lives in, use TRACE_ZONE() instead of creating one directly
+    class Zone {
+    public:
+        explicit Zone(const char* name) : m_name(name), m_start(Tracer::now()) {}
+        ~Zone() { Tracer::record(m_name, m_start, Tracer::now()); }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    private:
+        const char* m_name;
+        Uint64 m_start;
+    };
+
+    // The time spent in one zone name over a period
+    struct ZoneStats {
+        const char* name = nullptr;
+        Uint32 count = 0;
+        double totalMs = 0.0;
+        double maxMs = 0.0;
+    };
+
+    // Nanoseconds of a steady clock
+    static Uint64 now();
+
+    // Add a zone to the calling thread's buffer
+    static void record(const char* name, Uint64 start, Uint64 end);
+
+    // Name the calling thread in the trace. The name has to be a string literal.
+    static void setThreadName(const char* name);
+
+    /**
+     * @brief Write the zones of every thread that ended in the last seconds to a Chrome trace file.
+     * @param path The JSON file to write.
+     * @param seconds How far back to go.
+     * @returns False if the file could not be written.
+     */
+    static bool writeChromeTrace(const std::string& path, double seconds);
+
+    // Sum up the zones that ended in the last seconds by name, the most time spent first
+    static std::vector<ZoneStats> getZoneStats(double seconds);
+
+private:
+    // A zone, written by its thread while others may read it, so every field is atomic
+    struct Event {
+        std::atomic<const char*> name = nullptr;
+        std::atomic<Uint64> start = 0;
+        std::atomic<Uint64> end = 0;
+    };
+
+    // A copy of an event that can be read without the atomics
+    struct EventCopy {
+        const char* name;
+        Uint64 start;
+        Uint64 end;
+        Uint32 threadId;
+    };
+
+    struct ThreadBuffer {
+        std::unique_ptr<Event[]> events;
+        std::atomic<Uint64> writeCount = 0;   // Events written since the start, the next one goes to writeCount % capacity
+        std::atomic<const char*> threadName = nullptr;
+        Uint32 threadId = 0;
+        Uint64 exitTime = 0; // When the thread ended, 0 while it runs. Guarded by s_buffersMutex.
+    };
+
+    // Holds the calling thread's buffer, and marks it as ended when the thread ends
+    struct ThreadBufferOwner {
+        std::shared_ptr<ThreadBuffer> buffer;
+        ~ThreadBufferOwner();
+    };
+
+    // The calling thread's buffer, created and registered on its first zone
+    static ThreadBuffer& getThreadBuffer();
+
+    // Copy the events of a buffer that ended at or after a time, leaving out the ones overwritten while copying
+    static void copyEvents(const ThreadBuffer& buffer, Uint64 since, std::vector<EventCopy>& events);
+
+    // Every running thread's buffer, and the buffers of the threads that ended last so their zones can still be written
+    static std::vector<std::shared_ptr<ThreadBuffer>> s_buffers;
+    static std::mutex s_buffersMutex;
+    static Uint32 s_nextThreadId; // Guarded by s_buffersMutex
+
+    static constexpr size_t s_bufferCapacity = 1 << 15; // Events per thread, about 20 seconds of the main loop at 144 Hz
+    static constexpr size_t s_maxEndedBuffers = 16; // Buffers of ended threads kept, the export starts new threads for every run
+};
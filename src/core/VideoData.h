@@ -1,6 +1,8 @@
 #pragma once
 #include <iostream>
+#include <memory>
 #include <SDL.h>
+#include "Demuxer.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -17,7 +19,9 @@ struct VideoData {
     SwsContext* swsContext = nullptr; // Used for converting the frame to the desired format (e.g., YUV to RGB).
     AVFrame* frame = nullptr; // Holds decoded video frame data.
     AVFrame* rgbFrame = nullptr; // Holds video frame data converted to RGB format for easier processing.
+    AVFrame* receivedFrame = nullptr; // Reference to the last frame received from the codec, shown when asked past the end of the stream.
     int streamIndex = -1; // The index of the video stream.
+    std::shared_ptr<Demuxer> demuxer; // Reader of the file shared with the audio, owns formatContext when set
 
     VideoData() {}
 
@@ -31,14 +35,18 @@ struct VideoData {
             av_frame_free(&rgbFrame);
             rgbFrame = nullptr;
         }
+        if (receivedFrame) {
+            av_frame_free(&receivedFrame);
+            receivedFrame = nullptr;
+        }
         if (codecContext) {
             avcodec_free_context(&codecContext);
             codecContext = nullptr;
         }
-        if (formatContext) {
+        if (formatContext && !demuxer) {
             avformat_close_input(&formatContext);
-            formatContext = nullptr;
         }
+        formatContext = nullptr;
         if (swsContext) {
             sws_freeContext(swsContext);
             swsContext = nullptr;
@@ -81,80 +89,6 @@ struct VideoData {
         // Calculate the total number of frames
         return static_cast<Uint32>(durationInSeconds * targetFramerate);
     }
-
-    // Get a specific frame from a video.
-    AVFrame* getFrame(Uint32 frameIndex) {
-        AVPacket packet;
-
-        // Get the timestamp in the stream's time base
-        AVRational timeBase = formatContext->streams[streamIndex]->time_base;
-
-        // Convert the desired frame number to a timestamp
-        int64_t targetTimestamp = av_rescale_q(frameIndex, getFPS(), timeBase);
-
-        // Seek the frame we want
-        if (av_seek_frame(formatContext, streamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD) < 0) {
-            std::cerr << "Error seeking video to timestamp: " << targetTimestamp << std::endl;
-            return nullptr;
-        }
-
-        // Flush the codec context buffers to clear any data from previous frames.
-        avcodec_flush_buffers(codecContext);
-
-        // Read packets from the media file. Each packet corresponds to a small chunk of data (e.g., a frame).
-        while (av_read_frame(formatContext, &packet) >= 0) {
-            if (packet.stream_index == streamIndex) {
-                // Send the packet to the codec for decoding
-                avcodec_send_packet(codecContext, &packet);
-
-                // Receive the decoded frame from the codec
-                int ret = avcodec_receive_frame(codecContext, frame);
-                if (ret >= 0) {
-                    // Convert the frame to RGB
-                    int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24, codecContext->width, codecContext->height, 1);
-                    uint8_t* buffer = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
-
-                    // Perform the conversion to RGB.
-                    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, buffer, AV_PIX_FMT_RGB24, codecContext->width, codecContext->height, 1);
-                    sws_scale(swsContext, frame->data, frame->linesize, 0, codecContext->height, rgbFrame->data, rgbFrame->linesize);
-
-                    av_packet_unref(&packet);
-                    return rgbFrame; // Return the RGB frame
-                }
-            }
-            av_packet_unref(&packet);
-        }
-
-        return nullptr; // Frame not found
-    }
-
-    // Get the texture of a specific video frame.
-    SDL_Texture* getFrameTexture(SDL_Renderer* renderer, Uint32 frameIndex) {
-        AVFrame* frame = getFrame(frameIndex);
-        if (!frame) {
-            return nullptr;
-        }
-
-        // Create an SDL_Texture from the frame's RGB data
-        SDL_Texture* texture = SDL_CreateTexture(renderer,
-            SDL_PIXELFORMAT_RGB24,
-            SDL_TEXTUREACCESS_STREAMING,
-            codecContext->width,
-            codecContext->height);
-
-        // Lock the texture for pixel access
-        void* pixels;
-        int pitch;
-        SDL_LockTexture(texture, nullptr, &pixels, &pitch);
-
-        // Copy the frame's RGB data into the texture
-        for (int y = 0; y < codecContext->height; y++) {
-            memcpy((uint8_t*)pixels + y * pitch, rgbFrame->data[0] + y * rgbFrame->linesize[0], codecContext->width * 3);
-        }
-
-        SDL_UnlockTexture(texture);
-        return texture;
-    }
 };
 
 // Structure holding all preprocessed ffmpeg data to be able to quickly process videos
@@ -164,11 +98,15 @@ struct AudioData {
     SwrContext* swrContext = nullptr; // Used for resampling and converting audio to SDL format.
     AVFrame* frame = nullptr; // Holds decoded audio frame data.
     int streamIndex = -1; // The index of the audio stream.
+    std::shared_ptr<Demuxer> demuxer; // Reader of the file shared with the video, owns formatContext when set. Audio packets are read through it.
 
     AudioData() {}
 
     // Cleanup audio data when it's no longer used
     ~AudioData() {
+        if (demuxer && streamIndex >= 0) {
+            demuxer->releaseStream(streamIndex);
+        }
         if (frame) {
             av_frame_free(&frame);
             frame = nullptr;
@@ -177,10 +115,10 @@ struct AudioData {
             avcodec_free_context(&codecContext);
             codecContext = nullptr;
         }
-        if (formatContext) {
+        if (formatContext && !demuxer) {
             avformat_close_input(&formatContext);
-            formatContext = nullptr;
         }
+        formatContext = nullptr;
         if (swrContext) {
             swr_free(&swrContext);
             swrContext = nullptr;
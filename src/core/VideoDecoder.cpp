@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "VideoDecoder.h"
+#include "AllocationTracker.h"
+#include "Metrics.h"
+#include "Tracer.h"
+
+VideoDecoder::VideoDecoder() { }
+
+VideoDecoder::~VideoDecoder() {
+    if (m_demuxer) {
+        m_demuxer->releaseStream(m_videoData.streamIndex);
+    }
+}
+
+bool VideoDecoder::open(const char* filepath, Uint32 owner) {
+    m_filepath = filepath;
+    m_owner = owner;
+
+    // Read through the owner's shared reader of the file if no other decoder reads its video yet, otherwise through a reader of our own
+    m_demuxer = Demuxer::openForStream(filepath, AVMEDIA_TYPE_VIDEO, &m_videoData.streamIndex, owner);
+    if (!m_demuxer) {
+        std::cerr << "Could not open video stream of: " << filepath << std::endl;
+        return false;
+    }
+    m_videoData.demuxer = m_demuxer;
+    m_videoData.formatContext = m_demuxer->getFormatContext();
+
+    // Get the video codec parameters
+    AVCodecParameters* codecParams = m_videoData.formatContext->streams[m_videoData.streamIndex]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(codecParams->codec_id);
+    if (!codec) {
+        std::cerr << "Unsupported video codec!" << std::endl;
+        return false;
+    }
+
+    // Allocate video codec context and copy the codec parameters to it
+    m_videoData.codecContext = avcodec_alloc_context3(codec);
+    if (!m_videoData.codecContext) {
+        std::cerr << "Could not allocate video codec context." << std::endl;
+        return false;
+    }
+    if (avcodec_parameters_to_context(m_videoData.codecContext, codecParams) < 0) {
+        std::cerr << "Could not copy video codec parameters to context." << std::endl;
+        return false;
+    }
+
+    // Let ffmpeg pick the amount of decoding threads
+    m_videoData.codecContext->thread_count = 0;
+
+    // Open the video codec
+    if (avcodec_open2(m_videoData.codecContext, codec, nullptr) < 0) {
+        std::cerr << "Could not open video codec." << std::endl;
+        return false;
+    }
+
+    // Allocate the decoded frame, and the RGB frame with a buffer it owns
+    m_videoData.frame = av_frame_alloc();
+    m_videoData.rgbFrame = av_frame_alloc();
+    m_videoData.receivedFrame = av_frame_alloc();
+    m_videoData.rgbFrame->format = AV_PIX_FMT_RGB24;
+    m_videoData.rgbFrame->width = m_videoData.codecContext->width;
+    m_videoData.rgbFrame->height = m_videoData.codecContext->height;
+    if (av_frame_get_buffer(m_videoData.rgbFrame, 0) < 0) {
+        std::cerr << "Could not allocate RGB frame." << std::endl;
+        return false;
+    }
+
+    // Set up SwsContext for frame conversion (YUV -> RGB)
+    m_videoData.swsContext = sws_getContext(m_videoData.codecContext->width, m_videoData.codecContext->height,
+        m_videoData.codecContext->pix_fmt,
+        m_videoData.codecContext->width, m_videoData.codecContext->height,
+        AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_videoData.swsContext) {
+        std::cerr << "Could not create video conversion context." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool VideoDecoder::getVideoFrame(Uint32 frameIndex, int fps, bool isPlaying) {
+    TRACE_ZONE("VideoDecoder::getVideoFrame");
+    ALLOCATION_TAG("Decoder");
+    if (!m_videoData.swsContext) {
+        std::cerr << "Video decoder is not open" << std::endl;
+        return false;
+    }
+
+    // Already decoded, the frame shown stays until the time of the next frame received
+    bool isNextFrameDue = m_pendingFrame == UINT32_MAX || frameIndex >= m_pendingFrame;
+    if (m_hasRGBFrame && m_lastFrame != UINT32_MAX && (frameIndex == m_lastFrame || (frameIndex > m_lastFrame && !isNextFrameDue))) return true;
+    static Metrics::Histogram& decodeTime = Metrics::shared().histogram("decoder.frameMs");
+    Metrics::ScopedTimer decodeTimer(decodeTime);
+
+    // Another decoder of the same file moved the shared reader
+    bool isPositionedBySharedSeek = false;
+    Uint32 serial = m_demuxer->getSerial(m_videoData.streamIndex);
+    if (serial != m_serial) {
+        avcodec_flush_buffers(m_videoData.codecContext);
+        av_frame_unref(m_videoData.receivedFrame);
+        m_serial = serial;
+        m_lastFrame = UINT32_MAX;
+        m_pendingFrame = UINT32_MAX;
+
+        // Continue from there if it is just before the wanted frame, seeking again would undo the other decoder's seek
+        double seekTime = m_demuxer->getSeekTime(m_videoData.streamIndex);
+        double targetTime = static_cast<double>(frameIndex) / fps;
+        isPositionedBySharedSeek = seekTime >= 0.0 && seekTime <= targetTime && (targetTime - seekTime) * fps <= m_framebehindSeekThreshold;
+    }
+
+    // Check if we need to seek
+    bool isNotPositioned         = m_lastFrame == UINT32_MAX;
+    bool isPausedAndFrameChanged = !isPlaying && frameIndex != m_lastFrame;
+    bool isPlayingAndFrameAhead  =  isPlaying && frameIndex < m_lastFrame;
+    bool isPlayingAndFrameBehind =  isPlaying && frameIndex > m_lastFrame + m_framebehindSeekThreshold;
+
+    if (!isPositionedBySharedSeek && (isNotPositioned || isPausedAndFrameChanged || isPlayingAndFrameBehind || isPlayingAndFrameAhead)) {
+        static Metrics::Counter& seeksFrameBehind = Metrics::shared().counter("decoder.seeksFrameBehind");
+        if (isPlayingAndFrameBehind) seeksFrameBehind.add(); // Playback fell further behind than m_framebehindSeekThreshold
+        if (!seek(frameIndex, fps)) return false;
+    }
+
+    // Decode and convert the frame, m_lastFrame becomes the position of the frame converted
+    if (!decodeAndProcessFrame(frameIndex, fps)) {
+        m_lastFrame = UINT32_MAX; // Position unknown, seek next time
+        return false;
+    }
+    return true;
+}
+
+bool VideoDecoder::seek(Uint32 frameIndex, int fps) {
+    TRACE_ZONE("VideoDecoder::seek");
+    static Metrics::Counter& seeks = Metrics::shared().counter("decoder.seeks");
+    seeks.add();
+
+    // Get the timestamp in the stream's time base
+    AVRational timeBase = m_videoData.formatContext->streams[m_videoData.streamIndex]->time_base;
+
+    // Convert the desired frame number to a timestamp
+    int64_t targetTimestamp = av_rescale_q(frameIndex, { 1, fps }, timeBase);
+
+    if (!m_demuxer->seek(m_videoData.streamIndex, targetTimestamp)) {
+        std::cerr << "Error seeking video to timestamp: " << targetTimestamp << std::endl;
+        return false;
+    }
+    m_serial = m_demuxer->getSerial(m_videoData.streamIndex);
+
+    // Flush the codec context buffers to clear any data from previous frames. Also leaves the draining state after the end of the stream.
+    avcodec_flush_buffers(m_videoData.codecContext);
+    av_frame_unref(m_videoData.receivedFrame);
+    m_lastFrame = UINT32_MAX;
+    m_pendingFrame = UINT32_MAX;
+    return true;
+}
+
+bool VideoDecoder::decodeAndProcessFrame(Uint32 frameIndex, int fps) {
+    TRACE_ZONE("VideoDecoder::decodeAndProcessFrame");
+
+    // The next frame is not due yet (sources with less fps than the timeline), keep showing the current one
+    if (m_pendingFrame != UINT32_MAX && m_pendingFrame > frameIndex && m_lastFrame != UINT32_MAX) return true;
+
+    // Frames the decoder still has ready from the last packet come first, it takes no new packet until they are received
+    if (receiveFrames(frameIndex, fps)) return true;
+
+    AVPacket packet;
+    Uint32 serial = m_serial;
+    bool hasSeeked = false;
+    while (m_demuxer->readPacket(m_videoData.streamIndex, &packet, &serial) >= 0) {
+        if (packet.stream_index != m_videoData.streamIndex) {
+            av_packet_unref(&packet);
+            continue;
+        }
+
+        // The playback audio moved the shared reader while we decode, its packets don't follow the ones the codec has.
+        // Seek back once, if it keeps moving give up until the next call.
+        if (serial != m_serial) {
+            av_packet_unref(&packet);
+            if (hasSeeked || !seek(frameIndex, fps)) return false;
+            hasSeeked = true;
+            continue;
+        }
+
+        // Send packet to the decoder
+        int result = avcodec_send_packet(m_videoData.codecContext, &packet);
+        av_packet_unref(&packet); // Free the packet
+        if (result != 0) continue;
+
+        // Receive the frames the decoder has ready
+        if (receiveFrames(frameIndex, fps)) return true;
+    }
+
+    // End of the stream: drain the frames the decoder still holds back (the last has_b_frames frames of clips with B-frames).
+    // Sending the end again after a previous drain only returns AVERROR_EOF.
+    avcodec_send_packet(m_videoData.codecContext, nullptr);
+    if (receiveFrames(frameIndex, fps)) return true;
+
+    // Asked past the last frame of the file (durations are rounded), use the last frame there is
+    if (m_pendingFrame != UINT32_MAX) return convertPendingFrame();
+    if (m_videoData.receivedFrame->buf[0]) {
+        return convertFrame(m_videoData.receivedFrame);
+    }
+    return false; // No frame found or error occurred
+}
+
+bool VideoDecoder::receiveFrames(Uint32 frameIndex, int fps) {
+    // A failed receive unrefs the frame, so the last frame that was received is kept as its own reference
+    while (avcodec_receive_frame(m_videoData.codecContext, m_videoData.frame) == 0) {
+        if (processFrame(frameIndex, fps)) return true;
+    }
+    return false;
+}
+
+bool VideoDecoder::processFrame(Uint32 frameIndex, int fps) {
+    TRACE_ZONE("VideoDecoder::processFrame");
+    Uint32 framePosition = getTimelineFrame(m_videoData.frame, fps);
+
+    // The frame shown at frameIndex is the last one that starts at or before it, which is only known once the frame after it arrives
+    bool isConverted = false;
+    if (framePosition > frameIndex) {
+        if (m_pendingFrame != UINT32_MAX) {
+            isConverted = convertPendingFrame();
+        }
+        else if (m_lastFrame == UINT32_MAX) {
+            // Nothing before it since the seek (the stream starts after frameIndex), it stands in until it is due
+            isConverted = convertFrame(m_videoData.frame);
+            m_lastFrame = frameIndex;
+        }
+        else {
+            isConverted = true; // The frame shown is still the right one
+        }
+    }
+    else if (m_pendingFrame != UINT32_MAX) {
+        // The frame held back is replaced before it was shown (sources with more fps than the timeline)
+        static Metrics::Counter& framesDropped = Metrics::shared().counter("decoder.framesDropped");
+        framesDropped.add();
+    }
+
+    // Hold the frame back until it is due
+    av_frame_unref(m_videoData.receivedFrame);
+    av_frame_move_ref(m_videoData.receivedFrame, m_videoData.frame);
+    m_pendingFrame = framePosition;
+    return isConverted;
+}
+
+bool VideoDecoder::convertPendingFrame() {
+    m_lastFrame = m_pendingFrame;
+    m_pendingFrame = UINT32_MAX;
+    return convertFrame(m_videoData.receivedFrame);
+}
+
+Uint32 VideoDecoder::getTimelineFrame(const AVFrame* frame, int fps) const {
+    // Rounded to the nearest frame, timestamps in time bases like milliseconds are not exact
+    auto stream = m_videoData.formatContext->streams[m_videoData.streamIndex];
+    double framePTS = frame->best_effort_timestamp * av_q2d(stream->time_base);
+    return static_cast<Uint32>(std::max<long long>(0, std::llround(framePTS * fps)));
+}
+
+bool VideoDecoder::convertFrame(const AVFrame* frame) {
+    TRACE_ZONE("sws_scale");
+    // Convert the frame from YUV to RGB
+    int height = sws_scale(m_videoData.swsContext,
+        frame->data,
+        frame->linesize,
+        0,
+        m_videoData.codecContext->height,
+        m_videoData.rgbFrame->data,
+        m_videoData.rgbFrame->linesize);
+    if (height <= 0) {
+        std::cerr << "Could not convert video frame to RGB" << std::endl;
+        return false;
+    }
+
+    m_hasRGBFrame = true;
+    return true;
+}
+
+const AVFrame* VideoDecoder::getRGBFrame() const {
+    return m_hasRGBFrame ? m_videoData.rgbFrame : nullptr;
+}
+
+int VideoDecoder::getWidth() const {
+    return m_videoData.codecContext ? m_videoData.codecContext->width : 0;
+}
+
+int VideoDecoder::getHeight() const {
+    return m_videoData.codecContext ? m_videoData.codecContext->height : 0;
+}
+
+const std::string& VideoDecoder::getFilepath() const {
+    return m_filepath;
+}
+
+Uint32 VideoDecoder::getOwner() const {
+    return m_owner;
+}
+
+Uint32 VideoDecoder::getPosition() const {
+    return m_lastFrame;
+}
+
+bool VideoDecoder::canDecodeWithoutSeek(Uint32 frameIndex) const {
+    if (!m_demuxer || m_demuxer->getSerial(m_videoData.streamIndex) != m_serial) return false;
+    return m_lastFrame != UINT32_MAX && frameIndex >= m_lastFrame && frameIndex <= m_lastFrame + m_framebehindSeekThreshold;
+}
+
+size_t VideoDecoder::getMemoryEstimate() const {
+    if (!m_videoData.codecContext) return 0;
+    size_t pixelCount = static_cast<size_t>(m_videoData.codecContext->width) * m_videoData.codecContext->height;
+
+    // Decoded frames are mostly YUV 4:2:0 (1.5 bytes per pixel), every frame thread holds one more
+    int heldFrames = m_referenceFrameEstimate + std::max(1, m_videoData.codecContext->thread_count);
+    return pixelCount * 3 + pixelCount * 3 / 2 * heldFrames;
+}
+
+SDL_Texture* VideoDecoder::createFrameTexture(SDL_Renderer* renderer) const {
+    const AVFrame* rgbFrame = getRGBFrame();
+    if (!rgbFrame || !renderer) return nullptr;
+
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STATIC, getWidth(), getHeight());
+    if (!texture) {
+        std::cerr << "Failed to create SDL texture: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+    SDL_UpdateTexture(texture, nullptr, rgbFrame->data[0], rgbFrame->linesize[0]);
+    return texture;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <SDL.h>
+#include <string>
+#include <memory>
+#include "VideoData.h"
+#include "Demuxer.h"
+
+/**
+ * @class VideoDecoder
+ * @brief Independent decoder for the video stream of one file, with its own codec and conversion state.
+ *        Packets come from a Demuxer that is shared with at most the file's audio of the same owner, never with another video decoder,
+ *        so different instances can decode on different threads at the same time.
+ */
+class VideoDecoder {
+public:
+    VideoDecoder();
+    ~VideoDecoder();
+
+    /**
+     * @brief Open the file and set up the codec context to decode its first video stream.
+     * @param filepath The path to the video file.
+     * @param owner Who the decoder is for, it shares a reader with the audio of the same owner (Demuxer::s_privateOwner for a reader of its own).
+     * @return True if successful, otherwise false.
+     */
+    bool open(const char* filepath, Uint32 owner = Demuxer::s_privateOwner);
+
+    /**
+     * @brief Decode a frame of the video into the RGB frame. Keeps decoding forward when possible, and only seeks when needed.
+     *        The frame shown is the last one whose timestamp is at or before frameIndex, so sources play at their own speed at any timeline fps.
+     * @param frameIndex The frame to decode, in the timeline's fps.
+     * @param fps The timeline's fps.
+     * @param isPlaying Whether the timeline is playing. While playing, small jumps forward decode through instead of seeking.
+     * @return True if successful, otherwise false.
+     */
+    bool getVideoFrame(Uint32 frameIndex, int fps, bool isPlaying);
+
+    // Get the last decoded frame in RGB24 (nullptr if nothing was decoded yet)
+    const AVFrame* getRGBFrame() const;
+
+    int getWidth() const;
+    int getHeight() const;
+    const std::string& getFilepath() const;
+    Uint32 getOwner() const;
+
+    // Get the position of the frame shown in the timeline's fps, from its timestamp (UINT32_MAX if the decoder is not positioned)
+    Uint32 getPosition() const;
+
+    // Check if getVideoFrame can reach frameIndex during playback by decoding forward, without seeking
+    bool canDecodeWithoutSeek(Uint32 frameIndex) const;
+
+    // Estimate the memory held by this decoder in bytes: the RGB frame plus the frames the codec keeps for reference
+    size_t getMemoryEstimate() const;
+
+    // Create a texture of the last decoded frame (nullptr if nothing was decoded yet or there is no renderer), the caller owns the texture
+    SDL_Texture* createFrameTexture(SDL_Renderer* renderer) const;
+
+private:
+    // Seek the reader to the keyframe before frameIndex and forget everything decoded before, returns true if successful
+    bool seek(Uint32 frameIndex, int fps);
+
+    // Decode and process video frames until we get the wanted frame, returns true if successfull
+    bool decodeAndProcessFrame(Uint32 frameIndex, int fps);
+
+    // Receive every frame the codec has ready and process them, returns true once the wanted frame was converted
+    bool receiveFrames(Uint32 frameIndex, int fps);
+
+    // Process the frame just received, returns true once the frame to show at frameIndex is converted
+    bool processFrame(Uint32 frameIndex, int fps);
+
+    // Convert the received frame that was held back and make it the current position
+    bool convertPendingFrame();
+
+    // Get the position of a decoded frame in the timeline's fps, from its timestamp
+    Uint32 getTimelineFrame(const AVFrame* frame, int fps) const;
+
+    // Convert a decoded frame to RGB, returns true if successful
+    bool convertFrame(const AVFrame* frame);
+
+private:
+    VideoData m_videoData; // ffmpeg state of this decoder, the formatContext belongs to m_demuxer
+    std::shared_ptr<Demuxer> m_demuxer;
+    Uint32 m_serial = 0; // Serial of the video stream in m_demuxer when this decoder was last positioned
+    std::string m_filepath;
+    Uint32 m_owner = Demuxer::s_privateOwner;
+    bool m_hasRGBFrame = false;
+    Uint32 m_lastFrame = UINT32_MAX; // Position of the converted frame in the timeline's fps, from its timestamp (UINT32_MAX = not positioned yet)
+    Uint32 m_pendingFrame = UINT32_MAX; // Position of the received frame that is not due yet (UINT32_MAX = none)
+    int m_referenceFrameEstimate = 16; // Decoded frames a codec may hold on to (the H.264 maximum), used for the memory estimate
+    int m_framebehindSeekThreshold = 30; // We need to be at least this many frames behind to use av_seek_frame over just skipping frames one by one.
+};
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <iostream>
+#include "AudioMixer.h"
+
+AudioMixer::AudioMixer(std::shared_ptr<const TimelineSnapshot> snapshot, int sampleRate, int channels)
+    : m_snapshot(std::move(snapshot)), m_sampleRate(sampleRate), m_channels(channels) { }
+
+AudioMixer::~AudioMixer() { }
+
+void AudioMixer::mix(Uint64 startSample, int sampleCount, std::vector<int16_t>& output) {
+    size_t valueCount = static_cast<size_t>(sampleCount) * m_channels;
+    m_accumulator.assign(valueCount, 0);
+    Uint64 endSample = startSample + sampleCount;
+    Uint64 fps = m_snapshot->fps;
+
+    for (const AudioSegment& segment : m_snapshot->audioSegments) {
+        Uint64 segmentStart = static_cast<Uint64>(segment.timelinePosition) * m_sampleRate / fps;
+        Uint64 segmentEnd = static_cast<Uint64>(segment.timelinePosition + segment.timelineDuration) * m_sampleRate / fps;
+        Uint64 firstSample = std::max(startSample, segmentStart);
+        Uint64 lastSample = std::min(endSample, segmentEnd);
+        if (firstSample >= lastSample) continue;
+
+        mixSegment(segment, firstSample, lastSample, startSample);
+    }
+
+    // Close the decoders of segments that ended
+    std::erase_if(m_sources, [this, endSample, fps](const auto& entry) {
+        const AudioSegment* segment = m_snapshot->findAudioSegment(entry.first);
+        return !segment || static_cast<Uint64>(segment->timelinePosition + segment->timelineDuration) * m_sampleRate / fps <= endSample;
+        });
+
+    output.resize(valueCount);
+    for (size_t i = 0; i < valueCount; i++) {
+        output[i] = static_cast<int16_t>(std::clamp(m_accumulator[i], -32768, 32767));
+    }
+}
+
+void AudioMixer::mixSegment(const AudioSegment& segment, Uint64 firstSample, Uint64 endSample, Uint64 blockStart) {
+    SegmentSource& source = m_sources[segment.segmentID];
+    if (source.hasFailed) return;
+    if (!segment.audioData || !segment.audioData->formatContext) {
+        std::cerr << "Invalid audio segment" << std::endl;
+        source.hasFailed = true;
+        return;
+    }
+
+    double fps = m_snapshot->fps;
+    Uint64 segmentStart = static_cast<Uint64>(segment.timelinePosition) * m_sampleRate / m_snapshot->fps;
+    double sourceStart = segment.sourceStartTime / fps;
+
+    if (!source.decoder) {
+        source.decoder = std::make_unique<AudioDecoder>();
+        if (!source.decoder->open(segment.audioData->formatContext->url, m_sampleRate, m_channels)) {
+            source.hasFailed = true;
+            return;
+        }
+    }
+
+    // Seek when starting the segment, or when the blocks skipped ahead
+    if (source.nextSample != firstSample) {
+        double time = sourceStart + static_cast<double>(firstSample - segmentStart) / m_sampleRate;
+        if (!source.decoder->seek(time)) {
+            source.hasFailed = true;
+            return;
+        }
+        source.pending.clear();
+        source.nextSample = firstSample;
+    }
+
+    // Decode whole packets, what is left over stays pending for the next block
+    int bytesPerFrame = source.decoder->getBytesPerFrame();
+    size_t neededBytes = static_cast<size_t>(endSample - firstSample) * bytesPerFrame;
+    double segmentEndTime = (segment.sourceStartTime + segment.timelineDuration) / fps;
+    while (source.pending.size() < neededBytes) {
+        if (source.decoder->decode(segmentEndTime, neededBytes - source.pending.size(), source.pending) <= 0) break;
+    }
+
+    // The end of the file leaves the rest of the block silent
+    size_t valueCount = std::min(source.pending.size(), neededBytes) / sizeof(int16_t);
+    const int16_t* samples = reinterpret_cast<const int16_t*>(source.pending.data());
+    int32_t* target = m_accumulator.data() + static_cast<size_t>(firstSample - blockStart) * m_channels;
+    for (size_t i = 0; i < valueCount; i++) {
+        target[i] += samples[i];
+    }
+
+    source.pending.erase(source.pending.begin(), source.pending.begin() + valueCount * sizeof(int16_t));
+    source.nextSample = endSample;
+}
+
+int AudioMixer::getSampleRate() const {
+    return m_sampleRate;
+}
+
+int AudioMixer::getChannels() const {
+    return m_channels;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <SDL.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Timeline.h"
+#include "AudioDecoder.h"
+
+/**
+ * @class AudioMixer
+ * @brief Mixes every audio segment of a timeline snapshot down to one interleaved signed 16-bit stream.
+ *        Meant to be asked for consecutive blocks of samples: every segment keeps its own AudioDecoder and continues decoding where the last block ended.
+ */
+class AudioMixer {
+public:
+    AudioMixer(std::shared_ptr<const TimelineSnapshot> snapshot, int sampleRate = 44100, int channels = 2);
+    ~AudioMixer();
+
+    /**
+     * @brief Mix a block of the timeline's audio. Samples where no segment plays are silent.
+     * @param startSample The first sample of the block, counted from the start of the timeline.
+     * @param sampleCount The amount of samples (per channel) in the block.
+     * @param output Receives sampleCount * channels interleaved samples.
+     */
+    void mix(Uint64 startSample, int sampleCount, std::vector<int16_t>& output);
+
+    int getSampleRate() const;
+    int getChannels() const;
+
+private:
+    // Decoding state of one segment
+    struct SegmentSource {
+        std::unique_ptr<AudioDecoder> decoder;
+        std::vector<uint8_t> pending; // Decoded samples not mixed yet
+        Uint64 nextSample = UINT64_MAX; // Timeline sample the first pending sample belongs to (UINT64_MAX = not positioned)
+        bool hasFailed = false;
+    };
+
+    // Mix the part [firstSample, endSample) of a segment into the accumulator, whose first sample is blockStart
+    void mixSegment(const AudioSegment& segment, Uint64 firstSample, Uint64 endSample, Uint64 blockStart);
+
+private:
+    std::shared_ptr<const TimelineSnapshot> m_snapshot;
+    int m_sampleRate;
+    int m_channels;
+    std::unordered_map<Uint32, SegmentSource> m_sources; // Keyed by segmentID
+    std::vector<int32_t> m_accumulator; // Mixed block before clamping to 16 bit
+};
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "BatchRenderer.h"
+#include "AssetsList.h"
+#include "ProjectFile.h"
+#include "Timeline.h"
+
+bool BatchRenderer::isRequested(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--render") == 0) return true;
+    }
+    return false;
+}
+
+int BatchRenderer::run(int argc, char* argv[]) {
+    if (!parseArguments(argc, argv)) return 2;
+
+    // Frames served to stdout would be mixed with the progress, which goes to stderr instead
+    if (FrameServer::isStandardOutput(m_settings.serveVideoTo) || FrameServer::isStandardOutput(m_settings.serveAudioTo)) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    int workerCount = std::min(m_jobCount, static_cast<int>(m_jobs.size()));
+    std::cout << "Rendering " << m_jobs.size() << " project(s) with " << workerCount << " worker(s)" << std::endl;
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&BatchRenderer::workerLoop, this);
+    }
+
+    // Print the progress every second until every job is done
+    {
+        std::unique_lock<std::mutex> lock(m_jobMutex);
+        auto allDone = [this]() {
+            for (const Job& job : m_jobs) {
+                if (!job.isDone) return false;
+            }
+            return true;
+        };
+        while (!m_jobFinished.wait_for(lock, std::chrono::seconds(1), allDone)) {
+            lock.unlock();
+            printProgress();
+            lock.lock();
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    int failedCount = 0;
+    for (const Job& job : m_jobs) {
+        if (!job.hasSucceeded) failedCount++;
+    }
+    std::cout << "Rendered " << m_jobs.size() - failedCount << " of " << m_jobs.size() << " project(s) in " << seconds << " s" << std::endl;
+    return failedCount == 0 ? 0 : 1;
+}
+
+bool BatchRenderer::parseArguments(int argc, char* argv[]) {
+    std::vector<std::filesystem::path> projects;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--render") {
+            // Every argument that is not an option is a project
+        }
+        else if (argument == "-o" && hasValue) {
+            m_output = argv[++i];
+        }
+        else if (argument == "--jobs" && hasValue) {
+            m_jobCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (argument == "--codec" && hasValue) {
+            m_settings.videoCodec = argv[++i];
+        }
+        else if (argument == "--preset" && hasValue) {
+            m_settings.preset = argv[++i];
+        }
+        else if (argument == "--crf" && hasValue) {
+            m_settings.crf = std::atoi(argv[++i]);
+        }
+        else if (argument == "--chunks" && hasValue) {
+            m_settings.chunkCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (argument == "--rendition" && hasValue) {
+            Rendition rendition;
+            if (!parseRendition(argv[++i], rendition)) {
+                std::cerr << "Invalid rendition: " << argv[i] << std::endl;
+                printUsage();
+                return false;
+            }
+            m_renditions.push_back(rendition);
+        }
+        else if (argument == "--serve" && hasValue) {
+            m_settings.serveVideoTo = argv[++i];
+        }
+        else if (argument == "--serve-format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "y4m") m_settings.serveVideoFormat = FrameServerFormat::Y4M;
+            else if (format == "rgb24") m_settings.serveVideoFormat = FrameServerFormat::RGB24;
+            else {
+                std::cerr << "Unknown serve format: " << format << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+        else if (argument == "--serve-audio" && hasValue) {
+            m_settings.serveAudioTo = argv[++i];
+        }
+        else if (argument == "--serve-only") {
+            m_isServingOnly = true;
+        }
+        else if (argument == "--resume") {
+            m_settings.resumable = true;
+        }
+        else if (argument == "--smart") {
+            m_settings.smartRender = true;
+        }
+        else if (argument == "--no-render-cache") {
+            m_settings.useRenderCache = false;
+        }
+        else if (argument.starts_with("-")) {
+            std::cerr << "Unknown option: " << argument << std::endl;
+            printUsage();
+            return false;
+        }
+        else {
+            projects.push_back(argument);
+        }
+    }
+
+    if (projects.empty()) {
+        std::cerr << "No project to render" << std::endl;
+        printUsage();
+        return false;
+    }
+
+    // A stream has a single reader, so only one project can be served
+    bool isServing = !m_settings.serveVideoTo.empty() || !m_settings.serveAudioTo.empty();
+    if (isServing && projects.size() > 1) {
+        std::cerr << "Only one project can be served at a time" << std::endl;
+        printUsage();
+        return false;
+    }
+    if (m_isServingOnly && !isServing) {
+        std::cerr << "--serve-only needs --serve or --serve-audio" << std::endl;
+        printUsage();
+        return false;
+    }
+    if (FrameServer::isStandardOutput(m_settings.serveVideoTo) && FrameServer::isStandardOutput(m_settings.serveAudioTo)) {
+        std::cerr << "The frames and the audio can't both be served to stdout" << std::endl;
+        printUsage();
+        return false;
+    }
+
+    // A single project may be rendered to a file, several projects go into a directory named after their project
+    bool outputIsDirectory = !m_output.empty() && (projects.size() > 1 || std::filesystem::is_directory(m_output));
+    if (outputIsDirectory) {
+        std::error_code error;
+        std::filesystem::create_directories(m_output, error);
+    }
+    for (const std::filesystem::path& project : projects) {
+        Job job;
+        job.projectPath = project;
+        if (m_output.empty()) job.outputPath = std::filesystem::path(project).replace_extension(".mp4");
+        else if (outputIsDirectory) job.outputPath = m_output / project.filename().replace_extension(".mp4");
+        else job.outputPath = m_output;
+        m_jobs.push_back(job);
+    }
+    return true;
+}
+
+void BatchRenderer::printUsage() const {
+    std::cerr << "Usage: RythmGameVideoEditor --render <project>... [options]\n"
+        << "  -o <path>           Output file for one project, or output directory for several (default: next to the project)\n"
+        << "  --jobs <n>          Amount of projects rendered at the same time (default: 1)\n"
+        << "  --codec <name>      Video encoder (default: " << ExportSettings().videoCodec << ")\n"
+        << "  --preset <name>     Encoder preset (default: " << ExportSettings().preset << ")\n"
+        << "  --crf <n>           Constant quality (default: " << ExportSettings().crf << ")\n"
+        << "  --chunks <n>        Split every project into n chunks encoded at the same time, then joined (default: 1)\n"
+        << "  --smart             Copy segments shown as they are from their source instead of encoding them again\n"
+        << "  --resume            Export in chunks of at most " << ExportSettings().checkpointSeconds << " s that are kept until the file is written.\n"
+        << "                      Running the same command again after a failure only exports the chunks that are missing or changed\n"
+        << "  --rendition <name>,<width>x<height>[,<w>:<h>]\n"
+        << "                      Also write <output>.<name>.<extension> at another size, cut to the aspect ratio w:h first if given.\n"
+        << "                      The frames are composited once for all files (e.g. --rendition 720p,1280x720 --rendition short,1080x1920,9:16)\n"
+        << "  --serve <target>    Also stream the frames uncompressed to another program (e.g. an external encoder).\n"
+        << "                      <target> is - (stdout), pipe:<name> (named pipe), unix:<path> (Unix domain socket) or a file\n"
+        << "  --serve-format <f>  y4m (default) or rgb24 (raw frames without a header, no conversion)\n"
+        << "  --serve-audio <target>\n"
+        << "                      Also stream the mixed audio as 16-bit WAV, to the same kinds of targets\n"
+        << "  --serve-only        Only serve, don't write a video file\n"
+        << "                      (e.g. --serve - --serve-only | ffmpeg -i - -c:v libsvtav1 out.mkv)\n"
+        << "  --no-render-cache   Composite every frame instead of reading cached frames" << std::endl;
+}
+
+bool BatchRenderer::parseRendition(const std::string& argument, Rendition& rendition) {
+    // <name>,<width>x<height>[,<w>:<h>]
+    size_t sizeStart = argument.find(',');
+    if (sizeStart == std::string::npos || sizeStart == 0) return false;
+    rendition.name = argument.substr(0, sizeStart);
+
+    size_t aspectStart = argument.find(',', sizeStart + 1);
+    std::string size = argument.substr(sizeStart + 1, aspectStart == std::string::npos ? std::string::npos : aspectStart - sizeStart - 1);
+    if (std::sscanf(size.c_str(), "%dx%d", &rendition.output.width, &rendition.output.height) != 2) return false;
+    if (rendition.output.width <= 0 || rendition.output.height <= 0) return false;
+
+    if (aspectStart != std::string::npos) {
+        int aspectWidth = 0, aspectHeight = 0;
+        if (std::sscanf(argument.c_str() + aspectStart + 1, "%d:%d", &aspectWidth, &aspectHeight) != 2) return false;
+        if (aspectWidth <= 0 || aspectHeight <= 0) return false;
+        rendition.output.cropAspect = static_cast<float>(aspectWidth) / aspectHeight;
+    }
+    return true;
+}
+
+void BatchRenderer::workerLoop() {
+    while (true) {
+        Job* job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            if (m_nextJob >= m_jobs.size()) return;
+            job = &m_jobs[m_nextJob++];
+        }
+
+        bool hasSucceeded = renderJob(*job);
+
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        job->hasSucceeded = hasSucceeded;
+        job->isDone = true;
+        m_jobFinished.notify_all();
+    }
+}
+
+bool BatchRenderer::renderJob(Job& job) {
+    {
+        std::lock_guard<std::mutex> lock(m_outputMutex);
+        std::cout << "Rendering " << job.projectPath.string() << (m_isServingOnly ? "" : " to " + job.outputPath.string()) << std::endl;
+    }
+
+    // Every job has its own timeline and media, without a renderer no thumbnails are created
+    Timeline timeline;
+    AssetsList assets(nullptr);
+    if (!ProjectFile::load(job.projectPath, timeline, assets)) {
+        std::lock_guard<std::mutex> lock(m_outputMutex);
+        std::cerr << "Failed to load " << job.projectPath.string() << std::endl;
+        return false;
+    }
+
+    ExportSettings settings = m_settings;
+    settings.outputPath = m_isServingOnly ? "" : job.outputPath.string();
+    for (const Rendition& rendition : m_renditions) {
+        ExportOutput output = rendition.output;
+        output.videoCodec = m_settings.videoCodec;
+        output.preset = m_settings.preset;
+        output.crf = m_settings.crf;
+        std::filesystem::path path = job.outputPath;
+        output.outputPath = path.replace_filename(job.outputPath.stem().string() + "." + rendition.name + job.outputPath.extension().string()).string();
+        settings.extraOutputs.push_back(output);
+    }
+    Exporter exporter(timeline.acquireSnapshot(), settings);
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        job.exporter = &exporter;
+    }
+    bool hasSucceeded = exporter.run();
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        job.exporter = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    std::cout << (hasSucceeded ? "Finished " : "Failed ") << job.projectPath.string() << std::endl;
+    exporter.printStageStats();
+    return hasSucceeded;
+}
+
+void BatchRenderer::printProgress() {
+    std::lock_guard<std::mutex> jobLock(m_jobMutex);
+    std::lock_guard<std::mutex> outputLock(m_outputMutex);
+    for (const Job& job : m_jobs) {
+        if (!job.exporter) continue;
+        std::cout << "  " << job.projectPath.filename().string() << ": " << static_cast<int>(job.exporter->getProgress() * 100.0f) << "%" << std::endl;
+    }
+}
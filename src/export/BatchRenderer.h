@@ -0,0 +1,72 @@
+#pragma once
+#include <SDL.h>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Exporter.h"
+
+/**
+ * @class BatchRenderer
+ * @brief Renders project files to video files from the command line, without a window: no SDL video, renderer or fonts are initialised.
+ *        Several projects can be rendered at the same time, each by its own worker with its own Exporter.
+ *
+ *        RythmGameVideoEditor --render <project>... [-o <file or directory>] [--jobs <n>] [--codec <name>] [--preset <name>] [--crf <n>] [--chunks <n>] [--smart] [--resume] [--rendition <name>,<w>x<h>[,<w>:<h>]]...
+ *            [--serve <target>] [--serve-format y4m|rgb24] [--serve-audio <target>] [--serve-only] [--no-render-cache]
+ */
+class BatchRenderer {
+public:
+    // Whether the command line asks for a batch render instead of the editor
+    static bool isRequested(int argc, char* argv[]);
+
+    /**
+     * @brief Read the command line, render every project and print progress and per-stage timing to std::cout.
+     * @return The process exit code: 0 if every project was rendered, 1 if any failed, 2 if the command line is invalid.
+     */
+    int run(int argc, char* argv[]);
+
+private:
+    // A project to render and how far it is
+    struct Job {
+        std::filesystem::path projectPath;
+        std::filesystem::path outputPath;
+        Exporter* exporter = nullptr; // Set while rendering, guarded by m_jobMutex
+        bool isDone = false;
+        bool hasSucceeded = false;
+    };
+
+    // Another file written next to the output of every project
+    struct Rendition {
+        std::string name; // Added to the output's file name
+        ExportOutput output;
+    };
+
+    // Read the options and projects, returns false (after printing the usage) if the command line is invalid
+    bool parseArguments(int argc, char* argv[]);
+
+    // Read a --rendition value, returns false if it is invalid
+    bool parseRendition(const std::string& argument, Rendition& rendition);
+    void printUsage() const;
+
+    // Worker loop, takes the next job until none are left
+    void workerLoop();
+
+    // Load a project and export it, returns true if the file was written
+    bool renderJob(Job& job);
+
+    // Print the progress of every job that is being rendered
+    void printProgress();
+
+private:
+    ExportSettings m_settings;   // Shared by every job, only the output path differs
+    std::filesystem::path m_output; // -o, a file for a single project or a directory for several
+    std::vector<Rendition> m_renditions;
+    bool m_isServingOnly = false; // --serve-only, no file is encoded
+    int m_jobCount = 1;          // Projects rendered at the same time
+    std::vector<Job> m_jobs;
+    size_t m_nextJob = 0;        // The first job no worker took yet, guarded by m_jobMutex
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobFinished; // Wakes the progress printer up when a job is done
+    std::mutex m_outputMutex;    // Keeps the lines printed by different workers apart
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * @class BoundedQueue
+ * @brief Queue between two pipeline stages running on different threads. A full queue blocks the producer, so a fast
+ *        stage can't run ahead of a slow one and fill up memory. Closing the queue wakes both sides up.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity) : m_capacity(capacity) { }
+
+    // Add an item, waits while the queue is full. Returns false if the queue was closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]() { return m_items.size() < m_capacity || m_isClosed; });
+        if (m_isClosed) return false;
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // Take the oldest item, waits while the queue is empty. Returns false once the queue is closed and empty.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]() { return !m_items.empty() || m_isClosed; });
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // Stop accepting items. Items already queued can still be taken.
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isClosed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+private:
+    std::deque<T> m_items;
+    size_t m_capacity;
+    bool m_isClosed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+};
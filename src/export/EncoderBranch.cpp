@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include "EncoderBranch.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+}
+
+EncoderBranch::EncoderBranch(const ExportOutput& output, const ExportBranchFormat& format)
+    : ExportBranch("encode " + std::filesystem::path(output.outputPath).filename().string(), format), m_output(output) {
+    // Cut the frame to the aspect ratio around its center
+    int frameWidth = m_format.frameWidth;
+    int frameHeight = m_format.frameHeight;
+    m_crop = { 0, 0, frameWidth, frameHeight };
+    if (m_output.cropAspect > 0.0f && frameHeight > 0) {
+        if (static_cast<float>(frameWidth) / frameHeight > m_output.cropAspect) {
+            m_crop.w = std::min(frameWidth, static_cast<int>(std::lround(frameHeight * m_output.cropAspect)));
+        }
+        else {
+            m_crop.h = std::min(frameHeight, static_cast<int>(std::lround(frameWidth / m_output.cropAspect)));
+        }
+        m_crop.x = (frameWidth - m_crop.w) / 2;
+        m_crop.y = (frameHeight - m_crop.h) / 2;
+    }
+
+    // A missing side follows the other one at the crop's aspect ratio
+    if (m_output.width <= 0 && m_output.height <= 0) {
+        m_output.width = m_crop.w;
+        m_output.height = m_crop.h;
+    }
+    else if (m_output.width <= 0) {
+        m_output.width = static_cast<int>(static_cast<int64_t>(m_output.height) * m_crop.w / std::max(1, m_crop.h));
+    }
+    else if (m_output.height <= 0) {
+        m_output.height = static_cast<int>(static_cast<int64_t>(m_output.width) * m_crop.h / std::max(1, m_crop.w));
+    }
+
+    // 4:2:0 chroma needs an even size
+    m_output.width &= ~1;
+    m_output.height &= ~1;
+}
+
+EncoderBranch::~EncoderBranch() {
+    stopThread();
+    closeOutput();
+}
+
+bool EncoderBranch::open() {
+    const char* path = m_output.outputPath.c_str();
+    if (avformat_alloc_output_context2(&m_formatContext, nullptr, nullptr, path) < 0 || !m_formatContext) {
+        std::cerr << "Could not create an output container for: " << path << std::endl;
+        return false;
+    }
+
+    if (m_format.hasVideo && !openVideoEncoder()) return false;
+    if (m_format.hasAudio && !openAudioEncoder()) return false;
+
+    if (!(m_formatContext->oformat->flags & AVFMT_NOFILE) && avio_open(&m_formatContext->pb, path, AVIO_FLAG_WRITE) < 0) {
+        std::cerr << "Could not open output file: " << path << std::endl;
+        return false;
+    }
+    if (avformat_write_header(m_formatContext, nullptr) < 0) {
+        std::cerr << "Could not write the header of: " << path << std::endl;
+        return false;
+    }
+
+    m_packet = av_packet_alloc();
+    return true;
+}
+
+bool EncoderBranch::finishOutput() {
+    if (av_write_trailer(m_formatContext) < 0) {
+        std::cerr << "Could not finish writing: " << m_output.outputPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const ExportOutput& EncoderBranch::getOutput() const {
+    return m_output;
+}
+
+bool EncoderBranch::openVideoEncoder() {
+    const AVCodec* codec = avcodec_find_encoder_by_name(m_output.videoCodec.c_str());
+    if (!codec) {
+        std::cerr << "Video encoder " << m_output.videoCodec << " is not available, using the container's default." << std::endl;
+        codec = avcodec_find_encoder(m_formatContext->oformat->video_codec);
+    }
+    if (!codec) {
+        std::cerr << "No video encoder found for: " << m_output.outputPath << std::endl;
+        return false;
+    }
+
+    m_videoStream = avformat_new_stream(m_formatContext, nullptr);
+    m_videoCodecContext = avcodec_alloc_context3(codec);
+    if (!m_videoStream || !m_videoCodecContext) {
+        std::cerr << "Could not allocate the video encoder." << std::endl;
+        return false;
+    }
+
+    AVCodecContext* codecContext = m_videoCodecContext;
+    codecContext->width = m_output.width;
+    codecContext->height = m_output.height;
+    codecContext->time_base = { 1, m_format.fps };
+    codecContext->framerate = { m_format.fps, 1 };
+    codecContext->thread_count = m_format.encoderThreads; // 0 = one per core
+
+    // Closed GOPs can be cut apart and joined without re-encoding
+    if (m_format.gopSize > 0) codecContext->gop_size = m_format.gopSize;
+    codecContext->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+
+    // Prefer 4:2:0, every player handles it
+    codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+    if (codec->pix_fmts) {
+        codecContext->pix_fmt = codec->pix_fmts[0];
+        for (const AVPixelFormat* format = codec->pix_fmts; *format != AV_PIX_FMT_NONE; format++) {
+            if (*format == AV_PIX_FMT_YUV420P) codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+        }
+    }
+
+    // Options only some encoders know are ignored by the others
+    if (m_output.videoBitrate > 0) {
+        codecContext->bit_rate = m_output.videoBitrate;
+    }
+    else {
+        av_opt_set(codecContext->priv_data, "crf", std::to_string(m_output.crf).c_str(), 0);
+    }
+    av_opt_set(codecContext->priv_data, "preset", m_output.preset.c_str(), 0);
+
+    if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+        std::cerr << "Could not open video encoder: " << codec->name << std::endl;
+        return false;
+    }
+    if (avcodec_parameters_from_context(m_videoStream->codecpar, codecContext) < 0) {
+        std::cerr << "Could not copy the video encoder parameters to the stream." << std::endl;
+        return false;
+    }
+    m_videoStream->time_base = codecContext->time_base;
+
+    m_videoFrame = av_frame_alloc();
+    m_videoFrame->format = codecContext->pix_fmt;
+    m_videoFrame->width = codecContext->width;
+    m_videoFrame->height = codecContext->height;
+    if (av_frame_get_buffer(m_videoFrame, 0) < 0) {
+        std::cerr << "Could not allocate the video frame." << std::endl;
+        return false;
+    }
+
+    // Converts (and crops and scales if needed) the composited RGB frames to the encoder's format
+    m_swsContext = sws_getContext(m_crop.w, m_crop.h, AV_PIX_FMT_RGB24,
+        codecContext->width, codecContext->height, codecContext->pix_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsContext) {
+        std::cerr << "Could not create the video conversion context." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool EncoderBranch::openAudioEncoder() {
+    const AVCodec* codec = avcodec_find_encoder(m_formatContext->oformat->audio_codec);
+    if (!codec) {
+        std::cerr << "No audio encoder found for: " << m_output.outputPath << std::endl;
+        return false;
+    }
+
+    m_audioStream = avformat_new_stream(m_formatContext, nullptr);
+    m_audioCodecContext = avcodec_alloc_context3(codec);
+    if (!m_audioStream || !m_audioCodecContext) {
+        std::cerr << "Could not allocate the audio encoder." << std::endl;
+        return false;
+    }
+
+    AVCodecContext* codecContext = m_audioCodecContext;
+    codecContext->sample_fmt = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+    codecContext->sample_rate = m_format.sampleRate;
+    av_channel_layout_default(&codecContext->ch_layout, m_format.channels);
+    codecContext->bit_rate = m_output.audioBitrate;
+    codecContext->time_base = { 1, m_format.sampleRate };
+
+    if (m_formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+        std::cerr << "Could not open audio encoder: " << codec->name << std::endl;
+        return false;
+    }
+    if (avcodec_parameters_from_context(m_audioStream->codecpar, codecContext) < 0) {
+        std::cerr << "Could not copy the audio encoder parameters to the stream." << std::endl;
+        return false;
+    }
+    m_audioStream->time_base = codecContext->time_base;
+
+    // Encoders that take any amount of samples get blocks of the default size
+    if (codecContext->frame_size > 0 && !(codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        m_audioFrameSize = codecContext->frame_size;
+    }
+
+    m_audioFrame = av_frame_alloc();
+    m_audioFrame->format = codecContext->sample_fmt;
+    m_audioFrame->sample_rate = codecContext->sample_rate;
+    m_audioFrame->nb_samples = m_audioFrameSize;
+    av_channel_layout_copy(&m_audioFrame->ch_layout, &codecContext->ch_layout);
+    if (av_frame_get_buffer(m_audioFrame, 0) < 0) {
+        std::cerr << "Could not allocate the audio frame." << std::endl;
+        return false;
+    }
+
+    // Converts the mixed signed 16-bit samples to the encoder's sample format
+    if (swr_alloc_set_opts2(&m_swrContext,
+        &codecContext->ch_layout, codecContext->sample_fmt, codecContext->sample_rate,
+        &codecContext->ch_layout, AV_SAMPLE_FMT_S16, m_format.sampleRate,
+        0, nullptr) < 0 || swr_init(m_swrContext) < 0) {
+        std::cerr << "Failed to initialize the SwrContext." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void EncoderBranch::closeOutput() {
+    if (m_formatContext && m_formatContext->pb && !(m_formatContext->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&m_formatContext->pb);
+    }
+    if (m_formatContext) {
+        avformat_free_context(m_formatContext);
+        m_formatContext = nullptr;
+    }
+    if (m_videoCodecContext) avcodec_free_context(&m_videoCodecContext);
+    if (m_audioCodecContext) avcodec_free_context(&m_audioCodecContext);
+    if (m_videoFrame) av_frame_free(&m_videoFrame);
+    if (m_audioFrame) av_frame_free(&m_audioFrame);
+    if (m_packet) av_packet_free(&m_packet);
+    if (m_swrContext) swr_free(&m_swrContext);
+    if (m_swsContext) {
+        sws_freeContext(m_swsContext);
+        m_swsContext = nullptr;
+    }
+    m_videoStream = nullptr;
+    m_audioStream = nullptr;
+}
+
+bool EncoderBranch::writeFrame(const CompositeFrame* composite, Uint32 frameNumber) {
+    AVFrame* frame = nullptr;
+    if (composite) {
+        // The encoder may still hold on to the previous frame
+        if (av_frame_make_writable(m_videoFrame) < 0) {
+            std::cerr << "Could not make the video frame writable." << std::endl;
+            return false;
+        }
+
+        // The crop is read straight out of the shared frame
+        const uint8_t* source = composite->pixels.data() + static_cast<size_t>(m_crop.y) * composite->linesize + static_cast<size_t>(m_crop.x) * 3;
+        int sourceLinesize = composite->linesize;
+        sws_scale(m_swsContext, &source, &sourceLinesize, 0, std::min(m_crop.h, composite->height), m_videoFrame->data, m_videoFrame->linesize);
+        m_videoFrame->pts = frameNumber;
+        frame = m_videoFrame;
+    }
+
+    if (avcodec_send_frame(m_videoCodecContext, frame) < 0) {
+        std::cerr << "Error sending a frame to the video encoder." << std::endl;
+        return false;
+    }
+    return writePackets(m_videoCodecContext, m_videoStream);
+}
+
+bool EncoderBranch::writeAudio(const AudioBlock* block) {
+    if (block) {
+        m_pendingSamples.insert(m_pendingSamples.end(), block->samples.begin(), block->samples.end());
+    }
+
+    // Whole encoder frames, and at the end what is left
+    size_t frameValues = static_cast<size_t>(m_audioFrameSize) * m_format.channels;
+    size_t encodedValues = 0;
+    while (m_pendingSamples.size() - encodedValues >= frameValues) {
+        if (!encodeAudioFrame(m_pendingSamples.data() + encodedValues, m_audioFrameSize)) return false;
+        encodedValues += frameValues;
+    }
+    if (!block && m_pendingSamples.size() > encodedValues) {
+        int sampleCount = static_cast<int>((m_pendingSamples.size() - encodedValues) / m_format.channels);
+        if (!encodeAudioFrame(m_pendingSamples.data() + encodedValues, sampleCount)) return false;
+        encodedValues = m_pendingSamples.size();
+    }
+    m_pendingSamples.erase(m_pendingSamples.begin(), m_pendingSamples.begin() + encodedValues);
+
+    if (!block) {
+        if (avcodec_send_frame(m_audioCodecContext, nullptr) < 0) {
+            std::cerr << "Error flushing the audio encoder." << std::endl;
+            return false;
+        }
+        return writePackets(m_audioCodecContext, m_audioStream);
+    }
+    return true;
+}
+
+bool EncoderBranch::encodeAudioFrame(const int16_t* samples, int sampleCount) {
+    if (av_frame_make_writable(m_audioFrame) < 0) {
+        std::cerr << "Could not make the audio frame writable." << std::endl;
+        return false;
+    }
+    const uint8_t* source = reinterpret_cast<const uint8_t*>(samples);
+    if (swr_convert(m_swrContext, m_audioFrame->data, sampleCount, &source, sampleCount) < 0) {
+        std::cerr << "Error in resampling audio" << std::endl;
+        return false;
+    }
+    m_audioFrame->nb_samples = sampleCount;
+    m_audioFrame->pts = m_encodedSamples;
+    m_encodedSamples += sampleCount;
+
+    if (avcodec_send_frame(m_audioCodecContext, m_audioFrame) < 0) {
+        std::cerr << "Error sending a frame to the audio encoder." << std::endl;
+        return false;
+    }
+    return writePackets(m_audioCodecContext, m_audioStream);
+}
+
+bool EncoderBranch::writePackets(AVCodecContext* codecContext, AVStream* stream) {
+    while (true) {
+        int ret = avcodec_receive_packet(codecContext, m_packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return true;
+        if (ret < 0) {
+            std::cerr << "Error receiving a packet from the encoder." << std::endl;
+            return false;
+        }
+
+        av_packet_rescale_ts(m_packet, codecContext->time_base, stream->time_base);
+        m_packet->stream_index = stream->index;
+        if (av_interleaved_write_frame(m_formatContext, m_packet) < 0) {
+            std::cerr << "Error writing a packet to: " << m_output.outputPath << std::endl;
+            return false;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <SDL.h>
+#include <string>
+#include <vector>
+#include "ExportBranch.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
+}
+
+// One file an export writes, and how it is encoded
+struct ExportOutput {
+    std::string outputPath;           // The container is picked from the extension (e.g. .mp4, .mkv, .mov)
+    int width = 0;                    // Output size, 0 = the size of the (cropped) composited frame
+    int height = 0;
+    float cropAspect = 0.0f;          // Cut the composited frame to this width / height around its center first (e.g. 9 / 16), 0 = no crop
+    std::string videoCodec = "libx264"; // Encoder name, falls back to the container's default encoder if not available
+    std::string preset = "veryfast";  // Encoder preset (x264/x265 only)
+    int crf = 18;                     // Constant quality (x264/x265 only), used when videoBitrate is 0
+    int64_t videoBitrate = 0;         // Bits per second, 0 = constant quality
+    int64_t audioBitrate = 192000;    // Bits per second
+};
+
+/**
+ * @class EncoderBranch
+ * @brief Scales, encodes and muxes the composited frames and mixed audio of an export into one file, on a thread of its own.
+ */
+class EncoderBranch : public ExportBranch {
+public:
+    EncoderBranch(const ExportOutput& output, const ExportBranchFormat& format);
+    ~EncoderBranch() override;
+
+    // Create the file and its encoders, returns true if successful
+    bool open() override;
+
+    const ExportOutput& getOutput() const;
+
+protected:
+    // Encode one video frame (nullptr flushes the encoder) and write the resulting packets
+    bool writeFrame(const CompositeFrame* composite, Uint32 frameNumber) override;
+
+    // Add samples (nullptr flushes) and encode them in blocks of the encoder's frame size
+    bool writeAudio(const AudioBlock* block) override;
+
+    // Write the trailer of the file
+    bool finishOutput() override;
+    void closeOutput() override;
+
+private:
+
+    bool openVideoEncoder();
+    bool openAudioEncoder();
+    bool encodeAudioFrame(const int16_t* samples, int sampleCount);
+
+    bool writePackets(AVCodecContext* codecContext, AVStream* stream);
+
+private:
+    ExportOutput m_output;
+    SDL_Rect m_crop = { 0, 0, 0, 0 }; // Part of the composited frame that is encoded
+
+    AVFormatContext* m_formatContext = nullptr;
+    AVCodecContext* m_videoCodecContext = nullptr;
+    AVCodecContext* m_audioCodecContext = nullptr;
+    AVStream* m_videoStream = nullptr;
+    AVStream* m_audioStream = nullptr;
+    SwsContext* m_swsContext = nullptr;
+    SwrContext* m_swrContext = nullptr;
+    AVFrame* m_videoFrame = nullptr;
+    AVFrame* m_audioFrame = nullptr;
+    AVPacket* m_packet = nullptr;
+    int m_audioFrameSize = 1024;    // Samples per audio frame, the encoder's frame size
+    std::vector<int16_t> m_pendingSamples; // Audio not encoded yet, less than one audio frame
+    Uint64 m_encodedSamples = 0;
+};
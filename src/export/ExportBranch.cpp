@@ -0,0 +1,83 @@
+#include <chrono>
+#include "ExportBranch.h"
+
+using BranchClock = std::chrono::steady_clock;
+
+static double secondsBetween(BranchClock::time_point start, BranchClock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+ExportBranch::ExportBranch(const std::string& name, const ExportBranchFormat& format)
+    : m_format(format), m_items(16) {
+    m_stats.name = name;
+}
+
+ExportBranch::~ExportBranch() {
+    stopThread();
+}
+
+void ExportBranch::start() {
+    m_thread = std::thread(&ExportBranch::writeLoop, this);
+}
+
+bool ExportBranch::pushFrame(Uint32 frameNumber, std::shared_ptr<const CompositeFrame> composite) {
+    if (m_hasFailed) return false;
+    if (!m_format.hasVideo) return true;
+    return m_items.push({ frameNumber, std::move(composite), nullptr });
+}
+
+bool ExportBranch::pushAudio(std::shared_ptr<const AudioBlock> block) {
+    if (m_hasFailed) return false;
+    if (!m_format.hasAudio) return true;
+    return m_items.push({ 0, nullptr, std::move(block) });
+}
+
+bool ExportBranch::finish() {
+    m_items.close();
+    if (m_thread.joinable()) m_thread.join();
+
+    bool isWritten = !m_hasFailed && finishOutput();
+    closeOutput();
+    return isWritten;
+}
+
+void ExportBranch::cancel() {
+    m_hasFailed = true;
+    m_items.close();
+}
+
+ExportStageStats ExportBranch::getStats() const {
+    return m_stats;
+}
+
+void ExportBranch::stopThread() {
+    if (m_thread.joinable()) {
+        cancel();
+        m_thread.join();
+    }
+}
+
+void ExportBranch::writeLoop() {
+    QueuedItem item;
+    while (!m_hasFailed) {
+        BranchClock::time_point waitStart = BranchClock::now();
+        if (!m_items.pop(item)) break;
+        BranchClock::time_point busyStart = BranchClock::now();
+        m_stats.waitSeconds += secondsBetween(waitStart, busyStart);
+
+        bool isWritten = item.composite ? writeFrame(item.composite.get(), item.frameNumber) : writeAudio(item.audioBlock.get());
+        if (!isWritten) {
+            cancel();
+            return;
+        }
+        if (item.composite) m_stats.itemCount++;
+        item = {}; // Let go of the frame, the other branches may still use it
+        m_stats.busySeconds += secondsBetween(busyStart, BranchClock::now());
+    }
+    if (m_hasFailed) return;
+
+    // Tell the output there is no more
+    if ((m_format.hasVideo && !writeFrame(nullptr, 0)) || (m_format.hasAudio && !writeAudio(nullptr))) {
+        cancel();
+    }
+}
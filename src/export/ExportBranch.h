@@ -0,0 +1,108 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Compositor.h"
+#include "BoundedQueue.h"
+
+// Throughput of one pipeline stage
+struct ExportStageStats {
+    std::string name;
+    Uint64 itemCount = 0;     // Frames (or audio blocks) processed
+    double busySeconds = 0.0; // Time spent working
+    double waitSeconds = 0.0; // Time spent waiting for the stage before or after it
+};
+
+// A block of mixed audio samples
+struct AudioBlock {
+    Uint64 startSample = 0;
+    std::vector<int16_t> samples; // Interleaved
+};
+
+// What every branch of an export gets
+struct ExportBranchFormat {
+    int fps = 60;
+    int frameWidth = 0;       // Size of the composited frames
+    int frameHeight = 0;
+    bool hasVideo = true;     // Whether the branch takes frames / audio, the other is skipped
+    bool hasAudio = false;
+    int sampleRate = 44100;   // Mixed audio, interleaved signed 16-bit
+    int channels = 2;
+    int gopSize = 0;          // Frames from one keyframe to the next, 0 = the encoder's default
+    int encoderThreads = 0;   // Threads of the video encoder, 0 = one per core
+};
+
+/**
+ * @class ExportBranch
+ * @brief Writes the composited frames and mixed audio of an export somewhere, on a thread of its own.
+ *        An export feeds the same frames to every branch: the frames are shared, each branch only reads them,
+ *        and a frame is freed once the last branch is done with it. A branch that is behind makes the export wait (backpressure).
+ */
+class ExportBranch {
+public:
+    ExportBranch(const std::string& name, const ExportBranchFormat& format);
+    virtual ~ExportBranch();
+
+    // Open where the branch writes to, returns true if successful
+    virtual bool open() = 0;
+
+    // Start writing on the branch's thread
+    void start();
+
+    /**
+     * @brief Queue a frame for the branch, waits while the branch is behind.
+     * @param frameNumber The frame counted from the start of the export.
+     * @param composite The frame, kept alive until the branch wrote it.
+     * @return False if the branch failed.
+     */
+    bool pushFrame(Uint32 frameNumber, std::shared_ptr<const CompositeFrame> composite);
+
+    // Queue a block of audio, returns false if the branch failed
+    bool pushAudio(std::shared_ptr<const AudioBlock> block);
+
+    // Write what is queued and finish the output. Returns true if everything was written.
+    bool finish();
+
+    // Stop writing, finish() returns false
+    void cancel();
+
+    // Get the time spent writing and waiting for frames
+    ExportStageStats getStats() const;
+
+protected:
+    // Write a frame / block of audio, nullptr when there is no more. Called on the branch's thread.
+    virtual bool writeFrame(const CompositeFrame* composite, Uint32 frameNumber) = 0;
+    virtual bool writeAudio(const AudioBlock* block) = 0;
+
+    // Complete the output after everything was written, returns true if successful
+    virtual bool finishOutput() = 0;
+
+    // Close the output, also after a failure
+    virtual void closeOutput() = 0;
+
+    // Stop the branch's thread, the destructor of a branch calls it before it closes anything the thread uses
+    void stopThread();
+
+protected:
+    ExportBranchFormat m_format;
+
+private:
+    // A frame or a block of audio, in one queue so the branch writes them in the order the export made them
+    struct QueuedItem {
+        Uint32 frameNumber = 0;
+        std::shared_ptr<const CompositeFrame> composite;
+        std::shared_ptr<const AudioBlock> audioBlock;
+    };
+
+    // Body of the branch's thread
+    void writeLoop();
+
+private:
+    BoundedQueue<QueuedItem> m_items;
+    std::thread m_thread;
+    std::atomic<bool> m_hasFailed = false;
+    ExportStageStats m_stats;
+};
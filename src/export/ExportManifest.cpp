@@ -0,0 +1,155 @@
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "ExportManifest.h"
+#include "RenderCache.h"
+
+static const char* manifestHeader = "RythmGameVideoEditorExport";
+static const int manifestVersion = 1;
+
+static const Uint64 FNV_OFFSET_BASIS = 14695981039346656037ull;
+static const Uint64 FNV_PRIME = 1099511628211ull;
+
+// FNV-1a over raw bytes
+static void hashBytes(Uint64& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+}
+
+template <typename T>
+static void hashValue(Uint64& hash, const T& value) {
+    hashBytes(hash, &value, sizeof(T));
+}
+
+ExportManifest::ExportManifest(const std::filesystem::path& filepath, const std::string& settingsKey)
+    : m_filepath(filepath), m_settingsKey(settingsKey) { }
+
+void ExportManifest::load() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_parts.clear();
+
+    std::ifstream file(m_filepath);
+    if (!file) return; // Nothing finished yet
+
+    std::string header;
+    int version = 0;
+    std::string keyword;
+    std::string settingsKey;
+    if (!(file >> header >> version) || header != manifestHeader || version > manifestVersion
+        || !(file >> keyword >> std::quoted(settingsKey)) || keyword != "settings") {
+        std::cerr << m_filepath.string() << " is not a supported export manifest, every part is exported again" << std::endl;
+        return;
+    }
+    if (settingsKey != m_settingsKey) {
+        std::cout << "The export settings changed since " << m_filepath.string() << " was written, every part is exported again" << std::endl;
+        return;
+    }
+
+    std::string line;
+    std::getline(file, line); // Rest of the settings line
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        CompletedPart part;
+        if (!(fields >> keyword) || keyword != "part") continue;
+        if (fields >> part.startFrame >> part.endFrame >> std::hex >> part.contentHash >> std::dec >> part.fileSize >> std::quoted(part.filename)) {
+            m_parts.push_back(part);
+        }
+    }
+}
+
+bool ExportManifest::isComplete(const std::filesystem::path& partPath, Uint32 startFrame, Uint32 endFrame, Uint64 contentHash) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string filename = partPath.filename().string();
+    for (const CompletedPart& part : m_parts) {
+        if (part.filename != filename || part.startFrame != startFrame || part.endFrame != endFrame || part.contentHash != contentHash) continue;
+
+        std::error_code error;
+        Uint64 fileSize = std::filesystem::file_size(partPath, error);
+        return !error && fileSize == part.fileSize;
+    }
+    return false;
+}
+
+bool ExportManifest::markComplete(const std::filesystem::path& partPath, Uint32 startFrame, Uint32 endFrame, Uint64 contentHash) {
+    std::error_code error;
+    Uint64 fileSize = std::filesystem::file_size(partPath, error);
+    if (error) {
+        std::cerr << "Could not read the size of " << partPath.string() << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string filename = partPath.filename().string();
+    std::erase_if(m_parts, [&filename](const CompletedPart& part) { return part.filename == filename; });
+    m_parts.push_back({ filename, startFrame, endFrame, contentHash, fileSize });
+    return save();
+}
+
+void ExportManifest::remove() {
+    std::error_code error;
+    std::filesystem::remove(m_filepath, error);
+}
+
+Uint64 ExportManifest::computeVideoHash(const TimelineSnapshot& snapshot, Uint32 startFrame, Uint32 endFrame) {
+    // The render cache already hashes everything that contributes to a frame, including the identity of the source files
+    RenderCache& renderCache = RenderCache::shared();
+    Uint64 hash = FNV_OFFSET_BASIS;
+    std::vector<VideoLayerRef> layers; // Reused for every frame
+    for (Uint32 frame = startFrame; frame < endFrame; frame++) {
+        snapshot.getVideoLayers(frame, layers);
+        hashValue(hash, renderCache.computeFrameHash(snapshot, frame, layers));
+    }
+    return hash;
+}
+
+Uint64 ExportManifest::computeAudioHash(const TimelineSnapshot& snapshot, Uint32 startFrame, Uint32 endFrame) {
+    Uint64 hash = FNV_OFFSET_BASIS;
+    hashValue(hash, snapshot.fps);
+    for (const AudioSegment& segment : snapshot.audioSegments) {
+        if (segment.timelinePosition >= endFrame || segment.timelinePosition + segment.timelineDuration <= startFrame) continue;
+
+        // A replaced or re-encoded file changes size or modification time
+        std::string filepath = segment.audioData && segment.audioData->formatContext ? segment.audioData->formatContext->url : "";
+        std::error_code error;
+        hashBytes(hash, filepath.data(), filepath.size());
+        Uint64 size = std::filesystem::file_size(filepath, error);
+        hashValue(hash, error ? 0 : size);
+        auto writeTime = std::filesystem::last_write_time(filepath, error).time_since_epoch().count();
+        hashValue(hash, error ? 0 : writeTime);
+
+        hashValue(hash, segment.timelinePosition);
+        hashValue(hash, segment.timelineDuration);
+        hashValue(hash, segment.sourceStartTime);
+    }
+    return hash;
+}
+
+bool ExportManifest::save() const {
+    std::filesystem::path temporaryPath = m_filepath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath);
+        file << manifestHeader << " " << manifestVersion << "\n";
+        file << "settings " << std::quoted(m_settingsKey) << "\n";
+        for (const CompletedPart& part : m_parts) {
+            file << "part " << part.startFrame << " " << part.endFrame << " " << std::hex << part.contentHash << std::dec << " "
+                << part.fileSize << " " << std::quoted(part.filename) << "\n";
+        }
+        if (!file) {
+            std::cerr << "Could not write " << temporaryPath.string() << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, m_filepath, error);
+    if (error) {
+        std::cerr << "Could not write " << m_filepath.string() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <SDL.h>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Timeline.h"
+
+/**
+ * @class ExportManifest
+ * @brief Remembers which parts of a chunked export were finished, so running the same export again after a failure or
+ *        a cancel skips them and only renders what is missing. Stored as a small text file next to the output:
+ *
+ *        RythmGameVideoEditorExport 1
+ *        settings "<every setting that changes how the parts are encoded>"
+ *        part <startFrame> <endFrame> <content hash> <file size> "<file name>"
+ *
+ *        A part is only reused if the settings are the same, its file is still there with the same size, and the hash of
+ *        everything shown (or heard) in its frames is the same. Editing the timeline only renders the parts it changed again.
+ */
+class ExportManifest {
+public:
+    /**
+     * @param filepath The manifest file.
+     * @param settingsKey Describes every setting that changes how parts are encoded, a manifest with another key is ignored. One line.
+     */
+    ExportManifest(const std::filesystem::path& filepath, const std::string& settingsKey);
+
+    // Read the finished parts, none if the file doesn't exist or was written for other settings
+    void load();
+
+    /**
+     * @brief Whether a part was finished before and can be used as it is.
+     * @param partPath The part's file, next to the manifest.
+     * @param startFrame The part's first timeline frame.
+     * @param endFrame The timeline frame after the part's last one.
+     * @param contentHash The part's hash from computeVideoHash() or computeAudioHash().
+     */
+    bool isComplete(const std::filesystem::path& partPath, Uint32 startFrame, Uint32 endFrame, Uint64 contentHash) const;
+
+    // Add a finished part and write the manifest, safe to call from several threads. Returns true if successful.
+    bool markComplete(const std::filesystem::path& partPath, Uint32 startFrame, Uint32 endFrame, Uint64 contentHash);
+
+    // Delete the manifest file, once the export is done
+    void remove();
+
+    // Hash everything shown in the frames [startFrame, endFrame)
+    static Uint64 computeVideoHash(const TimelineSnapshot& snapshot, Uint32 startFrame, Uint32 endFrame);
+
+    // Hash every audio segment heard in the frames [startFrame, endFrame) and where it plays
+    static Uint64 computeAudioHash(const TimelineSnapshot& snapshot, Uint32 startFrame, Uint32 endFrame);
+
+private:
+    struct CompletedPart {
+        std::string filename;
+        Uint32 startFrame = 0;
+        Uint32 endFrame = 0;
+        Uint64 contentHash = 0;
+        Uint64 fileSize = 0; // A part cut short by a crash has another size
+    };
+
+    // Write every finished part, replacing the file at once so a crash while writing leaves the old manifest
+    bool save() const;
+
+private:
+    std::filesystem::path m_filepath;
+    std::string m_settingsKey;
+    std::vector<CompletedPart> m_parts;
+    mutable std::mutex m_mutex; // Guards m_parts, parts finish on different threads
+};
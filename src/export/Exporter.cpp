@@ -0,0 +1,694 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "Exporter.h"
+#include "AudioMixer.h"
+#include "RenderCache.h"
+#include "Remuxer.h"
+#include "PacketIndex.h"
+#include "ExportManifest.h"
+
+using ExportClock = std::chrono::steady_clock;
+
+static double secondsBetween(ExportClock::time_point start, ExportClock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+Exporter::Exporter(std::shared_ptr<const TimelineSnapshot> snapshot, const ExportSettings& settings)
+    : m_snapshot(std::move(snapshot)), m_settings(settings), m_decodedFrames(8), m_compositedFrames(8), m_audioBlocks(64) {
+    m_endFrame = m_settings.endFrame != 0 ? m_settings.endFrame : m_snapshot->getEndFrame();
+    m_hasVideo = m_settings.includeVideo;
+    m_hasAudio = m_settings.includeAudio && !m_snapshot->audioSegments.empty();
+    if (m_settings.width <= 0 || m_settings.height <= 0) {
+        m_settings.width = m_snapshot->outputWidth;
+        m_settings.height = m_snapshot->outputHeight;
+    }
+
+    // 4:2:0 chroma needs an even size
+    m_settings.width &= ~1;
+    m_settings.height &= ~1;
+
+    m_stageStats = { { "decode" }, { "composite" }, { "audio mixdown" }, { "fan-out" } };
+}
+
+Exporter::~Exporter() { }
+
+bool Exporter::run() {
+    if (m_endFrame <= m_settings.startFrame || (!m_hasVideo && !m_hasAudio)) {
+        std::cerr << "Nothing to export" << std::endl;
+        return false;
+    }
+
+    // Export in parts that are joined afterwards: stream copied source ranges and the frames around them, or chunks encoded at the same time.
+    // Parts are joined into one file, with more output files every frame is encoded once per file instead.
+    // Served frames are streamed in order as they are composited, so they can't be exported in parts either.
+    bool hasExtraOutputs = !m_settings.extraOutputs.empty() || !m_settings.serveVideoTo.empty() || !m_settings.serveAudioTo.empty() || m_settings.outputPath.empty();
+    bool isChunked = m_settings.chunkCount > 1 || m_settings.resumable;
+    if (hasExtraOutputs && (m_settings.smartRender || isChunked)) {
+        std::cerr << "Exporting to more than one output, chunks and smart rendering are not used" << std::endl;
+    }
+    if (m_hasVideo && !hasExtraOutputs && (m_settings.smartRender || isChunked)) {
+        ExportClock::time_point exportStart = ExportClock::now();
+        std::vector<ExportPart> parts;
+        if (m_settings.smartRender) parts = planSmartRender();
+        if (parts.empty() && isChunked) parts = planChunks();
+        if (parts.size() > 1 || (parts.size() == 1 && !parts[0].sourcePath.empty())) {
+            bool isWritten = runParts(parts);
+            m_exportSeconds = secondsBetween(exportStart, ExportClock::now());
+            return isWritten;
+        }
+    }
+    if (!openOutputs()) {
+        std::lock_guard<std::mutex> lock(m_chunkMutex);
+        m_branches.clear();
+        return false;
+    }
+
+    ExportClock::time_point exportStart = ExportClock::now();
+    std::thread decodeThread;
+    std::thread compositeThread;
+    std::thread audioThread;
+    if (m_hasVideo) {
+        decodeThread = std::thread(&Exporter::decodeStage, this);
+        compositeThread = std::thread(&Exporter::compositeStage, this);
+    }
+    else {
+        m_compositedFrames.close(); // Audio only, the encode stage doesn't wait for frames
+    }
+    if (m_hasAudio) audioThread = std::thread(&Exporter::audioStage, this);
+    for (std::unique_ptr<ExportBranch>& branch : m_branches) {
+        branch->start();
+    }
+
+    encodeStage();
+
+    // The encode stage stopped early on an error, unblock the other stages
+    if (m_hasFailed) fail();
+    if (decodeThread.joinable()) decodeThread.join();
+    if (compositeThread.joinable()) compositeThread.join();
+    if (audioThread.joinable()) audioThread.join();
+
+    // Let every branch encode what it has queued and finish its file
+    bool isWritten = !m_hasFailed;
+    for (std::unique_ptr<ExportBranch>& branch : m_branches) {
+        if (!branch->finish()) isWritten = false;
+        m_stageStats.push_back(branch->getStats());
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_chunkMutex);
+        m_branches.clear();
+    }
+    m_exportSeconds = secondsBetween(exportStart, ExportClock::now());
+    return isWritten && !m_hasFailed;
+}
+
+void Exporter::cancel() {
+    fail();
+}
+
+float Exporter::getProgress() const {
+    Uint32 frameCount = m_endFrame > m_settings.startFrame ? m_endFrame - m_settings.startFrame : 0;
+    if (frameCount == 0) return 1.0f;
+
+    // Running chunked, the frames are encoded by the exporters of the video chunks
+    std::lock_guard<std::mutex> lock(m_chunkMutex);
+    if (!m_chunkExporters.empty()) {
+        Uint32 encodedFrames = m_resumedFrames;
+        for (const std::unique_ptr<Exporter>& exporter : m_chunkExporters) {
+            if (exporter->m_hasVideo) encodedFrames += exporter->m_encodedFrames;
+        }
+        return static_cast<float>(encodedFrames) / frameCount;
+    }
+    return static_cast<float>(m_encodedFrames) / frameCount;
+}
+
+const std::vector<ExportStageStats>& Exporter::getStageStats() const {
+    return m_stageStats;
+}
+
+void Exporter::printStageStats() const {
+    for (const ExportStageStats& stats : m_stageStats) {
+        if (stats.itemCount == 0) continue;
+        double perSecond = stats.busySeconds > 0.0 ? stats.itemCount / stats.busySeconds : 0.0;
+        std::cout << "Export stage " << stats.name << ": " << stats.itemCount << " items, " << perSecond << " per second while busy, "
+            << stats.busySeconds << " s busy, " << stats.waitSeconds << " s waiting" << std::endl;
+    }
+
+    // Faster than real time above 1
+    double duration = static_cast<double>(m_encodedFrames) / m_snapshot->fps;
+    double speed = m_exportSeconds > 0.0 ? duration / m_exportSeconds : 0.0;
+    std::cout << "Exported " << m_encodedFrames << " frames in " << m_exportSeconds << " s (" << speed << "x real time)" << std::endl;
+}
+
+bool Exporter::JobFrameProvider::getSegmentFrame(const VideoSegment& segment, Uint32 /*frameInSegment*/, LayerFrame& frame) {
+    auto it = m_job.segmentFrames.find(segment.segmentID);
+    if (it == m_job.segmentFrames.end()) return false;
+
+    frame.data = it->second->pixels.data();
+    frame.linesize = it->second->linesize;
+    frame.width = it->second->width;
+    frame.height = it->second->height;
+    return true;
+}
+
+bool Exporter::openOutputs() {
+    ExportBranchFormat format;
+    format.fps = m_snapshot->fps;
+    format.frameWidth = m_snapshot->outputWidth;
+    format.frameHeight = m_snapshot->outputHeight;
+    format.hasVideo = m_hasVideo;
+    format.hasAudio = m_hasAudio;
+    format.sampleRate = m_settings.sampleRate;
+    format.channels = m_settings.channels;
+    format.gopSize = m_settings.gopSize;
+    format.encoderThreads = m_settings.encoderThreads;
+
+    // The encoders share the cores when there is more than one
+    std::vector<ExportOutput> outputs;
+    if (!m_settings.outputPath.empty()) outputs.push_back(getPrimaryOutput());
+    outputs.insert(outputs.end(), m_settings.extraOutputs.begin(), m_settings.extraOutputs.end());
+    if (format.encoderThreads == 0 && outputs.size() > 1) {
+        format.encoderThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency() / outputs.size()));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_chunkMutex);
+        for (const ExportOutput& output : outputs) {
+            m_branches.push_back(std::make_unique<EncoderBranch>(output, format));
+        }
+        if (!m_settings.serveVideoTo.empty() && m_hasVideo) {
+            m_branches.push_back(std::make_unique<FrameServer>(m_settings.serveVideoTo, m_settings.serveVideoFormat, format));
+        }
+        if (!m_settings.serveAudioTo.empty() && m_hasAudio) {
+            m_branches.push_back(std::make_unique<FrameServer>(m_settings.serveAudioTo, FrameServerFormat::WAV, format));
+        }
+    }
+    if (m_branches.empty()) {
+        std::cerr << "No output to export to" << std::endl;
+        return false;
+    }
+    for (std::unique_ptr<ExportBranch>& branch : m_branches) {
+        if (!branch->open()) return false;
+    }
+    return true;
+}
+
+ExportOutput Exporter::getPrimaryOutput() const {
+    ExportOutput output;
+    output.outputPath = m_settings.outputPath;
+    output.width = m_settings.width;
+    output.height = m_settings.height;
+    output.videoCodec = m_settings.videoCodec;
+    output.preset = m_settings.preset;
+    output.crf = m_settings.crf;
+    output.videoBitrate = m_settings.videoBitrate;
+    output.audioBitrate = m_settings.audioBitrate;
+    return output;
+}
+
+void Exporter::decodeStage() {
+    ExportStageStats& stats = m_stageStats[0];
+    std::unordered_map<Uint32, DecoderLease> decoders; // Keyed by segmentID
+    RenderCache& renderCache = RenderCache::shared();
+
+    for (Uint32 frame = m_settings.startFrame; frame < m_endFrame && !m_hasFailed; frame++) {
+        ExportClock::time_point busyStart = ExportClock::now();
+        auto job = std::make_shared<FrameJob>();
+        job->frame = frame;
+        m_snapshot->getVideoLayers(frame, job->layers);
+
+        // Frames the preview already composited are read from the render cache
+        if (m_settings.useRenderCache && RenderCache::isWorthCaching(job->layers)) {
+            job->isComposited = renderCache.load(renderCache.computeFrameHash(*m_snapshot, frame, job->layers), job->composite);
+        }
+
+        if (!job->isComposited) {
+            // A segment that can't be decoded fails the export, instead of writing a frame with a stale or missing layer
+            bool isDecoded = true;
+            for (const VideoLayerRef& layer : job->layers) {
+                isDecoded = isDecoded && decodeSegmentFrame(*layer.segment, job, decoders);
+                if (layer.incoming) isDecoded = isDecoded && decodeSegmentFrame(*layer.incoming, job, decoders);
+            }
+            if (!isDecoded) {
+                fail();
+                break;
+            }
+
+            // Return the decoders of segments that ended to the pool
+            std::erase_if(decoders, [&job](const auto& entry) { return !job->segmentFrames.count(entry.first); });
+        }
+
+        ExportClock::time_point busyEnd = ExportClock::now();
+        stats.busySeconds += secondsBetween(busyStart, busyEnd);
+        stats.itemCount++;
+
+        bool isPushed = m_decodedFrames.push(job);
+        stats.waitSeconds += secondsBetween(busyEnd, ExportClock::now());
+        if (!isPushed) break;
+    }
+    m_decodedFrames.close();
+}
+
+bool Exporter::decodeSegmentFrame(const VideoSegment& segment, const std::shared_ptr<FrameJob>& job, std::unordered_map<Uint32, DecoderLease>& decoders) {
+    if (!segment.videoData || !segment.videoData->formatContext) {
+        std::cerr << "Invalid video segment" << std::endl;
+        return false;
+    }
+    const char* filepath = segment.videoData->formatContext->url;
+    Uint32 sourceFrame = segment.getSourceFrame(job->frame);
+
+    // Frames the preview decoded are still in the frame cache
+    std::shared_ptr<const CachedFrame> cachedFrame = FrameCache::shared().get(filepath, sourceFrame, m_snapshot->fps);
+    if (cachedFrame) {
+        job->segmentFrames[segment.segmentID] = cachedFrame;
+        return true;
+    }
+
+    DecoderLease& decoder = decoders[segment.segmentID];
+    if (!decoder) {
+        decoder = DecoderPool::shared().acquire(filepath, segment.segmentID, sourceFrame);
+        if (!decoder) return false;
+    }
+
+    // Decode forward like playback does, exporting never jumps
+    if (!decoder->getVideoFrame(sourceFrame, m_snapshot->fps, true)) {
+        std::cerr << "Failed to decode frame " << sourceFrame << " of: " << filepath << std::endl;
+        return false;
+    }
+    const AVFrame* rgbFrame = decoder->getRGBFrame();
+    if (!rgbFrame) return false;
+
+    // Copy the frame, the decoder overwrites it with the next one while this one waits in the queue
+    auto image = std::make_shared<CachedFrame>();
+    image->width = decoder->getWidth();
+    image->height = decoder->getHeight();
+    image->linesize = image->width * 3;
+    image->pixels.resize(static_cast<size_t>(image->linesize) * image->height);
+    for (int y = 0; y < image->height; y++) {
+        memcpy(image->pixels.data() + static_cast<size_t>(y) * image->linesize, rgbFrame->data[0] + static_cast<size_t>(y) * rgbFrame->linesize[0], image->linesize);
+    }
+    job->segmentFrames[segment.segmentID] = image;
+    return true;
+}
+
+void Exporter::compositeStage() {
+    ExportStageStats& stats = m_stageStats[1];
+    Compositor compositor;
+    std::shared_ptr<FrameJob> job;
+
+    while (true) {
+        ExportClock::time_point waitStart = ExportClock::now();
+        if (!m_decodedFrames.pop(job)) break;
+        ExportClock::time_point busyStart = ExportClock::now();
+        stats.waitSeconds += secondsBetween(waitStart, busyStart);
+
+        if (!job->isComposited) {
+            JobFrameProvider provider(*job);
+            compositor.composite(*m_snapshot, job->frame, job->layers, provider, job->composite);
+            job->segmentFrames.clear();
+        }
+
+        ExportClock::time_point busyEnd = ExportClock::now();
+        stats.busySeconds += secondsBetween(busyStart, busyEnd);
+        stats.itemCount++;
+
+        bool isPushed = m_compositedFrames.push(job);
+        stats.waitSeconds += secondsBetween(busyEnd, ExportClock::now());
+        if (!isPushed) break;
+    }
+    m_compositedFrames.close();
+}
+
+void Exporter::audioStage() {
+    ExportStageStats& stats = m_stageStats[2];
+    AudioMixer mixer(m_snapshot, m_settings.sampleRate, m_settings.channels);
+    Uint64 fps = m_snapshot->fps;
+    Uint64 startSample = static_cast<Uint64>(m_settings.startFrame) * m_settings.sampleRate / fps;
+    Uint64 endSample = static_cast<Uint64>(m_endFrame) * m_settings.sampleRate / fps;
+
+    for (Uint64 sample = startSample; sample < endSample && !m_hasFailed; sample += m_audioBlockSize) {
+        ExportClock::time_point busyStart = ExportClock::now();
+        auto block = std::make_shared<AudioBlock>();
+        block->startSample = sample - startSample;
+        mixer.mix(sample, static_cast<int>(std::min<Uint64>(m_audioBlockSize, endSample - sample)), block->samples);
+
+        ExportClock::time_point busyEnd = ExportClock::now();
+        stats.busySeconds += secondsBetween(busyStart, busyEnd);
+        stats.itemCount++;
+
+        bool isPushed = m_audioBlocks.push(block);
+        stats.waitSeconds += secondsBetween(busyEnd, ExportClock::now());
+        if (!isPushed) break;
+    }
+    m_audioBlocks.close();
+}
+
+void Exporter::encodeStage() {
+    ExportStageStats& stats = m_stageStats[3];
+    Uint64 encodedSamples = 0;
+    bool isAudioDone = !m_hasAudio;
+    std::shared_ptr<FrameJob> job;
+    std::shared_ptr<AudioBlock> block;
+
+    // Take the next audio block, keeping track of the time spent waiting for it
+    auto popAudioBlock = [this, &stats, &block, &isAudioDone]() {
+        ExportClock::time_point waitStart = ExportClock::now();
+        if (!m_audioBlocks.pop(block)) isAudioDone = true;
+        stats.waitSeconds += secondsBetween(waitStart, ExportClock::now());
+        return !isAudioDone;
+    };
+
+    // Hand an audio block to every branch, they all get the same one
+    auto pushAudioBlock = [this, &stats, &block, &encodedSamples]() {
+        ExportClock::time_point pushStart = ExportClock::now();
+        std::shared_ptr<const AudioBlock> sharedBlock = block;
+        for (std::unique_ptr<ExportBranch>& branch : m_branches) {
+            if (!branch->pushAudio(sharedBlock)) return false;
+        }
+        encodedSamples += block->samples.size() / m_settings.channels;
+        stats.waitSeconds += secondsBetween(pushStart, ExportClock::now());
+        return true;
+    };
+
+    while (!m_hasFailed) {
+        ExportClock::time_point waitStart = ExportClock::now();
+        if (!m_compositedFrames.pop(job)) break;
+        ExportClock::time_point pushStart = ExportClock::now();
+        stats.waitSeconds += secondsBetween(waitStart, pushStart);
+
+        // Every branch gets the same frame, which lives as long as the job. Waiting here means a branch is behind.
+        Uint32 frameNumber = job->frame - m_settings.startFrame;
+        std::shared_ptr<const CompositeFrame> composite(job, &job->composite);
+        job = nullptr;
+        for (std::unique_ptr<ExportBranch>& branch : m_branches) {
+            if (!branch->pushFrame(frameNumber, composite)) {
+                fail();
+                return;
+            }
+        }
+        stats.waitSeconds += secondsBetween(pushStart, ExportClock::now());
+        stats.itemCount++;
+        m_encodedFrames++;
+
+        // Keep the audio up with the video, so the muxers can interleave the streams without buffering
+        Uint64 audioTarget = static_cast<Uint64>(frameNumber + 1) * m_settings.sampleRate / m_snapshot->fps;
+        while (!isAudioDone && encodedSamples < audioTarget && popAudioBlock()) {
+            if (!pushAudioBlock()) {
+                fail();
+                return;
+            }
+        }
+    }
+    if (m_hasFailed) return;
+
+    // The audio left after the last video frame (or all audio if there is no video)
+    while (!isAudioDone && popAudioBlock()) {
+        if (!pushAudioBlock()) {
+            fail();
+            return;
+        }
+        if (!m_hasVideo) m_encodedFrames = static_cast<Uint32>(encodedSamples * m_snapshot->fps / m_settings.sampleRate);
+    }
+}
+
+void Exporter::fail() {
+    m_hasFailed = true;
+    m_decodedFrames.close();
+    m_compositedFrames.close();
+    m_audioBlocks.close();
+
+    std::lock_guard<std::mutex> lock(m_chunkMutex);
+    for (std::unique_ptr<Exporter>& exporter : m_chunkExporters) {
+        exporter->cancel();
+    }
+    for (std::unique_ptr<ExportBranch>& branch : m_branches) {
+        branch->cancel();
+    }
+}
+
+std::vector<Exporter::ExportPart> Exporter::planChunks() const {
+    // Chunks start on a GOP boundary, so every chunk's GOPs are the GOPs a single encoder would have made
+    Uint32 gopSize = getGopSize();
+    Uint32 frameCount = m_endFrame - m_settings.startFrame;
+    Uint32 gopCount = (frameCount + gopSize - 1) / gopSize;
+    Uint32 chunkCount = std::min<Uint32>(m_settings.chunkCount, gopCount);
+
+    // A chunk that didn't finish is exported again, so a resumable export keeps them short
+    if (m_settings.resumable) {
+        Uint32 gopsPerCheckpoint = std::max<Uint32>(1, static_cast<Uint32>(m_settings.checkpointSeconds) * m_snapshot->fps / gopSize);
+        chunkCount = std::max(chunkCount, (gopCount + gopsPerCheckpoint - 1) / gopsPerCheckpoint);
+    }
+
+    std::vector<ExportPart> parts;
+    for (Uint32 i = 0; i < chunkCount; i++) {
+        ExportPart part;
+        part.startFrame = m_settings.startFrame + static_cast<Uint32>(static_cast<Uint64>(gopCount) * i / chunkCount) * gopSize;
+        part.endFrame = std::min(m_endFrame, m_settings.startFrame + static_cast<Uint32>(static_cast<Uint64>(gopCount) * (i + 1) / chunkCount) * gopSize);
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+std::vector<Exporter::ExportPart> Exporter::planSmartRender() const {
+    std::vector<ExportPart> parts;
+
+    // Stream copied packets have to fit in the stream the encoder makes. Only H.264 is joined with other H.264 streams.
+    const AVCodec* encoder = avcodec_find_encoder_by_name(m_settings.videoCodec.c_str());
+    if (!encoder || encoder->id != AV_CODEC_ID_H264) return parts;
+
+    // Whether a segment's source is encoded like the output, so its packets can be copied as they are
+    std::unordered_map<Uint32, std::shared_ptr<const PacketIndex>> sources; // Keyed by segmentID, nullptr if it can't be copied
+    auto getCopyableSource = [this, &sources](const VideoSegment& segment) {
+        auto it = sources.find(segment.segmentID);
+        if (it != sources.end()) return it->second;
+
+        std::shared_ptr<const PacketIndex> index;
+        const SegmentTransform& transform = segment.transform;
+        bool isUntouched = transform.positionX == 0.0f && transform.positionY == 0.0f && transform.scale == 1.0f && transform.opacity == 1.0f
+            && transform.cropLeft == 0.0f && transform.cropTop == 0.0f && transform.cropRight == 0.0f && transform.cropBottom == 0.0f;
+        if (isUntouched && segment.videoData && segment.videoData->formatContext) {
+            index = PacketIndex::get(segment.videoData->formatContext->url);
+        }
+        if (index) {
+            const AVCodecParameters* parameters = index->getCodecParameters();
+            bool isMatching = parameters->codec_id == AV_CODEC_ID_H264 && parameters->format == AV_PIX_FMT_YUV420P
+                && parameters->width == m_settings.width && parameters->height == m_settings.height
+                && parameters->extradata_size > 4 && parameters->extradata[0] == 1 && (parameters->extradata[4] & 3) == 3 // avcC with 4 byte NAL sizes, as mp4, mov and mkv store it
+                && index->isConstantFrameRate() && av_cmp_q(index->getFrameRate(), { m_snapshot->fps, 1 }) == 0;
+            if (!isMatching) index = nullptr;
+        }
+        sources[segment.segmentID] = index;
+        return index;
+    };
+
+    // Find the runs of frames that show a single untouched segment whose source can be copied
+    Uint32 minimumCopyFrames = static_cast<Uint32>(m_snapshot->fps); // Shorter copies are not worth the cut
+    Uint32 reencodeStart = m_settings.startFrame;
+    Uint32 frame = m_settings.startFrame;
+    std::vector<VideoLayerRef> layers;
+    std::vector<VideoLayerRef> nextLayers;
+    while (frame < m_endFrame) {
+        m_snapshot->getVideoLayers(frame, layers);
+        std::shared_ptr<const PacketIndex> source;
+        if (layers.size() == 1 && !layers[0].incoming) source = getCopyableSource(*layers[0].segment);
+        if (!source) {
+            frame++;
+            continue;
+        }
+
+        // The run ends where the segment ends or something else becomes visible
+        const VideoSegment& segment = *layers[0].segment;
+        Uint32 runEnd = frame + 1;
+        Uint32 segmentEnd = std::min(m_endFrame, segment.timelinePosition + segment.timelineDuration);
+        while (runEnd < segmentEnd) {
+            m_snapshot->getVideoLayers(runEnd, nextLayers);
+            if (nextLayers.size() != 1 || nextLayers[0].incoming || nextLayers[0].segment->segmentID != segment.segmentID) break;
+            runEnd++;
+        }
+
+        // Copy whole GOPs only, the frames before the first and after the last keyframe in the run are re-encoded
+        Uint32 sourceFrame = segment.getSourceFrame(frame);
+        Uint32 sourceEnd = std::min(sourceFrame + (runEnd - frame), source->getFrameCount());
+        Uint32 firstKeyframe = source->getKeyframeAtOrAfter(sourceFrame);
+        Uint32 lastKeyframe = source->getKeyframeAtOrBefore(sourceEnd);
+        if (firstKeyframe != UINT32_MAX && lastKeyframe != UINT32_MAX && lastKeyframe >= firstKeyframe + minimumCopyFrames) {
+            ExportPart copy;
+            copy.startFrame = frame + (firstKeyframe - sourceFrame);
+            copy.endFrame = frame + (lastKeyframe - sourceFrame);
+            copy.sourcePath = segment.videoData->formatContext->url;
+            copy.sourceStart = source->getTimestamp(firstKeyframe);
+            copy.sourceEnd = source->getTimestamp(lastKeyframe);
+
+            if (copy.startFrame > reencodeStart) parts.push_back({ .startFrame = reencodeStart, .endFrame = copy.startFrame, .sourcePath = {}, .sourceStart = 0, .sourceEnd = 0 });
+            parts.push_back(copy);
+            reencodeStart = copy.endFrame;
+        }
+        frame = runEnd;
+    }
+
+    // Nothing to copy, a single encoder does the same without the joins
+    if (parts.empty()) return parts;
+    if (m_endFrame > reencodeStart) parts.push_back({ .startFrame = reencodeStart, .endFrame = m_endFrame, .sourcePath = {}, .sourceStart = 0, .sourceEnd = 0 });
+    return parts;
+}
+
+Uint32 Exporter::getGopSize() const {
+    return m_settings.gopSize > 0 ? m_settings.gopSize : m_snapshot->fps * 2;
+}
+
+std::string Exporter::getPartSettingsKey() const {
+    // The frames themselves are covered by the hash of every part
+    std::ostringstream key;
+    key << m_settings.width << "x" << m_settings.height << " " << m_snapshot->fps << "fps " << m_settings.videoCodec << " " << m_settings.preset
+        << " crf " << m_settings.crf << " video " << m_settings.videoBitrate << " audio " << m_settings.audioBitrate
+        << " " << m_settings.sampleRate << "Hz " << m_settings.channels << "ch gop " << getGopSize();
+    return key.str();
+}
+
+bool Exporter::runParts(const std::vector<ExportPart>& parts) {
+    // Every worker gets an equal share of the cores, as one encoder per core would fight over them. The audio gets a worker of its own.
+    int workerCount = std::max(1, m_settings.chunkCount) + (m_hasAudio ? 1 : 0);
+    int threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    ExportSettings partSettings = m_settings;
+    partSettings.chunkCount = 1;
+    partSettings.smartRender = false;
+    partSettings.gopSize = getGopSize();
+    partSettings.encoderThreads = std::max(1, threadCount / workerCount);
+
+    // The parts are written next to the output file, and deleted once joined. Their names follow their frames, so a resumed export finds them again.
+    std::filesystem::path outputPath = m_settings.outputPath;
+    auto getTemporaryPath = [&outputPath](const std::string& name) {
+        std::filesystem::path path = outputPath;
+        return path.replace_filename(outputPath.stem().string() + "." + name + outputPath.extension().string()).string();
+    };
+
+    // Parts finished by an earlier run of a resumable export are used as they are
+    std::filesystem::path manifestPath = outputPath;
+    manifestPath += ".export";
+    ExportManifest manifest(manifestPath, getPartSettingsKey());
+    if (m_settings.resumable) manifest.load();
+
+    std::vector<RemuxPart> remuxParts;
+    std::vector<std::string> temporaryPaths;
+    std::vector<Uint64> partHashes; // Content hash of the part of every exporter, to note it in the manifest
+    std::string audioPath;
+    Uint32 copiedFrames = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_chunkMutex);
+        m_resumedFrames = 0;
+
+        // The audio is encoded once for the whole range, joining audio parts would click at every join. It goes first, it takes the longest.
+        if (m_hasAudio) {
+            audioPath = getTemporaryPath("audio");
+            temporaryPaths.push_back(audioPath);
+            Uint64 hash = m_settings.resumable ? ExportManifest::computeAudioHash(*m_snapshot, m_settings.startFrame, m_endFrame) : 0;
+            if (!m_settings.resumable || !manifest.isComplete(audioPath, m_settings.startFrame, m_endFrame, hash)) {
+                ExportSettings settings = partSettings;
+                settings.includeVideo = false;
+                settings.outputPath = audioPath;
+                m_chunkExporters.push_back(std::make_unique<Exporter>(m_snapshot, settings));
+                partHashes.push_back(hash);
+            }
+        }
+
+        for (const ExportPart& part : parts) {
+            RemuxPart remuxPart;
+            remuxPart.startTime = part.startFrame - m_settings.startFrame;
+            if (!part.sourcePath.empty()) {
+                remuxPart.filepath = part.sourcePath;
+                remuxPart.sourceStart = part.sourceStart;
+                remuxPart.sourceEnd = part.sourceEnd;
+                copiedFrames += part.endFrame - part.startFrame;
+            }
+            else {
+                remuxPart.filepath = getTemporaryPath("part" + std::to_string(part.startFrame) + "-" + std::to_string(part.endFrame));
+                temporaryPaths.push_back(remuxPart.filepath);
+                Uint64 hash = m_settings.resumable ? ExportManifest::computeVideoHash(*m_snapshot, part.startFrame, part.endFrame) : 0;
+                if (m_settings.resumable && manifest.isComplete(remuxPart.filepath, part.startFrame, part.endFrame, hash)) {
+                    m_resumedFrames += part.endFrame - part.startFrame;
+                }
+                else {
+                    ExportSettings settings = partSettings;
+                    settings.includeAudio = false;
+                    settings.startFrame = part.startFrame;
+                    settings.endFrame = part.endFrame;
+                    settings.outputPath = remuxPart.filepath;
+                    m_chunkExporters.push_back(std::make_unique<Exporter>(m_snapshot, settings));
+                    partHashes.push_back(hash);
+                }
+            }
+            remuxParts.push_back(remuxPart);
+        }
+    }
+    if (m_resumedFrames > 0) {
+        std::cout << "Resuming the export, " << m_resumedFrames << " frames were exported before" << std::endl;
+    }
+
+    // Cancelling while the parts were set up
+    if (m_hasFailed) fail();
+
+    // Workers take the next part until none are left. A resumable export notes every finished part right away.
+    std::atomic<size_t> nextPart = 0;
+    std::atomic<bool> hasPartFailed = false;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::min<int>(workerCount, static_cast<int>(m_chunkExporters.size())); i++) {
+        workers.emplace_back([this, &nextPart, &hasPartFailed, &manifest, &partHashes]() {
+            for (size_t part = nextPart++; part < m_chunkExporters.size() && !m_hasFailed; part = nextPart++) {
+                Exporter& exporter = *m_chunkExporters[part];
+                if (!exporter.run()) hasPartFailed = true;
+                else if (m_settings.resumable) {
+                    Uint32 startFrame = exporter.m_hasVideo ? exporter.m_settings.startFrame : m_settings.startFrame;
+                    Uint32 endFrame = exporter.m_hasVideo ? exporter.m_settings.endFrame : m_endFrame;
+                    manifest.markComplete(exporter.m_settings.outputPath, startFrame, endFrame, partHashes[part]);
+                }
+            }
+            });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    bool isWritten = !m_hasFailed && !hasPartFailed;
+    ExportStageStats joinStats = { "stream copy" };
+    ExportClock::time_point joinStart = ExportClock::now();
+    if (isWritten) {
+        isWritten = Remuxer::concatenate(remuxParts, { 1, m_snapshot->fps }, audioPath, m_settings.outputPath);
+        joinStats.itemCount = remuxParts.size();
+    }
+    joinStats.busySeconds = secondsBetween(joinStart, ExportClock::now());
+    if (isWritten) m_encodedFrames += copiedFrames + m_resumedFrames;
+
+    // Add up the stages of all parts, they ran at the same time so the busy time is the time of all threads together.
+    // The pipeline stages come first, then the encoder of every part's file.
+    size_t pipelineStageCount = m_stageStats.size();
+    ExportStageStats encodeStats = { "encode" };
+    std::lock_guard<std::mutex> lock(m_chunkMutex);
+    for (const std::unique_ptr<Exporter>& exporter : m_chunkExporters) {
+        for (size_t stage = 0; stage < exporter->m_stageStats.size(); stage++) {
+            ExportStageStats& total = stage < pipelineStageCount ? m_stageStats[stage] : encodeStats;
+            total.itemCount += exporter->m_stageStats[stage].itemCount;
+            total.busySeconds += exporter->m_stageStats[stage].busySeconds;
+            total.waitSeconds += exporter->m_stageStats[stage].waitSeconds;
+        }
+        if (exporter->m_hasVideo) m_encodedFrames += exporter->m_encodedFrames;
+    }
+    m_stageStats.push_back(encodeStats);
+    m_stageStats.push_back(joinStats);
+    m_chunkExporters.clear();
+    m_resumedFrames = 0;
+
+    // The finished parts of a resumable export that failed stay for the next run
+    if (!isWritten && m_settings.resumable) {
+        std::cerr << "The finished parts are kept next to the output, run the same export again to resume it" << std::endl;
+        return false;
+    }
+    for (const std::string& path : temporaryPaths) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+    manifest.remove();
+    return isWritten;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <SDL.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Timeline.h"
+#include "Compositor.h"
+#include "FrameCache.h"
+#include "DecoderPool.h"
+#include "BoundedQueue.h"
+#include "EncoderBranch.h"
+#include "FrameServer.h"
+
+// What and how to export
+struct ExportSettings {
+    std::string outputPath;           // The container is picked from the extension (e.g. .mp4, .mkv, .mov), empty = only serve the frames
+    int width = 0;                    // Output size, 0 = the timeline's output size
+    int height = 0;
+    std::string videoCodec = "libx264"; // Encoder name, falls back to the container's default encoder if not available
+    std::string preset = "veryfast";  // Encoder preset (x264/x265 only)
+    int crf = 18;                     // Constant quality (x264/x265 only), used when videoBitrate is 0
+    int64_t videoBitrate = 0;         // Bits per second, 0 = constant quality
+    int64_t audioBitrate = 192000;    // Bits per second
+    int sampleRate = 44100;
+    int channels = 2;
+    Uint32 startFrame = 0;            // First timeline frame to export
+    Uint32 endFrame = 0;              // Timeline frame after the last one to export, 0 = the end of the timeline
+    bool useRenderCache = true;       // Use frames of the RenderCache instead of compositing them again
+    int gopSize = 0;                  // Frames from one keyframe to the next, 0 = the encoder's default. GOPs are always closed.
+    int encoderThreads = 0;           // Threads of the video encoder, 0 = one per core
+    int chunkCount = 1;               // Time chunks rendered and encoded at the same time by their own encoder, then joined by a stream copy
+    bool smartRender = false;         // Stream copy the GOPs of segments shown as they are, only encode the frames around them
+    bool resumable = false;           // Keep finished chunks and a manifest next to the output until the file is joined, running the same export again skips them
+    int checkpointSeconds = 60;       // Longest chunk of a resumable export, the most work lost when it fails
+    bool includeVideo = true;         // Leave the video or audio stream out of the file
+    bool includeAudio = true;
+    std::vector<ExportOutput> extraOutputs; // More files (e.g. other sizes or a 9:16 crop) encoded from the same composited frames and audio
+    std::string serveVideoTo;         // Also stream the composited frames uncompressed to another program, see FrameServer for the targets. Empty = don't
+    FrameServerFormat serveVideoFormat = FrameServerFormat::Y4M;
+    std::string serveAudioTo;         // Also stream the mixed audio as WAV, empty = don't
+};
+
+/**
+ * @class Exporter
+ * @brief Renders a timeline snapshot to a video file, frame by frame at the timeline's fps, without any window.
+ *        Runs as a pipeline of stages on their own threads, connected by bounded queues:
+ *        decode (segment frames) -> composite -> encode, with the audio mixdown feeding the encode stage next to it.
+ *        The encode stage runs on the thread that calls run() and hands every frame and audio block to an EncoderBranch per output file,
+ *        which scale, encode and mux at the same time, and to a FrameServer per served stream. The frames are shared by the branches, not copied.
+ *
+ *        With more than one chunk, the frames are split into chunks that start on a GOP boundary, and every chunk is exported
+ *        to a temporary file by its own Exporter at the same time (the audio by one more). The files are then stream copied into one.
+ *        Smart rendering splits the frames the same way, but takes the GOPs of segments shown untouched straight from their source file.
+ *        A resumable export always runs in chunks, and an ExportManifest remembers the finished ones for the next run.
+ */
+class Exporter {
+public:
+    Exporter(std::shared_ptr<const TimelineSnapshot> snapshot, const ExportSettings& settings);
+    ~Exporter();
+
+    /**
+     * @brief Export the timeline. Blocks until the file is written, cancel() can be called from another thread.
+     * @return True if the whole file was written, otherwise false.
+     */
+    bool run();
+
+    // Stop a running export, run() returns false
+    void cancel();
+
+    // Get the fraction of frames encoded, 0 to 1. Safe to call from any thread.
+    float getProgress() const;
+
+    // Get the throughput of every stage, complete once run() returned
+    const std::vector<ExportStageStats>& getStageStats() const;
+
+    // Print the throughput of every stage to std::cout
+    void printStageStats() const;
+
+private:
+    // A timeline frame travelling through the pipeline
+    struct FrameJob {
+        Uint32 frame = 0;
+        std::vector<VideoLayerRef> layers; // What every track shows at frame, computed once by the decode stage
+        std::unordered_map<Uint32, std::shared_ptr<const CachedFrame>> segmentFrames; // Decoded frames keyed by segmentID
+        CompositeFrame composite;
+        bool isComposited = false; // Taken from the RenderCache, skips the composite stage
+    };
+
+    // A range of frames exported on its own and joined with the others afterwards
+    struct ExportPart {
+        Uint32 startFrame = 0;
+        Uint32 endFrame = 0;
+        std::string sourcePath; // Stream copied from this file if set, otherwise re-encoded
+        int64_t sourceStart = 0; // Timestamps of the keyframes the copy starts and stops at, in the source stream's time base
+        int64_t sourceEnd = 0;
+    };
+
+    // Serves the frames the decode stage prepared to the Compositor
+    class JobFrameProvider : public FrameProvider {
+    public:
+        JobFrameProvider(FrameJob& job) : m_job(job) { }
+        bool getSegmentFrame(const VideoSegment& segment, Uint32 frameInSegment, LayerFrame& frame) override;
+    private:
+        FrameJob& m_job;
+    };
+
+    // Open a branch for every output file and served stream, returns true if successful
+    bool openOutputs();
+
+    // Get the output file the settings describe directly, next to the extra outputs
+    ExportOutput getPrimaryOutput() const;
+
+    // Stage bodies, each runs on its own thread
+    void decodeStage();
+    void compositeStage();
+    void audioStage();
+    void encodeStage();
+
+    // Decode the frame of a segment into the job, returns false if the segment could not be decoded
+    bool decodeSegmentFrame(const VideoSegment& segment, const std::shared_ptr<FrameJob>& job, std::unordered_map<Uint32, DecoderLease>& decoders);
+
+    // Stop every stage after an error, run() returns false
+    void fail();
+
+    // Split the frames into chunkCount chunks that start on a GOP boundary, more if a resumable export's chunks would be longer than a checkpoint
+    std::vector<ExportPart> planChunks() const;
+
+    /**
+     * @brief Find the frames where a single segment is shown untouched and its source is encoded like the output would be.
+     *        The whole GOPs in those frames are copied from the source, the frames around them re-encoded.
+     * @return The parts in order, empty if nothing can be copied.
+     */
+    std::vector<ExportPart> planSmartRender() const;
+
+    // Export the re-encoded parts (at the same time with more than one chunk) and the audio, then join all parts into the output
+    bool runParts(const std::vector<ExportPart>& parts);
+
+    // Get the frames from one keyframe to the next
+    Uint32 getGopSize() const;
+
+    // Describe every setting that changes how the parts are encoded, parts of a resumable export are only reused with the same settings
+    std::string getPartSettingsKey() const;
+
+private:
+    std::shared_ptr<const TimelineSnapshot> m_snapshot;
+    ExportSettings m_settings;
+    Uint32 m_endFrame = 0;
+    bool m_hasVideo = true;
+    bool m_hasAudio = false;
+
+    std::vector<std::unique_ptr<ExportBranch>> m_branches; // One per output file and served stream
+    int m_audioBlockSize = 1024; // Samples per mixed audio block
+
+    BoundedQueue<std::shared_ptr<FrameJob>> m_decodedFrames;    // decode -> composite
+    BoundedQueue<std::shared_ptr<FrameJob>> m_compositedFrames; // composite -> encode
+    BoundedQueue<std::shared_ptr<AudioBlock>> m_audioBlocks;    // audio -> encode
+
+    std::vector<ExportStageStats> m_stageStats; // decode, composite, audio, encode
+    std::atomic<Uint32> m_encodedFrames = 0;
+    std::atomic<bool> m_hasFailed = false;
+    double m_exportSeconds = 0.0; // Wall time of the last run()
+
+    std::vector<std::unique_ptr<Exporter>> m_chunkExporters; // Exporters of the audio and the re-encoded parts, while running in parts
+    Uint32 m_resumedFrames = 0; // Frames of parts finished by an earlier run, while running in parts
+    mutable std::mutex m_chunkMutex; // Guards m_chunkExporters and m_branches
+};
@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "FrameServer.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <afunix.h> // Unix domain sockets, Windows 10 1803 and later
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif // _WIN32
+
+// Kernel buffer asked for pipes and sockets, fewer wake ups of the reader at high data rates (a 4K RGB frame is 24 MiB)
+static const int streamBufferSize = 4 << 20;
+
+static void closeSocket(intptr_t socket) {
+#ifdef _WIN32
+    closesocket(static_cast<SOCKET>(socket));
+#else
+    ::close(static_cast<int>(socket));
+#endif // _WIN32
+}
+
+FrameServer::FrameServer(const std::string& target, FrameServerFormat streamFormat, const ExportBranchFormat& format)
+    : ExportBranch("serve " + target, format), m_target(target), m_streamFormat(streamFormat) {
+    // A server streams either the frames or the audio
+    m_format.hasVideo = m_streamFormat != FrameServerFormat::WAV;
+    m_format.hasAudio = m_streamFormat == FrameServerFormat::WAV;
+}
+
+FrameServer::~FrameServer() {
+    stopThread();
+    closeOutput();
+}
+
+bool FrameServer::open() {
+#ifndef _WIN32
+    // A reader that quits makes the write fail, instead of ending the process
+    std::signal(SIGPIPE, SIG_IGN);
+#endif // _WIN32
+
+    bool isOpen = false;
+    if (isStandardOutput(m_target)) isOpen = openStandardOutput();
+    else if (m_target.starts_with("pipe:")) isOpen = openPipe(m_target.substr(5));
+    else if (m_target.starts_with("unix:")) isOpen = openSocket(m_target.substr(5));
+    else isOpen = openFile(m_target);
+    if (!isOpen) return false;
+
+    switch (m_streamFormat) {
+    case FrameServerFormat::Y4M:
+        return writeY4MHeader();
+    case FrameServerFormat::WAV:
+        return writeWavHeader();
+    default:
+        return true; // Raw frames have no header
+    }
+}
+
+bool FrameServer::isStandardOutput(const std::string& target) {
+    return target == "-";
+}
+
+bool FrameServer::writeFrame(const CompositeFrame* composite, Uint32 /*frameNumber*/) {
+    if (!composite) return true; // The reader sees the end when the stream closes
+
+    if (m_streamFormat == FrameServerFormat::RGB24) {
+        // Written straight from the shared frame, row by row if its lines are padded
+        size_t rowSize = static_cast<size_t>(composite->width) * 3;
+        if (static_cast<size_t>(composite->linesize) == rowSize) {
+            WriteBuffer buffer = { composite->pixels.data(), rowSize * composite->height };
+            return write(&buffer, 1);
+        }
+        m_rowBuffers.clear();
+        for (int y = 0; y < composite->height; y++) {
+            m_rowBuffers.push_back({ composite->pixels.data() + static_cast<size_t>(y) * composite->linesize, rowSize });
+        }
+        return write(m_rowBuffers.data(), m_rowBuffers.size());
+    }
+
+    // Y4M: convert into the reused planes, then write the frame header and the planes together
+    int width = m_format.frameWidth;
+    int height = m_format.frameHeight;
+    int chromaWidth = m_isChroma420 ? width / 2 : width;
+    int chromaHeight = m_isChroma420 ? height / 2 : height;
+    size_t lumaSize = static_cast<size_t>(width) * height;
+    size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+    uint8_t* planes[3] = { m_yuvPlanes.data(), m_yuvPlanes.data() + lumaSize, m_yuvPlanes.data() + lumaSize + chromaSize };
+    int linesizes[3] = { width, chromaWidth, chromaWidth };
+    const uint8_t* source = composite->pixels.data();
+    int sourceLinesize = composite->linesize;
+    sws_scale(m_swsContext, &source, &sourceLinesize, 0, std::min(height, composite->height), planes, linesizes);
+
+    static const char frameHeader[] = "FRAME\n";
+    WriteBuffer buffers[2] = { { frameHeader, sizeof(frameHeader) - 1 }, { m_yuvPlanes.data(), m_yuvPlanes.size() } };
+    return write(buffers, 2);
+}
+
+bool FrameServer::writeAudio(const AudioBlock* block) {
+    if (!block) return true;
+    WriteBuffer buffer = { block->samples.data(), block->samples.size() * sizeof(int16_t) };
+    return write(&buffer, 1);
+}
+
+bool FrameServer::finishOutput() {
+    return true; // Closing the stream is its end
+}
+
+void FrameServer::closeOutput() {
+#ifdef _WIN32
+    if (m_socket != -1) {
+        closeSocket(m_socket);
+        WSACleanup();
+    }
+    if (m_handle != -1 && m_ownsHandle) {
+        HANDLE handle = reinterpret_cast<HANDLE>(m_handle);
+        if (GetFileType(handle) == FILE_TYPE_PIPE) {
+            FlushFileBuffers(handle); // Let the reader take what is still in the pipe
+            DisconnectNamedPipe(handle);
+        }
+        CloseHandle(handle);
+    }
+    if (!m_socketPath.empty()) DeleteFileA(m_socketPath.c_str());
+#else
+    if (m_socket != -1) closeSocket(m_socket);
+    if (m_handle != -1 && m_ownsHandle) ::close(static_cast<int>(m_handle));
+    if (!m_socketPath.empty()) ::unlink(m_socketPath.c_str());
+#endif // _WIN32
+    m_socket = -1;
+    m_handle = -1;
+    m_socketPath.clear();
+
+    if (m_swsContext) {
+        sws_freeContext(m_swsContext);
+        m_swsContext = nullptr;
+    }
+}
+
+bool FrameServer::openStandardOutput() {
+    m_ownsHandle = false;
+#ifdef _WIN32
+    // Text mode would turn every 0x0A byte into 0x0D 0x0A
+    _setmode(_fileno(stdout), _O_BINARY);
+    m_handle = reinterpret_cast<intptr_t>(GetStdHandle(STD_OUTPUT_HANDLE));
+#else
+    m_handle = STDOUT_FILENO;
+#endif // _WIN32
+    return true;
+}
+
+bool FrameServer::openPipe(const std::string& name) {
+#ifdef _WIN32
+    // Named pipes live in their own namespace, a bare name is put there
+    std::string pipeName = name.starts_with("\\\\") ? name : "\\\\.\\pipe\\" + name;
+    HANDLE pipe = CreateNamedPipeA(pipeName.c_str(), PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1, streamBufferSize, 0, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        std::cerr << "Could not create the named pipe: " << pipeName << std::endl;
+        return false;
+    }
+    std::clog << "Waiting for a reader on " << pipeName << std::endl;
+    if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+        std::cerr << "No reader connected to: " << pipeName << std::endl;
+        CloseHandle(pipe);
+        return false;
+    }
+    m_handle = reinterpret_cast<intptr_t>(pipe);
+#else
+    if (mkfifo(name.c_str(), 0600) != 0 && errno != EEXIST) {
+        std::cerr << "Could not create the named pipe: " << name << std::endl;
+        return false;
+    }
+    std::clog << "Waiting for a reader on " << name << std::endl;
+    int fd = ::open(name.c_str(), O_WRONLY); // Blocks until the reader opens the other end
+    if (fd < 0) {
+        std::cerr << "Could not open the named pipe: " << name << std::endl;
+        return false;
+    }
+#ifdef F_SETPIPE_SZ
+    fcntl(fd, F_SETPIPE_SZ, streamBufferSize); // Linux only, the default of 64 KiB is a few rows of a 4K frame
+#endif // F_SETPIPE_SZ
+    m_handle = fd;
+#endif // _WIN32
+    return true;
+}
+
+bool FrameServer::openSocket(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+#ifdef _WIN32
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        std::cerr << "Could not initialize Winsock." << std::endl;
+        return false;
+    }
+    DeleteFileA(path.c_str()); // A socket left behind by an earlier export
+    SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool isListening = listener != INVALID_SOCKET
+        && bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0
+        && listen(listener, 1) == 0;
+#else
+    ::unlink(path.c_str()); // A socket left behind by an earlier export
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool isListening = listener >= 0
+        && bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0
+        && listen(listener, 1) == 0;
+#endif // _WIN32
+    if (!isListening) {
+        std::cerr << "Could not listen on the socket: " << path << std::endl;
+        if (static_cast<intptr_t>(listener) != -1) closeSocket(listener);
+#ifdef _WIN32
+        WSACleanup();
+#endif // _WIN32
+        return false;
+    }
+    m_socketPath = path;
+
+    std::clog << "Waiting for a reader on " << path << std::endl;
+    intptr_t connection = static_cast<intptr_t>(accept(listener, nullptr, nullptr));
+    closeSocket(listener); // One reader per export
+    if (connection == -1) {
+        std::cerr << "No reader connected to: " << path << std::endl;
+#ifdef _WIN32
+        WSACleanup();
+#endif // _WIN32
+        return false;
+    }
+
+    int bufferSize = streamBufferSize;
+    setsockopt(static_cast<decltype(listener)>(connection), SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&bufferSize), sizeof(bufferSize));
+    m_socket = connection;
+    return true;
+}
+
+bool FrameServer::openFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Could not open output file: " << path << std::endl;
+        return false;
+    }
+    m_handle = reinterpret_cast<intptr_t>(file);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not open output file: " << path << std::endl;
+        return false;
+    }
+    m_handle = fd;
+#endif // _WIN32
+    return true;
+}
+
+bool FrameServer::write(const WriteBuffer* buffers, size_t count) {
+#ifdef _WIN32
+    for (size_t i = 0; i < count; i++) {
+        const char* data = static_cast<const char*>(buffers[i].data);
+        size_t remaining = buffers[i].size;
+        while (remaining > 0) {
+            int chunk = static_cast<int>(std::min<size_t>(remaining, 1 << 30));
+            DWORD written = 0;
+            if (m_socket != -1) {
+                int sent = send(static_cast<SOCKET>(m_socket), data, chunk, 0);
+                if (sent == SOCKET_ERROR) {
+                    std::cerr << "The reader of " << m_target << " stopped reading." << std::endl;
+                    return false;
+                }
+                written = static_cast<DWORD>(sent);
+            }
+            else if (!WriteFile(reinterpret_cast<HANDLE>(m_handle), data, static_cast<DWORD>(chunk), &written, nullptr)) {
+                std::cerr << "The reader of " << m_target << " stopped reading." << std::endl;
+                return false;
+            }
+            data += written;
+            remaining -= written;
+        }
+    }
+    return true;
+#else
+    // Gather the buffers into as few system calls as possible, picking up where a partial write stopped
+    int fd = static_cast<int>(m_socket != -1 ? m_socket : m_handle);
+    size_t index = 0;  // First buffer not completely written
+    size_t offset = 0; // Bytes of that buffer already written
+    while (index < count) {
+        iovec vectors[64];
+        int vectorCount = 0;
+        for (size_t i = index; i < count && vectorCount < 64; i++) {
+            size_t skip = i == index ? offset : 0;
+            vectors[vectorCount].iov_base = const_cast<char*>(static_cast<const char*>(buffers[i].data) + skip);
+            vectors[vectorCount].iov_len = buffers[i].size - skip;
+            vectorCount++;
+        }
+
+        ssize_t written = writev(fd, vectors, vectorCount);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "The reader of " << m_target << " stopped reading." << std::endl;
+            return false;
+        }
+
+        size_t remaining = static_cast<size_t>(written);
+        while (index < count && remaining >= buffers[index].size - offset) {
+            remaining -= buffers[index].size - offset;
+            index++;
+            offset = 0;
+        }
+        offset += remaining;
+    }
+    return true;
+#endif // _WIN32
+}
+
+bool FrameServer::writeY4MHeader() {
+    // 4:2:0 halves the data, but needs an even size
+    int width = m_format.frameWidth;
+    int height = m_format.frameHeight;
+    m_isChroma420 = width % 2 == 0 && height % 2 == 0;
+    AVPixelFormat pixelFormat = m_isChroma420 ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_YUV444P;
+    m_swsContext = sws_getContext(width, height, AV_PIX_FMT_RGB24, width, height, pixelFormat, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsContext) {
+        std::cerr << "Could not create the video conversion context." << std::endl;
+        return false;
+    }
+    size_t lumaSize = static_cast<size_t>(width) * height;
+    m_yuvPlanes.resize(m_isChroma420 ? lumaSize * 3 / 2 : lumaSize * 3);
+
+    // swscale converts to BT.601 in limited range
+    char header[128];
+    int size = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 %s XCOLORRANGE=LIMITED\n",
+        width, height, m_format.fps, m_isChroma420 ? "C420jpeg" : "C444");
+    WriteBuffer buffer = { header, static_cast<size_t>(size) };
+    return write(&buffer, 1);
+}
+
+bool FrameServer::writeWavHeader() {
+    uint8_t header[44];
+    auto put32 = [&header](int position, uint32_t value) {
+        for (int i = 0; i < 4; i++) header[position + i] = static_cast<uint8_t>(value >> (8 * i));
+    };
+    auto put16 = [&header](int position, uint16_t value) {
+        header[position] = static_cast<uint8_t>(value);
+        header[position + 1] = static_cast<uint8_t>(value >> 8);
+    };
+
+    // The length isn't known while streaming, the sizes are the largest possible like other streaming WAV writers do
+    uint16_t blockAlign = static_cast<uint16_t>(m_format.channels * sizeof(int16_t));
+    std::memcpy(header, "RIFF", 4);
+    put32(4, 0xFFFFFFFF);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    put32(16, 16);        // Size of the fmt chunk
+    put16(20, 1);         // PCM
+    put16(22, static_cast<uint16_t>(m_format.channels));
+    put32(24, static_cast<uint32_t>(m_format.sampleRate));
+    put32(28, static_cast<uint32_t>(m_format.sampleRate) * blockAlign);
+    put16(32, blockAlign);
+    put16(34, 16);        // Bits per sample
+    std::memcpy(header + 36, "data", 4);
+    put32(40, 0xFFFFFFFF);
+
+    WriteBuffer buffer = { header, sizeof(header) };
+    return write(&buffer, 1);
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <SDL.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ExportBranch.h"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+// How a FrameServer writes its stream
+enum class FrameServerFormat {
+    Y4M,   // YUV4MPEG2 (4:2:0, or 4:4:4 at an odd size), read by ffmpeg, x264, x265, rav1e, SVT-AV1 and others
+    RGB24, // Raw packed RGB without any header, written straight from the composited frames (ffmpeg -f rawvideo -pix_fmt rgb24 -s <w>x<h> -r <fps>)
+    WAV,   // Signed 16-bit PCM in a WAV header whose sizes are left unknown, the reader reads to the end of the stream
+};
+
+/**
+ * @class FrameServer
+ * @brief Streams the uncompressed composited frames or mixed audio of an export to another program, e.g. an external encoder.
+ *        The target is "-" (stdout), "pipe:<name>" (a named pipe / FIFO the reader opens), "unix:<path>" (a Unix domain socket the reader connects to)
+ *        or the path of a file. Writes block while the reader is behind, which holds up the whole export.
+ *        Raw RGB frames and audio blocks are written from the shared buffers of the export without copying them.
+ */
+class FrameServer : public ExportBranch {
+public:
+    /**
+     * @param target Where the stream is written to, see the class description.
+     * @param streamFormat Y4M or RGB24 serve the frames, WAV serves the audio.
+     * @param format The frames and audio of the export.
+     */
+    FrameServer(const std::string& target, FrameServerFormat streamFormat, const ExportBranchFormat& format);
+    ~FrameServer() override;
+
+    // Open the target and wait for the reader of a pipe or socket to connect, then write the stream's header. Returns true if successful.
+    bool open() override;
+
+    // Whether a target is stdout, whatever is printed there would end up in the stream
+    static bool isStandardOutput(const std::string& target);
+
+protected:
+    bool writeFrame(const CompositeFrame* composite, Uint32 frameNumber) override;
+    bool writeAudio(const AudioBlock* block) override;
+    bool finishOutput() override;
+    void closeOutput() override;
+
+private:
+    // A piece of memory to write, several are written with one call where the platform can
+    struct WriteBuffer {
+        const void* data;
+        size_t size;
+    };
+
+    bool openStandardOutput();
+    bool openPipe(const std::string& name);
+    bool openSocket(const std::string& path);
+    bool openFile(const std::string& path);
+
+    // Write every buffer, waits while the reader is behind. Returns false if the reader went away.
+    bool write(const WriteBuffer* buffers, size_t count);
+
+    bool writeY4MHeader();
+    bool writeWavHeader();
+
+private:
+    std::string m_target;
+    FrameServerFormat m_streamFormat;
+    intptr_t m_handle = -1;     // File descriptor, or HANDLE on Windows
+    intptr_t m_socket = -1;     // Connected socket, used instead of m_handle
+    std::string m_socketPath;   // Removed again when the socket closes
+    bool m_ownsHandle = true;   // stdout is left open
+
+    SwsContext* m_swsContext = nullptr;  // RGB to the Y4M's YUV
+    bool m_isChroma420 = true;
+    std::vector<uint8_t> m_yuvPlanes;    // One converted frame, the planes back to back as Y4M stores them
+    std::vector<WriteBuffer> m_rowBuffers; // The rows of a raw frame whose lines are padded
+};
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "Remuxer.h"
+
+// An opened input file and the one stream read from it
+struct RemuxInput {
+    AVFormatContext* formatContext = nullptr;
+    int streamIndex = -1;
+
+    ~RemuxInput() { close(); }
+
+    bool open(const std::string& filepath, AVMediaType type) {
+        close();
+        if (avformat_open_input(&formatContext, filepath.c_str(), nullptr, nullptr) < 0) {
+            std::cerr << "Could not open: " << filepath << std::endl;
+            return false;
+        }
+        if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+            std::cerr << "Could not find stream info of: " << filepath << std::endl;
+            return false;
+        }
+        streamIndex = av_find_best_stream(formatContext, type, -1, -1, nullptr, 0);
+        if (streamIndex < 0) {
+            std::cerr << "Could not find a " << av_get_media_type_string(type) << " stream in: " << filepath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Read the next packet of the stream, returns false at the end of the file
+    bool read(AVPacket* packet) {
+        while (av_read_frame(formatContext, packet) >= 0) {
+            if (packet->stream_index == streamIndex) return true;
+            av_packet_unref(packet);
+        }
+        return false;
+    }
+
+    AVStream* getStream() const { return formatContext->streams[streamIndex]; }
+
+    void close() {
+        if (formatContext) avformat_close_input(&formatContext);
+        streamIndex = -1;
+    }
+};
+
+// Add an output stream with the codec parameters of an input stream, returns nullptr if it could not be added
+static AVStream* addCopiedStream(AVFormatContext* output, const AVStream* input) {
+    AVStream* stream = avformat_new_stream(output, nullptr);
+    if (!stream || avcodec_parameters_copy(stream->codecpar, input->codecpar) < 0) {
+        std::cerr << "Could not add a stream to the output." << std::endl;
+        return nullptr;
+    }
+    stream->codecpar->codec_tag = 0; // Let the output container pick its own tag
+    stream->time_base = input->time_base;
+    return stream;
+}
+
+static bool hasSameExtradata(const AVCodecParameters* parameters, const std::vector<uint8_t>& extradata) {
+    return parameters->extradata_size == static_cast<int>(extradata.size()) && (extradata.empty() || memcmp(parameters->extradata, extradata.data(), extradata.size()) == 0);
+}
+
+/**
+ * @brief Get the SPS and PPS of an H.264 stream's avcC extradata as NAL units with a 4 byte size in front, as mp4 packets store them.
+ * @return True if successful, false if the extradata is not avcC with 4 byte NAL sizes.
+ */
+static bool getParameterSetUnits(const AVCodecParameters* parameters, std::vector<uint8_t>& units) {
+    const uint8_t* data = parameters->extradata;
+    int size = parameters->extradata_size;
+    if (parameters->codec_id != AV_CODEC_ID_H264 || size < 7 || data[0] != 1 || (data[4] & 3) != 3) return false;
+
+    // avcC: 5 header bytes, the SPS count, the SPSs with a 2 byte size, the PPS count, the PPSs with a 2 byte size
+    int position = 5;
+    for (int list = 0; list < 2; list++) {
+        if (position >= size) return false;
+        int count = list == 0 ? (data[position] & 0x1f) : data[position];
+        position++;
+        for (int i = 0; i < count; i++) {
+            if (position + 2 > size) return false;
+            int unitSize = (data[position] << 8) | data[position + 1];
+            position += 2;
+            if (position + unitSize > size) return false;
+            uint8_t sizeBytes[4] = { 0, 0, static_cast<uint8_t>(unitSize >> 8), static_cast<uint8_t>(unitSize) };
+            units.insert(units.end(), sizeBytes, sizeBytes + 4);
+            units.insert(units.end(), data + position, data + position + unitSize);
+            position += unitSize;
+        }
+    }
+    return true;
+}
+
+// Put data in front of a packet's data
+static bool prependToPacket(AVPacket* packet, const std::vector<uint8_t>& data) {
+    AVPacket* combined = av_packet_alloc();
+    if (!combined || av_new_packet(combined, static_cast<int>(data.size()) + packet->size) < 0) {
+        av_packet_free(&combined);
+        return false;
+    }
+    memcpy(combined->data, data.data(), data.size());
+    memcpy(combined->data + data.size(), packet->data, packet->size);
+    av_packet_copy_props(combined, packet);
+    av_packet_unref(packet);
+    av_packet_move_ref(packet, combined);
+    av_packet_free(&combined);
+    return true;
+}
+
+bool Remuxer::concatenate(const std::vector<RemuxPart>& parts, AVRational timeBase, const std::string& audioPath, const std::string& outputPath) {
+    if (parts.empty()) return false;
+
+    // The decode timestamps are counted again with the largest reorder delay of all parts, so every part's frames are decoded before they are shown
+    int decodeDelay = 0;
+    for (const RemuxPart& part : parts) {
+        RemuxInput input;
+        if (!input.open(part.filepath, AVMEDIA_TYPE_VIDEO)) return false;
+        decodeDelay = std::max(decodeDelay, input.getStream()->codecpar->video_delay);
+    }
+
+    RemuxInput video;
+    RemuxInput audio;
+    if (!video.open(parts[0].filepath, AVMEDIA_TYPE_VIDEO)) return false;
+    bool hasAudio = !audioPath.empty();
+    if (hasAudio && !audio.open(audioPath, AVMEDIA_TYPE_AUDIO)) return false;
+
+    AVFormatContext* output = nullptr;
+    if (avformat_alloc_output_context2(&output, nullptr, nullptr, outputPath.c_str()) < 0 || !output) {
+        std::cerr << "Could not create an output container for: " << outputPath << std::endl;
+        return false;
+    }
+
+    AVPacket* videoPacket = av_packet_alloc();
+    AVPacket* audioPacket = av_packet_alloc();
+    AVStream* videoStream = addCopiedStream(output, video.getStream());
+    AVStream* audioStream = hasAudio ? addCopiedStream(output, audio.getStream()) : nullptr;
+    bool isWritten = videoStream && (!hasAudio || audioStream) && videoPacket && audioPacket;
+
+    if (isWritten && !(output->oformat->flags & AVFMT_NOFILE) && avio_open(&output->pb, outputPath.c_str(), AVIO_FLAG_WRITE) < 0) {
+        std::cerr << "Could not open output file: " << outputPath << std::endl;
+        isWritten = false;
+    }
+    if (isWritten && avformat_write_header(output, nullptr) < 0) {
+        std::cerr << "Could not write the header of: " << outputPath << std::endl;
+        isWritten = false;
+    }
+
+    // Position the video input at the start of a part, returns false if it can't be read
+    size_t partIndex = 0;
+    int64_t partPacketCount = 0;
+    std::vector<uint8_t> parameterSets; // Put in front of the part's first keyframe, empty if the decoder already has them
+    std::vector<uint8_t> activeExtradata; // Parameter sets the decoder uses at the end of the last part
+    if (videoStream) activeExtradata.assign(videoStream->codecpar->extradata, videoStream->codecpar->extradata + videoStream->codecpar->extradata_size);
+    auto startPart = [&]() {
+        const RemuxPart& part = parts[partIndex];
+        if (partIndex > 0 && !video.open(part.filepath, AVMEDIA_TYPE_VIDEO)) return false;
+        if (part.sourceStart != AV_NOPTS_VALUE && av_seek_frame(video.formatContext, video.streamIndex, part.sourceStart, AVSEEK_FLAG_BACKWARD) < 0) {
+            std::cerr << "Could not seek in: " << part.filepath << std::endl;
+            return false;
+        }
+        partPacketCount = 0;
+
+        parameterSets.clear();
+        const AVCodecParameters* parameters = video.getStream()->codecpar;
+        if (parameters->codec_id != videoStream->codecpar->codec_id) {
+            std::cerr << "Can't join " << part.filepath << ", it is encoded with another codec" << std::endl;
+            return false;
+        }
+        if (!hasSameExtradata(parameters, activeExtradata)) {
+            if (!getParameterSetUnits(parameters, parameterSets)) {
+                std::cerr << "Can't join " << part.filepath << ", it is encoded with other settings" << std::endl;
+                return false;
+            }
+            activeExtradata.assign(parameters->extradata, parameters->extradata + parameters->extradata_size);
+        }
+        return true;
+    };
+
+    // Take the next video packet, moving on to the next part at the end of a part. Timestamps are moved to the part's place in the output.
+    int64_t lastVideoDts = AV_NOPTS_VALUE;
+    auto readVideo = [&]() {
+        while (true) {
+            const RemuxPart& part = parts[partIndex];
+            if (video.read(videoPacket)) {
+                bool isKeyframe = videoPacket->flags & AV_PKT_FLAG_KEY;
+                if (part.sourceStart != AV_NOPTS_VALUE && partPacketCount == 0 && !(isKeyframe && videoPacket->pts == part.sourceStart)) {
+                    av_packet_unref(videoPacket); // Before the keyframe the part starts at
+                    continue;
+                }
+                bool isPartEnd = part.sourceEnd != AV_NOPTS_VALUE && isKeyframe && videoPacket->pts >= part.sourceEnd;
+                if (!isPartEnd) {
+                    int64_t origin = part.sourceStart != AV_NOPTS_VALUE ? part.sourceStart : 0;
+                    int64_t frame = part.startTime + av_rescale_q(videoPacket->pts - origin, video.getStream()->time_base, timeBase);
+                    videoPacket->pts = av_rescale_q(frame, timeBase, videoStream->time_base);
+                    videoPacket->dts = av_rescale_q(part.startTime + partPacketCount - decodeDelay, timeBase, videoStream->time_base);
+                    if (lastVideoDts != AV_NOPTS_VALUE && videoPacket->dts <= lastVideoDts) videoPacket->dts = lastVideoDts + 1;
+                    lastVideoDts = videoPacket->dts;
+                    videoPacket->duration = av_rescale_q(videoPacket->duration, video.getStream()->time_base, videoStream->time_base);
+                    videoPacket->stream_index = videoStream->index;
+                    videoPacket->pos = -1;
+
+                    if (partPacketCount == 0 && !parameterSets.empty() && !prependToPacket(videoPacket, parameterSets)) {
+                        isWritten = false;
+                        return false;
+                    }
+                    partPacketCount++;
+                    return true;
+                }
+                av_packet_unref(videoPacket);
+            }
+
+            if (++partIndex >= parts.size()) return false;
+            if (!startPart()) {
+                isWritten = false;
+                return false;
+            }
+        }
+    };
+    auto readAudio = [&]() {
+        if (!audio.read(audioPacket)) return false;
+        av_packet_rescale_ts(audioPacket, audio.getStream()->time_base, audioStream->time_base);
+        audioPacket->stream_index = audioStream->index;
+        audioPacket->pos = -1;
+        return true;
+    };
+
+    // Write the packets of both streams in decode time order, so the muxer doesn't have to buffer one of them
+    if (isWritten && !startPart()) isWritten = false;
+    bool hasVideoPacket = isWritten && readVideo();
+    bool hasAudioPacket = isWritten && hasAudio && readAudio();
+    while (isWritten && (hasVideoPacket || hasAudioPacket)) {
+        bool takeVideo = hasVideoPacket;
+        if (hasVideoPacket && hasAudioPacket) {
+            takeVideo = av_compare_ts(videoPacket->dts, videoStream->time_base, audioPacket->dts, audioStream->time_base) <= 0;
+        }
+
+        AVPacket* packet = takeVideo ? videoPacket : audioPacket;
+        if (av_interleaved_write_frame(output, packet) < 0) {
+            std::cerr << "Error writing a packet to: " << outputPath << std::endl;
+            isWritten = false;
+            break;
+        }
+        if (takeVideo) hasVideoPacket = readVideo();
+        else hasAudioPacket = readAudio();
+    }
+
+    if (isWritten && av_write_trailer(output) < 0) {
+        std::cerr << "Could not finish writing: " << outputPath << std::endl;
+        isWritten = false;
+    }
+
+    if (output->pb && !(output->oformat->flags & AVFMT_NOFILE)) avio_closep(&output->pb);
+    avformat_free_context(output);
+    av_packet_free(&videoPacket);
+    av_packet_free(&audioPacket);
+    return isWritten;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// A file whose video is copied into the output, starting at startTime
+struct RemuxPart {
+    std::string filepath;
+    int64_t startTime = 0; // In the time base given to the Remuxer
+    int64_t sourceStart = AV_NOPTS_VALUE; // Copy from the keyframe at this timestamp (in the file's time base), from the start of the file if not set
+    int64_t sourceEnd = AV_NOPTS_VALUE;   // Copy up to the keyframe at this timestamp, to the end of the file if not set
+};
+
+/**
+ * @class Remuxer
+ * @brief Copies already encoded streams into a new file without decoding or encoding them again (a stream copy).
+ *        Used to join the parts of an export into one file: chunks encoded at the same time, and ranges copied from source files.
+ *        The video runs at a constant frame rate, so the decode timestamps are counted again over all parts.
+ *        H.264 parts with other parameter sets than the first part get theirs in front of their first keyframe.
+ */
+class Remuxer {
+public:
+    /**
+     * @brief Write the video of every part one after another, and the audio of another file next to it, into one file.
+     *        The parts must be the same codec and each must start with a keyframe that starts a closed GOP.
+     * @param parts The files to take the video from, in order.
+     * @param timeBase The time base of the parts' startTime, one frame.
+     * @param audioPath The file to take the audio from, empty for no audio.
+     * @param outputPath The file to write, the container is picked from the extension.
+     * @return True if the whole file was written, otherwise false.
+     */
+    static bool concatenate(const std::vector<RemuxPart>& parts, AVRational timeBase, const std::string& audioPath, const std::string& outputPath);
+};
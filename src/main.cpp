@@ -1,9 +1,36 @@
 #define SDL_MAIN_HANDLED  // This prevents SDL from overriding the main function
 #include "Application.h"
+#include "AllocationTracker.h"
+#include "BatchRenderer.h"
+#include "Metrics.h"
 #include "util.h"
+#include <cstdlib>
+#include <string>
 
 int main(int argc, char* argv[]) {
+    // Render projects from the command line without opening a window
+    if (BatchRenderer::isRequested(argc, argv)) {
+        SDL_SetMainReady();
+        BatchRenderer batchRenderer;
+        return batchRenderer.run(argc, argv);
+    }
+
+    // --metrics <directory> [--metrics-interval <seconds>] writes playback health snapshots while the editor runs.
+    // --assert-no-allocations stops at the first allocation in a NO_ALLOCATIONS region, in a build with TRACK_ALLOCATIONS and asserts.
+    std::string metricsDirectory;
+    double metricsInterval = 5.0;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--metrics" && hasValue) metricsDirectory = argv[++i];
+        else if (argument == "--metrics-interval" && hasValue) metricsInterval = std::atof(argv[++i]);
+        else if (argument == "--assert-no-allocations") AllocationTracker::setAssertOnViolation(true);
+    }
+    if (!metricsDirectory.empty()) Metrics::shared().startSnapshots(metricsDirectory, metricsInterval);
+
     Application app(appWindowSizeX, appWindowSizeY);
     app.run();
+    Metrics::shared().stopSnapshots();
+    if (AllocationTracker::isEnabled()) AllocationTracker::printReport();
     return 0;
 }
\ No newline at end of file
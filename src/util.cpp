@@ -1,6 +1,8 @@
+#include <cstdio>
 #include <filesystem>
 #include <iostream>
 #include "util.h"
+#include "GlyphAtlas.h"
 
 std::wstring to_wstring(const char* str) {
     if (!str) throw std::invalid_argument("Input string is null");
@@ -39,54 +41,13 @@ TTF_Font* getFontBig() { return s_fontBig; }
 TTF_Font* getFontSmall() { return s_fontSmall; }
 
 SDL_Rect renderText(SDL_Renderer* renderer, int xPos, int yPos, TTF_Font* font, const char* text, SDL_Color color) {
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, text, color);
-    if (!textSurface) {
-        printf("Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError());
-        return { xPos, yPos, 0, 0 };
-    }
-    // Convert surface to texture
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    SDL_FreeSurface(textSurface); // Free the surface now that we have a texture
-
-    if (!textTexture) printf("Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError());
-
-    // Define the destination rectangle for the text
-    SDL_Rect textRect;
-    textRect.x = xPos;
-    textRect.y = yPos;
-    SDL_QueryTexture(textTexture, nullptr, nullptr, &textRect.w, &textRect.h); // Get width and height from the texture
-
-    SDL_RenderCopy(renderer, textTexture, nullptr, &textRect); // Render text
-
-    SDL_DestroyTexture(textTexture);
-
-    return textRect;
+    if (!font || !text) return { xPos, yPos, 0, 0 };
+    return GlyphAtlas::get(renderer, font).drawText(xPos, yPos, text, color);
 }
 
-SDL_Rect renderTextWithCustomSpacing(SDL_Renderer* renderer, int xPos, int yPos, TTF_Font* font, std::string text, int customSpacing, SDL_Color color) {
-    if (text.empty()) return { xPos, yPos, 0, 0 };
-
-    int offsetX = 0;
-
-    // Render each character (number) individually with custom spacing
-    int charWidth = 0;
-    int charHeight = 0;
-    for (char c : text) {
-        std::string character(1, c);  // Convert char to string
-        SDL_Surface* surface = TTF_RenderText_Solid(font, character.c_str(), color);
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-
-        TTF_SizeText(font, character.c_str(), &charWidth, &charHeight);
-
-        SDL_Rect dstRect = { xPos + offsetX, yPos, charWidth, charHeight };
-        SDL_RenderCopy(renderer, texture, nullptr, &dstRect);
-
-        offsetX += charWidth + customSpacing; // Move to the right, applying custom spacing
-
-        SDL_FreeSurface(surface);
-        SDL_DestroyTexture(texture);
-    }
-    return { xPos, yPos, offsetX, charHeight };
+SDL_Rect renderTextWithCustomSpacing(SDL_Renderer* renderer, int xPos, int yPos, TTF_Font* font, const std::string& text, int customSpacing, SDL_Color color) {
+    if (!font) return { xPos, yPos, 0, 0 };
+    return GlyphAtlas::get(renderer, font).drawText(xPos, yPos, text, color, customSpacing, true);
 }
 
 std::string formatTime(double timeInSeconds, int fps) {
@@ -112,13 +73,9 @@ std::string formatTime(double timeInSeconds, int fps) {
     }
 
     // Format the output with zero-padded values
-    std::ostringstream oss;
-    oss << std::setw(2) << std::setfill('0') << hours << ":"
-        << std::setw(2) << std::setfill('0') << minutes << ":"
-        << std::setw(2) << std::setfill('0') << seconds << ":"
-        << std::setw(2) << std::setfill('0') << frames;
-
-    return oss.str();
+    char text[32];
+    std::snprintf(text, sizeof(text), "%02d:%02d:%02d:%02d", hours, minutes, seconds, frames);
+    return text;
 }
 
 std::string formatTime(Uint32 timeInFrames, int fps) {
@@ -128,11 +85,7 @@ std::string formatTime(Uint32 timeInFrames, int fps) {
     int hours = (timeInFrames - minutes - seconds - frames) / fps / 3600;
 
     // Format the output with zero-padded values
-    std::ostringstream oss;
-    oss << std::setw(2) << std::setfill('0') << hours << ":"
-        << std::setw(2) << std::setfill('0') << minutes << ":"
-        << std::setw(2) << std::setfill('0') << seconds << ":"
-        << std::setw(2) << std::setfill('0') << frames;
-
-    return oss.str();
+    char text[32];
+    std::snprintf(text, sizeof(text), "%02d:%02d:%02d:%02d", hours, minutes, seconds, frames);
+    return text;
 }
@@ -17,7 +17,7 @@ TTF_Font* getFontBig();
 TTF_Font* getFontSmall();
 
 /**
- * @brief Renders some text to the screen at a position.
+ * @brief Renders some text to the screen at a position. The glyphs come from the font's GlyphAtlas, so drawing text creates no textures.
  * @param renderer The SDL_Renderer to use.
  * @param xPos The text's top-left x-position on screen.
  * @param yPos The text's top-left y-position on screen.
@@ -39,7 +39,7 @@ SDL_Rect renderText(SDL_Renderer* renderer, int xPos, int yPos, TTF_Font* font,
  * @param color The text color.
  * @returns The boundary rectangle of the resulting text.
  */
-SDL_Rect renderTextWithCustomSpacing(SDL_Renderer* renderer, int xPos, int yPos, TTF_Font* font, std::string text, int customSpacing, SDL_Color color = { 255, 255, 255, 255 });
+SDL_Rect renderTextWithCustomSpacing(SDL_Renderer* renderer, int xPos, int yPos, TTF_Font* font, const std::string& text, int customSpacing, SDL_Color color = { 255, 255, 255, 255 });
 
 /**
  * @brief Format a double with a time into hh:mm:ss:ff format. (Hours, Minutes, seconds, frames)
@@ -82,6 +82,7 @@ void AssetsListWindow::render() {
 
 void AssetsListWindow::update(int x, int y, int w, int h) {
     rect = { x, y, w, h };
+    invalidate();
 
     // If the list is longer than can be displayed, update the furthest yPos the scroll position can be in. (So when increasing the window size, it will scroll up if possible)
     int assetListLength;
@@ -111,6 +112,7 @@ void AssetsListWindow::handleEvent(SDL_Event& event) {
         // Clamp the scroll position
         if (m_scrollOffset < 0) m_scrollOffset = 0;
         if (m_scrollOffset > assetListLength + m_assetStartYPos - rect.h) m_scrollOffset = assetListLength + m_assetStartYPos - rect.h;
+        invalidate();
         break;
     }
     case SDL_DROPFILE: {
@@ -119,6 +121,7 @@ void AssetsListWindow::handleEvent(SDL_Event& event) {
         const char* droppedFile = event.drop.file;
         loadFile(droppedFile);
         SDL_free(event.drop.file);
+        invalidate();
         break;
     }
     }
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <iostream>
+#include "GlyphAtlas.h"
+#include "Tracer.h"
+
+std::map<std::pair<SDL_Renderer*, TTF_Font*>, std::unique_ptr<GlyphAtlas>> GlyphAtlas::s_atlases;
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer* renderer, TTF_Font* font) : m_renderer(renderer), m_font(font) {
+    m_fontHeight = TTF_FontHeight(m_font);
+
+    // The printable ASCII characters are in nearly every string, rasterise them together up front
+    for (int character = 32; character < 127; character++) {
+        getGlyph(static_cast<Uint8>(character));
+    }
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    for (SDL_Texture* page : m_pages) {
+        SDL_DestroyTexture(page);
+    }
+}
+
+SDL_Rect GlyphAtlas::drawText(int xPos, int yPos, const std::string& text, SDL_Color color, int customSpacing, bool useCustomSpacing) {
+    SDL_Rect textRect = addText(m_batch, xPos, yPos, text, color, customSpacing, useCustomSpacing);
+    m_batch.flush(m_renderer); // One draw call per page, nearly always a single one
+    return textRect;
+}
+
+SDL_Rect GlyphAtlas::addText(RenderBatch& batch, int xPos, int yPos, const std::string& text, SDL_Color color, int customSpacing, bool useCustomSpacing) {
+    if (text.empty()) return { xPos, yPos, 0, 0 };
+    const TextLayout& layout = getLayout(text, customSpacing, useCustomSpacing);
+    for (const Quad& quad : layout.quads) {
+        batch.drawQuad(m_pages[quad.page], { xPos + quad.dest.x, yPos + quad.dest.y, quad.dest.w, quad.dest.h }, quad.uv, color);
+    }
+    return { xPos, yPos, layout.width, layout.height };
+}
+
+GlyphAtlas& GlyphAtlas::get(SDL_Renderer* renderer, TTF_Font* font) {
+    std::unique_ptr<GlyphAtlas>& atlas = s_atlases[{ renderer, font }];
+    if (!atlas) atlas = std::make_unique<GlyphAtlas>(renderer, font);
+    return *atlas;
+}
+
+void GlyphAtlas::releaseAll() {
+    s_atlases.clear();
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(Uint8 character) {
+    Glyph& glyph = m_glyphs[character];
+    if (!glyph.isLoaded) {
+        glyph.isLoaded = true; // Also when it fails, it is not tried again every frame
+        rasteriseGlyph(character, glyph);
+    }
+    return glyph;
+}
+
+bool GlyphAtlas::rasteriseGlyph(Uint8 character, Glyph& glyph) {
+    TRACE_ZONE("GlyphAtlas::rasteriseGlyph");
+    int minX = 0, maxX = 0, minY = 0, maxY = 0;
+    if (character < 32 || TTF_GlyphMetrics32(m_font, character, &minX, &maxX, &minY, &maxY, &glyph.advance) != 0) return false;
+    char text[2] = { static_cast<char>(character), '\0' };
+    int height = 0;
+    TTF_SizeText(m_font, text, &glyph.width, &height);
+    glyph.offsetX = std::min(0, minX);
+    if (maxX <= minX) return true; // Nothing to draw, only the advance
+
+    // White, so the vertex color tints it
+    SDL_Surface* rendered = TTF_RenderGlyph32_Blended(m_font, character, { 255, 255, 255, 255 });
+    if (!rendered) {
+        std::cerr << "Unable to render glyph! SDL_ttf Error: " << TTF_GetError() << std::endl;
+        return false;
+    }
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(rendered);
+    if (!surface) return false;
+
+    // Next shelf, or next page, when the glyph doesn't fit. One pixel apart so filtering never picks up a neighbour.
+    int paddedWidth = surface->w + 1;
+    int paddedHeight = surface->h + 1;
+    if (!m_pages.empty() && m_shelfX + paddedWidth > m_pageSize) {
+        m_shelfX = 0;
+        m_shelfY += m_shelfHeight;
+        m_shelfHeight = 0;
+    }
+    if (m_pages.empty() || m_shelfY + paddedHeight > m_pageSize) {
+        if (paddedWidth > m_pageSize || paddedHeight > m_pageSize || !addPage()) {
+            SDL_FreeSurface(surface);
+            return false;
+        }
+    }
+
+    glyph.page = static_cast<int>(m_pages.size()) - 1;
+    glyph.source = { m_shelfX, m_shelfY, surface->w, surface->h };
+    SDL_UpdateTexture(m_pages.back(), &glyph.source, surface->pixels, surface->pitch);
+    SDL_FreeSurface(surface);
+
+    m_shelfX += paddedWidth;
+    m_shelfHeight = std::max(m_shelfHeight, paddedHeight);
+    return true;
+}
+
+bool GlyphAtlas::addPage() {
+    SDL_Texture* page = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, m_pageSize, m_pageSize);
+    if (!page) {
+        std::cerr << "Unable to create a glyph atlas texture! SDL Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(page, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(page, SDL_ScaleModeNearest); // Glyphs are drawn at their own size
+
+    // Start transparent, a new texture holds whatever the driver gives it
+    std::vector<Uint32> clear(static_cast<size_t>(m_pageSize) * m_pageSize, 0);
+    SDL_UpdateTexture(page, nullptr, clear.data(), m_pageSize * static_cast<int>(sizeof(Uint32)));
+
+    m_pages.push_back(page);
+    m_shelfX = 0;
+    m_shelfY = 0;
+    m_shelfHeight = 0;
+    return true;
+}
+
+const GlyphAtlas::TextLayout& GlyphAtlas::getLayout(const std::string& text, int customSpacing, bool useCustomSpacing) {
+    std::string key = text;
+    key += '\0';
+    key += useCustomSpacing ? std::to_string(customSpacing) : "k";
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end()) return it->second;
+
+    TRACE_ZONE("GlyphAtlas::layout");
+    if (m_layouts.size() >= m_maxLayoutCount) m_layouts.clear();
+
+    TextLayout layout;
+    layout.height = m_fontHeight;
+    int penX = 0;
+    Uint8 previous = 0;
+    for (char c : text) {
+        Uint8 character = static_cast<Uint8>(c);
+        const Glyph& glyph = getGlyph(character);
+        if (!useCustomSpacing && previous != 0) penX += TTF_GetFontKerningSizeGlyphs32(m_font, previous, character);
+        previous = character;
+
+        if (glyph.page >= 0) {
+            float pageSize = static_cast<float>(m_pageSize);
+            layout.quads.push_back({ glyph.page,
+                { static_cast<float>(penX + glyph.offsetX), 0.0f, static_cast<float>(glyph.source.w), static_cast<float>(glyph.source.h) },
+                { glyph.source.x / pageSize, glyph.source.y / pageSize, glyph.source.w / pageSize, glyph.source.h / pageSize } });
+        }
+        penX += useCustomSpacing ? glyph.width + customSpacing : glyph.advance;
+    }
+    layout.width = penX;
+    return m_layouts.emplace(std::move(key), std::move(layout)).first->second;
+}
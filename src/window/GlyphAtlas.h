@@ -0,0 +1,101 @@
+#pragma once
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "RenderBatch.h"
+
+/**
+ * @class GlyphAtlas
+ * @brief Draws text of one font with glyphs rasterised once into shared textures (pages), instead of rendering a surface
+ *        and creating a texture for every call. A string is laid out once and its layout cached, after that drawing it is a
+ *        single SDL_RenderGeometry call per page with one quad per character, tinted by the vertex color. Text can also be
+ *        added to a RenderBatch, to be drawn together with the rest of a frame.
+ *        Text is read as Latin-1, like TTF_RenderText does. Only use it from the thread that renders.
+ */
+class GlyphAtlas {
+public:
+    GlyphAtlas(SDL_Renderer* renderer, TTF_Font* font);
+    ~GlyphAtlas();
+
+    /**
+     * @brief Draw text with its top-left corner at a position.
+     * @param xPos The text's top-left x-position on screen.
+     * @param yPos The text's top-left y-position on screen.
+     * @param text The text to draw.
+     * @param color The text color.
+     * @param customSpacing Pixels added to (or taken from) the width of every character, when useCustomSpacing is set.
+     * @param useCustomSpacing Place characters by their width plus customSpacing, instead of by the font's advance and kerning.
+     * @returns The boundary rectangle of the text.
+     */
+    SDL_Rect drawText(int xPos, int yPos, const std::string& text, SDL_Color color, int customSpacing = 0, bool useCustomSpacing = false);
+
+    // Add text to a batch instead of drawing it right away, takes the same parameters as drawText()
+    SDL_Rect addText(RenderBatch& batch, int xPos, int yPos, const std::string& text, SDL_Color color, int customSpacing = 0, bool useCustomSpacing = false);
+
+    // Get the atlas of a font for a renderer, created the first time
+    static GlyphAtlas& get(SDL_Renderer* renderer, TTF_Font* font);
+
+    // Destroy every atlas and its textures, before the renderer is destroyed or the fonts are closed
+    static void releaseAll();
+
+private:
+    // Where a glyph is in the atlas and how it is placed
+    struct Glyph {
+        int page = -1;             // -1 = not rasterised (yet), or nothing to draw (e.g. a space)
+        SDL_Rect source = { 0, 0, 0, 0 };
+        int offsetX = 0;           // From the pen position to the left of the glyph's image
+        int width = 0;             // Width of the character on its own, what TTF_SizeText measures
+        int advance = 0;           // Distance to the next character
+        bool isLoaded = false;
+    };
+
+    // One character of a laid out string
+    struct Quad {
+        int page;
+        SDL_FRect dest;   // Relative to the text's top-left corner
+        SDL_FRect uv;     // Texture coordinates in the page, 0 to 1
+    };
+
+    // A string placed once, drawn at any position and color
+    struct TextLayout {
+        std::vector<Quad> quads;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Get a glyph, rasterises it into the atlas the first time
+    const Glyph& getGlyph(Uint8 character);
+
+    // Rasterise a glyph into the current page, starting a new page when it is full
+    bool rasteriseGlyph(Uint8 character, Glyph& glyph);
+
+    // Add an empty page, returns false if the texture could not be created
+    bool addPage();
+
+    // Get the layout of a string, laid out and cached the first time
+    const TextLayout& getLayout(const std::string& text, int customSpacing, bool useCustomSpacing);
+
+private:
+    SDL_Renderer* m_renderer;
+    TTF_Font* m_font;
+    int m_fontHeight = 0;
+
+    Glyph m_glyphs[256];                 // Indexed by the Latin-1 character
+    std::vector<SDL_Texture*> m_pages;
+    int m_pageSize = 512;                // Width and height of every page
+    int m_shelfX = 0;                    // Packing position in the last page: glyphs are placed left to right on shelves
+    int m_shelfY = 0;
+    int m_shelfHeight = 0;
+
+    std::unordered_map<std::string, TextLayout> m_layouts; // Keyed by the text, spacing mode and spacing
+    size_t m_maxLayoutCount = 2048;      // The cache is emptied beyond this, e.g. after scrolling through many time labels
+
+    RenderBatch m_batch;                 // Reused by every drawText()
+
+    static std::map<std::pair<SDL_Renderer*, TTF_Font*>, std::unique_ptr<GlyphAtlas>> s_atlases;
+};
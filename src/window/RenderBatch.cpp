@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include "RenderBatch.h"
+
+void RenderBatch::fillRect(const SDL_Rect& rect, SDL_Color color) {
+    if (rect.w <= 0 || rect.h <= 0) return;
+    drawQuad(nullptr, { static_cast<float>(rect.x), static_cast<float>(rect.y), static_cast<float>(rect.w), static_cast<float>(rect.h) }, { 0.0f, 0.0f, 0.0f, 0.0f }, color);
+}
+
+void RenderBatch::drawLine(int x1, int y1, int x2, int y2, SDL_Color color) {
+    // Straight lines are rectangles covering both end points
+    if (x1 == x2 || y1 == y2) {
+        fillRect({ std::min(x1, x2), std::min(y1, y2), std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1 }, color);
+        return;
+    }
+
+    // Other lines are a quad one pixel wide, through the centers of the end pixels
+    float dx = static_cast<float>(x2 - x1);
+    float dy = static_cast<float>(y2 - y1);
+    float length = std::sqrt(dx * dx + dy * dy);
+    float normalX = -dy / length * 0.5f;
+    float normalY = dx / length * 0.5f;
+    float startX = x1 + 0.5f, startY = y1 + 0.5f, endX = x2 + 0.5f, endY = y2 + 0.5f;
+    SDL_FPoint corners[4] = {
+        { startX + normalX, startY + normalY }, { endX + normalX, endY + normalY },
+        { endX - normalX, endY - normalY }, { startX - normalX, startY - normalY } };
+    addQuad(getRun(nullptr), corners, { 0.0f, 0.0f, 0.0f, 0.0f }, color);
+}
+
+void RenderBatch::drawTexture(SDL_Texture* texture, const SDL_Rect* source, const SDL_Rect& dest, SDL_Color color) {
+    if (!texture || dest.w <= 0 || dest.h <= 0) return;
+
+    int width = 0, height = 0;
+    if (SDL_QueryTexture(texture, nullptr, nullptr, &width, &height) != 0 || width <= 0 || height <= 0) return;
+    SDL_FRect uv = { 0.0f, 0.0f, 1.0f, 1.0f };
+    if (source) {
+        uv = { static_cast<float>(source->x) / width, static_cast<float>(source->y) / height,
+            static_cast<float>(source->w) / width, static_cast<float>(source->h) / height };
+    }
+    drawQuad(texture, { static_cast<float>(dest.x), static_cast<float>(dest.y), static_cast<float>(dest.w), static_cast<float>(dest.h) }, uv, color);
+}
+
+void RenderBatch::drawQuad(SDL_Texture* texture, const SDL_FRect& dest, const SDL_FRect& uv, SDL_Color color) {
+    SDL_FPoint corners[4] = {
+        { dest.x, dest.y }, { dest.x + dest.w, dest.y },
+        { dest.x + dest.w, dest.y + dest.h }, { dest.x, dest.y + dest.h } };
+    addQuad(getRun(texture), corners, uv, color);
+}
+
+void RenderBatch::nextLayer() {
+    m_layerStart = m_runCount;
+    m_lastRun = m_runCount;
+}
+
+void RenderBatch::flush(SDL_Renderer* renderer) {
+    for (size_t i = 0; i < m_runCount; i++) {
+        Run& run = m_runs[i];
+        if (!run.indices.empty()) {
+            SDL_RenderGeometry(renderer, run.texture, run.vertices.data(), static_cast<int>(run.vertices.size()),
+                run.indices.data(), static_cast<int>(run.indices.size()));
+        }
+        run.vertices.clear();
+        run.indices.clear();
+    }
+    m_runCount = 0;
+    m_layerStart = 0;
+    m_lastRun = 0;
+}
+
+RenderBatch::Run& RenderBatch::getRun(SDL_Texture* texture) {
+    if (m_lastRun < m_runCount && m_runs[m_lastRun].texture == texture) return m_runs[m_lastRun];
+
+    for (size_t i = m_layerStart; i < m_runCount; i++) {
+        if (m_runs[i].texture == texture) {
+            m_lastRun = i;
+            return m_runs[i];
+        }
+    }
+
+    if (m_runCount == m_runs.size()) m_runs.emplace_back();
+    m_lastRun = m_runCount++;
+    m_runs[m_lastRun].texture = texture;
+    return m_runs[m_lastRun];
+}
+
+void RenderBatch::addQuad(Run& run, const SDL_FPoint (&corners)[4], const SDL_FRect& uv, SDL_Color color) {
+    int first = static_cast<int>(run.vertices.size());
+    run.vertices.push_back({ corners[0], color, { uv.x, uv.y } });
+    run.vertices.push_back({ corners[1], color, { uv.x + uv.w, uv.y } });
+    run.vertices.push_back({ corners[2], color, { uv.x + uv.w, uv.y + uv.h } });
+    run.vertices.push_back({ corners[3], color, { uv.x, uv.y + uv.h } });
+    run.indices.insert(run.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+
+/**
+ * @class RenderBatch
+ * @brief Collects the coloured rectangles, lines and textured quads of a frame into vertex arrays, and draws them with one
+ *        SDL_RenderGeometry call per texture instead of a draw call (and color change) per primitive.
+ *
+ *        Within a layer, everything with the same texture is drawn together in the order it was added: first everything
+ *        without a texture, then every texture in the order it was first used. Things with different textures that overlap
+ *        need nextLayer() in between, whatever is added after it is drawn over everything added before.
+ */
+class RenderBatch {
+public:
+    RenderBatch() = default;
+
+    void fillRect(const SDL_Rect& rect, SDL_Color color);
+
+    // A one pixel wide line, both end points included like SDL_RenderDrawLine
+    void drawLine(int x1, int y1, int x2, int y2, SDL_Color color);
+
+    /**
+     * @brief Draw (part of) a texture into a rectangle.
+     * @param texture The texture to draw.
+     * @param source The part of the texture to draw, nullptr for all of it.
+     * @param dest Where to draw it.
+     * @param color Multiplied with the texture's colors.
+     */
+    void drawTexture(SDL_Texture* texture, const SDL_Rect* source, const SDL_Rect& dest, SDL_Color color = { 255, 255, 255, 255 });
+
+    /**
+     * @brief Draw a quad with texture coordinates, e.g. a glyph of an atlas.
+     * @param texture The texture to sample, nullptr for a flat color.
+     * @param dest Where to draw it.
+     * @param uv The part of the texture, as fractions of its size.
+     * @param color Multiplied with the texture's colors.
+     */
+    void drawQuad(SDL_Texture* texture, const SDL_FRect& dest, const SDL_FRect& uv, SDL_Color color);
+
+    // Start a new layer, drawn over everything added so far
+    void nextLayer();
+
+    // Draw everything added and start over, keeping the memory for the next frame
+    void flush(SDL_Renderer* renderer);
+
+private:
+    // Everything of one texture in one layer
+    struct Run {
+        SDL_Texture* texture = nullptr;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    // Get the run of a texture in the current layer, added the first time
+    Run& getRun(SDL_Texture* texture);
+
+    // Add a quad by its four corners, clockwise from the top-left
+    void addQuad(Run& run, const SDL_FPoint (&corners)[4], const SDL_FRect& uv, SDL_Color color);
+
+private:
+    std::vector<Run> m_runs;  // In drawing order, reused every frame
+    size_t m_runCount = 0;    // Runs in use this frame
+    size_t m_layerStart = 0;  // First run of the current layer
+    size_t m_lastRun = 0;     // Run used last, the next primitive nearly always goes there too
+};
@@ -24,6 +24,9 @@ public:
     void render() override;
     void update(int x, int y, int w, int h) override;
     void handleEvent(SDL_Event& event) override;
+    void renderOverlay() override;
+    bool isDirty() override;
+    bool isAnimating() override;
     Window* findTypeImpl(const std::type_info& type) override;
 
     // Add a video and/or audio segment to the timeline at the mouse position
@@ -45,4 +48,5 @@ private:
     TimelineView m_view;
     TimelineRenderer* m_rendererImpl = nullptr;
     TimelineController* m_controller = nullptr;
+    Uint64 m_drawnVersion = 0; // Timeline version when the window was last drawn
 };
\ No newline at end of file
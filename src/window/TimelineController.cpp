@@ -1,5 +1,6 @@
 #include "TimelineController.h"
 #include "ContextMenu.h"
+#include "ProjectFile.h"
 #include "util.h"
 #include <algorithm>
 #include <type_traits>
@@ -53,6 +54,13 @@ void TimelineController::handleKeyDown(const SDL_Event& event) {
         if (currentTime != 0) m_timeline->setCurrentTime(currentTime - 1);
         break;
     }
+    case SDLK_s:
+        // Save the project, so it can be rendered from the command line
+        if (SDL_GetModState() & KMOD_CTRL) {
+            std::filesystem::path projectPath = ProjectFile::getDefaultPath();
+            if (ProjectFile::save(*m_timeline, projectPath)) std::cout << "Saved project to " << projectPath.string() << std::endl;
+        }
+        break;
     default:
         break;
     }
@@ -212,6 +220,9 @@ void TimelineController::handleMouseButtonDown(const SDL_Event& event, const SDL
                 m_selection->selectedAudioSegments.clear();
                 selectedSegmentsVector.push_back(clickedSegment);
             }
+            if constexpr (std::is_same_v<std::remove_pointer_t<decltype(clickedSegment)>, VideoSegment>) {
+                showVideoSegmentContextMenu(mouseButton.x, mouseButton.y);
+            }
         }
 
         return true;
@@ -254,6 +265,57 @@ void TimelineController::handleMouseButtonDown(const SDL_Event& event, const SDL
     }
 }
 
+void TimelineController::showVideoSegmentContextMenu(int x, int y) {
+    // Create an action that moves and scales the selected segments
+    auto placement = [this](float positionX, float positionY, float scale) {
+        return [this, positionX, positionY, scale]() {
+            SegmentTransform transform;
+            transform.positionX = positionX;
+            transform.positionY = positionY;
+            transform.scale = scale;
+            m_timeline->setSegmentsPlacement(&m_selection->selectedVideoSegments, transform);
+        };
+    };
+    // Create an action that sets the opacity of the selected segments
+    auto opacity = [this](float value) {
+        return [this, value]() { m_timeline->setSegmentsOpacity(&m_selection->selectedVideoSegments, value); };
+    };
+    // Create an action that sets the transition into the selected segments, lasting half a second
+    auto transition = [this](TransitionType type, SDL_Color color = { 0, 0, 0, 255 }) {
+        return [this, type, color]() {
+            SegmentTransition segmentTransition;
+            segmentTransition.type = type;
+            segmentTransition.duration = static_cast<Uint32>(std::max(1, m_timeline->getFPS() / 2));
+            segmentTransition.color = color;
+            m_timeline->setSegmentsTransition(&m_selection->selectedVideoSegments, segmentTransition);
+        };
+    };
+
+    std::vector<ContextMenu::MenuItem> contextMenuOptions = {
+        { "Layout", nullptr, {
+            { "Full Frame",        placement( 0.00f,  0.00f, 1.0f) },
+            { "PiP Top Right",     placement( 0.33f, -0.32f, 0.3f) },
+            { "PiP Bottom Left",   placement(-0.33f,  0.32f, 0.3f) },
+            { "Card (Lower Third)", placement( 0.00f,  0.30f, 0.4f) }
+        }},
+        { "Opacity", nullptr, {
+            { "100%", opacity(1.00f) },
+            { "75%",  opacity(0.75f) },
+            { "50%",  opacity(0.50f) },
+            { "25%",  opacity(0.25f) }
+        }},
+        { "Transition In", nullptr, {
+            { "None",          transition(TRANSITION_NONE) },
+            { "Crossfade",     transition(TRANSITION_CROSSFADE) },
+            { "Dip to Black",  transition(TRANSITION_DIP_TO_COLOR, { 0, 0, 0, 255 }) },
+            { "Dip to White",  transition(TRANSITION_DIP_TO_COLOR, { 255, 255, 255, 255 }) },
+            { "Wipe",          transition(TRANSITION_WIPE) }
+        }},
+        { "Delete Selected Item(s)", [this]() { m_timeline->deleteSegments(&m_selection->selectedVideoSegments, &m_selection->selectedAudioSegments); m_selection->clear(); } }
+    };
+    ContextMenu::show(x, y, contextMenuOptions);
+}
+
 void TimelineController::handleMouseMotion(const SDL_Event& event, const SDL_Rect& rect) {
     SDL_Point mousePoint = { event.motion.x, event.motion.y };
 
@@ -357,6 +419,9 @@ void TimelineController::handleMouseMotion(const SDL_Event& event, const SDL_Rec
             }
         }
 
+        // Resizing modifies the segments directly, so publish the result for readers
+        m_timeline->commit();
+
         return; // while resizing, don't process other interactions
     }
 
@@ -24,6 +24,9 @@ private:
     void handleMouseButtonUp(const SDL_Event& event);
     void handleMouseWheel(const SDL_Event& event);
 
+    // Show the context menu with layout, opacity and delete actions for the selected video segments
+    void showVideoSegmentContextMenu(int x, int y);
+
     Uint32 frameFromMouseX(int mouseX, const SDL_Rect& rect) const;
     Track getTrackID(SDL_Point mousePoint, const SDL_Rect& rect);
     int getTrackPos(int y, const SDL_Rect& rect);
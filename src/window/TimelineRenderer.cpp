@@ -1,118 +1,320 @@
 #include "TimelineRenderer.h"
+#include "AllocationTracker.h"
+#include "GlyphAtlas.h"
+#include "Tracer.h"
 #include "util.h"
 #include <algorithm>
+#include <cstdlib>
+#include <iostream>
 #include <string>
 
+// The first frame shown in a pixel column of the tracks
+static Uint32 getColumnFrame(const TimelineView& view, int column) {
+    return view.scrollOffset + static_cast<Uint32>(static_cast<Uint64>(column) * view.zoom / view.timeLabelInterval);
+}
+
+// The pixel column of the tracks a frame starts in, negative left of the window. Rounded down, so scrolling moves every frame by the same amount.
+static Sint64 getFrameColumn(const TimelineView& view, Uint32 frame) {
+    Sint64 offset = (static_cast<Sint64>(frame) - view.scrollOffset) * view.timeLabelInterval;
+    Sint64 zoom = static_cast<Sint64>(view.zoom);
+    return offset / zoom - (offset % zoom < 0 ? 1 : 0);
+}
+
+// Get by how many pixels everything moves when scrolling from one offset to the other. Only scrolling by whole time labels keeps the labels
+// (which start at the scroll offset) and everything else in place relative to each other, returns false otherwise.
+static bool getScrollShift(const TimelineView& view, Uint32 fromScrollOffset, Uint32 toScrollOffset, int& shift) {
+    Sint64 frames = static_cast<Sint64>(toScrollOffset) - fromScrollOffset;
+    if (frames % static_cast<Sint64>(view.zoom) != 0) return false;
+    shift = static_cast<int>(frames / static_cast<Sint64>(view.zoom) * view.timeLabelInterval);
+    return true;
+}
+
 TimelineRenderer::TimelineRenderer(Timeline* timeline, SDL_Renderer* renderer)
     : m_timeline(timeline), m_renderer(renderer) {}
 
+TimelineRenderer::~TimelineRenderer() {
+    discardLayers();
+}
+
 void TimelineRenderer::render(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection) {
+    TRACE_ZONE("TimelineRenderer::render");
+    ALLOCATION_TAG("Timeline");
+    int columnCount = std::max(0, rect.w - view.trackStartXPos);
+    bool isRenderBarRebuilt = updateRenderBar(columnCount, view);
+
+    if (!updateLayers(rect.w, rect.h)) {
+        renderLayer(rect, view, 0, columnCount);
+        return;
+    }
+
+    // Resizing a segment edits it in place, without a new version
+    Uint64 version = m_timeline->getVersion();
+    bool isSameContent = m_isLayerValid && !isRenderBarRebuilt && !selection.isResizing && view.zoom == m_layerZoom && version == m_layerVersion;
+    int shift = 0;
+    bool isShifted = isSameContent && getScrollShift(view, m_layerScrollOffset, view.scrollOffset, shift) && std::abs(shift) < columnCount;
+
+    // Drawing into the layer resets the clipping of the target render() draws to
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(m_renderer);
+    SDL_Rect previousClipRect;
+    bool isClipped = SDL_RenderIsClipEnabled(m_renderer);
+    SDL_RenderGetClipRect(m_renderer, &previousClipRect);
+
+    SDL_Rect layerRect = { 0, 0, rect.w, rect.h };
+    if (!isShifted) {
+        SDL_SetRenderTarget(m_renderer, m_layers[m_currentLayer]);
+        renderLayer(layerRect, view, 0, columnCount);
+    }
+    else if (shift != 0) {
+        int nextLayer = 1 - m_currentLayer;
+        SDL_SetRenderTarget(m_renderer, m_layers[nextLayer]);
+
+        // The track data on the left stays in place, the tracks (and the ruler above them) move by the shift
+        SDL_Rect trackDataRect = { 0, 0, std::min(view.trackStartXPos, rect.w), rect.h };
+        SDL_RenderCopy(m_renderer, m_layers[m_currentLayer], &trackDataRect, &trackDataRect);
+        int keptWidth = columnCount - std::abs(shift);
+        SDL_Rect sourceRect = { view.trackStartXPos + std::max(shift, 0), 0, keptWidth, rect.h };
+        SDL_Rect destRect = { view.trackStartXPos + std::max(-shift, 0), 0, keptWidth, rect.h };
+        SDL_RenderCopy(m_renderer, m_layers[m_currentLayer], &sourceRect, &destRect);
+        m_currentLayer = nextLayer;
+
+        // Only the strip that scrolled into view
+        if (shift > 0) renderLayer(layerRect, view, keptWidth, columnCount);
+        else renderLayer(layerRect, view, 0, -shift);
+    }
+
+    SDL_SetRenderTarget(m_renderer, previousTarget);
+    if (isClipped) SDL_RenderSetClipRect(m_renderer, &previousClipRect);
+    SDL_RenderCopy(m_renderer, m_layers[m_currentLayer], nullptr, &rect);
+
+    m_isLayerValid = true;
+    m_layerScrollOffset = view.scrollOffset;
+    m_layerZoom = view.zoom;
+    m_layerVersion = version;
+}
+
+void TimelineRenderer::renderOverlay(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection) {
+    TRACE_ZONE("TimelineRenderer::renderOverlay");
+    NO_ALLOCATIONS("timeline overlay"); // Drawn every frame
+    SDL_Rect tracksRect = { rect.x + view.trackStartXPos, rect.y, rect.w - view.trackStartXPos, rect.h };
+    if (tracksRect.w <= 0 || tracksRect.h <= 0) return;
+
+    SDL_RenderSetClipRect(m_renderer, &tracksRect);
+    renderSelection(rect, view, selection);
+    renderTimeIndicator(rect, view);
+    m_batch.flush(m_renderer);
+}
+
+bool TimelineRenderer::isRenderBarOutdated() const {
+    return RenderCache::shared().getGeneration() != m_renderBarGeneration && SDL_GetTicks64() - m_renderBarUpdatedAt >= m_renderBarUpdateInterval;
+}
+
+void TimelineRenderer::discardLayers() {
+    for (SDL_Texture*& layer : m_layers) {
+        if (layer) SDL_DestroyTexture(layer);
+        layer = nullptr;
+    }
+    m_layerWidth = 0;
+    m_layerHeight = 0;
+    m_isLayerValid = false;
+}
+
+bool TimelineRenderer::updateLayers(int width, int height) {
+    if (!m_isLayerSupported || width <= 0 || height <= 0) return false;
+    if (m_layers[0] && m_layers[1] && width == m_layerWidth && height == m_layerHeight) return true;
+
+    discardLayers();
+    if (SDL_RenderTargetSupported(m_renderer)) {
+        for (SDL_Texture*& layer : m_layers) {
+            layer = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+            if (layer) SDL_SetTextureBlendMode(layer, SDL_BLENDMODE_NONE);
+        }
+    }
+    if (!m_layers[0] || !m_layers[1]) {
+        std::cerr << "Unable to create the timeline layer textures, the timeline is drawn from scratch every time! SDL Error: " << SDL_GetError() << std::endl;
+        discardLayers();
+        m_isLayerSupported = false;
+        return false;
+    }
+    m_layerWidth = width;
+    m_layerHeight = height;
+    return true;
+}
+
+void TimelineRenderer::renderLayer(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn) {
+    int columnCount = std::max(0, rect.w - view.trackStartXPos);
+    bool isStrip = firstColumn > 0 || lastColumn < columnCount;
+    SDL_Rect tracksRect = { rect.x + view.trackStartXPos + firstColumn, rect.y, lastColumn - firstColumn, rect.h };
+    if (isStrip) SDL_RenderSetClipRect(m_renderer, &tracksRect);
+
     // Background
-    SDL_SetRenderDrawColor(m_renderer, 42, 46, 50, 255);
-    SDL_RenderFillRect(m_renderer, &rect);
+    m_batch.fillRect(rect, { 42, 46, 50, 255 });
 
-    renderTopBar(rect, view);
+    // Everything is collected into the batch and drawn at the end with a few draw calls.
+    // Thumbnails and labels only cover their own segment or track, so they share a layer with the rectangles below them.
+    renderTopBar(rect, view, firstColumn, lastColumn);
+    renderRenderBar(rect, view);
     renderVideoTracks(rect, view);
-    renderVideoSegments(rect, view, selection);
     renderAudioTracks(rect, view);
-    renderAudioSegments(rect, view, selection);
-    renderTimeIndicator(rect, view);
+
+    // Segments are cut off at the left of the tracks, they scroll under the track data
+    if (tracksRect.w > 0) {
+        if (!isStrip) {
+            m_batch.flush(m_renderer);
+            SDL_RenderSetClipRect(m_renderer, &tracksRect);
+        }
+        renderVideoSegments(rect, view, firstColumn, lastColumn);
+        renderAudioSegments(rect, view, firstColumn, lastColumn);
+    }
+    m_batch.flush(m_renderer);
+    SDL_RenderSetClipRect(m_renderer, nullptr);
 }
 
-void TimelineRenderer::renderTopBar(const SDL_Rect& rect, const TimelineView& view) {
-    int xPos = rect.x + view.trackStartXPos;
+void TimelineRenderer::renderTopBar(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn) {
+    // Labels reach to the right of their position, start at the one before the first column
+    int firstLabel = std::max(0, firstColumn / view.timeLabelInterval - 1);
+    int xPos = rect.x + view.trackStartXPos + firstLabel * view.timeLabelInterval;
     int yPos = rect.y;
-    Uint32 timeLabel = view.scrollOffset;
-    SDL_SetRenderDrawColor(m_renderer, view.timeLabelColor.r, view.timeLabelColor.g, view.timeLabelColor.b, view.timeLabelColor.a);
+    Uint32 timeLabel = view.scrollOffset + firstLabel * view.zoom;
+    GlyphAtlas& atlas = GlyphAtlas::get(m_renderer, getFont());
 
-    while (xPos < rect.x + rect.w) {
-        SDL_Rect textRect = renderTextWithCustomSpacing(m_renderer, xPos, yPos,
-            getFont(), formatTime(timeLabel, m_timeline->getFPS()).c_str(),
-            -1, view.timeLabelColor);
+    while (xPos < rect.x + view.trackStartXPos + lastColumn) {
+        SDL_Rect textRect = atlas.addText(m_batch, xPos, yPos, getTimeLabel(timeLabel), view.timeLabelColor, -1, true);
 
-        SDL_RenderDrawLine(m_renderer, xPos, rect.y + textRect.h, xPos, rect.y + view.topBarheight);
-        SDL_RenderDrawLine(m_renderer, xPos + view.timeLabelInterval / 2, rect.y + (int)(textRect.h * 1.5), xPos + view.timeLabelInterval / 2, rect.y + view.topBarheight);
+        m_batch.drawLine(xPos, rect.y + textRect.h, xPos, rect.y + view.topBarheight, view.timeLabelColor);
+        m_batch.drawLine(xPos + view.timeLabelInterval / 2, rect.y + (int)(textRect.h * 1.5), xPos + view.timeLabelInterval / 2, rect.y + view.topBarheight, view.timeLabelColor);
 
         xPos += view.timeLabelInterval;
         timeLabel += view.zoom;
     }
 }
 
+const std::string& TimelineRenderer::getTimeLabel(Uint32 frame) {
+    int fps = m_timeline->getFPS();
+    if (fps != m_timeLabelFps || m_timeLabels.size() > 1024) {
+        m_timeLabels.clear();
+        m_timeLabelFps = fps;
+    }
+
+    auto it = m_timeLabels.find(frame);
+    if (it == m_timeLabels.end()) it = m_timeLabels.emplace(frame, formatTime(frame, fps)).first;
+    return it->second;
+}
+
+bool TimelineRenderer::updateRenderBar(int columnCount, const TimelineView& view) {
+    std::shared_ptr<const TimelineSnapshot> snapshot = m_timeline->acquireSnapshot();
+    RenderCache& renderCache = RenderCache::shared();
+
+    // Hashing every column is too slow to do each frame, only update when the view or timeline changed, or the cache did a while ago
+    bool isSameContent = snapshot->version == m_renderBarVersion && view.zoom == m_renderBarZoom
+        && columnCount == static_cast<int>(m_renderBarColumns.size()) && !isRenderBarOutdated();
+    if (isSameContent && view.scrollOffset == m_renderBarScrollOffset) return false;
+
+    // When scrolled by whole time labels, the columns still in view move along and only the new ones are checked
+    int shift = 0;
+    bool isShifted = isSameContent && getScrollShift(view, m_renderBarScrollOffset, view.scrollOffset, shift);
+    std::vector<bool> previousColumns = std::move(m_renderBarColumns);
+    m_renderBarColumns.assign(columnCount, false);
+    std::vector<VideoLayerRef> layers; // Reused for every column
+    for (int column = 0; column < columnCount; column++) {
+        int previousColumn = column + shift;
+        if (isShifted && previousColumn >= 0 && previousColumn < columnCount) {
+            m_renderBarColumns[column] = previousColumns[previousColumn];
+            continue;
+        }
+        Uint32 frame = getColumnFrame(view, column);
+        snapshot->getVideoLayers(frame, layers);
+        if (!RenderCache::isWorthCaching(layers)) continue;
+        m_renderBarColumns[column] = renderCache.contains(renderCache.computeFrameHash(*snapshot, frame, layers));
+    }
+
+    m_renderBarScrollOffset = view.scrollOffset;
+    if (isShifted) return false;
+    m_renderBarVersion = snapshot->version;
+    m_renderBarGeneration = renderCache.getGeneration();
+    m_renderBarZoom = view.zoom;
+    m_renderBarUpdatedAt = SDL_GetTicks64();
+    return true;
+}
+
+void TimelineRenderer::renderRenderBar(const SDL_Rect& rect, const TimelineView& view) {
+    // Draw a line along the bottom of the top bar for every run of cached columns
+    int columnCount = static_cast<int>(m_renderBarColumns.size());
+    int yPos = rect.y + view.topBarheight - view.renderBarHeight;
+    int runStart = -1;
+    for (int column = 0; column <= columnCount; column++) {
+        bool isCached = column < columnCount && m_renderBarColumns[column];
+        if (isCached && runStart < 0) runStart = column;
+        if (!isCached && runStart >= 0) {
+            SDL_Rect barRect = { rect.x + view.trackStartXPos + runStart, yPos, column - runStart, view.renderBarHeight };
+            m_batch.fillRect(barRect, view.renderBarColor);
+            runStart = -1;
+        }
+    }
+}
+
 void TimelineRenderer::renderVideoTracks(const SDL_Rect& rect, const TimelineView& view) {
     for (int i = 0; i < m_timeline->getVideoTrackCount(); i++) {
         int trackYpos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() - 1 - i) * view.rowHeight;
+        if (!isRowVisible(rect, view, trackYpos)) continue;
 
         SDL_Rect backgroundRect = { rect.x, trackYpos, rect.w, view.rowHeight };
-        SDL_SetRenderDrawColor(m_renderer, view.betweenLineColor.r, view.betweenLineColor.g, view.betweenLineColor.b, view.betweenLineColor.a);
-        SDL_RenderFillRect(m_renderer, &backgroundRect);
+        m_batch.fillRect(backgroundRect, view.betweenLineColor);
 
         SDL_Rect videoTrackDataRect = { rect.x, trackYpos + 1, view.trackDataWidth, view.trackHeight };
-        SDL_SetRenderDrawColor(m_renderer, view.videoTrackDataColor.r, view.videoTrackDataColor.g, view.videoTrackDataColor.b, view.videoTrackDataColor.a);
-        SDL_RenderFillRect(m_renderer, &videoTrackDataRect);
+        m_batch.fillRect(videoTrackDataRect, view.videoTrackDataColor);
         {
             std::string label = std::string("V") + std::to_string(i);
-            renderText(m_renderer,
+            GlyphAtlas::get(m_renderer, getFontBig()).addText(m_batch,
                 videoTrackDataRect.x + videoTrackDataRect.w / 4,
                 videoTrackDataRect.y + videoTrackDataRect.h / 4,
-                getFontBig(),
-                label.c_str(), view.timeLabelColor);
+                label, view.timeLabelColor);
         }
 
         SDL_Rect videoTrackRect = { rect.x + view.trackStartXPos, trackYpos + 1, rect.w - view.trackStartXPos, view.trackHeight };
-        SDL_SetRenderDrawColor(m_renderer, view.videoTrackBGColor.r, view.videoTrackBGColor.g, view.videoTrackBGColor.b, view.videoTrackBGColor.a);
-        SDL_RenderFillRect(m_renderer, &videoTrackRect);
+        m_batch.fillRect(videoTrackRect, view.videoTrackBGColor);
     }
 }
 
-void TimelineRenderer::renderVideoSegments(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection) {
+void TimelineRenderer::renderVideoSegments(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn) {
     const auto* segments = m_timeline->getAllVideoSegments();
     if (!segments) return;
+    int trackCount = m_timeline->getVideoTrackCount();
+    updateTrackIndex(m_videoTrackIndex, *segments, trackCount, [this](int trackID) { return m_timeline->getVideoTrackPos(trackID); });
 
-    for (const VideoSegment& segment : *segments) {
-        if (view.scrollOffset > segment.timelinePosition + segment.timelineDuration) continue;
+    for (int trackPos = 0; trackPos < trackCount; trackPos++) {
+        int trackYpos = rect.y + view.topBarheight + (trackCount - 1 - trackPos) * view.rowHeight;
+        if (!isRowVisible(rect, view, trackYpos)) continue;
 
-        Uint32 xPos = segment.timelinePosition - view.scrollOffset;
-        int diff = 0;
-        if (view.scrollOffset > segment.timelinePosition) {
-            xPos = 0;
-            diff = view.scrollOffset - segment.timelinePosition;
-        }
-
-        int renderXPos = rect.x + view.trackStartXPos + xPos * view.timeLabelInterval / view.zoom;
-        int trackPos = m_timeline->getVideoTrackPos(segment.trackID);
-        int renderYPos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() - 1 - trackPos) * view.rowHeight;
-        int renderWidth = (segment.timelineDuration - diff) * view.timeLabelInterval / view.zoom;
+        renderTrackSegments(rect, view, firstColumn, lastColumn, *segments, m_videoTrackIndex.tracks[trackPos], trackYpos, view.videoTrackSegmentColor,
+            [this, &view](const VideoSegment& segment, int renderXPos, int renderYPos, int renderWidth) {
+                drawVideoSegment(view, segment, renderXPos, renderYPos, renderWidth);
+            });
+    }
+}
 
-        SDL_Rect outlineRect = { renderXPos - 1, renderYPos - 1, renderWidth + 2, view.trackHeight + 2 };
-        if (std::find(selection.selectedVideoSegments.begin(), selection.selectedVideoSegments.end(), &segment) != selection.selectedVideoSegments.end()) {
-            SDL_SetRenderDrawColor(m_renderer, view.segmentHighlightColor.r, view.segmentHighlightColor.g, view.segmentHighlightColor.b, view.segmentHighlightColor.a);
-        }
-        else {
-            SDL_SetRenderDrawColor(m_renderer, view.segmentOutlineColor.r, view.segmentOutlineColor.g, view.segmentOutlineColor.b, view.segmentOutlineColor.a);
-        }
-        SDL_RenderFillRect(m_renderer, &outlineRect);
-
-        SDL_Rect segmentRect = { renderXPos + 1, renderYPos + 1, renderWidth - 2, view.trackHeight - 2 };
-        SDL_SetRenderDrawColor(m_renderer, view.videoTrackSegmentColor.r, view.videoTrackSegmentColor.g, view.videoTrackSegmentColor.b, view.videoTrackSegmentColor.a);
-        SDL_RenderFillRect(m_renderer, &segmentRect);
-
-        int videoFrameWidth = 0, videoFrameHeight = 0;
-        SDL_QueryTexture(segment.firstFrame, nullptr, nullptr, &videoFrameWidth, &videoFrameHeight);
-        if (videoFrameWidth > 0 && videoFrameHeight > 0) {
-            int frameInTrackWidth = (view.trackHeight - 2) * videoFrameWidth / videoFrameHeight;
-            int firstFrameWidth = std::min(renderWidth - 2, frameInTrackWidth);
-            SDL_Rect firstFrameRect = { renderXPos + 1, renderYPos + 1, firstFrameWidth, view.trackHeight - 2 };
-            int sourceWidth = videoFrameWidth * firstFrameWidth / frameInTrackWidth;
-            SDL_Rect sourceRect = { 0, 0, sourceWidth, videoFrameHeight };
-            SDL_RenderCopy(m_renderer, segment.firstFrame, &sourceRect, &firstFrameRect);
-
-            int renderWidthLeftOver = renderWidth - 2 - firstFrameWidth;
-            if (renderWidthLeftOver > 0) {
-                int lastFrameWidth = std::min(renderWidthLeftOver, frameInTrackWidth);
-                SDL_Rect lastFrameRect = { renderXPos + renderWidth - 1 - lastFrameWidth, renderYPos + 1, lastFrameWidth, view.trackHeight - 2 };
-                sourceRect.w = videoFrameWidth * lastFrameWidth / frameInTrackWidth;
-                SDL_RenderCopy(m_renderer, segment.lastFrame, &sourceRect, &lastFrameRect);
-            }
+void TimelineRenderer::drawVideoSegment(const TimelineView& view, const VideoSegment& segment, int renderXPos, int renderYPos, int renderWidth) {
+    SDL_Rect outlineRect = { renderXPos - 1, renderYPos - 1, renderWidth + 2, view.trackHeight + 2 };
+    m_batch.fillRect(outlineRect, view.segmentOutlineColor);
+
+    SDL_Rect segmentRect = { renderXPos + 1, renderYPos + 1, renderWidth - 2, view.trackHeight - 2 };
+    m_batch.fillRect(segmentRect, view.videoTrackSegmentColor);
+
+    int videoFrameWidth = 0, videoFrameHeight = 0;
+    SDL_QueryTexture(segment.firstFrame, nullptr, nullptr, &videoFrameWidth, &videoFrameHeight);
+    if (videoFrameWidth > 0 && videoFrameHeight > 0) {
+        int frameInTrackWidth = (view.trackHeight - 2) * videoFrameWidth / videoFrameHeight;
+        int firstFrameWidth = std::min(renderWidth - 2, frameInTrackWidth);
+        SDL_Rect firstFrameRect = { renderXPos + 1, renderYPos + 1, firstFrameWidth, view.trackHeight - 2 };
+        int sourceWidth = videoFrameWidth * firstFrameWidth / frameInTrackWidth;
+        SDL_Rect sourceRect = { 0, 0, sourceWidth, videoFrameHeight };
+        m_batch.drawTexture(segment.firstFrame, &sourceRect, firstFrameRect);
+
+        int renderWidthLeftOver = renderWidth - 2 - firstFrameWidth;
+        if (renderWidthLeftOver > 0) {
+            int lastFrameWidth = std::min(renderWidthLeftOver, frameInTrackWidth);
+            SDL_Rect lastFrameRect = { renderXPos + renderWidth - 1 - lastFrameWidth, renderYPos + 1, lastFrameWidth, view.trackHeight - 2 };
+            sourceRect.w = videoFrameWidth * lastFrameWidth / frameInTrackWidth;
+            m_batch.drawTexture(segment.lastFrame, &sourceRect, lastFrameRect);
         }
     }
 }
@@ -120,72 +322,184 @@ void TimelineRenderer::renderVideoSegments(const SDL_Rect& rect, const TimelineV
 void TimelineRenderer::renderAudioTracks(const SDL_Rect& rect, const TimelineView& view) {
     for (int i = 0; i < m_timeline->getAudioTrackCount(); i++) {
         int trackYpos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() + i) * view.rowHeight;
+        if (!isRowVisible(rect, view, trackYpos)) continue;
 
         SDL_Rect backgroundRect = { rect.x, trackYpos, rect.w, view.rowHeight };
-        SDL_SetRenderDrawColor(m_renderer, view.betweenLineColor.r, view.betweenLineColor.g, view.betweenLineColor.b, view.betweenLineColor.a);
-        SDL_RenderFillRect(m_renderer, &backgroundRect);
+        m_batch.fillRect(backgroundRect, view.betweenLineColor);
 
         SDL_Rect audioTrackDataRect = { rect.x, trackYpos + 1, view.trackDataWidth, view.trackHeight };
-        SDL_SetRenderDrawColor(m_renderer, view.audioTrackDataColor.r, view.audioTrackDataColor.g, view.audioTrackDataColor.b, view.audioTrackDataColor.a);
-        SDL_RenderFillRect(m_renderer, &audioTrackDataRect);
+        m_batch.fillRect(audioTrackDataRect, view.audioTrackDataColor);
         {
             std::string label = std::string("A") + std::to_string(i);
-            renderText(m_renderer,
+            GlyphAtlas::get(m_renderer, getFontBig()).addText(m_batch,
                 audioTrackDataRect.x + audioTrackDataRect.w / 4,
                 audioTrackDataRect.y + audioTrackDataRect.h / 4,
-                getFontBig(),
-                label.c_str(), view.timeLabelColor);
+                label, view.timeLabelColor);
         }
 
         SDL_Rect audioTrackRect = { rect.x + view.trackStartXPos, trackYpos + 1, rect.w - view.trackStartXPos, view.trackHeight };
-        SDL_SetRenderDrawColor(m_renderer, view.audioTrackBGColor.r, view.audioTrackBGColor.g, view.audioTrackBGColor.b, view.audioTrackBGColor.a);
-        SDL_RenderFillRect(m_renderer, &audioTrackRect);
+        m_batch.fillRect(audioTrackRect, view.audioTrackBGColor);
     }
 }
 
-void TimelineRenderer::renderAudioSegments(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection) {
+void TimelineRenderer::renderAudioSegments(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn) {
     const auto* segments = m_timeline->getAllAudioSegments();
     if (!segments) return;
+    int trackCount = m_timeline->getAudioTrackCount();
+    updateTrackIndex(m_audioTrackIndex, *segments, trackCount, [this](int trackID) { return m_timeline->getAudioTrackPos(trackID); });
 
-    for (const AudioSegment& segment : *segments) {
-        if (view.scrollOffset > segment.timelinePosition + segment.timelineDuration) continue;
+    for (int trackPos = 0; trackPos < trackCount; trackPos++) {
+        int trackYpos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() + trackPos) * view.rowHeight;
+        if (!isRowVisible(rect, view, trackYpos)) continue;
 
-        Uint32 xPos = segment.timelinePosition - view.scrollOffset;
-        int diff = 0;
-        if (view.scrollOffset > segment.timelinePosition) {
-            xPos = 0;
-            diff = view.scrollOffset - segment.timelinePosition;
-        }
+        renderTrackSegments(rect, view, firstColumn, lastColumn, *segments, m_audioTrackIndex.tracks[trackPos], trackYpos, view.audioTrackSegmentColor,
+            [this, &view](const AudioSegment&, int renderXPos, int renderYPos, int renderWidth) {
+                drawAudioSegment(view, renderXPos, renderYPos, renderWidth);
+            });
+    }
+}
 
-        int renderXPos = rect.x + view.trackStartXPos + xPos * view.timeLabelInterval / view.zoom;
-        int trackPos = m_timeline->getAudioTrackPos(segment.trackID);
-        int renderYPos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() + trackPos) * view.rowHeight;
-        int renderWidth = (segment.timelineDuration - diff) * view.timeLabelInterval / view.zoom;
+void TimelineRenderer::drawAudioSegment(const TimelineView& view, int renderXPos, int renderYPos, int renderWidth) {
+    SDL_Rect outlineRect = { renderXPos - 1, renderYPos - 1, renderWidth + 2, view.trackHeight + 2 };
+    m_batch.fillRect(outlineRect, view.segmentOutlineColor);
 
-        SDL_Rect outlineRect = { renderXPos - 1, renderYPos - 1, renderWidth + 2, view.trackHeight + 2 };
-        if (std::find(selection.selectedAudioSegments.begin(), selection.selectedAudioSegments.end(), &segment) != selection.selectedAudioSegments.end()) {
-            SDL_SetRenderDrawColor(m_renderer, view.segmentHighlightColor.r, view.segmentHighlightColor.g, view.segmentHighlightColor.b, view.segmentHighlightColor.a);
-        } else {
-            SDL_SetRenderDrawColor(m_renderer, view.segmentOutlineColor.r, view.segmentOutlineColor.g, view.segmentOutlineColor.b, view.segmentOutlineColor.a);
+    SDL_Rect segmentRect = { renderXPos + 1, renderYPos + 1, renderWidth - 2, view.trackHeight - 2 };
+    m_batch.fillRect(segmentRect, view.audioTrackSegmentColor);
+}
+
+bool TimelineRenderer::isRowVisible(const SDL_Rect& rect, const TimelineView& view, int trackYpos) const {
+    return trackYpos < rect.y + rect.h && trackYpos + view.rowHeight > rect.y + view.topBarheight;
+}
+
+template <typename Segment, typename GetTrackPos>
+void TimelineRenderer::updateTrackIndex(TrackIndex& index, const std::vector<Segment>& segments, int trackCount, GetTrackPos getTrackPos) {
+    // Edits commit a new version, in-place resizing (which never reorders a track) only changes positions and durations
+    Uint64 version = m_timeline->getVersion();
+    if (index.isBuilt && index.version == version && index.segmentData == segments.data()
+        && index.segmentCount == segments.size() && static_cast<int>(index.tracks.size()) == trackCount) return;
+
+    index.tracks.resize(trackCount);
+    for (std::vector<size_t>& track : index.tracks) track.clear();
+    for (size_t i = 0; i < segments.size(); i++) {
+        int trackPos = getTrackPos(segments[i].trackID);
+        if (trackPos >= 0 && trackPos < trackCount) index.tracks[trackPos].push_back(i);
+    }
+    for (std::vector<size_t>& track : index.tracks) {
+        std::sort(track.begin(), track.end(), [&segments](size_t a, size_t b) { return segments[a].timelinePosition < segments[b].timelinePosition; });
+    }
+
+    index.version = version;
+    index.segmentData = segments.data();
+    index.segmentCount = segments.size();
+    index.isBuilt = true;
+}
+
+template <typename Segment, typename DrawSegment>
+void TimelineRenderer::renderTrackSegments(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn, const std::vector<Segment>& segments,
+    const std::vector<size_t>& trackSegments, int trackYpos, SDL_Color color, DrawSegment drawSegment) {
+    if (trackSegments.empty()) return;
+    int tracksXPos = rect.x + view.trackStartXPos;
+    auto getEnd = [&segments](size_t i) { return segments[i].timelinePosition + segments[i].timelineDuration; };
+
+    // Outlines reach a pixel past their segment, so also the segments right next to the columns
+    Uint32 firstFrame = getColumnFrame(view, std::max(0, firstColumn - 1));
+    Uint32 lastFrame = getColumnFrame(view, lastColumn + 1);
+
+    // Draw the run of covered columns [runStart, runEnd) as a single bar
+    int runStart = -1, runEnd = -1;
+    auto drawCoverageBar = [&]() {
+        SDL_Rect outlineRect = { tracksXPos + runStart, trackYpos - 1, runEnd - runStart, view.trackHeight + 2 };
+        m_batch.fillRect(outlineRect, view.segmentOutlineColor);
+        SDL_Rect barRect = { tracksXPos + runStart, trackYpos + 1, runEnd - runStart, view.trackHeight - 2 };
+        m_batch.fillRect(barRect, color);
+        runStart = -1;
+    };
+
+    // Skip everything left of the columns
+    auto it = std::partition_point(trackSegments.begin(), trackSegments.end(), [&](size_t i) { return getEnd(i) < firstFrame; });
+    while (it != trackSegments.end()) {
+        const Segment& segment = segments[*it];
+        if (segment.timelinePosition > lastFrame) break; // Right of the columns, and so is the rest
+
+        // Placed by where the segment starts, also when that is left of the window, so every segment moves along when scrolling
+        Sint64 startColumn = getFrameColumn(view, segment.timelinePosition);
+        Sint64 endColumn = getFrameColumn(view, getEnd(*it));
+        int renderWidth = static_cast<int>(endColumn - startColumn);
+
+        if (renderWidth >= m_minSegmentWidth) {
+            if (runStart >= 0) drawCoverageBar();
+            drawSegment(segment, tracksXPos + static_cast<int>(startColumn), trackYpos, renderWidth);
+            ++it;
+            continue;
         }
-        SDL_RenderFillRect(m_renderer, &outlineRect);
 
-        SDL_Rect segmentRect = { renderXPos + 1, renderYPos + 1, renderWidth - 2, view.trackHeight - 2 };
-        SDL_SetRenderDrawColor(m_renderer, view.audioTrackSegmentColor.r, view.audioTrackSegmentColor.g, view.audioTrackSegmentColor.b, view.audioTrackSegmentColor.a);
-        SDL_RenderFillRect(m_renderer, &segmentRect);
+        // Too narrow to tell apart, merge it into the bar (a gap of a pixel or more starts a new one)
+        int column = static_cast<int>(std::max<Sint64>(startColumn, 0));
+        int columnEnd = static_cast<int>(std::max<Sint64>(endColumn, column + 1));
+        if (runStart >= 0 && column > runEnd) drawCoverageBar();
+        if (runStart < 0) runStart = column;
+        runEnd = std::max(runEnd, columnEnd);
+
+        // Everything ending within the covered columns adds nothing to the bar, jump past it.
+        // Every step either covers another column or draws a segment of several pixels, so a track costs O(width * log n).
+        Uint32 coveredUntil = getColumnFrame(view, runEnd);
+        it = std::partition_point(it + 1, trackSegments.end(), [&](size_t i) { return getEnd(i) <= coveredUntil; });
+    }
+    if (runStart >= 0) drawCoverageBar();
+}
+
+void TimelineRenderer::renderSelection(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection) {
+    // Only pointers into the timeline's current segments, a stale selection is not drawn
+    const auto* videoSegments = m_timeline->getAllVideoSegments();
+    for (const VideoSegment* segment : selection.selectedVideoSegments) {
+        if (!videoSegments || videoSegments->empty() || segment < &videoSegments->front() || segment > &videoSegments->back()) continue;
+        int trackPos = m_timeline->getVideoTrackPos(segment->trackID);
+        int trackYpos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() - 1 - trackPos) * view.rowHeight;
+        renderSelectionOutline(rect, view, segment->timelinePosition, segment->timelineDuration, trackYpos);
+    }
+
+    const auto* audioSegments = m_timeline->getAllAudioSegments();
+    for (const AudioSegment* segment : selection.selectedAudioSegments) {
+        if (!audioSegments || audioSegments->empty() || segment < &audioSegments->front() || segment > &audioSegments->back()) continue;
+        int trackPos = m_timeline->getAudioTrackPos(segment->trackID);
+        int trackYpos = rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() + trackPos) * view.rowHeight;
+        renderSelectionOutline(rect, view, segment->timelinePosition, segment->timelineDuration, trackYpos);
+    }
+}
+
+void TimelineRenderer::renderSelectionOutline(const SDL_Rect& rect, const TimelineView& view, Uint32 timelinePosition, Uint32 timelineDuration, int trackYpos) {
+    if (!isRowVisible(rect, view, trackYpos)) return;
+    Sint64 startColumn = getFrameColumn(view, timelinePosition);
+    Sint64 endColumn = getFrameColumn(view, timelinePosition + timelineDuration);
+    if (endColumn < -1 || startColumn > rect.w - view.trackStartXPos) return;
+
+    int renderWidth = static_cast<int>(endColumn - startColumn);
+    int tracksXPos = rect.x + view.trackStartXPos;
+    if (renderWidth >= m_minSegmentWidth) {
+        // The band between the segment's outline rectangle and its inside
+        int renderXPos = tracksXPos + static_cast<int>(startColumn);
+        m_batch.fillRect({ renderXPos - 1, trackYpos - 1, renderWidth + 2, 2 }, view.segmentHighlightColor);
+        m_batch.fillRect({ renderXPos - 1, trackYpos + view.trackHeight - 1, renderWidth + 2, 2 }, view.segmentHighlightColor);
+        m_batch.fillRect({ renderXPos - 1, trackYpos + 1, 2, view.trackHeight - 2 }, view.segmentHighlightColor);
+        m_batch.fillRect({ renderXPos + renderWidth - 1, trackYpos + 1, 2, view.trackHeight - 2 }, view.segmentHighlightColor);
+    }
+    else {
+        // Merged into a coverage bar, which only has an outline above and below
+        int column = static_cast<int>(std::max<Sint64>(startColumn, 0));
+        int columnEnd = static_cast<int>(std::max<Sint64>(endColumn, column + 1));
+        m_batch.fillRect({ tracksXPos + column, trackYpos - 1, columnEnd - column, 2 }, view.segmentHighlightColor);
+        m_batch.fillRect({ tracksXPos + column, trackYpos + view.trackHeight - 1, columnEnd - column, 2 }, view.segmentHighlightColor);
     }
 }
 
 void TimelineRenderer::renderTimeIndicator(const SDL_Rect& rect, const TimelineView& view) {
     if (view.scrollOffset <= m_timeline->getCurrentTime()) {
         int indicatorX = view.trackStartXPos + (m_timeline->getCurrentTime() - view.scrollOffset) * view.timeLabelInterval / view.zoom;
-        SDL_SetRenderDrawColor(m_renderer, view.timeIndicatorColor.r, view.timeIndicatorColor.g, view.timeIndicatorColor.b, view.timeIndicatorColor.a);
-
-        SDL_RenderDrawLine(m_renderer, rect.x + indicatorX, rect.y, rect.x + indicatorX, rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() + m_timeline->getAudioTrackCount()) * view.rowHeight);
+        m_batch.drawLine(rect.x + indicatorX, rect.y, rect.x + indicatorX, rect.y + view.topBarheight + (m_timeline->getVideoTrackCount() + m_timeline->getAudioTrackCount()) * view.rowHeight, view.timeIndicatorColor);
 
         if (view.zoom <= view.indicatorFrameDisplayThreshold) {
             int indicatorXplus1 = indicatorX + view.timeLabelInterval / view.zoom;
-            SDL_RenderDrawLine(m_renderer, rect.x + indicatorX, rect.y + view.topBarheight, rect.x + indicatorXplus1, rect.y + view.topBarheight);
+            m_batch.drawLine(rect.x + indicatorX, rect.y + view.topBarheight, rect.x + indicatorXplus1, rect.y + view.topBarheight, view.timeIndicatorColor);
         }
     }
 }
@@ -1,23 +1,133 @@
 #pragma once
 
 #include <SDL.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "Timeline.h"
 #include "TimelineSelectionManager.h"
 #include "TimelineView.h"
+#include "RenderCache.h"
+#include "RenderBatch.h"
 
+/**
+ * @class TimelineRenderer
+ * @brief Draws the timeline in two layers. The static layer (ruler, render bar, tracks and segments) is kept in a texture and only
+ *        drawn again when it changed: scrolling shifts the previous layer and only draws the strip that scrolled into view.
+ *        The overlay (playhead and selection) is drawn over it every frame.
+ */
 class TimelineRenderer {
 public:
     TimelineRenderer(Timeline* timeline, SDL_Renderer* renderer);
+    ~TimelineRenderer();
+
+    // Draw the static layer into rect, updating what changed since the last call
     void render(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection);
 
+    // Draw the playhead and the selection, over what render() drew. It changes more often, so it is drawn every frame instead of kept.
+    void renderOverlay(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection);
+
+    // Whether the render bar is due for an update, because frames were added to or removed from the render cache
+    bool isRenderBarOutdated() const;
+
+    // Destroy the layer textures, e.g. when the renderer lost its render targets. They are created again on the next render().
+    void discardLayers();
+
 private:
     Timeline* m_timeline;
     SDL_Renderer* m_renderer;
+    RenderBatch m_batch; // Everything of a frame, drawn at the end of render()
+
+    // The static layer, two textures take turns since a texture can't be copied onto itself when scrolling
+    SDL_Texture* m_layers[2] = { nullptr, nullptr };
+    int m_currentLayer = 0;        // The texture holding the last drawn layer
+    int m_layerWidth = 0;
+    int m_layerHeight = 0;
+    bool m_isLayerValid = false;   // Whether the current texture holds a complete layer
+    bool m_isLayerSupported = true; // False when render targets are not available, everything is drawn straight away then
+    Uint32 m_layerScrollOffset = 0; // The view and timeline the current layer was drawn with
+    Uint32 m_layerZoom = 0;
+    Uint64 m_layerVersion = 0;
+
+    // Render bar: whether the frame at every pixel column of the tracks is in the render cache
+    std::vector<bool> m_renderBarColumns;
+    Uint64 m_renderBarVersion = 0;
+    Uint64 m_renderBarGeneration = 0;
+    Uint32 m_renderBarScrollOffset = 0;
+    Uint32 m_renderBarZoom = 0;
+    Uint64 m_renderBarUpdatedAt = 0; // SDL_GetTicks64() of the last update
+    Uint64 m_renderBarUpdateInterval = 500; // Milliseconds between updates when only the cache changed
+
+    // Formatted time labels of the top bar by frame, the same few are drawn every frame
+    std::unordered_map<Uint32, std::string> m_timeLabels;
+    int m_timeLabelFps = 0; // The fps the labels were formatted at
+
+    // Indices of the segments of every track (by trackPos), sorted by timeline position. Segments on a track never overlap,
+    // so their ends are sorted too and the first visible one is found with a binary search.
+    struct TrackIndex {
+        std::vector<std::vector<size_t>> tracks;
+        Uint64 version = 0;                // Timeline version it was built at
+        const void* segmentData = nullptr; // The segment vector's storage it indexes
+        size_t segmentCount = 0;
+        bool isBuilt = false;
+    };
+    TrackIndex m_videoTrackIndex;
+    TrackIndex m_audioTrackIndex;
+    int m_minSegmentWidth = 4; // Segments narrower than this (in pixels) are merged into coverage bars
+
+    // Get the formatted time label of a frame
+    const std::string& getTimeLabel(Uint32 frame);
+
+    // Create the layer textures at the window's size, returns false if render targets are not available
+    bool updateLayers(int width, int height);
+
+    /**
+     * @brief Draw the static layer, or the part of it between two pixel columns of the tracks.
+     * @param rect Where to draw the whole layer.
+     * @param firstColumn The first pixel column (from the left of the tracks) to draw.
+     * @param lastColumn The column after the last one to draw.
+     */
+    void renderLayer(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn);
+
+    /**
+     * @brief Update which columns of the render bar are cached. Scrolling by whole time labels only checks the new columns.
+     * @returns True if the columns changed in any other way than by scrolling, so the whole layer has to be drawn again.
+     */
+    bool updateRenderBar(int columnCount, const TimelineView& view);
+
+    // Rebuild a track index when the timeline changed since it was built
+    template <typename Segment, typename GetTrackPos>
+    void updateTrackIndex(TrackIndex& index, const std::vector<Segment>& segments, int trackCount, GetTrackPos getTrackPos);
+
+    /**
+     * @brief Render the segments of one track between two pixel columns. Segments of at least m_minSegmentWidth pixels are drawn by
+     *        drawSegment, runs of narrower ones are merged into one coverage bar per run of covered pixel columns. The work is bounded
+     *        by the width drawn, not the amount of segments on the track.
+     * @param trackSegments The track's segment indices, sorted by timeline position.
+     * @param trackYpos The top of the track's row on screen.
+     * @param color The color of the track's segments.
+     * @param drawSegment Called as drawSegment(segment, renderXPos, renderYPos, renderWidth).
+     */
+    template <typename Segment, typename DrawSegment>
+    void renderTrackSegments(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn, const std::vector<Segment>& segments,
+        const std::vector<size_t>& trackSegments, int trackYpos, SDL_Color color, DrawSegment drawSegment);
+
+    // Draw a video / audio segment that is wide enough to be drawn on its own
+    void drawVideoSegment(const TimelineView& view, const VideoSegment& segment, int renderXPos, int renderYPos, int renderWidth);
+    void drawAudioSegment(const TimelineView& view, int renderXPos, int renderYPos, int renderWidth);
+
+    // Draw the highlighted outline of a selected segment over its normal outline
+    void renderSelectionOutline(const SDL_Rect& rect, const TimelineView& view, Uint32 timelinePosition, Uint32 timelineDuration, int trackYpos);
+
+    // Whether a track row starting at trackYpos is (partly) inside the tracks area of rect
+    bool isRowVisible(const SDL_Rect& rect, const TimelineView& view, int trackYpos) const;
 
-    void renderTopBar(const SDL_Rect& rect, const TimelineView& view);
+    void renderTopBar(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn);
+    void renderRenderBar(const SDL_Rect& rect, const TimelineView& view);
     void renderVideoTracks(const SDL_Rect& rect, const TimelineView& view);
-    void renderVideoSegments(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection);
+    void renderVideoSegments(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn);
     void renderAudioTracks(const SDL_Rect& rect, const TimelineView& view);
-    void renderAudioSegments(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection);
+    void renderAudioSegments(const SDL_Rect& rect, const TimelineView& view, int firstColumn, int lastColumn);
+    void renderSelection(const SDL_Rect& rect, const TimelineView& view, const TimelineSelectionManager& selection);
     void renderTimeIndicator(const SDL_Rect& rect, const TimelineView& view);
 };
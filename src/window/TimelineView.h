@@ -9,6 +9,7 @@ struct TimelineView {
     int scrollSpeed = 10;
     int timeLabelInterval = 70;
     int topBarheight = 30;
+    int renderBarHeight = 3;
     Uint8 indicatorFrameDisplayThreshold = 8;
     int trackDataWidth = 100;
     int trackStartXPos = trackDataWidth + 2;
@@ -29,4 +30,5 @@ struct TimelineView {
     SDL_Color timeIndicatorColor    = { 255, 255, 255, 255 }; // White
     SDL_Color betweenLineColor      = {  30,  33,  36, 255 }; // Dark Gray
     SDL_Color timeLabelColor        = { 180, 180, 180, 255 }; // Light Gray
+    SDL_Color renderBarColor        = {  64, 190,  90, 255 }; // Green
 };
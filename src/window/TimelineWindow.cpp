@@ -23,15 +23,39 @@ TimeLineWindow::~TimeLineWindow() {
 }
 
 void TimeLineWindow::render() {
+    m_drawnVersion = m_timeline->getVersion();
     m_rendererImpl->render(rect, m_view, m_selection);
 }
 
+void TimeLineWindow::renderOverlay() {
+    SDL_RenderSetClipRect(p_renderer, &rect);
+    m_rendererImpl->renderOverlay(rect, m_view, m_selection);
+    SDL_RenderSetClipRect(p_renderer, nullptr);
+}
+
 void TimeLineWindow::handleEvent(SDL_Event& event) {
     m_controller->handleEvent(event, rect);
+
+    // The kept layers are lost with the render targets
+    if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) m_rendererImpl->discardLayers();
+
+    // Moving the mouse only changes the cursor, unless something is being dragged
+    bool isHovering = event.type == SDL_MOUSEMOTION && !m_selection.isHolding && !m_selection.isDragging && !m_selection.isResizing
+        && !m_selection.isPreparingResize && !m_selection.isMovingCurrentTime;
+    if (!isHovering) invalidate();
+}
+
+bool TimeLineWindow::isDirty() {
+    return p_isDirty || m_timeline->getVersion() != m_drawnVersion || m_rendererImpl->isRenderBarOutdated();
+}
+
+bool TimeLineWindow::isAnimating() {
+    return m_timeline->isPlaying(); // The playhead moves
 }
 
 void TimeLineWindow::update(int x, int y, int w, int h) {
     rect = { x, y, w, h };
+    invalidate();
 }
 
 void TimeLineWindow::deleteSelectedSegments() {
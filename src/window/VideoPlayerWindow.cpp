@@ -2,6 +2,10 @@
 #include <iostream>
 #include "TimelineWindow.h"
 #include "VideoPlayerWindow.h"
+#include "AllocationTracker.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "util.h"
 
 VideoPlayerWindow::VideoPlayerWindow(Timeline* timeline, int x, int y, int w, int h, SDL_Renderer* renderer, EventManager* eventManager, Window* parent, SDL_Color color)
     : Window(x, y, w, h, renderer, eventManager, parent, color)
@@ -47,11 +51,30 @@ void VideoPlayerWindow::render() {
     renderTimeline();
 }
 
-void VideoPlayerWindow::handleEvent(SDL_Event& event) { }
+void VideoPlayerWindow::renderOverlay() {
+    if (m_isMetricsOverlayVisible) renderMetricsOverlay();
+}
+
+void VideoPlayerWindow::handleEvent(SDL_Event& event) {
+    if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F8) {
+        m_isMetricsOverlayVisible = !m_isMetricsOverlayVisible;
+    }
+}
+
+bool VideoPlayerWindow::isDirty() {
+    // Drawn again when the frame to show changed, and when playback starts or stops (to start or stop the audio)
+    return p_isDirty || m_timeline->isPlaying() != m_isPlaying || m_timeline->getCurrentTime() != m_lastRenderedTime
+        || m_timeline->getVersion() != m_lastRenderedVersion;
+}
+
+bool VideoPlayerWindow::isAnimating() {
+    return m_timeline->isPlaying(); // Audio is queued and frames are shown every frame
+}
 
 void VideoPlayerWindow::update(int x, int y, int w, int h) {
     rect = { x, y, w, h };
     setVideoRect(&rect);
+    invalidate();
 }
 
 void VideoPlayerWindow::setVideoRect(SDL_Rect* rect) {
@@ -70,8 +93,12 @@ void VideoPlayerWindow::setVideoRect(SDL_Rect* rect) {
 }
 
 void VideoPlayerWindow::renderTimeline() {
-    // Get the current video segment from the timeline
-    VideoSegment* currentVideoSegment = m_timeline->getCurrentVideoSegment();
+    // Acquire the latest committed timeline state, it stays consistent for the rest of this frame
+    m_snapshot = m_timeline->acquireSnapshot();
+    m_isPlaying = m_timeline->isPlaying();
+
+    // Prepare the segments right ahead of the playhead
+    m_prefetch.update(*m_snapshot, m_timeline->getCurrentTime(), m_isPlaying);
 
     if (m_timeline->isPlaying()) {
         playAudio();
@@ -80,21 +107,70 @@ void VideoPlayerWindow::renderTimeline() {
         pausePlayback();
     }
 
-    if (currentVideoSegment) {
-        renderFrame(currentVideoSegment);
-    }
+    renderFrame();
 }
 
 void VideoPlayerWindow::playAudio() {
     // Get the current audio segment (if applicable)
-    AudioSegment* currentAudioSegment = m_timeline->getCurrentAudioSegment();
+    const AudioSegment* currentAudioSegment = m_snapshot->getCurrentAudioSegment(m_timeline->getCurrentTime());
+
+    // The audio of the next segment is already queued behind the current one, keep feeding the next one
+    if (m_handedOffSegmentID != 0) {
+        if (!currentAudioSegment || currentAudioSegment->segmentID == m_handedOffSegmentID) {
+            currentAudioSegment = m_snapshot->findAudioSegment(m_lastAudioSegmentID);
+        }
+        else {
+            m_handedOffSegmentID = 0; // The playhead reached the next segment (or jumped elsewhere)
+        }
+    }
+
     if (!currentAudioSegment) {
         // Pause audio if no audio segments found at the current timeline position.
         SDL_PauseAudioDevice(m_audioDevice, 1);
+        m_handedOffSegmentID = 0;
+        m_wasAudioQueued = false;
         return;
     }
 
     playAudioSegment(currentAudioSegment);
+
+    if (m_isAudioSegmentDone && m_handedOffSegmentID == 0) {
+        handOffToNextAudioSegment(currentAudioSegment);
+    }
+}
+
+bool VideoPlayerWindow::queueAudioPreroll(const AudioSegment* audioSegment, double fromTime) {
+    AudioPreroll preroll;
+    if (!m_prefetch.takeAudioPreroll(audioSegment->segmentID, preroll)) return false;
+    if (fromTime < preroll.startTime || fromTime >= preroll.endTime) return false;
+
+    // Skip what the playhead already passed, at a whole sample frame
+    const int bytesPerFrame = av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) * 2;
+    size_t offset = static_cast<size_t>((fromTime - preroll.startTime) * 44100) * bytesPerFrame;
+    if (offset >= preroll.samples.size()) return false;
+
+    if (SDL_QueueAudio(m_audioDevice, preroll.samples.data() + offset, static_cast<Uint32>(preroll.samples.size() - offset)) < 0) {
+        std::cerr << "Error queueing audio: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    m_nextAudioTime = preroll.endTime;
+    return true;
+}
+
+void VideoPlayerWindow::handOffToNextAudioSegment(const AudioSegment* audioSegment) {
+    // Only a segment that starts exactly where this one ends, anything else has silence in between
+    const AudioSegment* nextAudioSegment = m_snapshot->getCurrentAudioSegment(audioSegment->timelinePosition + audioSegment->timelineDuration);
+    if (!nextAudioSegment || nextAudioSegment->segmentID == audioSegment->segmentID) return;
+
+    double startTime = nextAudioSegment->sourceStartTime / static_cast<double>(m_snapshot->fps);
+    if (!queueAudioPreroll(nextAudioSegment, startTime)) return;
+
+    // Continue decoding the next segment after its preroll, once the playhead gets there playAudioSegment sees it as the current one
+    m_lastAudioSegmentID = nextAudioSegment->segmentID;
+    m_lastAudioSegmentPos = nextAudioSegment->timelinePosition;
+    m_isAudioSegmentDone = false;
+    m_isAudioPositioned = false;
+    m_handedOffSegmentID = audioSegment->segmentID;
 }
 
 void VideoPlayerWindow::pausePlayback() {
@@ -102,36 +178,153 @@ void VideoPlayerWindow::pausePlayback() {
     SDL_PauseAudioDevice(m_audioDevice, 1);
 
     // Reset last segments
-    m_lastVideoSegment = m_startVideoSegment;
-    m_lastAudioSegment = nullptr;
+    m_lastAudioSegmentID = 0;
+    m_handedOffSegmentID = 0;
+    m_wasAudioQueued = false;
 }
 
-void VideoPlayerWindow::renderFrame(VideoSegment* videoSegment) {
-    Uint32 currentVideoSegmentFrame = getCurrentTimeInSegment(videoSegment);
+void VideoPlayerWindow::renderFrame() {
+    TRACE_ZONE("VideoPlayerWindow::renderFrame");
+    Uint32 currentTime = m_timeline->getCurrentTime();
+
+    // Only composite again if the time or the timeline changed
+    if (currentTime != m_lastRenderedTime || m_snapshot->version != m_lastRenderedVersion) {
+        static Metrics::Histogram& frameTime = Metrics::shared().histogram("player.frameMs");
+        Metrics::ScopedTimer frameTimer(frameTime);
+        m_renderCount++;
+
+        // Once playing, the layer lookup reuses the vector the frames before it filled. Decoding, compositing and the
+        // caches still allocate for frames they haven't seen, so they are outside the region.
+        m_layers.reserve(m_snapshot->videoTrackIDtoPosMap.size());
+        {
+            NO_ALLOCATIONS_IF("playback", m_isPlaying);
+            m_snapshot->getVideoLayers(currentTime, m_layers);
+        }
+        releaseInactiveDecoders(m_layers);
 
-    if (currentVideoSegmentFrame != m_lastVideoSegmentFrame) {
-        // Get and decode the video frame at the corresponding time in the segment
-        if (!getVideoFrame(videoSegment)) {
-            std::cerr << "Failed to retrieve video frame during playback." << std::endl;
-            return;
+        // Sections with several layers or a transition are played from the render cache once they were composited
+        RenderCache& renderCache = RenderCache::shared();
+        Uint64 frameHash = RenderCache::isWorthCaching(m_layers) ? renderCache.computeFrameHash(*m_snapshot, currentTime, m_layers) : 0;
+        if (frameHash != 0 && renderCache.load(frameHash, m_compositeFrame)) {
+            m_hasFrame = true;
+        }
+        else {
+            // A composite with a stale or missing layer must not be served again once the real frame decodes
+            bool isExact = false;
+            m_hasFrame = m_compositor.composite(*m_snapshot, currentTime, m_layers, *this, m_compositeFrame, &isExact);
+            if (m_hasFrame && isExact && frameHash != 0) renderCache.store(frameHash, m_compositeFrame);
+
+            // Return the decoders of segments that are hidden below other layers. Only after compositing, on a cache hit
+            // no decoder is used and the visible segments keep theirs for the first frame that is not cached.
+            std::erase_if(m_segmentDecoders, [this](const auto& entry) { return entry.second.lastUsed != m_renderCount; });
+        }
+        m_isTextureStale = true;
+
+        if (m_isPlaying && m_hasFrame) {
+            static Metrics::Counter& framesPresented = Metrics::shared().counter("player.framesPresented");
+            static Metrics::Counter& framesSkipped = Metrics::shared().counter("player.framesSkipped");
+            framesPresented.add();
+
+            // The playhead moved on more than a frame since the last one shown, the frames in between were never shown.
+            // Jumps of a second or more are the user moving the playhead.
+            if (m_lastRenderedTime != UINT32_MAX && currentTime > m_lastRenderedTime + 1 && currentTime - m_lastRenderedTime < static_cast<Uint32>(m_snapshot->fps)) {
+                framesSkipped.add(currentTime - m_lastRenderedTime - 1);
+            }
         }
-        m_lastVideoSegmentFrame = currentVideoSegmentFrame;
-        m_startVideoSegment = videoSegment;
+
+        m_lastRenderedTime = currentTime;
+        m_lastRenderedVersion = m_snapshot->version;
     }
 
-    renderFrameToScreen(videoSegment);
+    if (m_hasFrame) {
+        renderFrameToScreen();
+    }
 }
 
-void VideoPlayerWindow::renderFrameToScreen(VideoSegment* videoSegment) {
-    if (!videoSegment->videoData->rgbFrame) return;
+bool VideoPlayerWindow::getSegmentFrame(const VideoSegment& segment, Uint32 frameInSegment, LayerFrame& frame) {
+    if (!segment.videoData || !segment.videoData->formatContext) {
+        std::cerr << "Invalid video segment" << std::endl;
+        return false;
+    }
+    SegmentDecoder* segmentDecoder = findSegmentDecoder(segment.segmentID);
+
+    // Frames decoded before come from the frame cache, so revisiting a section doesn't decode it again
+    FrameCache& frameCache = FrameCache::shared();
+    const char* filepath = segment.videoData->formatContext->url;
+    segmentDecoder->cachedFrame = frameCache.get(filepath, frameInSegment, m_snapshot->fps);
+    if (segmentDecoder->cachedFrame) {
+        frame.data = segmentDecoder->cachedFrame->pixels.data();
+        frame.linesize = segmentDecoder->cachedFrame->linesize;
+        frame.width = segmentDecoder->cachedFrame->width;
+        frame.height = segmentDecoder->cachedFrame->height;
+        return true;
+    }
 
-    static int s_lastFrameWidth = 0, s_lastFrameHeight = 0;
+    VideoDecoder* decoder = getSegmentDecoder(segmentDecoder, segment, frameInSegment);
+    if (!decoder) return false;
 
-    int frameWidth = videoSegment->videoData->codecContext->width;
-    int frameHeight = videoSegment->videoData->codecContext->height;
+    // Get and decode the video frame at the corresponding time in the segment
+    bool isDecoded = decoder->getVideoFrame(frameInSegment, m_snapshot->fps, m_isPlaying);
+    if (!isDecoded) {
+        std::cerr << "Failed to retrieve video frame during playback." << std::endl;
+        if (decoder->getRGBFrame()) {
+            static Metrics::Counter& framesRepeated = Metrics::shared().counter("player.framesRepeated");
+            framesRepeated.add();
+        }
+    }
+
+    // Show the last decoded frame if decoding failed
+    const AVFrame* rgbFrame = decoder->getRGBFrame();
+    if (!rgbFrame) return false;
+
+    frame.data = rgbFrame->data[0];
+    frame.linesize = rgbFrame->linesize[0];
+    frame.width = decoder->getWidth();
+    frame.height = decoder->getHeight();
+    frame.isExact = isDecoded;
+
+    if (isDecoded) {
+        frameCache.put(filepath, frameInSegment, m_snapshot->fps, frame.data, frame.width, frame.height, frame.linesize);
+    }
+    return true;
+}
+
+VideoPlayerWindow::SegmentDecoder* VideoPlayerWindow::findSegmentDecoder(Uint32 segmentID) {
+    // The map is only locked for the lookup, every segment's decoder is used by one thread at a time
+    std::lock_guard<std::mutex> lock(m_segmentDecodersMutex);
+    SegmentDecoder* segmentDecoder = &m_segmentDecoders[segmentID];
+    segmentDecoder->lastUsed = m_renderCount;
+    return segmentDecoder;
+}
+
+VideoDecoder* VideoPlayerWindow::getSegmentDecoder(SegmentDecoder* segmentDecoder, const VideoSegment& segment, Uint32 frameInSegment) {
+    if (!segmentDecoder->lease && !segmentDecoder->hasFailed) {
+        // Take the decoder prefetched before the segment started, it already holds the first frame
+        segmentDecoder->lease = m_prefetch.takeVideoDecoder(segment.segmentID);
+        if (!segmentDecoder->lease) {
+            segmentDecoder->lease = DecoderPool::shared().acquire(segment.videoData->formatContext->url, segment.segmentID, frameInSegment, Demuxer::s_playbackOwner);
+        }
+        segmentDecoder->hasFailed = !segmentDecoder->lease;
+    }
+    return segmentDecoder->lease.get();
+}
+
+void VideoPlayerWindow::releaseInactiveDecoders(const std::vector<VideoLayerRef>& layers) {
+    std::erase_if(m_segmentDecoders, [&layers](const auto& entry) {
+        for (const VideoLayerRef& layer : layers) {
+            if (layer.segment->segmentID == entry.first) return false;
+            if (layer.incoming && layer.incoming->segmentID == entry.first) return false;
+        }
+        return true;
+        });
+}
+
+void VideoPlayerWindow::renderFrameToScreen() {
+    int frameWidth = m_compositeFrame.width;
+    int frameHeight = m_compositeFrame.height;
 
     // Create an SDL texture if not already created or if size has changed
-    if (!m_videoTexture || frameWidth != s_lastFrameWidth || frameHeight != s_lastFrameHeight) {
+    if (!m_videoTexture || frameWidth != m_videoTextureWidth || frameHeight != m_videoTextureHeight) {
         if (m_videoTexture) SDL_DestroyTexture(m_videoTexture);  // Free existing texture
         m_videoTexture = SDL_CreateTexture(
             p_renderer,
@@ -144,17 +337,17 @@ void VideoPlayerWindow::renderFrameToScreen(VideoSegment* videoSegment) {
             std::cerr << "Failed to create SDL texture: " << SDL_GetError() << std::endl;
             return;
         }
-        s_lastFrameWidth = frameWidth;
-        s_lastFrameHeight = frameHeight;
+        m_videoTextureWidth = frameWidth;
+        m_videoTextureHeight = frameHeight;
+        m_isTextureStale = true;
     }
 
     // Copy frame data to the texture
-    SDL_UpdateTexture(
-        m_videoTexture,
-        nullptr,
-        videoSegment->videoData->rgbFrame->data[0],
-        videoSegment->videoData->rgbFrame->linesize[0]
-    );
+    if (m_isTextureStale) {
+        TRACE_ZONE("SDL_UpdateTexture");
+        SDL_UpdateTexture(m_videoTexture, nullptr, m_compositeFrame.pixels.data(), m_compositeFrame.linesize);
+        m_isTextureStale = false;
+    }
 
     SDL_Rect destRect = m_videoRect;
 
@@ -176,213 +369,190 @@ void VideoPlayerWindow::renderFrameToScreen(VideoSegment* videoSegment) {
     SDL_RenderCopy(p_renderer, m_videoTexture, nullptr, &destRect);
 }
 
-bool VideoPlayerWindow::getVideoFrame(VideoSegment* videoSegment) {
-    if (!videoSegment) {
-        std::cerr << "Invalid video segment" << std::endl;
-        return false;
+void VideoPlayerWindow::playAudioSegment(const AudioSegment* audioSegment) {
+    TRACE_ZONE("VideoPlayerWindow::playAudioSegment");
+    ALLOCATION_TAG("Audio");
+    if (!audioSegment || !audioSegment->audioData || !audioSegment->audioData->demuxer) {
+        std::cerr << "Invalid audio segment" << std::endl;
+        return;
     }
 
-    Uint32 currentFrame = getCurrentTimeInSegment(videoSegment);
+    AudioData* audioData = audioSegment->audioData;
+    Demuxer* demuxer = audioData->demuxer.get();
+    AVRational timeBase = audioData->formatContext->streams[audioData->streamIndex]->time_base;
+    double fps = m_snapshot->fps;
 
-    // Check if we need to seek
-    bool isNewSegment = m_lastVideoSegment != videoSegment;
-    bool isPausedAndFrameChanged = !m_timeline->isPlaying() && currentFrame != m_lastVideoSegmentFrame;
-    bool isPlayingAndFrameAhead  =  m_timeline->isPlaying() && currentFrame < m_lastVideoSegmentFrame;
-    bool isPlayingAndFrameBehind =  m_timeline->isPlaying() && currentFrame > m_lastVideoSegmentFrame + m_framebehindSeekThreshold;
+    // Start from the current time if this is a new segment
+    if (m_lastAudioSegmentID != audioSegment->segmentID || audioSegment->timelinePosition != m_lastAudioSegmentPos) {
+        Uint32 currentFrame = m_timeline->getCurrentTime() - audioSegment->timelinePosition + audioSegment->sourceStartTime;
+        m_nextAudioTime = currentFrame / fps;
+        m_isAudioSegmentDone = false;
+        m_isAudioPositioned = false;
 
-    if (isNewSegment || isPausedAndFrameChanged || isPlayingAndFrameBehind || isPlayingAndFrameAhead) {
-        // Get the timestamp in the stream's time base
-        AVRational timeBase = videoSegment->videoData->formatContext->streams[videoSegment->videoData->streamIndex]->time_base;
-        
-        // Convert the desired frame number to a timestamp
-        int64_t targetTimestamp = av_rescale_q(currentFrame, { 1, m_timeline->getFPS()}, timeBase);
-
-        if (av_seek_frame(videoSegment->videoData->formatContext, videoSegment->videoData->streamIndex, targetTimestamp, AVSEEK_FLAG_BACKWARD) < 0) {
-            std::cerr << "Error seeking video to timestamp: " << targetTimestamp << std::endl;
-            return false;
-        }
+        // Clear the audio queue
+        SDL_ClearQueuedAudio(m_audioDevice);
 
-        // Flush the codec context buffers to clear any data from previous frames.
-        avcodec_flush_buffers(videoSegment->videoData->codecContext);
+        // If the segment was prefetched, its start plays right away while the reader seeks past it
+        queueAudioPreroll(audioSegment, m_nextAudioTime);
 
-        m_lastVideoSegment = videoSegment;
+        m_lastAudioSegmentID = audioSegment->segmentID;
+        m_lastAudioSegmentPos = audioSegment->timelinePosition;
+        m_wasAudioQueued = false;
     }
 
-    // Decode and display the frame
-    return decodeAndProcessFrame(videoSegment, currentFrame);
-}
-
-bool VideoPlayerWindow::decodeAndProcessFrame(VideoSegment* videoSegment, Uint32 currentFrame) {
-    AVPacket packet;
-    while (av_read_frame(videoSegment->videoData->formatContext, &packet) >= 0) {
-        if (packet.stream_index == videoSegment->videoData->streamIndex) {
-            // Send packet to the decoder
-            if (avcodec_send_packet(videoSegment->videoData->codecContext, &packet) != 0) {
-                av_packet_unref(&packet);
-                continue;
-            }
+    // The device played everything queued before more was decoded, it went silent in between
+    if (m_wasAudioQueued && !m_isAudioSegmentDone && SDL_GetQueuedAudioSize(m_audioDevice) == 0) {
+        static Metrics::Counter& underruns = Metrics::shared().counter("audio.underruns");
+        underruns.add();
+    }
 
-            // Receive the frame from the decoder
-            if (avcodec_receive_frame(videoSegment->videoData->codecContext, videoSegment->videoData->frame) == 0) {
-                if (processFrame(videoSegment, currentFrame)) {
-                    av_packet_unref(&packet); // Free the packet
-                    return true; // Successfully got the frame
-                }
+    // The reader is shared with the video. If the video just seeked to right before the audio we need, continue from there instead of seeking again.
+    Uint32 serial = demuxer->getSerial(audioData->streamIndex);
+    if (!m_isAudioPositioned || serial != m_audioSerial) {
+        double seekTime = demuxer->getSeekTime(audioData->streamIndex);
+        bool isPositionedBySharedSeek = serial != m_audioSerial && seekTime >= 0.0 && seekTime <= m_nextAudioTime && m_nextAudioTime - seekTime <= m_audioSeekTolerance;
+
+        if (!isPositionedBySharedSeek) {
+            // Convert the wanted time to a timestamp in the stream's time base
+            int64_t timestamp = static_cast<int64_t>(m_nextAudioTime / av_q2d(timeBase));
+            if (!demuxer->seek(audioData->streamIndex, timestamp)) {
+                std::cerr << "Error seeking audio to timestamp: " << timestamp << std::endl;
+                return;
             }
+            static Metrics::Counter& audioSeeks = Metrics::shared().counter("audio.seeks");
+            audioSeeks.add();
         }
-        av_packet_unref(&packet); // Free the packet
-    }
-    return false; // No frame found or error occurred
-}
 
-bool VideoPlayerWindow::processFrame(VideoSegment* videoSegment, Uint32 currentFrame) {
-    auto stream = videoSegment->videoData->formatContext->streams[videoSegment->videoData->streamIndex];
-
-    // Calculate the frame's presentation timestamp in frames (frame index)
-    double framePTS = videoSegment->videoData->frame->pts * av_q2d(stream->time_base);
+        // Flush the codec context buffers to clear any data from previous audio frames.
+        avcodec_flush_buffers(audioData->codecContext);
+        m_audioSerial = demuxer->getSerial(audioData->streamIndex);
+        m_isAudioPositioned = true;
+    }
 
-    // Adjust the frame's timing based on the target frame rate
-    double adjustedFramePTS = framePTS * m_timeline->getFPS();
+    // Source time (in seconds) where the segment ends
+    double endTime = (audioSegment->sourceStartTime + audioSegment->timelineDuration) / fps;
 
-    Uint32 currentPlaybackFrame = getCurrentTimeInSegment(videoSegment);
+    // Only decode enough to keep a little audio queued, reading the whole segment at once would also pile up the video packets of the shared reader
+    AVPacket packet;
+    Uint32 packetSerial = m_audioSerial;
+    while (!m_isAudioSegmentDone && SDL_GetQueuedAudioSize(m_audioDevice) < m_audioQueueTarget) {
+        if (demuxer->readPacket(audioData->streamIndex, &packet, &packetSerial) < 0) {
+            m_isAudioSegmentDone = true; // End of the file
+            break;
+        }
 
-    // Check if the frame is too late
-    if (adjustedFramePTS + m_frameDropThreshold < currentPlaybackFrame) {
-        return false; // Skip this frame
-    }
+        // A video decoder moved the shared reader in the meantime, the next call positions the audio again
+        if (packetSerial != m_audioSerial) {
+            av_packet_unref(&packet);
+            break;
+        }
 
-    // Check if the frame is too early
-    if (adjustedFramePTS > currentPlaybackFrame) {
-        double frameTimeDifference = adjustedFramePTS - currentPlaybackFrame;
-        double targetDelayTime = frameTimeDifference / av_q2d(videoSegment->fps); // Time delay in seconds
-        SDL_Delay(static_cast<Uint32>(targetDelayTime * 1000));  // Delay in milliseconds
-    }
+        // Send packet to the decoder
+        int ret = avcodec_send_packet(audioData->codecContext, &packet);
+        av_packet_unref(&packet);
+        if (ret < 0) continue;
 
-    // Allocate buffer for rgbFrame if not already done
-    if (!videoSegment->videoData->rgbFrame->data[0]) {
-        int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24,
-            videoSegment->videoData->codecContext->width,
-            videoSegment->videoData->codecContext->height, 1);
-        uint8_t* buffer = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
-        av_image_fill_arrays(videoSegment->videoData->rgbFrame->data,
-            videoSegment->videoData->rgbFrame->linesize,
-            buffer, AV_PIX_FMT_RGB24,
-            videoSegment->videoData->codecContext->width,
-            videoSegment->videoData->codecContext->height, 1);
-    }
+        // Receive the audio frames from the decoder
+        while (avcodec_receive_frame(audioData->codecContext, audioData->frame) == 0) {
+            AVFrame* frame = audioData->frame;
 
-    // Convert the frame from YUV to RGB
-    sws_scale(videoSegment->videoData->swsContext,
-        videoSegment->videoData->frame->data,
-        videoSegment->videoData->frame->linesize,
-        0,
-        videoSegment->videoData->codecContext->height,
-        videoSegment->videoData->rgbFrame->data,
-        videoSegment->videoData->rgbFrame->linesize);
+            // Calculate the frame's start and end time in seconds
+            double frameTime = frame->best_effort_timestamp * av_q2d(timeBase);
+            double frameEndTime = frameTime + static_cast<double>(frame->nb_samples) / frame->sample_rate;
 
-    return true;
-}
+            // Check if the audio segment duration is reached
+            if (frameTime >= endTime) {
+                m_isAudioSegmentDone = true;
+                break;
+            }
 
-void VideoPlayerWindow::playAudioSegment(AudioSegment* audioSegment) {
-    if (!audioSegment) {
-        std::cerr << "Invalid audio segment" << std::endl;
-        return;
-    }
+            // Skip audio that was already played (decoding starts at the keyframe before a seek target)
+            if (frameEndTime <= m_nextAudioTime) continue;
 
-    Uint32 startFrameIndex = audioSegment->sourceStartTime;
-    Uint32 endFrameIndex = startFrameIndex + audioSegment->duration;
+            // Check if the audio frame is valid
+            if (!frame->data[0]) {
+                std::cerr << "Invalid audio frame" << std::endl;
+                return;
+            }
 
-    // Seek to the beginning of the segment if this is a new segment
-    if (m_lastAudioSegment != audioSegment || audioSegment->timelinePosition != m_lastAudioSegmentPos) {
-        // Get the timestamp in the stream's time base
-        AVRational timeBase = audioSegment->audioData->formatContext->streams[audioSegment->audioData->streamIndex]->time_base;
+            // Resample and convert audio to SDL format
+            int numSamples = swr_convert(audioData->swrContext,
+                &m_audioBuffer,                 // output buffer
+                frame->nb_samples * 2,          // number of samples to output (2 for stereo)
+                (const uint8_t**)frame->data,   // input buffer
+                frame->nb_samples);             // number of input samples
 
-        Uint32 currentFrame = m_timeline->getCurrentTime() - audioSegment->timelinePosition;
-        // Convert the desired frame number to a timestamp
-        int64_t startTimestamp   = av_rescale_q(startFrameIndex, { 1, m_timeline->getFPS() }, timeBase);
-        int64_t currentTimestamp = av_rescale_q(currentFrame,    { 1, m_timeline->getFPS() }, timeBase);
+            if (numSamples < 0) {
+                std::cerr << "Error in resampling audio" << std::endl;
+                return;
+            }
 
-        if (currentTimestamp > startTimestamp) {
-            startTimestamp = currentTimestamp;
-        }
+            int bufferSize = numSamples * av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) * 2; // 2 channels (assuming stereo)
 
-        if (av_seek_frame(audioSegment->audioData->formatContext, audioSegment->audioData->streamIndex, startTimestamp, AVSEEK_FLAG_BACKWARD) < 0) {
-            std::cerr << "Error seeking audio to timestamp: " << startTimestamp << std::endl;
-            return;
+            // Queue audio data to SDL
+            if (bufferSize > 0 && SDL_QueueAudio(m_audioDevice, m_audioBuffer, bufferSize) < 0) {
+                std::cerr << "Error queueing audio: " << SDL_GetError() << std::endl;
+            }
+            m_nextAudioTime = frameEndTime;
         }
+    }
 
-        // Flush the codec context buffers to clear any data from previous audio frames.
-        avcodec_flush_buffers(audioSegment->audioData->codecContext);
+    SDL_PauseAudioDevice(m_audioDevice, 0); // Unpause audio
 
-        // Clear the audio queue
-        SDL_ClearQueuedAudio(m_audioDevice);
-
-        m_lastAudioSegment = audioSegment;
-        m_lastAudioSegmentPos = audioSegment->timelinePosition;
-    }
+    static Metrics::Gauge& audioQueued = Metrics::shared().gauge("audio.queuedMs");
+    Uint32 queuedBytes = SDL_GetQueuedAudioSize(m_audioDevice);
+    audioQueued.set(queuedBytes * 1000ll / (44100 * 2 * 2));
+    m_wasAudioQueued = queuedBytes > 0;
+}
 
-    // Decode audio frames and play them until reaching the end of the segment duration
-    AVPacket packet;
-    while (av_read_frame(audioSegment->audioData->formatContext, &packet) >= 0) {
-        if (packet.stream_index == audioSegment->audioData->streamIndex) {
-            // Send packet to the decoder
-            int ret = avcodec_send_packet(audioSegment->audioData->codecContext, &packet);
-            if (ret < 0) break;
-            while (ret >= 0) {
-                // Receive the audio frame from the decoder
-                ret = avcodec_receive_frame(audioSegment->audioData->codecContext, audioSegment->audioData->frame);
-
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-                if (ret < 0) return;
-
-                // Calculate the frame's presentation timestamp (in frame index)
-                int64_t currentFrameIndex = audioSegment->audioData->frame->pts;
-
-                if (currentFrameIndex > endFrameIndex) break;
-
-                // Check if the audio frame is valid
-                if (!audioSegment->audioData->frame || !audioSegment->audioData->frame->data[0]) {
-                    std::cerr << "Invalid audio frame" << std::endl;
-                    return;
-                }
-
-                // Resample and convert audio to SDL format
-                int numSamples = swr_convert(audioSegment->audioData->swrContext,
-                    &m_audioBuffer,                                        // output buffer
-                    audioSegment->audioData->frame->nb_samples * 2,        // number of samples to output (2 for stereo)
-                    (const uint8_t**)audioSegment->audioData->frame->data, // input buffer
-                    audioSegment->audioData->frame->nb_samples);           // number of input samples
-
-                if (numSamples < 0) {
-                    std::cerr << "Error in resampling audio" << std::endl;
-                    return;
-                }
-
-                int bufferSize = numSamples * av_get_bytes_per_sample(AV_SAMPLE_FMT_S16) * 2; // 2 channels (assuming stereo)
-
-                // Ensure the buffer is valid before queueing
-                if (bufferSize <= 0) {
-                    std::cerr << "Buffer size is 0, not queuing audio." << std::endl;
-                }
-
-                // Queue audio data to SDL
-                if (SDL_QueueAudio(m_audioDevice, m_audioBuffer, bufferSize) < 0) {
-                    std::cerr << "Error queueing audio: " << SDL_GetError() << std::endl;
-                }
-
-                // Check if the audio segment duration is reached
-                if (currentFrameIndex >= endFrameIndex) {
-                    SDL_PauseAudioDevice(m_audioDevice, 1); // Pause audio if end of segment is reached
-                    break;
-                }
-                else {
-                    SDL_PauseAudioDevice(m_audioDevice, 0); // Unpause audio
-                }
-            }
-        }
-        av_packet_unref(&packet);
+void VideoPlayerWindow::renderMetricsOverlay() {
+    Metrics& metrics = Metrics::shared();
+    static Metrics::Counter& framesPresented = metrics.counter("player.framesPresented");
+    static Metrics::Counter& framesSkipped = metrics.counter("player.framesSkipped");
+    static Metrics::Counter& framesRepeated = metrics.counter("player.framesRepeated");
+    static Metrics::Counter& framesDropped = metrics.counter("decoder.framesDropped");
+    static Metrics::Counter& seeks = metrics.counter("decoder.seeks");
+    static Metrics::Counter& seeksFrameBehind = metrics.counter("decoder.seeksFrameBehind");
+    static Metrics::Counter& audioSeeks = metrics.counter("audio.seeks");
+    static Metrics::Counter& underruns = metrics.counter("audio.underruns");
+    static Metrics::Gauge& audioQueued = metrics.gauge("audio.queuedMs");
+    static Metrics::Gauge& queuedJobs = metrics.gauge("threadPool.queuedJobs");
+    static Metrics::Histogram& decodeTime = metrics.histogram("decoder.frameMs");
+    static Metrics::Histogram& frameTime = metrics.histogram("player.frameMs");
+
+    // The overlay is as tall as the list of lines
+    std::vector<std::string> lines;
+    char text[128];
+    snprintf(text, sizeof(text), "Frames: %llu shown, %llu skipped, %llu repeated", static_cast<unsigned long long>(framesPresented.get()),
+        static_cast<unsigned long long>(framesSkipped.get()), static_cast<unsigned long long>(framesRepeated.get()));
+    lines.push_back(text);
+    snprintf(text, sizeof(text), "Decoder: %llu frames dropped as too late", static_cast<unsigned long long>(framesDropped.get()));
+    lines.push_back(text);
+    snprintf(text, sizeof(text), "Seeks: %llu video (%llu fell behind), %llu audio", static_cast<unsigned long long>(seeks.get()),
+        static_cast<unsigned long long>(seeksFrameBehind.get()), static_cast<unsigned long long>(audioSeeks.get()));
+    lines.push_back(text);
+    snprintf(text, sizeof(text), "Decode: %.2f ms mean, %.2f p95, %.2f max", decodeTime.getMean(), decodeTime.getPercentile(0.95), decodeTime.getMax());
+    lines.push_back(text);
+    snprintf(text, sizeof(text), "Composite: %.2f ms mean, %.2f p95, %.2f max", frameTime.getMean(), frameTime.getPercentile(0.95), frameTime.getMax());
+    lines.push_back(text);
+    snprintf(text, sizeof(text), "Audio: %lld ms queued, %llu underruns", static_cast<long long>(audioQueued.get()), static_cast<unsigned long long>(underruns.get()));
+    lines.push_back(text);
+    snprintf(text, sizeof(text), "Thread pool: %lld jobs queued (max %lld)", static_cast<long long>(queuedJobs.get()), static_cast<long long>(queuedJobs.getMax()));
+    lines.push_back(text);
+    int lineCount = static_cast<int>(lines.size());
+
+    TTF_Font* font = getFontSmall();
+    int lineHeight = TTF_FontLineSkip(font);
+    SDL_Rect background = { m_videoRect.x + 6, m_videoRect.y + 6, 300, lineHeight * lineCount + 8 };
+    SDL_RenderSetClipRect(p_renderer, &rect);
+    SDL_SetRenderDrawBlendMode(p_renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(p_renderer, 0, 0, 0, 180);
+    SDL_RenderFillRect(p_renderer, &background);
+    SDL_SetRenderDrawBlendMode(p_renderer, SDL_BLENDMODE_NONE);
+    for (int i = 0; i < lineCount; i++) {
+        renderText(p_renderer, background.x + 6, background.y + 4 + i * lineHeight, font, lines[i].c_str());
     }
-    return;
+    SDL_RenderSetClipRect(p_renderer, nullptr);
 }
 
 Window* VideoPlayerWindow::findTypeImpl(const std::type_info& type) {
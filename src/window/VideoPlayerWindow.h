@@ -1,25 +1,40 @@
 #pragma once
 #include <SDL.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "Window.h"
 #include "Timeline.h"
+#include "Compositor.h"
 #include "EventManager.h"
 #include "VideoData.h"
+#include "DecoderPool.h"
+#include "PrefetchScheduler.h"
+#include "RenderCache.h"
+#include "FrameCache.h"
 
 /**
  * @class VideoPlayerWindow
- * @brief Window segment that can render videos.
+ * @brief Window segment that can render videos. Composites every visible video segment of the timeline.
  */
-class VideoPlayerWindow : public Window {
+class VideoPlayerWindow : public Window, public FrameProvider {
 public:
     VideoPlayerWindow(Timeline* timeline, int x, int y, int w, int h, SDL_Renderer* renderer, EventManager* eventManager, Window* parent = nullptr, SDL_Color color = { 83, 83, 83, 255 });
     ~VideoPlayerWindow();
 
     void render() override;
+    void renderOverlay() override;
     void update(int x, int y, int w, int h) override;
     void handleEvent(SDL_Event& event) override;
+    bool isDirty() override;
+    bool isAnimating() override;
     Window* findTypeImpl(const std::type_info& type) override;
 
+    // Decode the frame of a segment for the compositor, safe to call for different segments at the same time
+    bool getSegmentFrame(const VideoSegment& segment, Uint32 frameInSegment, LayerFrame& frame) override;
+
 private:
     // Set the video display Rect. Keeps the video resolution, regardless of window proportions.
     void setVideoRect(SDL_Rect* rect);
@@ -30,28 +45,45 @@ private:
     void playAudio();
     void pausePlayback();
 
-    void renderFrame(VideoSegment* videoSegment);
-    void renderFrameToScreen(VideoSegment* videoSegment);
+    // Composite the current timeline frame (if it changed) and draw it
+    void renderFrame();
+    void renderFrameToScreen();
+
+    // Decoder of a visible segment. Every segment leases its own, so segments decode independently (and in parallel during transitions).
+    struct SegmentDecoder {
+        DecoderLease lease;
+        bool hasFailed = false; // The pool could not open a decoder, don't retry every frame
+        Uint64 lastUsed = 0; // Value of m_renderCount when this segment was last composited
+        std::shared_ptr<const CachedFrame> cachedFrame; // Frame from the FrameCache handed to the compositor, held until the next frame
+    };
+
+    // Get the state of a visible segment, created on first use. Marks the segment as used in this frame.
+    SegmentDecoder* findSegmentDecoder(Uint32 segmentID);
+
+    // Get the decoder of a visible segment, leased from the DecoderPool on first use. The decoded frame is stored inside the decoder.
+    VideoDecoder* getSegmentDecoder(SegmentDecoder* segmentDecoder, const VideoSegment& segment, Uint32 frameInSegment);
 
-    // Get the current video frame from a videoSegment. The resulting frame is stored inside videoSegment.
-    bool getVideoFrame(VideoSegment* videoSegment);
+    // Return the decoders of segments that are not in layers to the pool, so the segments that are can pick them up
+    void releaseInactiveDecoders(const std::vector<VideoLayerRef>& layers);
 
-    // Decode and process video frames until we get the current frame, returns true if successfull
-    bool decodeAndProcessFrame(VideoSegment* videoSegment, Uint32 currentFrame);
+    void playAudioSegment(const AudioSegment* audioSegment);
 
-    // Process the current frame, returns true if successfull, false if this is not the right frame
-    bool processFrame(VideoSegment* videoSegment, Uint32 currentFrame);
+    // Queue the prefetched start of an audio segment from fromTime (source time in seconds). Returns true if it was queued.
+    bool queueAudioPreroll(const AudioSegment* audioSegment, double fromTime);
 
-    void playAudioSegment(AudioSegment* audioSegment);
+    // Once all audio of a segment is queued, continue with the segment right after it, so the cut plays without a gap
+    void handOffToNextAudioSegment(const AudioSegment* audioSegment);
 
-    Uint32 getCurrentTimeInSegment(VideoSegment* segment) {
-        return m_timeline->getCurrentTime() - segment->timelinePosition + segment->sourceStartTime;
-    }
+    // Draw the playback health metrics over the top-left of the video
+    void renderMetricsOverlay();
 
 private:
     SDL_Texture* m_videoTexture = nullptr; // Texture for the video frame
+    int m_videoTextureWidth = 0;
+    int m_videoTextureHeight = 0;
     VideoData* m_videoData = nullptr; // Holds pointers to all VideoData for ffmpeg to be able to read frames
     Timeline* m_timeline = nullptr; // Pointer towards the timeline
+    std::shared_ptr<const TimelineSnapshot> m_snapshot; // Timeline state being played, acquired once per rendered frame
     SDL_Rect m_videoRect; // Rectangle to display the video in
     int m_WtoH_ratioW = 16; // Width to height ratio: width (default 1920:1080 = 16:9)
     int m_WtoH_ratioH = 9; // Width to height ratio: height (default 1920:1080 = 16:9)
@@ -61,11 +93,32 @@ private:
     uint8_t* m_audioBuffer;
     int m_audioBufferSize;
 
-    VideoSegment* m_lastVideoSegment = nullptr;
-    AudioSegment* m_lastAudioSegment = nullptr;
-    VideoSegment* m_startVideoSegment = nullptr;
-    Uint32 m_lastVideoSegmentFrame = UINT32_MAX;
+    std::unordered_map<Uint32, SegmentDecoder> m_segmentDecoders; // Keyed by segmentID
+    std::mutex m_segmentDecodersMutex; // Guards m_segmentDecoders, the compositor asks for segment frames from several threads
+    bool m_isPlaying = false; // Whether the timeline was playing when the current frame was composited
+
+    Compositor m_compositor;
+    CompositeFrame m_compositeFrame;
+    std::vector<VideoLayerRef> m_layers; // What every track shows at the current frame, computed once per frame and reused
+    bool m_hasFrame = false; // Whether m_compositeFrame holds any segment
+    bool m_isTextureStale = false; // Whether m_compositeFrame changed since it was uploaded to m_videoTexture
+    Uint64 m_renderCount = 0;
+    Uint32 m_lastRenderedTime = UINT32_MAX;
+    Uint64 m_lastRenderedVersion = 0;
+
+    // Segments are identified by segmentID, since every snapshot holds its own copies of them (0 = none)
+    Uint32 m_lastAudioSegmentID = 0;
     Uint32 m_lastAudioSegmentPos = 0;
-    double m_frameDropThreshold = 1; // Allow being one frame behind
-    int m_framebehindSeekThreshold = 30; // We need to be at least 10 frames behind to use av_seek_frame over just skipping frames one by one.
+    double m_nextAudioTime = 0.0; // Source time in seconds up to which audio is queued
+    bool m_isAudioSegmentDone = false; // All audio of the current segment is queued
+    bool m_isAudioPositioned = false; // The shared reader is positioned for the current segment
+    Uint32 m_audioSerial = 0; // Serial of the audio stream in the shared reader when the audio was last positioned
+    double m_audioSeekTolerance = 1.0; // Seconds the shared reader may be behind the wanted audio to continue instead of seeking
+    Uint32 m_audioQueueTarget = 44100 * 2 * 2 / 5; // Bytes of audio to keep queued (0.2 seconds)
+    Uint32 m_handedOffSegmentID = 0; // Segment still under the playhead whose audio is fully queued, the queue continues with m_lastAudioSegmentID
+    bool m_wasAudioQueued = false; // Audio of the current segment was left queued last frame, an empty queue now is an underrun
+
+    bool m_isMetricsOverlayVisible = false; // Toggled with F8
+
+    PrefetchScheduler m_prefetch; // Prepares the segments right ahead of the playhead
 };
\ No newline at end of file
@@ -15,6 +15,33 @@ void Window::render() {
 
 void Window::update(int x, int y, int w, int h) {
     rect = { x, y, w, h };
+    invalidate();
+}
+
+bool Window::renderIfDirty() {
+    if (!isDirty()) return false;
+    p_isDirty = false;
+    if (rect.w <= 0 || rect.h <= 0) return false;
+
+    // Neighbours are not drawn again, so nothing may be drawn over them
+    SDL_RenderSetClipRect(p_renderer, &rect);
+    render();
+    SDL_RenderSetClipRect(p_renderer, nullptr);
+    return true;
+}
+
+void Window::renderOverlay() { }
+
+void Window::invalidate() {
+    p_isDirty = true;
+}
+
+bool Window::isDirty() {
+    return p_isDirty;
+}
+
+bool Window::isAnimating() {
+    return false;
 }
 
 void Window::handleEvent(SDL_Event& event) { }
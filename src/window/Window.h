@@ -5,6 +5,8 @@
 /**
  * @class Window
  * @brief Basic empty window segment.
+ *        What a window draws is kept in the application's frame between frames, a window is only drawn again when it is dirty:
+ *        after invalidate() (e.g. on input that changes it, or a new size), or when isDirty() sees its data changed.
  */
 class Window {
 public:
@@ -13,6 +15,24 @@ public:
 
     virtual void render();
     virtual void update(int x, int y, int w, int h);
+
+    /**
+     * @brief Draw the window (clipped to its rect) if it is dirty, and then mark it clean. Splits only draw their dirty children.
+     * @returns Whether anything was drawn.
+     */
+    virtual bool renderIfDirty();
+
+    // Draw what changes every frame over the kept frame (e.g. the playhead), it is not kept itself
+    virtual void renderOverlay();
+
+    // Mark the window (and every window in it) to be drawn again
+    virtual void invalidate();
+
+    // Whether the window (or a window in it) has to be drawn again
+    virtual bool isDirty();
+
+    // Whether the window (or a window in it) changes every frame by itself (e.g. during playback), so frames can't wait for input
+    virtual bool isAnimating();
     /**
      * @brief Handle user events.
      * @param event User interaction event code.
@@ -36,6 +56,7 @@ protected:
     SDL_Renderer* p_renderer;
     EventManager* p_eventManager;
     SDL_Color p_color;
+    bool p_isDirty = true; // Drawn again on the next frame
 };
 
 template<typename T>
@@ -37,6 +37,46 @@ void WindowHSplit::render() {
     SDL_RenderFillRect(p_renderer, &m_divider);
 }
 
+bool WindowHSplit::renderIfDirty() {
+    // Only the children that changed, the rest of the frame is kept
+    bool isDrawn = false;
+    if (p_isDirty) {
+        p_isDirty = false;
+        isDrawn = true; // Invalidating a split invalidates its children too, so they are all drawn below
+        SDL_RenderSetClipRect(p_renderer, &rect);
+        Window::render();
+        SDL_RenderSetClipRect(p_renderer, nullptr);
+    }
+    if (m_topWindow->renderIfDirty()) isDrawn = true;
+    if (m_bottomWindow->renderIfDirty()) isDrawn = true;
+
+    // The divider may be overlapped by a child that was drawn again
+    if (isDrawn) {
+        SDL_SetRenderDrawColor(p_renderer, m_dividerColor.r, m_dividerColor.g, m_dividerColor.b, m_dividerColor.a);
+        SDL_RenderFillRect(p_renderer, &m_divider);
+    }
+    return isDrawn;
+}
+
+void WindowHSplit::renderOverlay() {
+    m_topWindow->renderOverlay();
+    m_bottomWindow->renderOverlay();
+}
+
+void WindowHSplit::invalidate() {
+    Window::invalidate();
+    m_topWindow->invalidate();
+    m_bottomWindow->invalidate();
+}
+
+bool WindowHSplit::isDirty() {
+    return p_isDirty || m_topWindow->isDirty() || m_bottomWindow->isDirty();
+}
+
+bool WindowHSplit::isAnimating() {
+    return m_topWindow->isAnimating() || m_bottomWindow->isAnimating();
+}
+
 void WindowHSplit::update(int x, int y, int w, int h) {
     int heightDiff = rect.h - h;
     int heightChange = heightDiff * m_topWindow->rect.h / rect.h;
@@ -66,6 +106,7 @@ void WindowHSplit::handleEvent(SDL_Event& event) {
                 m_divider.y = newMiddle;
                 m_topWindow->update(m_topWindow->rect.x, m_topWindow->rect.y, m_topWindow->rect.w, newMiddle);
                 m_bottomWindow->update(m_bottomWindow->rect.x, newMiddle + m_dividerThickness, m_bottomWindow->rect.w, rect.h - newMiddle - m_dividerThickness);
+                invalidate(); // The divider moved
             }
             else if (SDL_PointInRect(&mouseMotion, &m_divider)) {
                 SDL_SetCursor(SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_SIZENS));
@@ -16,6 +16,11 @@ public:
     void render() override;
     void update(int x, int y, int w, int h) override;
     void handleEvent(SDL_Event& event) override;
+    bool renderIfDirty() override;
+    void renderOverlay() override;
+    void invalidate() override;
+    bool isDirty() override;
+    bool isAnimating() override;
     Window* findTypeImpl(const std::type_info& type) override;
 
     void setTopWindow(Window* window);
@@ -35,6 +35,43 @@ void WindowVSplit::render() {
     SDL_RenderFillRect(p_renderer, &m_divider);
 }
 
+bool WindowVSplit::renderIfDirty() {
+    // Only the children that changed, the rest of the frame is kept
+    bool isDrawn = false;
+    if (p_isDirty) {
+        p_isDirty = false;
+        isDrawn = true; // Invalidating a split invalidates its children too, so they are all drawn below
+    }
+    if (m_leftWindow->renderIfDirty()) isDrawn = true;
+    if (m_rightWindow->renderIfDirty()) isDrawn = true;
+
+    // The divider may be overlapped by a child that was drawn again
+    if (isDrawn) {
+        SDL_SetRenderDrawColor(p_renderer, m_dividerColor.r, m_dividerColor.g, m_dividerColor.b, m_dividerColor.a);
+        SDL_RenderFillRect(p_renderer, &m_divider);
+    }
+    return isDrawn;
+}
+
+void WindowVSplit::renderOverlay() {
+    m_leftWindow->renderOverlay();
+    m_rightWindow->renderOverlay();
+}
+
+void WindowVSplit::invalidate() {
+    Window::invalidate();
+    m_leftWindow->invalidate();
+    m_rightWindow->invalidate();
+}
+
+bool WindowVSplit::isDirty() {
+    return p_isDirty || m_leftWindow->isDirty() || m_rightWindow->isDirty();
+}
+
+bool WindowVSplit::isAnimating() {
+    return m_leftWindow->isAnimating() || m_rightWindow->isAnimating();
+}
+
 void WindowVSplit::update(int x, int y, int w, int h) {
     int widthDiff = rect.w - w;
     int widthChange = widthDiff * m_leftWindow->rect.w / rect.w;
@@ -64,6 +101,7 @@ void WindowVSplit::handleEvent(SDL_Event& event) {
                 m_divider.x = newMiddle;
                 m_leftWindow->update(m_leftWindow->rect.x, m_leftWindow->rect.y, newMiddle, m_leftWindow->rect.h);
                 m_rightWindow->update(newMiddle + m_dividerThickness, m_rightWindow->rect.y, rect.w - newMiddle - m_dividerThickness, m_rightWindow->rect.h);
+                invalidate(); // The divider moved
             }
             else if (SDL_PointInRect(&mouseMotion, &m_divider)) {
                 SDL_SetCursor(SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_SIZEWE));